@@ -21,7 +21,10 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/time.h>
 
 #include "azimuth/control/paused.h"
 #include "azimuth/control/util.h"
@@ -32,11 +35,14 @@
 #include "azimuth/state/dialog.h"
 #include "azimuth/state/planet.h"
 #include "azimuth/state/player.h"
+#include "azimuth/state/replay.h"
 #include "azimuth/state/save.h"
 #include "azimuth/state/space.h"
 #include "azimuth/tick/script.h"
 #include "azimuth/tick/space.h"
+#include "azimuth/util/key.h"
 #include "azimuth/util/misc.h"
+#include "azimuth/util/random.h"
 #include "azimuth/view/space.h"
 
 /*===========================================================================*/
@@ -77,7 +83,7 @@ static void begin_saved_game(
   if (saved_game->present) {
     // Resume saved game:
     state.ship.player = saved_game->player;
-    az_enter_room(&state, &planet->rooms[state.ship.player.current_room]);
+    az_enter_room(&state, state.ship.player.current_room);
     position_ship_at_save_point_if_any();
     az_after_entering_room(&state);
     state.console_help_message_cooldown = 10.0;
@@ -90,13 +96,105 @@ static void begin_saved_game(
   }
 }
 
+/*===========================================================================*/
+// Replay recording and playback (see state/replay.h):
+
+static const char *record_path = NULL;
+// Non-NULL while we're recording the current session:
+static FILE *record_file = NULL;
+// Non-NULL while we're playing back a replay, in which case the next record
+// (if any) has already been read into next_record:
+static FILE *replay_file = NULL;
+static bool has_next_record = false;
+static az_replay_record_t next_record;
+
+static void stop_recording(void) {
+  if (record_file == NULL) return;
+  if (fclose(record_file) != 0) {
+    printf("Failed to finish writing replay to %s\n", record_path);
+  }
+  record_file = NULL;
+}
+
+static void begin_recording(const az_saved_games_t *saved_games,
+                            const az_preferences_t *prefs,
+                            int saved_game_index) {
+  assert(record_file == NULL);
+  if (record_path == NULL || replay_file != NULL) return;
+  // Make sure that whatever was recorded gets flushed to disk even if the
+  // player quits the game in the middle of the session.
+  static bool registered_atexit = false;
+  if (!registered_atexit) {
+    atexit(stop_recording);
+    registered_atexit = true;
+  }
+  const az_replay_start_t start = {
+    .saved_game_index = saved_game_index,
+    .saved_game = saved_games->games[saved_game_index],
+    .prefs = *prefs, .seed = az_get_global_random_seed()
+  };
+  record_file = fopen(record_path, "wb");
+  if (record_file == NULL || !az_write_replay_start(&start, record_file)) {
+    printf("Failed to start recording replay to %s\n", record_path);
+    stop_recording();
+  }
+}
+
+static void write_record(const az_replay_record_t *record) {
+  if (record_file == NULL) return;
+  if (!az_write_replay_record(record, record_file)) {
+    printf("Failed to write replay to %s; recording stopped.\n",
+           record_path);
+    stop_recording();
+  }
+}
+
+static void record_pause(const az_preferences_t *prefs) {
+  az_replay_record_t pause_record = { .kind = AZ_RPR_PAUSE };
+  pause_record.data.pause.player = state.ship.player;
+  pause_record.data.pause.prefs = *prefs;
+  write_record(&pause_record);
+}
+
+static void record_key(az_key_id_t key_id) {
+  az_replay_record_t key_record = { .kind = AZ_RPR_KEY };
+  key_record.data.key = key_id;
+  write_record(&key_record);
+}
+
+static void advance_replay(void) {
+  assert(replay_file != NULL);
+  has_next_record = az_read_replay_record(replay_file, &next_record);
+}
+
+void az_set_space_record_path(const char *path) {
+  record_path = path;
+}
+
+/*===========================================================================*/
+
+// True if we've started a background save from a save point, and should
+// report its result to the player once it finishes.
+static bool awaiting_save_result = false;
+
 static bool save_current_game(az_saved_games_t *saved_games) {
   assert(state.save_file_index >= 0);
   assert(state.save_file_index < AZ_ARRAY_SIZE(saved_games->games));
   az_saved_game_t *saved_game = &saved_games->games[state.save_file_index];
   saved_game->present = true;
   saved_game->player = state.ship.player;
-  return az_save_saved_games(saved_games);
+  // Never touch the player's real save file during playback.
+  if (replay_file != NULL) return true;
+  return az_begin_saving_saved_games(saved_games);
+}
+
+static bool poll_saving_games(bool *success_out) {
+  // During playback, pretend that saves finish immediately.
+  if (replay_file != NULL) {
+    *success_out = true;
+    return true;
+  }
+  return az_poll_saving_games(success_out);
 }
 
 static void update_controls(const az_preferences_t *prefs) {
@@ -116,24 +214,164 @@ static void update_controls(const az_preferences_t *prefs) {
     az_is_key_held(prefs->keys[AZ_PREFS_UTIL_KEY_INDEX]);
 }
 
-az_space_action_t az_space_event_loop(
+static void on_key_down(const az_preferences_t *prefs, az_key_id_t key_id) {
+  if (state.skip.allowed && !state.skip.active) {
+    assert(state.sync_vm.script != NULL);
+    if (key_id == prefs->keys[AZ_PREFS_PAUSE_KEY_INDEX]) {
+      if (state.skip.cooldown < 1.0) {
+        state.skip.cooldown = 4.0;
+      } else {
+        state.skip.active = true;
+        state.skip.cooldown = 0.0;
+      }
+    } else if (key_id == AZ_KEY_RETURN) {
+      state.skip.cooldown = (state.skip.cooldown > 0.0 ? 4.0 : 0.3);
+    }
+  }
+  if (state.monologue.step != AZ_MLS_INACTIVE) {
+    if (state.monologue.step == AZ_MLS_TALK) {
+      state.monologue.step = AZ_MLS_WAIT;
+      state.monologue.progress = 0.0;
+      state.monologue.chars_to_print = state.monologue.paragraph_length;
+    } else if (state.monologue.step == AZ_MLS_WAIT &&
+               key_id == AZ_KEY_RETURN) {
+      assert(state.sync_vm.script != NULL);
+      az_resume_script(&state, &state.sync_vm);
+    }
+    return;
+  } else if (state.dialogue.step != AZ_DLS_INACTIVE) {
+    if (state.dialogue.step == AZ_DLS_TALK) {
+      state.dialogue.step = AZ_DLS_WAIT;
+      state.dialogue.progress = 0.0;
+      state.dialogue.chars_to_print = state.dialogue.paragraph_length;
+    } else if (state.dialogue.step == AZ_DLS_WAIT &&
+               key_id == AZ_KEY_RETURN) {
+      assert(state.sync_vm.script != NULL);
+      az_resume_script(&state, &state.sync_vm);
+    }
+    return;
+  } else if (state.mode == AZ_MODE_UPGRADE && !az_is_number_key(key_id)) {
+    if (state.upgrade_mode.step == AZ_UGS_MESSAGE) {
+      state.upgrade_mode.step = AZ_UGS_CLOSE;
+      state.upgrade_mode.progress = 0.0;
+    }
+    return;
+  } else if (state.mode == AZ_MODE_GAME_OVER) return;
+  // Handle the keystroke:
+  switch (key_id) {
+    case AZ_KEY_1: az_select_gun(&state.ship.player, AZ_GUN_CHARGE); break;
+    case AZ_KEY_2: az_select_gun(&state.ship.player, AZ_GUN_FREEZE); break;
+    case AZ_KEY_3: az_select_gun(&state.ship.player, AZ_GUN_TRIPLE); break;
+    case AZ_KEY_4: az_select_gun(&state.ship.player, AZ_GUN_HOMING); break;
+    case AZ_KEY_5: az_select_gun(&state.ship.player, AZ_GUN_PHASE);  break;
+    case AZ_KEY_6: az_select_gun(&state.ship.player, AZ_GUN_BURST);  break;
+    case AZ_KEY_7: az_select_gun(&state.ship.player, AZ_GUN_PIERCE); break;
+    case AZ_KEY_8: az_select_gun(&state.ship.player, AZ_GUN_BEAM);   break;
+    case AZ_KEY_9:
+      az_select_ordnance(&state.ship.player, AZ_ORDN_ROCKETS);
+      break;
+    case AZ_KEY_0:
+      az_select_ordnance(&state.ship.player, AZ_ORDN_BOMBS);
+      break;
+    default:
+      if (key_id == prefs->keys[AZ_PREFS_PAUSE_KEY_INDEX]) {
+        if (state.mode == AZ_MODE_NORMAL &&
+            state.cutscene.scene == AZ_SCENE_NOTHING &&
+            !state.ship.autopilot.enabled) {
+          state.mode = AZ_MODE_PAUSING;
+          state.pausing_mode = (az_pausing_mode_data_t){
+            .step = AZ_PSS_FADE_OUT, .fade_alpha = 0.0
+          };
+        }
+      } else if (key_id == prefs->keys[AZ_PREFS_UP_KEY_INDEX]) {
+        state.ship.controls.up_pressed = true;
+      } else if (key_id == prefs->keys[AZ_PREFS_DOWN_KEY_INDEX]) {
+        state.ship.controls.down_pressed = true;
+      } else if (key_id == prefs->keys[AZ_PREFS_FIRE_KEY_INDEX]) {
+        state.ship.controls.fire_pressed = true;
+      } else if (key_id == prefs->keys[AZ_PREFS_UTIL_KEY_INDEX]) {
+        state.ship.controls.util_pressed = true;
+      } else if (key_id == AZ_KEY_BACKTICK && az_is_tracking_allocs()) {
+        az_report_alloc_tracking();
+      }
+      break;
+  }
+}
+
+/*===========================================================================*/
+
+static double wall_seconds(void) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (double)now.tv_sec + 1e-6 * (double)now.tv_usec;
+}
+
+// Statistics gathered while playing back a replay:
+static struct {
+  int num_ticks;
+  bool diverged; // true if a tick's checksum didn't match the recording
+  double total_tick_seconds;
+  double max_tick_seconds;
+  int slowest_tick;
+} replay_stats;
+
+// Tick the state, taking the controls from the replay if we're playing one
+// back.  Returns false if the replay has run out of ticks or has diverged
+// from the recording.
+static bool tick_space_state(const az_preferences_t *prefs) {
+  if (replay_file != NULL) {
+    if (!has_next_record || next_record.kind != AZ_RPR_TICK) return false;
+    // Any *_pressed flags set by replayed keystrokes are already included
+    // in the recorded controls.
+    state.ship.controls = next_record.data.tick.controls;
+    const double start_time = wall_seconds();
+    az_tick_space_state(&state, 1.0/60.0);
+    const double elapsed = wall_seconds() - start_time;
+    const int tick = replay_stats.num_ticks++;
+    replay_stats.total_tick_seconds += elapsed;
+    if (elapsed > replay_stats.max_tick_seconds) {
+      replay_stats.max_tick_seconds = elapsed;
+      replay_stats.slowest_tick = tick;
+    }
+    if (az_space_state_checksum(&state) != next_record.data.tick.checksum) {
+      printf("Replay diverged from the recording at tick %d.\n", tick);
+      replay_stats.diverged = true;
+      return false;
+    }
+    advance_replay();
+  } else {
+    update_controls(prefs);
+    az_replay_record_t tick_record = { .kind = AZ_RPR_TICK };
+    tick_record.data.tick.controls = state.ship.controls;
+    az_tick_space_state(&state, 1.0/60.0);
+    if (record_file != NULL) {
+      tick_record.data.tick.checksum = az_space_state_checksum(&state);
+      write_record(&tick_record);
+    }
+  }
+  return true;
+}
+
+// Run the game until the session ends.  If we're playing back a replay, it
+// ends early (as though exiting to the title screen) once the replay runs out
+// or diverges.
+static az_space_action_t run_space_loop(
     const az_planet_t *planet, az_saved_games_t *saved_games,
-    az_preferences_t *prefs, int saved_game_index) {
-  begin_saved_game(planet, saved_games, prefs, saved_game_index);
+    az_preferences_t *prefs) {
+  awaiting_save_result = false;
 
   while (true) {
     // If we just finished the game intro, start us on the first room.
     if (state.intro && state.sync_vm.script == NULL) {
       state.intro = false;
       save_current_game(saved_games);
-      az_enter_room(&state, &planet->rooms[planet->start_room]);
+      az_enter_room(&state, planet->start_room);
       position_ship_at_save_point_if_any();
       az_after_entering_room(&state);
     }
 
     // Tick the state and redraw the screen.
-    update_controls(prefs);
-    az_tick_space_state(&state, 1.0/60.0);
+    if (!tick_space_state(prefs)) return AZ_SA_EXIT_TO_TITLE;
     az_tick_audio(&state.soundboard);
     az_start_screen_redraw(); {
       az_space_draw_screen(&state);
@@ -143,7 +381,10 @@ az_space_action_t az_space_event_loop(
     // Check the current mode; we may need to do something before we move on to
     // handling events.
     if (state.victory) {
+      if (replay_file != NULL) return AZ_SA_VICTORY;
+      stop_recording();
       az_victory_event_loop(saved_games, &state.ship.player);
+      az_report_script_profile();
       return AZ_SA_VICTORY;
     } else if (state.mode == AZ_MODE_GAME_OVER) {
       // If we're at the end of the game over animation, exit this controller
@@ -151,140 +392,129 @@ az_space_action_t az_space_event_loop(
       // controller.
       if (state.game_over_mode.step == AZ_GOS_FADE_OUT &&
           state.game_over_mode.progress >= 1.0) {
+        az_report_script_profile();
         return AZ_SA_GAME_OVER;
       }
     } else if (state.mode == AZ_MODE_PAUSING) {
       // If we're at the end of the pausing fade-out, directly engage the
       // paused screen controller, and once it's done, either resume the game
-      // or exit to the title screen, as appropriate.
+      // or exit to the title screen, as appropriate.  (When playing back a
+      // replay, we instead resume with whatever changes were made while the
+      // game was paused.)
       if (state.pausing_mode.step == AZ_PSS_FADE_OUT &&
           state.pausing_mode.fade_alpha == 1.0) {
-        switch (az_paused_event_loop(planet, prefs, &state.ship)) {
-          case AZ_PA_RESUME:
-            state.pausing_mode.step = AZ_PSS_FADE_IN;
-            break;
-          case AZ_PA_EXIT_TO_TITLE:
+        if (replay_file != NULL) {
+          if (!has_next_record || next_record.kind != AZ_RPR_PAUSE) {
             return AZ_SA_EXIT_TO_TITLE;
+          }
+          state.ship.player = next_record.data.pause.player;
+          *prefs = next_record.data.pause.prefs;
+          advance_replay();
+          state.pausing_mode.step = AZ_PSS_FADE_IN;
+        } else {
+          switch (az_paused_event_loop(planet, prefs, &state.ship)) {
+            case AZ_PA_RESUME:
+              state.pausing_mode.step = AZ_PSS_FADE_IN;
+              record_pause(prefs);
+              break;
+            case AZ_PA_EXIT_TO_TITLE:
+              az_report_script_profile();
+              return AZ_SA_EXIT_TO_TITLE;
+          }
         }
       }
     } else if (state.mode == AZ_MODE_CONSOLE &&
                state.console_mode.step == AZ_CSS_SAVE) {
-      // If we need to save the game, do so.
-      const bool ok = save_current_game(saved_games);
-      if (ok) az_set_message(&state, save_success_paragraph);
+      // If we need to save the game, start doing so; we'll report the result
+      // once the save finishes.
+      if (save_current_game(saved_games)) awaiting_save_result = true;
       else az_set_message(&state, save_failed_paragraph);
     }
 
-    // Handle the event queue.
+    // If a background save has finished, let the player know how it went.
+    bool save_ok;
+    if (poll_saving_games(&save_ok) && awaiting_save_result) {
+      awaiting_save_result = false;
+      az_set_message(&state, (save_ok ? save_success_paragraph :
+                              save_failed_paragraph));
+    }
+
+    // Handle the event queue.  During playback, the player's own keystrokes
+    // are ignored in favor of the recorded ones.
     az_event_t event;
     while (az_poll_event(&event)) {
       switch (event.kind) {
         case AZ_EVENT_KEY_DOWN:
-          if (state.skip.allowed && !state.skip.active) {
-            assert(state.sync_vm.script != NULL);
-            if (event.key.id == prefs->keys[AZ_PREFS_PAUSE_KEY_INDEX]) {
-              if (state.skip.cooldown < 1.0) {
-                state.skip.cooldown = 4.0;
-              } else {
-                state.skip.active = true;
-                state.skip.cooldown = 0.0;
-              }
-            } else if (event.key.id == AZ_KEY_RETURN) {
-              state.skip.cooldown = (state.skip.cooldown > 0.0 ? 4.0 : 0.3);
-            }
-          }
-          if (state.monologue.step != AZ_MLS_INACTIVE) {
-            if (state.monologue.step == AZ_MLS_TALK) {
-              state.monologue.step = AZ_MLS_WAIT;
-              state.monologue.progress = 0.0;
-              state.monologue.chars_to_print =
-                state.monologue.paragraph_length;
-            } else if (state.monologue.step == AZ_MLS_WAIT &&
-                       event.key.id == AZ_KEY_RETURN) {
-              assert(state.sync_vm.script != NULL);
-              az_resume_script(&state, &state.sync_vm);
-            }
-            break;
-          } else if (state.dialogue.step != AZ_DLS_INACTIVE) {
-            if (state.dialogue.step == AZ_DLS_TALK) {
-              state.dialogue.step = AZ_DLS_WAIT;
-              state.dialogue.progress = 0.0;
-              state.dialogue.chars_to_print = state.dialogue.paragraph_length;
-            } else if (state.dialogue.step == AZ_DLS_WAIT &&
-                       event.key.id == AZ_KEY_RETURN) {
-              assert(state.sync_vm.script != NULL);
-              az_resume_script(&state, &state.sync_vm);
-            }
-            break;
-          } else if (state.mode == AZ_MODE_UPGRADE &&
-                     !az_is_number_key(event.key.id)) {
-            if (state.upgrade_mode.step == AZ_UGS_MESSAGE) {
-              state.upgrade_mode.step = AZ_UGS_CLOSE;
-              state.upgrade_mode.progress = 0.0;
-            }
-            break;
-          } else if (state.mode == AZ_MODE_GAME_OVER) break;
-          // Handle the keystroke:
-          switch (event.key.id) {
-            case AZ_KEY_1:
-              az_select_gun(&state.ship.player, AZ_GUN_CHARGE);
-              break;
-            case AZ_KEY_2:
-              az_select_gun(&state.ship.player, AZ_GUN_FREEZE);
-              break;
-            case AZ_KEY_3:
-              az_select_gun(&state.ship.player, AZ_GUN_TRIPLE);
-              break;
-            case AZ_KEY_4:
-              az_select_gun(&state.ship.player, AZ_GUN_HOMING);
-              break;
-            case AZ_KEY_5:
-              az_select_gun(&state.ship.player, AZ_GUN_PHASE);
-              break;
-            case AZ_KEY_6:
-              az_select_gun(&state.ship.player, AZ_GUN_BURST);
-              break;
-            case AZ_KEY_7:
-              az_select_gun(&state.ship.player, AZ_GUN_PIERCE);
-              break;
-            case AZ_KEY_8:
-              az_select_gun(&state.ship.player, AZ_GUN_BEAM);
-              break;
-            case AZ_KEY_9:
-              az_select_ordnance(&state.ship.player, AZ_ORDN_ROCKETS);
-              break;
-            case AZ_KEY_0:
-              az_select_ordnance(&state.ship.player, AZ_ORDN_BOMBS);
-              break;
-            default:
-              if (event.key.id == prefs->keys[AZ_PREFS_PAUSE_KEY_INDEX]) {
-                if (state.mode == AZ_MODE_NORMAL &&
-                    state.cutscene.scene == AZ_SCENE_NOTHING &&
-                    !state.ship.autopilot.enabled) {
-                  state.mode = AZ_MODE_PAUSING;
-                  state.pausing_mode = (az_pausing_mode_data_t){
-                    .step = AZ_PSS_FADE_OUT, .fade_alpha = 0.0
-                  };
-                }
-              } else if (event.key.id == prefs->keys[AZ_PREFS_UP_KEY_INDEX]) {
-                state.ship.controls.up_pressed = true;
-              } else if (event.key.id ==
-                         prefs->keys[AZ_PREFS_DOWN_KEY_INDEX]) {
-                state.ship.controls.down_pressed = true;
-              } else if (event.key.id ==
-                         prefs->keys[AZ_PREFS_FIRE_KEY_INDEX]) {
-                state.ship.controls.fire_pressed = true;
-              } else if (event.key.id ==
-                         prefs->keys[AZ_PREFS_UTIL_KEY_INDEX]) {
-                state.ship.controls.util_pressed = true;
-              }
-              break;
-          }
+          if (replay_file != NULL) break;
+          record_key(event.key.id);
+          on_key_down(prefs, event.key.id);
           break;
         default: break;
       }
     }
+    if (replay_file != NULL) {
+      while (has_next_record && next_record.kind == AZ_RPR_KEY) {
+        on_key_down(prefs, next_record.data.key);
+        advance_replay();
+      }
+    }
   }
 }
 
+az_space_action_t az_space_event_loop(
+    const az_planet_t *planet, az_saved_games_t *saved_games,
+    az_preferences_t *prefs, int saved_game_index) {
+  begin_recording(saved_games, prefs, saved_game_index);
+  begin_saved_game(planet, saved_games, prefs, saved_game_index);
+  const az_space_action_t action = run_space_loop(planet, saved_games, prefs);
+  stop_recording();
+  return action;
+}
+
+bool az_space_replay_loop(const az_planet_t *planet, const char *path) {
+  assert(record_file == NULL);
+  assert(replay_file == NULL);
+  replay_file = fopen(path, "rb");
+  if (replay_file == NULL) {
+    printf("Failed to open replay %s\n", path);
+    return false;
+  }
+  // The replay uses its own copies of the saved games and preferences, so
+  // that the player's real ones are left alone.
+  static az_saved_games_t saved_games;
+  static az_preferences_t prefs;
+  az_replay_start_t start;
+  if (!az_read_replay_start(replay_file, &start)) {
+    printf("Failed to read replay %s\n", path);
+    fclose(replay_file);
+    replay_file = NULL;
+    return false;
+  }
+  az_reset_saved_games(&saved_games);
+  saved_games.games[start.saved_game_index] = start.saved_game;
+  prefs = start.prefs;
+  az_set_global_random_seed(start.seed);
+  AZ_ZERO_OBJECT(&replay_stats);
+  advance_replay();
+
+  begin_saved_game(planet, &saved_games, &prefs, start.saved_game_index);
+  run_space_loop(planet, &saved_games, &prefs);
+  // If the session ended with records still left over, the playback must
+  // have gone differently from the recording.
+  const bool success = !replay_stats.diverged && !has_next_record;
+  if (!replay_stats.diverged && has_next_record) {
+    printf("Replay ended early, after %d ticks.\n", replay_stats.num_ticks);
+  }
+  fclose(replay_file);
+  replay_file = NULL;
+  has_next_record = false;
+
+  printf("Replayed %d ticks: mean tick %.3f ms, max tick %.3f ms "
+         "(tick %d)\n", replay_stats.num_ticks,
+         (replay_stats.num_ticks == 0 ? 0.0 : 1000.0 *
+          replay_stats.total_tick_seconds / replay_stats.num_ticks),
+         1000.0 * replay_stats.max_tick_seconds, replay_stats.slowest_tick);
+  return success;
+}
+
 /*===========================================================================*/
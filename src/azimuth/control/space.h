@@ -21,6 +21,8 @@
 #ifndef AZIMUTH_CONTROL_SPACE_H_
 #define AZIMUTH_CONTROL_SPACE_H_
 
+#include <stdbool.h>
+
 #include "azimuth/state/planet.h"
 #include "azimuth/state/save.h"
 #include "azimuth/util/prefs.h"
@@ -37,6 +39,19 @@ az_space_action_t az_space_event_loop(
     const az_planet_t *planet, az_saved_games_t *saved_games,
     az_preferences_t *prefs, int saved_game_index);
 
+// If path is non-NULL, record each subsequent session of az_space_event_loop
+// as a replay at that path (replacing the previous session's replay, if any).
+// If path is NULL, stop recording sessions.  The path string must remain
+// valid for as long as it's in use.
+void az_set_space_record_path(const char *path);
+
+// Play back the replay at the given path, with the recorded inputs in place
+// of the player's, printing timing statistics when done.  Returns true if
+// the whole replay played back exactly as recorded, or false if it couldn't
+// be loaded or it diverged from the recording (in which case a message
+// reporting the tick of divergence is printed).
+bool az_space_replay_loop(const az_planet_t *planet, const char *path);
+
 /*===========================================================================*/
 
 #endif // AZIMUTH_CONTROL_SPACE_H_
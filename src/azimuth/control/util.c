@@ -26,6 +26,7 @@
 #include "azimuth/gui/audio.h"
 #include "azimuth/state/save.h"
 #include "azimuth/system/resource.h"
+#include "azimuth/util/misc.h"
 #include "azimuth/util/prefs.h"
 #include "azimuth/util/string.h"
 #include "azimuth/view/prefs.h"
@@ -40,7 +41,7 @@ void az_load_preferences(az_preferences_t *prefs) {
   if (!az_load_prefs_from_path(prefs_path, prefs)) {
     az_reset_prefs_to_defaults(prefs);
   }
-  free(prefs_path);
+  az_free(prefs_path);
 }
 
 bool az_save_preferences(const az_preferences_t *prefs) {
@@ -49,7 +50,7 @@ bool az_save_preferences(const az_preferences_t *prefs) {
   if (data_dir == NULL) return false;
   char *prefs_path = az_strprintf("%s/prefs.txt", data_dir);
   const bool success = az_save_prefs_to_path(prefs, prefs_path);
-  free(prefs_path);
+  az_free(prefs_path);
   return success;
 }
 
@@ -95,7 +96,7 @@ void az_load_saved_games(const az_planet_t *planet,
   if (!az_load_games_from_path(planet, save_path, saved_games)) {
     az_reset_saved_games(saved_games);
   }
-  free(save_path);
+  az_free(save_path);
 }
 
 bool az_save_saved_games(const az_saved_games_t *saved_games) {
@@ -104,8 +105,18 @@ bool az_save_saved_games(const az_saved_games_t *saved_games) {
   if (data_dir == NULL) return false;
   char *save_path = az_strprintf("%s/save.txt", data_dir);
   const bool success = az_save_games_to_path(saved_games, save_path);
-  free(save_path);
+  az_free(save_path);
   return success;
 }
 
+bool az_begin_saving_saved_games(const az_saved_games_t *saved_games) {
+  assert(saved_games != NULL);
+  const char *data_dir = az_get_app_data_directory();
+  if (data_dir == NULL) return false;
+  char *save_path = az_strprintf("%s/save.txt", data_dir);
+  az_begin_saving_games_to_path(saved_games, save_path);
+  az_free(save_path);
+  return true;
+}
+
 /*===========================================================================*/
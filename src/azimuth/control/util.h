@@ -39,6 +39,10 @@ void az_update_prefefences(const az_prefs_pane_t *pane,
 void az_load_saved_games(const az_planet_t *planet,
                          az_saved_games_t *saved_games);
 bool az_save_saved_games(const az_saved_games_t *saved_games);
+// Start saving the games on a background thread (see
+// az_begin_saving_games_to_path), and return true, or return false if the
+// save couldn't be started at all.
+bool az_begin_saving_saved_games(const az_saved_games_t *saved_games);
 
 /*===========================================================================*/
 
@@ -22,6 +22,7 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <SDL/SDL.h>
 
@@ -47,6 +48,19 @@ AZ_STATIC_ASSERT(AZ_AUDIO_RATE == 22050);
 // How many sound effects we can play simultaneously:
 #define MAX_SIMULTANEOUS_SOUNDS 16
 
+// How many samples of music the render thread may synthesize ahead of
+// playback (about 370 ms; must be a power of two):
+#define MUSIC_RING_SIZE 8192
+// How many samples of music the render thread synthesizes at a time:
+#define MUSIC_RENDER_CHUNK 512
+// The render thread won't begin a new part of the music until playback is at
+// most this many samples behind it, so that music flag changes take effect at
+// the next part boundary about as promptly as when we synthesized music
+// directly in the audio callback:
+#define MUSIC_PART_LOOKAHEAD (2 * AUDIO_BUFFERSIZE)
+// How long the render thread sleeps when it has nothing to do:
+#define MUSIC_RENDER_SLEEP_MILLIS 10
+
 /*===========================================================================*/
 // Globals:
 
@@ -57,19 +71,184 @@ AZ_STATIC_ASSERT(AZ_AUDIO_RATE == 22050);
 static int global_music_volume = MAX_VOLUME; // 0 to MAX_VOLUME
 static int global_sound_volume = MAX_VOLUME; // 0 to MAX_VOLUME
 
-static az_music_synth_t music_synth;
+static const az_music_t *current_music = NULL;
 static int music_fade_volume = 0; // 0 to MAX_VOLUME
 static int music_fade_slowdown = 0;
 static int music_fade_counter = 0;
 static const az_music_t *next_music = NULL;
 static int next_music_flag = 0;
 
+// Requests from the main thread and audio_callback to the music render
+// thread, and the render thread's responses.
 static struct {
+  // Incremented by audio_callback each time it switches to new music.
+  int generation;
+  const az_music_t *music;
+  int flag;
+  // A flag change for the music of the current generation:
+  bool change_flag;
+  int new_flag;
+  // The latest generation that the render thread has started rendering, and
+  // the value of music_ring_write at the moment it started.
+  int rendered_generation;
+  uint32_t generation_start;
+  bool quit;
+} music_control;
+
+typedef struct {
   const az_sound_data_t *data;
   size_t sample_index;
   int volume; // 0 to MAX_VOLUME
+  az_sound_priority_t priority;
+  unsigned long start_frame; // value of sound_frame when this started
   bool loop, persisted, paused, finished;
-} active_sounds[MAX_SIMULTANEOUS_SOUNDS];
+} az_active_sound_t;
+
+static az_active_sound_t active_sounds[MAX_SIMULTANEOUS_SOUNDS];
+
+// Counts calls to az_tick_audio, so we can tell which sounds are oldest.
+static unsigned long sound_frame = 0;
+
+static az_audio_stats_t audio_stats;
+
+/*===========================================================================*/
+// Music ring buffer:
+
+// The music render thread synthesizes music ahead of time into this ring
+// buffer, and audio_callback copies it out.  There is exactly one writer and
+// one reader, so no lock is needed: music_ring_write and music_ring_read count
+// the total number of samples ever written/read, only the render thread
+// stores to music_ring_write, and only audio_callback stores to
+// music_ring_read.
+static int16_t music_ring[MUSIC_RING_SIZE];
+static uint32_t music_ring_write = 0;
+static uint32_t music_ring_read = 0;
+
+#define LOAD_ACQUIRE(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(ptr, value) \
+  __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+
+// Called only from audio_callback.
+static void switch_music(const az_music_t *music, int flag) {
+  current_music = music;
+  ++music_control.generation;
+  music_control.music = music;
+  music_control.flag = flag;
+  music_control.change_flag = false;
+}
+
+// Called only from audio_callback.
+static void read_music(int16_t *samples, int num_samples) {
+  uint32_t read = music_ring_read;
+  const uint32_t write = LOAD_ACQUIRE(&music_ring_write);
+  if (music_control.rendered_generation != music_control.generation) {
+    // The render thread hasn't noticed the switch yet, so everything in the
+    // ring is left over from the old music; skip all of it.
+    STORE_RELEASE(&music_ring_read, write);
+    memset(samples, 0, num_samples * sizeof(int16_t));
+    return;
+  }
+  if ((int32_t)(music_control.generation_start - read) > 0) {
+    read = music_control.generation_start;
+  }
+  const int num_available = (int)(write - read);
+  assert(num_available >= 0 && num_available <= MUSIC_RING_SIZE);
+  const int num_copied = az_imin(num_available, num_samples);
+  for (int i = 0; i < num_copied; ++i) {
+    samples[i] = music_ring[(read + i) & (MUSIC_RING_SIZE - 1)];
+  }
+  if (num_copied < num_samples) {
+    memset(samples + num_copied, 0,
+           (num_samples - num_copied) * sizeof(int16_t));
+    if (current_music != NULL) {
+      AZ_WARNING_ONCE("Music render thread fell behind\n");
+    }
+  }
+  STORE_RELEASE(&music_ring_read, read + num_copied);
+}
+
+/*===========================================================================*/
+// Music render thread:
+
+// This is only ever touched by the render thread (and by az_init_audio before
+// the render thread starts).
+static az_music_synth_t music_synth;
+static SDL_Thread *music_render_thread = NULL;
+
+static int run_music_render_thread(void *unused) {
+  int generation = 0;
+  while (true) {
+    // Pick up any requests, holding the audio lock only long enough to copy
+    // them out.
+    bool reset = false, quit = false;
+    const az_music_t *music = NULL;
+    int flag = 0;
+    SDL_LockAudio(); {
+      quit = music_control.quit;
+      if (music_control.generation != generation) {
+        generation = music_control.generation;
+        music = music_control.music;
+        flag = music_control.flag;
+        reset = true;
+        music_control.rendered_generation = generation;
+        music_control.generation_start = music_ring_write;
+      }
+      // Since switch_music clears change_flag, any pending flag change is
+      // meant for the current generation, even if we just switched to it.
+      if (music_control.change_flag) {
+        if (reset) flag = music_control.new_flag;
+        else music_synth.flag = music_control.new_flag;
+        music_control.change_flag = false;
+      }
+    } SDL_UnlockAudio();
+    if (quit) break;
+    if (reset) az_reset_music_synth(&music_synth, music, flag);
+
+    // Don't begin the next part of the music until playback is nearly caught
+    // up, so that flag changes still take effect at the next part boundary.
+    // Anything from before the current generation started will be skipped
+    // by read_music, so it doesn't count towards what's buffered.
+    const uint32_t write = music_ring_write;
+    uint32_t read = LOAD_ACQUIRE(&music_ring_read);
+    if ((int32_t)(music_control.generation_start - read) > 0) {
+      read = music_control.generation_start;
+    }
+    const int num_buffered = (int)(write - read);
+    assert(num_buffered >= 0 && num_buffered <= MUSIC_RING_SIZE);
+    if (MUSIC_RING_SIZE - num_buffered < MUSIC_RENDER_CHUNK ||
+        (music_synth.part_finished &&
+         num_buffered > MUSIC_PART_LOOKAHEAD)) {
+      SDL_Delay(MUSIC_RENDER_SLEEP_MILLIS);
+      continue;
+    }
+
+    int16_t chunk[MUSIC_RENDER_CHUNK];
+    int num_rendered = az_synthesize_music_part(&music_synth, chunk,
+                                                MUSIC_RENDER_CHUNK);
+    if (num_rendered < MUSIC_RENDER_CHUNK && !music_synth.part_finished) {
+      // The music has stopped; fill the rest of the chunk with silence.
+      memset(chunk + num_rendered, 0,
+             (MUSIC_RENDER_CHUNK - num_rendered) * sizeof(int16_t));
+      num_rendered = MUSIC_RENDER_CHUNK;
+    }
+    for (int i = 0; i < num_rendered; ++i) {
+      music_ring[(write + i) & (MUSIC_RING_SIZE - 1)] = chunk[i];
+    }
+    STORE_RELEASE(&music_ring_write, write + num_rendered);
+  }
+  return 0;
+}
+
+static void stop_music_render_thread(void) {
+  SDL_LockAudio(); {
+    music_control.quit = true;
+  } SDL_UnlockAudio();
+  SDL_WaitThread(music_render_thread, NULL);
+  music_render_thread = NULL;
+}
+
+/*===========================================================================*/
+// Audio callback:
 
 static void audio_callback(void *userdata, Uint8 *bytes, int numbytes) {
   assert(numbytes % sizeof(int16_t) == 0);
@@ -77,14 +256,14 @@ static void audio_callback(void *userdata, Uint8 *bytes, int numbytes) {
   int16_t *samples = (int16_t*)bytes;
 
   if (next_music != NULL && music_fade_volume == 0) {
-    az_reset_music_synth(&music_synth, next_music, next_music_flag);
+    switch_music(next_music, next_music_flag);
     music_fade_volume = MAX_VOLUME;
     music_fade_slowdown = 0;
     music_fade_counter = 0;
     next_music = NULL;
     next_music_flag = 0;
   }
-  az_synthesize_music(&music_synth, samples, num_samples);
+  read_music(samples, num_samples);
 
   for (int i = 0; i < num_samples; ++i) {
     int sound_sample = 0;
@@ -121,8 +300,8 @@ static void audio_callback(void *userdata, Uint8 *bytes, int numbytes) {
       if (music_fade_counter == 0) {
         music_fade_counter = music_fade_slowdown;
         --music_fade_volume;
-        if (music_fade_volume == 0 && music_synth.music != NULL) {
-          az_reset_music_synth(&music_synth, NULL, 0);
+        if (music_fade_volume == 0 && current_music != NULL) {
+          switch_music(NULL, 0);
         }
       }
     }
@@ -132,17 +311,22 @@ static void audio_callback(void *userdata, Uint8 *bytes, int numbytes) {
 /*===========================================================================*/
 // Music:
 
+static void change_current_music_flag(int flag) {
+  music_control.change_flag = true;
+  music_control.new_flag = flag;
+}
+
 static void tick_music(const az_soundboard_t *soundboard) {
   if (soundboard->change_current_music_flag) {
-    music_synth.flag = soundboard->new_current_music_flag;
+    change_current_music_flag(soundboard->new_current_music_flag);
   }
   if (soundboard->change_music) {
-    if (soundboard->next_music == music_synth.music) {
+    if (soundboard->next_music == current_music) {
       music_fade_slowdown = 0;
       next_music = NULL;
       next_music_flag = 0;
       if (soundboard->change_next_music_flag) {
-        music_synth.flag = soundboard->new_next_music_flag;
+        change_current_music_flag(soundboard->new_next_music_flag);
       }
     } else {
       music_fade_slowdown =
@@ -159,7 +343,49 @@ static void tick_music(const az_soundboard_t *soundboard) {
 /*===========================================================================*/
 // Sound effects:
 
+// Returns true if active sound a should be stolen in preference to active
+// sound b: less important sounds go first, then quieter sounds, then older
+// sounds.
+static bool better_to_steal(const az_active_sound_t *a,
+                            const az_active_sound_t *b) {
+  if (a->priority != b->priority) return a->priority < b->priority;
+  if (a->volume != b->volume) return a->volume < b->volume;
+  return a->start_frame < b->start_frame;
+}
+
+// Finds a voice to play a new sound with the given priority and volume, and
+// resets it.  If all voices are in use, steals the voice of the least
+// important active one-shot sound, provided that it is no more important (and,
+// for equally important sounds, no louder) than the new sound.  Persisted
+// sounds are never stolen, since they would just restart on the next frame.
+// Returns NULL if no voice is available.
+static az_active_sound_t *find_voice(az_sound_priority_t priority,
+                                     int volume) {
+  az_active_sound_t *victim = NULL;
+  AZ_ARRAY_LOOP(sound, active_sounds) {
+    if (sound->data == NULL) {
+      victim = sound;
+      goto found;
+    }
+    if (sound->persisted) continue;
+    if (victim == NULL || better_to_steal(sound, victim)) victim = sound;
+  }
+  if (victim == NULL || victim->priority > priority ||
+      (victim->priority == priority && victim->volume > volume)) {
+    ++audio_stats.num_dropped;
+    return NULL;
+  }
+  ++audio_stats.num_stolen;
+ found:
+  AZ_ZERO_OBJECT(victim);
+  victim->start_frame = sound_frame;
+  return victim;
+}
+
 static void tick_sounds(const az_soundboard_t *soundboard) {
+  ++sound_frame;
+  audio_stats.num_dropped += soundboard->num_dropped;
+
   // First, go through each of the active persisted sounds and update their
   // status based on the soundboard.
   bool already_active[soundboard->num_persists];
@@ -192,37 +418,37 @@ static void tick_sounds(const az_soundboard_t *soundboard) {
   for (int i = 0; i < soundboard->num_persists; ++i) {
     if (already_active[i] || !soundboard->persists[i].play) continue;
     if (soundboard->persists[i].sound_data->num_samples == 0) continue;
-    bool success = false;
-    AZ_ARRAY_LOOP(sound, active_sounds) {
-      if (sound->data != NULL) continue;
-      sound->data = soundboard->persists[i].sound_data;
-      sound->sample_index = 0;
-      sound->volume = (int)(soundboard->persists[i].volume * MAX_VOLUME);
-      sound->loop = soundboard->persists[i].loop;
-      sound->persisted = true;
-      sound->paused = false;
-      success = true;
-      break;
+    const int volume = (int)(soundboard->persists[i].volume * MAX_VOLUME);
+    const az_sound_priority_t priority = soundboard->persists[i].priority;
+    az_active_sound_t *sound = find_voice(priority, volume);
+    if (sound == NULL) {
+      AZ_WARNING_ONCE("Could not play persistent sound\n");
+      continue;
     }
-    if (!success) AZ_WARNING_ONCE("Could not play persistent sound\n");
+    sound->data = soundboard->persists[i].sound_data;
+    sound->volume = volume;
+    sound->priority = priority;
+    sound->loop = soundboard->persists[i].loop;
+    sound->persisted = true;
   }
 
-  // Third, start playing any new one-shot sounds.
-  for (int i = 0; i < soundboard->num_oneshots; ++i) {
-    if (soundboard->oneshots[i].sound_data->num_samples == 0) continue;
-    bool success = false;
-    AZ_ARRAY_LOOP(sound, active_sounds) {
-      if (sound->data != NULL) continue;
+  // Third, start playing any new one-shot sounds, most important first (so
+  // that they get first dibs on any voices that need to be stolen).
+  for (int priority = AZ_SNDPRI_CRITICAL; priority >= AZ_SNDPRI_LOW;
+       --priority) {
+    for (int i = 0; i < soundboard->num_oneshots; ++i) {
+      if (soundboard->oneshots[i].priority != priority) continue;
+      if (soundboard->oneshots[i].sound_data->num_samples == 0) continue;
+      const int volume = (int)(soundboard->oneshots[i].volume * MAX_VOLUME);
+      az_active_sound_t *sound = find_voice(priority, volume);
+      if (sound == NULL) {
+        AZ_WARNING_ONCE("Could not play sound effect\n");
+        continue;
+      }
       sound->data = soundboard->oneshots[i].sound_data;
-      sound->sample_index = 0;
-      sound->volume = (int)(soundboard->oneshots[i].volume * MAX_VOLUME);
-      sound->loop = false;
-      sound->persisted = false;
-      sound->paused = false;
-      success = true;
-      break;
+      sound->volume = volume;
+      sound->priority = priority;
     }
-    if (!success) AZ_WARNING_ONCE("Could not play sound effect\n");
   }
 }
 
@@ -234,6 +460,10 @@ static bool audio_system_paused = false;
 
 void az_init_audio(void) {
   assert(!audio_system_initialized);
+  music_synth.oscillator = AZ_MUSIC_OSC_BANDLIMITED;
+  az_note_static_footprint("audio voices", sizeof(active_sounds));
+  az_note_static_footprint("music synth",
+                           sizeof(music_synth) + sizeof(music_ring));
 
   SDL_AudioSpec audio_spec = {
     .freq = AZ_AUDIO_RATE,
@@ -247,6 +477,12 @@ void az_init_audio(void) {
   }
 
   atexit(SDL_CloseAudio);
+
+  music_render_thread = SDL_CreateThread(run_music_render_thread, NULL);
+  if (music_render_thread == NULL) {
+    AZ_FATAL("SDL_CreateThread failed: %s\n", SDL_GetError());
+  }
+  atexit(stop_music_render_thread);
   audio_system_initialized = true;
 }
 
@@ -282,6 +518,10 @@ void az_tick_audio(az_soundboard_t *soundboard) {
   AZ_ZERO_OBJECT(soundboard);
 }
 
+void az_get_audio_stats(az_audio_stats_t *stats_out) {
+  *stats_out = audio_stats;
+}
+
 void az_pause_all_audio(void) {
   if (!audio_system_initialized) return;
   assert(!audio_system_paused);
@@ -37,6 +37,18 @@ void az_tick_audio(az_soundboard_t *soundboard);
 void az_set_global_music_volume(float volume);
 void az_set_global_sound_volume(float volume);
 
+// Running totals of sound effects that we were asked to play but couldn't.
+typedef struct {
+  // Sounds that were never played, because the soundboard or the mixer was
+  // full of sounds at least as important.
+  unsigned long num_dropped;
+  // Sounds that were cut off partway through to make room for a more
+  // important (or louder) sound.
+  unsigned long num_stolen;
+} az_audio_stats_t;
+
+void az_get_audio_stats(az_audio_stats_t *stats_out);
+
 /*===========================================================================*/
 
 // Initialize our audio system (once the GUI has been initialized).  This is
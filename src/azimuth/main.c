@@ -19,6 +19,7 @@
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <SDL/SDL.h> // for main() renaming
 
@@ -33,9 +34,11 @@
 #include "azimuth/state/planet.h"
 #include "azimuth/state/save.h"
 #include "azimuth/state/sound.h" // for az_init_sound_datas
+#include "azimuth/state/space.h" // for az_space_state_t
 #include "azimuth/state/wall.h" // for az_init_wall_datas
 #include "azimuth/system/resource.h"
-#include "azimuth/util/misc.h" // for AZ_ASSERT_UNREACHABLE
+#include "azimuth/tick/script.h" // for az_enable_script_profiling
+#include "azimuth/util/misc.h"
 #include "azimuth/util/prefs.h"
 #include "azimuth/view/dialog.h" // for az_init_portrait_drawing
 #include "azimuth/view/wall.h" // for az_init_wall_drawing
@@ -61,6 +64,25 @@ typedef enum {
 } az_controller_t;
 
 int main(int argc, char **argv) {
+  // Ignore any arguments we don't recognize (e.g. the -psn_* argument that
+  // Mac OS X passes to apps launched from the Finder).
+  const char *replay_path = NULL;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--profile-scripts") == 0) {
+      az_enable_script_profiling();
+    } else if (strcmp(argv[i], "--track-memory") == 0) {
+      az_enable_alloc_tracking();
+      atexit(az_report_alloc_tracking);
+    } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      az_set_space_record_path(argv[++i]);
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_path = argv[++i];
+    }
+  }
+  az_note_static_footprint("az_space_state_t", sizeof(az_space_state_t));
+  az_note_static_footprint("az_planet_t", sizeof(az_planet_t));
+  az_note_static_footprint("az_saved_games_t", sizeof(az_saved_games_t));
+
   az_init_sound_datas();
   az_init_baddie_datas();
   az_init_wall_datas();
@@ -77,6 +99,12 @@ int main(int argc, char **argv) {
   az_set_global_music_volume(preferences.music_volume);
   az_set_global_sound_volume(preferences.sound_volume);
 
+  // In replay mode, just play back the replay and then quit.
+  if (replay_path != NULL) {
+    return (az_space_replay_loop(&planet, replay_path) ? EXIT_SUCCESS :
+            EXIT_FAILURE);
+  }
+
   az_controller_t controller = AZ_CONTROLLER_TITLE;
   az_title_intro_t title_intro = AZ_TI_SHOW_INTRO;
   int saved_game_slot_index = 0;
@@ -28,6 +28,7 @@
 #include "azimuth/util/color.h"
 #include "azimuth/util/key.h"
 #include "azimuth/util/misc.h"
+#include "azimuth/util/string.h"
 
 /*===========================================================================*/
 
@@ -53,37 +54,27 @@ bool az_fprint_paragraph(const char *paragraph, FILE *file) {
 /*===========================================================================*/
 
 char *az_sscan_paragraph(const char *string) {
-  const int length = strlen(string);
-  int paragraph_length = 0;
-  int start = 0;
-  for (; start < length; ++start) {
-    if (string[start] != ' ' && string[start] != '\n') break;
-  }
-  int s_index = start;
-  while (s_index < length) {
-    const bool linebreak = (string[s_index] == '\n');
-    ++paragraph_length;
-    ++s_index;
-    if (linebreak) {
-      for (; s_index < length && string[s_index] == ' '; ++s_index) {}
-    }
-  }
-  char *paragraph = AZ_ALLOC(paragraph_length + 1, char);
+  return az_sscan_paragraph_in_place(az_strdup(string));
+}
+
+char *az_sscan_paragraph_in_place(char *string) {
+  // Skipping characters never makes the paragraph longer than the string, so
+  // we can write the paragraph out over the string as we go.
+  int s_index = 0;
+  for (; string[s_index] == ' ' || string[s_index] == '\n'; ++s_index) {}
   int p_index = 0;
-  s_index = start;
-  while (s_index < length) {
+  while (string[s_index] != '\0') {
     const bool linebreak = (string[s_index] == '\n');
-    assert(p_index < paragraph_length);
-    paragraph[p_index] = string[s_index];
+    assert(p_index <= s_index);
+    string[p_index] = string[s_index];
     ++p_index;
     ++s_index;
     if (linebreak) {
-      for (; s_index < length && string[s_index] == ' '; ++s_index) {}
+      for (; string[s_index] == ' '; ++s_index) {}
     }
   }
-  assert(p_index == paragraph_length);
-  assert(paragraph[paragraph_length] == '\0');
-  return paragraph;
+  string[p_index] = '\0';
+  return string;
 }
 
 /*===========================================================================*/
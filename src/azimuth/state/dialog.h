@@ -90,6 +90,9 @@ bool az_fprint_paragraph(const char *paragraph, FILE *file);
 
 // Parse and allocate the paragraph.
 char *az_sscan_paragraph(const char *string);
+// Like az_sscan_paragraph, but parse the paragraph in place, overwriting the
+// given string, and return the string.
+char *az_sscan_paragraph_in_place(char *string);
 
 // Return the number of lines in the paragraph.  This will be at least 1,
 // even for an empty string.
@@ -127,6 +127,44 @@ bool az_point_within_gravfield(const az_gravfield_t *gravfield,
   }
 }
 
+double az_gravfield_bounding_radius(const az_gravfield_t *gravfield) {
+  assert(gravfield->kind != AZ_GRAV_NOTHING);
+  const az_gravfield_size_t *size = &gravfield->size;
+  if (!az_is_trapezoidal(gravfield->kind)) {
+    return size->sector.inner_radius + size->sector.thickness;
+  }
+  const double semilength = size->trapezoid.semilength;
+  const double front_offset = size->trapezoid.front_offset;
+  const double front_semiwidth = size->trapezoid.front_semiwidth;
+  const double rear_semiwidth = size->trapezoid.rear_semiwidth;
+  az_vector_t corners[4] = {
+    {semilength, front_offset - front_semiwidth},
+    {semilength, front_offset + front_semiwidth},
+    {-semilength, rear_semiwidth},
+    {-semilength, -rear_semiwidth}
+  };
+  if (az_is_liquid(gravfield->kind)) {
+    // A liquid gravfield bends around the planet's center; its rear corners
+    // stay put, but its front corners get pushed out onto the outer arc.  The
+    // farthest point of each arc or side from the position is one of its
+    // ends, so the (adjusted) corners still give the bounding radius.
+    const double position_norm = az_vnorm(gravfield->position);
+    const double outer_radius =
+      hypot(fmax(front_offset + front_semiwidth,
+                 front_offset - front_semiwidth),
+            position_norm + semilength);
+    for (int i = 0; i < 2; ++i) {
+      const az_vector_t abs_corner =
+        az_vwithlen((az_vector_t){corners[i].x + position_norm,
+                                  corners[i].y}, outer_radius);
+      corners[i] = (az_vector_t){abs_corner.x - position_norm, abs_corner.y};
+    }
+  }
+  double radius = 0.0;
+  AZ_ARRAY_LOOP(corner, corners) radius = fmax(radius, az_vnorm(*corner));
+  return radius;
+}
+
 static void get_liquid_surface_arc(
     const az_gravfield_t *gravfield, double *arc_radius_out,
     az_vector_t *arc_center_out, double *min_theta_out,
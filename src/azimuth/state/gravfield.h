@@ -84,6 +84,10 @@ double az_sector_interior_angle(const az_gravfield_size_t *size);
 bool az_point_within_gravfield(const az_gravfield_t *gravfield,
                                az_vector_t point);
 
+// Returns the radius of a circle, centered on the gravfield's position, that
+// contains every point within the gravfield.
+double az_gravfield_bounding_radius(const az_gravfield_t *gravfield);
+
 bool az_ray_hits_liquid_surface(
     const az_gravfield_t *gravfield, az_vector_t start, az_vector_t delta,
     az_vector_t *point_out, az_vector_t *normal_out);
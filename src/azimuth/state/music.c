@@ -21,8 +21,10 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "azimuth/util/audio.h"
+#include "azimuth/util/file.h"
 #include "azimuth/util/misc.h"
 #include "azimuth/util/music.h"
 #include "azimuth/util/string.h"
@@ -164,9 +166,30 @@ static void destroy_music_datas(void) {
   AZ_ARRAY_LOOP(music, music_datas) az_destroy_music(music);
 }
 
+// If there is a compiled version of the given music file (e.g. musicNN.bin
+// for musicNN.txt) that is at least as new as the text file, try to load
+// that instead, since it's much faster than parsing the text.
+static bool load_compiled_music(
+    const char *music_path, int num_drums, const az_sound_data_t *drums,
+    az_music_t *music_out) {
+  const size_t length = strlen(music_path);
+  if (length < 4 || strcmp(music_path + length - 4, ".txt") != 0) {
+    return false;
+  }
+  char *compiled_path = az_strprintf("%.*s.bin", (int)(length - 4),
+                                     music_path);
+  const bool success = az_file_is_up_to_date(compiled_path, music_path) &&
+    az_load_compiled_music_from_path(compiled_path, num_drums, drums,
+                                     music_out);
+  az_free(compiled_path);
+  return success;
+}
+
 bool az_init_music_datas(const char *resource_dir) {
   assert(!music_data_initialized);
   assert(resource_dir != NULL);
+  az_note_static_footprint("music tables", sizeof(drum_datas) +
+                           sizeof(music_datas) + sizeof(music_filenames));
   // Initialize drum kit:
   int num_drums = 0;
   const az_sound_data_t *drums = NULL;
@@ -176,13 +199,14 @@ bool az_init_music_datas(const char *resource_dir) {
     const char *filename = music_filenames[i];
     if (filename == NULL) continue;
     char *music_path = az_strprintf("%s/music/%s", resource_dir, filename);
-    if (!az_parse_music_from_path(music_path, num_drums, drums,
+    if (!load_compiled_music(music_path, num_drums, drums, &music_datas[i]) &&
+        !az_parse_music_from_path(music_path, num_drums, drums,
                                   &music_datas[i])) {
       AZ_WARNING_ALWAYS("Failed to load music from %s\n", music_path);
-      free(music_path);
+      az_free(music_path);
       destroy_music_datas();
       return false;
-    } else free(music_path);
+    } else az_free(music_path);
   }
   atexit(destroy_music_datas);
   music_data_initialized = true;
@@ -22,14 +22,23 @@
 #include <assert.h>
 #include <setjmp.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "azimuth/constants.h"
 #include "azimuth/state/dialog.h"
 #include "azimuth/state/room.h"
+#include "azimuth/state/wall.h"
+#include "azimuth/util/arena.h"
+#include "azimuth/util/file.h"
 #include "azimuth/util/misc.h"
+#include "azimuth/util/parallel.h"
+#include "azimuth/util/scan.h"
 #include "azimuth/util/string.h"
+#include "azimuth/util/warning.h"
 
 /*===========================================================================*/
 
@@ -38,11 +47,12 @@
 #define AZ_MAX_NUM_PARAGRAPHS 50000
 
 typedef struct {
-  FILE *file;
+  az_scanner_t scanner;
   bool success;
   jmp_buf jump;
   int num_zones, num_hints, num_paragraphs;
   az_planet_t *planet;
+  az_arena_t *arena; // if non-NULL, allocate the planet's data from here
 } az_load_planet_t;
 
 #ifdef NDEBUG
@@ -55,43 +65,47 @@ typedef struct {
 #endif // NDEBUG
 
 #define READ(...) do { \
-    if (fscanf(loader->file, __VA_ARGS__) < AZ_COUNT_ARGS(__VA_ARGS__) - 1) { \
+    if (az_scan(&loader->scanner, __VA_ARGS__) < \
+        AZ_COUNT_ARGS(__VA_ARGS__) - 1) { \
       FAIL(); \
     } \
   } while (false)
 
+#define ALLOC(n, type) \
+  (loader->arena == NULL ? AZ_ALLOC((n), type) : \
+   AZ_ARENA_ALLOC(loader->arena, (n), type))
+
 // Read the next non-whitespace character.  If it is '!' or if we reach EOF,
 // do nothing more; otherwise, fail parsing.
 static void scan_to_bang(az_load_planet_t *loader) {
   char ch;
-  if (fscanf(loader->file, " %c", &ch) < 1) return;
+  if (az_scan(&loader->scanner, " %c", &ch) < 1) return;
   if (ch != '!') FAIL();
 }
 
 static char *scan_string(az_load_planet_t *loader) {
-  if (fgetc(loader->file) != '"') FAIL();
-  fpos_t pos;
-  if (fgetpos(loader->file, &pos) != 0) FAIL();
+  az_scanner_t *scanner = &loader->scanner;
+  if (az_scan_getc(scanner) != '"') FAIL();
+  // Find the closing quote and the unescaped length of the string.
+  const char *start = scanner->ptr;
   size_t length = 0;
-  while (true) {
-    const int ch = fgetc(loader->file);
-    if (ch == EOF) FAIL();
-    else if (ch == '"') break;
-    else if (ch == '\\') fgetc(loader->file);
+  for (const char *ptr = start; true; ++ptr) {
+    if (ptr >= scanner->end) FAIL();
+    else if (*ptr == '"') {
+      scanner->ptr = ptr + 1;
+      break;
+    } else if (*ptr == '\\') {
+      if (++ptr >= scanner->end) FAIL();
+    }
     ++length;
   }
-  if (fsetpos(loader->file, &pos) != 0) FAIL();
-  char *string = AZ_ALLOC(length + 1, char);
+  char *string = ALLOC(length + 1, char);
+  const char *ptr = start;
   for (size_t i = 0; i < length; ++i) {
-    const int ch = fgetc(loader->file);
-    if (ch == EOF) FAIL();
-    string[i] = (ch == '\\' ? fgetc(loader->file) : ch);
+    if (*ptr == '\\') ++ptr;
+    string[i] = *(ptr++);
   }
   assert(string[length] == '\0');
-  if (fgetc(loader->file) != '"') {
-    free(string);
-    FAIL();
-  }
   return string;
 }
 
@@ -108,17 +122,20 @@ static void parse_planet_header(az_load_planet_t *loader) {
   loader->num_hints = num_hints;
   loader->num_paragraphs = num_paragraphs;
   loader->planet->num_zones = 0;
-  loader->planet->zones = AZ_ALLOC(num_zones, az_zone_t);
+  loader->planet->zones = ALLOC(num_zones, az_zone_t);
   loader->planet->num_hints = 0;
-  loader->planet->hints = AZ_ALLOC(num_hints, az_hint_t);
+  loader->planet->hints = ALLOC(num_hints, az_hint_t);
   loader->planet->num_rooms = num_rooms;
-  loader->planet->rooms = AZ_ALLOC(num_rooms, az_room_t);
+  loader->planet->rooms = ALLOC(num_rooms, az_room_t);
   loader->planet->num_paragraphs = 0;
-  loader->planet->paragraphs = AZ_ALLOC(num_paragraphs, char*);
+  loader->planet->paragraphs = ALLOC(num_paragraphs, char*);
   loader->planet->start_room = start_room_num;
   char ch = '\0';
-  if (fscanf(loader->file, " $s%c", &ch) < 1 || ch != ':') FAIL();
-  loader->planet->on_start = az_fscan_script(loader->file);
+  if (az_scan(&loader->scanner, " $s%c", &ch) < 1 || ch != ':') FAIL();
+  loader->planet->on_start = (loader->arena == NULL ?
+                              az_scan_script(&loader->scanner) :
+                              az_arena_scan_script(&loader->scanner,
+                                                   loader->arena));
   if (loader->planet->on_start == NULL) FAIL();
   scan_to_bang(loader);
 }
@@ -188,11 +205,8 @@ static void parse_paragraph_directive(az_load_planet_t *loader) {
   int paragraph_index;
   READ("%d", &paragraph_index);
   if (paragraph_index != loader->planet->num_paragraphs) FAIL();
-  char *string = scan_string(loader);
-  char *paragraph = az_sscan_paragraph(string);
-  free(string);
-  if (paragraph == NULL) FAIL();
-  loader->planet->paragraphs[loader->planet->num_paragraphs] = paragraph;
+  loader->planet->paragraphs[loader->planet->num_paragraphs] =
+    az_sscan_paragraph_in_place(scan_string(loader));
   ++loader->planet->num_paragraphs;
   scan_to_bang(loader);
 }
@@ -206,14 +220,16 @@ static void parse_zone_directive(az_load_planet_t *loader) {
   if (red < 0 || red > 255 || green < 0 || green > 255 || blue < 0 ||
       blue > 255) FAIL();
   zone->color = (az_color_t){red, green, blue, 255};
-  zone->entering_message = az_strprintf("Entering: $X%02x%02x%02x%s",
-                                        red, green, blue, zone->name);
+  zone->entering_message = (loader->arena == NULL ?
+    az_strprintf("Entering: $X%02x%02x%02x%s", red, green, blue, zone->name) :
+    az_arena_strprintf(loader->arena, "Entering: $X%02x%02x%02x%s",
+                       red, green, blue, zone->name));
   ++loader->planet->num_zones;
   scan_to_bang(loader);
 }
 
 static bool parse_directive(az_load_planet_t *loader) {
-  switch (fgetc(loader->file)) {
+  switch (az_scan_getc(&loader->scanner)) {
     case 'H': parse_hint_directive(loader); return true;
     case 'T': parse_paragraph_directive(loader); return true;
     case 'Z': parse_zone_directive(loader); return true;
@@ -228,6 +244,7 @@ static void validate_planet_basis(az_load_planet_t *loader) {
       loader->planet->num_paragraphs != loader->num_paragraphs) FAIL();
 }
 
+#undef ALLOC
 #undef READ
 #undef FAIL
 
@@ -242,42 +259,745 @@ static void parse_planet_basis(az_load_planet_t *loader) {
   loader->success = true;
 }
 
-static bool load_planet_basis(const char *filepath, az_planet_t *planet_out) {
+// Load the planet's zones, hints, paragraphs, and so on (everything but the
+// rooms, which get allocated but not loaded).  If use_arena is true, these
+// are allocated from a new arena owned by the planet, rather than separately.
+static bool load_planet_basis(const char *filepath, bool use_arena,
+                              az_planet_t *planet_out) {
   assert(planet_out != NULL);
-  FILE *file = fopen(filepath, "r");
-  if (file == NULL) return false;
-  az_load_planet_t loader = {.file = file, .planet = planet_out};
+  AZ_ZERO_OBJECT(planet_out);
+  size_t size;
+  char *data = az_read_file(filepath, &size);
+  if (data == NULL) return false;
+  if (use_arena) planet_out->arena = AZ_ALLOC(1, az_arena_t);
+  az_load_planet_t loader = {.planet = planet_out, .arena = planet_out->arena};
+  az_init_scanner(&loader.scanner, data, size);
   parse_planet_basis(&loader);
-  fclose(file);
+  az_free(data);
   return loader.success;
 }
 
-bool az_load_planet(const char *resource_dir, az_planet_t *planet_out) {
+typedef struct {
+  const char *resource_dir;
+  az_planet_t *planet;
+  bool metadata_only;
+  int *failure_lines; // for each room, 0 on success, -1 if unreadable
+  int *num_exits;
+  az_room_key_t *exits; // AZ_MAX_NUM_DOORS entries for each room
+} az_load_rooms_t;
+
+// Called in parallel (see az_parallel_for), so this must only touch the data
+// for its own room.
+static void load_room_at_index(void *data, int index) {
+  az_load_rooms_t *job = data;
+  char *room_path =
+    az_strprintf("%s/rooms/room%03d.txt", job->resource_dir, index);
+  az_room_t *room = &job->planet->rooms[index];
+  az_room_key_t *exits = job->exits + index * AZ_MAX_NUM_DOORS;
+  int failure_line = 0;
+  bool success;
+  if (job->metadata_only) {
+    success = az_load_room_metadata_quietly(
+        room_path, room, exits, &job->num_exits[index],
+        &failure_line);
+  } else {
+    success = az_load_room_quietly(room_path, NULL, room, &failure_line);
+    job->num_exits[index] = room->num_doors;
+    for (int i = 0; i < room->num_doors; ++i) {
+      exits[i] = room->doors[i].destination;
+    }
+  }
+  if (!success) {
+    job->failure_lines[index] = (failure_line == 0 ? -1 : failure_line);
+  }
+  az_free(room_path);
+}
+
+// Check the things about a room that can't be checked until the planet's
+// other rooms are loaded.
+static bool validate_room_links(const az_planet_t *planet,
+                                const az_room_t *room, int num_exits,
+                                const az_room_key_t *exits) {
+  if (room->zone_key >= planet->num_zones) return false;
+  for (int i = 0; i < num_exits; ++i) {
+    if (exits[i] >= planet->num_rooms) return false;
+  }
+  return true;
+}
+
+static az_room_cache_t *create_room_cache(const az_load_rooms_t *job) {
+  const int num_rooms = job->planet->num_rooms;
+  az_room_cache_t *cache = AZ_ALLOC(1, az_room_cache_t);
+  cache->resource_dir = az_strdup(job->resource_dir);
+  cache->exit_starts = AZ_ALLOC(num_rooms + 1, int);
+  for (int i = 0; i < num_rooms; ++i) {
+    cache->exit_starts[i + 1] = cache->exit_starts[i] + job->num_exits[i];
+  }
+  cache->exits = AZ_ALLOC(cache->exit_starts[num_rooms], az_room_key_t);
+  for (int i = 0; i < num_rooms; ++i) {
+    memcpy(cache->exits + cache->exit_starts[i],
+           job->exits + i * AZ_MAX_NUM_DOORS,
+           job->num_exits[i] * sizeof(az_room_key_t));
+  }
+  cache->current_key = cache->previous_key = -1;
+  AZ_ARRAY_LOOP(entry, cache->entries) entry->key = -1;
+  return cache;
+}
+
+static void destroy_room_cache(az_room_cache_t *cache) {
+  AZ_ARRAY_LOOP(entry, cache->entries) az_destroy_arena(&entry->arena);
+  az_free(cache->exits);
+  az_free(cache->exit_starts);
+  az_free(cache->resource_dir);
+  az_free(cache);
+}
+
+static bool load_rooms(const char *resource_dir, az_planet_t *planet_out,
+                       bool metadata_only) {
   assert(resource_dir != NULL);
   assert(planet_out != NULL);
 
   {
     char *planet_path = az_strprintf("%s/rooms/planet.txt", resource_dir);
-    const bool success = load_planet_basis(planet_path, planet_out);
-    free(planet_path);
+    // A lazily-loaded planet is only ever used by the game, which never
+    // modifies it, so it can use an arena; the fully-loaded planet is also
+    // used by the editor, which needs to be able to free individual parts.
+    const bool success =
+      load_planet_basis(planet_path, metadata_only, planet_out);
+    az_free(planet_path);
     if (!success) return false;
   }
 
-  for (int i = 0; i < planet_out->num_rooms; ++i) {
-    char *room_path = az_strprintf("%s/rooms/room%03d.txt", resource_dir, i);
-    const bool success =
-      az_load_room_from_path(room_path, &planet_out->rooms[i]) &&
-      planet_out->rooms[i].zone_key < planet_out->num_zones;
-    free(room_path);
-    if (!success) {
-      az_destroy_planet(planet_out);
-      return false;
+  // The room files are independent of each other, so parse them in parallel,
+  // and then check the links between them once they've all been loaded.  If
+  // more than one room is bad, always report the first one, no matter which
+  // order the workers happened to finish in.
+  const int num_rooms = planet_out->num_rooms;
+  az_load_rooms_t job = {
+    .resource_dir = resource_dir, .planet = planet_out,
+    .metadata_only = metadata_only,
+    .failure_lines = AZ_ALLOC(num_rooms, int),
+    .num_exits = AZ_ALLOC(num_rooms, int),
+    .exits = AZ_ALLOC(num_rooms * AZ_MAX_NUM_DOORS, az_room_key_t)
+  };
+  az_parallel_for(num_rooms, load_room_at_index, &job);
+  bool success = true;
+  for (int i = 0; i < num_rooms; ++i) {
+    if (job.failure_lines[i] != 0) {
+#ifndef NDEBUG
+      if (job.failure_lines[i] > 0) {
+        fprintf(stderr, "room.c: failure at line %d (room %03d)\n",
+                job.failure_lines[i], i);
+      } else fprintf(stderr, "planet.c: couldn't read room %03d\n", i);
+#endif // NDEBUG
+      success = false;
+      break;
+    }
+    if (!validate_room_links(planet_out, &planet_out->rooms[i],
+                             job.num_exits[i],
+                             job.exits + i * AZ_MAX_NUM_DOORS)) {
+#ifndef NDEBUG
+      fprintf(stderr, "planet.c: room %03d has a bad zone or door\n", i);
+#endif // NDEBUG
+      success = false;
+      break;
     }
   }
+  if (success && metadata_only) {
+    planet_out->room_cache = create_room_cache(&job);
+  }
+  az_free(job.failure_lines);
+  az_free(job.num_exits);
+  az_free(job.exits);
+  if (!success) az_destroy_planet(planet_out);
+  return success;
+}
+
+bool az_load_planet_text(const char *resource_dir, az_planet_t *planet_out) {
+  return load_rooms(resource_dir, planet_out, false);
+}
+
+bool az_load_planet_lazily(const char *resource_dir, az_planet_t *planet_out) {
+  return load_rooms(resource_dir, planet_out, true);
+}
 
+// Returns true if the bundle at the given path is at least as new as the
+// planet.txt file and all of the planet's room files.
+static bool is_bundle_up_to_date(const char *bundle_path,
+                                 const char *resource_dir, int num_rooms) {
+  for (int i = -1; i < num_rooms; ++i) {
+    char *text_path = (i < 0 ?
+                       az_strprintf("%s/rooms/planet.txt", resource_dir) :
+                       az_strprintf("%s/rooms/room%03d.txt", resource_dir, i));
+    const bool up_to_date = az_file_is_up_to_date(bundle_path, text_path);
+    az_free(text_path);
+    if (!up_to_date) return false;
+  }
   return true;
 }
 
+bool az_load_planet(const char *resource_dir, az_planet_t *planet_out) {
+  assert(resource_dir != NULL);
+  assert(planet_out != NULL);
+  char *bundle_path = az_strprintf("%s/rooms/planet.bin", resource_dir);
+  if (is_bundle_up_to_date(bundle_path, resource_dir, 0) &&
+      az_load_planet_bundle_from_path(bundle_path, planet_out)) {
+    if (is_bundle_up_to_date(bundle_path, resource_dir,
+                             planet_out->num_rooms)) {
+      az_free(bundle_path);
+      return true;
+    }
+    az_destroy_planet(planet_out);
+  }
+  az_free(bundle_path);
+  return az_load_planet_lazily(resource_dir, planet_out);
+}
+
+/*===========================================================================*/
+// Lazily-loaded room contents:
+
+static az_cached_room_t *find_cached_room(az_room_cache_t *cache,
+                                          az_room_key_t key) {
+  AZ_ARRAY_LOOP(entry, cache->entries) {
+    if (entry->key == key) return entry;
+  }
+  return NULL;
+}
+
+// Pick a cache slot to load a new room into: an empty one if there is one,
+// otherwise the least recently used one that isn't the current or previous
+// room.
+static az_cached_room_t *choose_cache_slot(az_room_cache_t *cache) {
+  az_cached_room_t *best = NULL;
+  AZ_ARRAY_LOOP(entry, cache->entries) {
+    if (entry->key < 0) return entry;
+    if (entry->key == cache->current_key ||
+        entry->key == cache->previous_key) continue;
+    if (best == NULL || entry->last_used < best->last_used) best = entry;
+  }
+  assert(best != NULL);
+  return best;
+}
+
+typedef struct {
+  const az_room_cache_t *cache;
+  az_cached_room_t *slots[AZ_ROOM_CACHE_SIZE];
+  az_room_key_t keys[AZ_ROOM_CACHE_SIZE];
+} az_fill_cache_t;
+
+// Called in parallel (see az_parallel_for).
+static void fill_cache_slot(void *data, int index) {
+  az_fill_cache_t *job = data;
+  az_cached_room_t *entry = job->slots[index];
+  const az_room_key_t key = job->keys[index];
+  // Reuse the arena (and its block) of whatever room was here before.
+  az_clear_arena(&entry->arena);
+  AZ_ZERO_OBJECT(&entry->room);
+  char *room_path =
+    az_strprintf("%s/rooms/room%03d.txt", job->cache->resource_dir, key);
+  int failure_line = 0;
+  if (!az_load_room_quietly(room_path, &entry->arena, &entry->room,
+                            &failure_line)) {
+    AZ_FATAL("Couldn't load %s (room.c line %d)\n", room_path,
+             failure_line);
+  }
+  az_free(room_path);
+}
+
+// Load the given rooms (none of which may already be cached) into the cache.
+static void load_into_cache(az_room_cache_t *cache, int num_keys,
+                            const az_room_key_t *keys) {
+  assert(num_keys <= AZ_ROOM_CACHE_SIZE - 2);
+  az_fill_cache_t job = {.cache = cache};
+  for (int i = 0; i < num_keys; ++i) {
+    assert(find_cached_room(cache, keys[i]) == NULL);
+    az_cached_room_t *entry = choose_cache_slot(cache);
+    entry->key = keys[i];
+    entry->last_used = ++cache->clock;
+    job.slots[i] = entry;
+    job.keys[i] = keys[i];
+  }
+  az_parallel_for(num_keys, fill_cache_slot, &job);
+  cache->num_loads += num_keys;
+}
+
+const az_room_t *az_get_room_contents(const az_planet_t *planet,
+                                      az_room_key_t key) {
+  assert(planet != NULL);
+  assert(key >= 0 && key < planet->num_rooms);
+  az_room_cache_t *cache = planet->room_cache;
+  if (cache == NULL) return &planet->rooms[key];
+  if (key != cache->current_key) {
+    cache->previous_key = cache->current_key;
+    cache->current_key = key;
+  }
+  az_cached_room_t *entry = find_cached_room(cache, key);
+  if (entry == NULL) {
+    load_into_cache(cache, 1, &key);
+    entry = find_cached_room(cache, key);
+    assert(entry != NULL);
+  }
+  entry->last_used = ++cache->clock;
+  return &entry->room;
+}
+
+void az_prefetch_room_neighbors(const az_planet_t *planet, az_room_key_t key) {
+  assert(planet != NULL);
+  assert(key >= 0 && key < planet->num_rooms);
+  az_room_cache_t *cache = planet->room_cache;
+  if (cache == NULL) return;
+  // Gather up the neighbors that aren't already cached (refreshing the ones
+  // that are), leaving the current and previous rooms' slots alone.
+  az_room_key_t keys[AZ_ROOM_CACHE_SIZE];
+  int num_keys = 0;
+  for (int i = cache->exit_starts[key]; i < cache->exit_starts[key + 1];
+       ++i) {
+    const az_room_key_t exit = cache->exits[i];
+    az_cached_room_t *entry = find_cached_room(cache, exit);
+    if (entry != NULL) {
+      entry->last_used = ++cache->clock;
+      continue;
+    }
+    bool duplicate = false;
+    for (int j = 0; j < num_keys; ++j) duplicate |= (keys[j] == exit);
+    if (!duplicate && num_keys < AZ_ROOM_CACHE_SIZE - 2) {
+      keys[num_keys++] = exit;
+    }
+  }
+  load_into_cache(cache, num_keys, keys);
+}
+
+/*===========================================================================*/
+
+/*===========================================================================*/
+// Compiled planet bundles:
+
+#define BUNDLE_VERSION 1
+#define BUNDLE_BYTE_ORDER 0x01020304
+// Every section of a bundle starts at a multiple of this many bytes, so that
+// the structs in it are properly aligned when the bundle is loaded (at a
+// page-aligned or malloc-aligned address).
+#define BUNDLE_ALIGNMENT 8
+
+// A bundle starts with this header, followed by the data that it points to.
+// Within the bundle, each pointer field of each struct is stored instead as
+// the offset of its target from the start of the bundle (or 0 for NULL), with
+// the exception of wall data pointers, which are stored as wall data indices
+// (since the wall data lives in a static table).
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  // These guard against loading a bundle written by an incompatible build:
+  uint32_t byte_order;
+  uint16_t pointer_size, planet_size, room_size, zone_size, hint_size;
+  uint16_t script_size, instruction_size, baddie_size, door_size;
+  uint16_t gravfield_size, node_size, wall_size, reserved;
+  int32_t start_room, num_zones, num_hints, num_paragraphs, num_rooms;
+  uint32_t on_start, zones, hints, paragraphs, rooms;
+  uint32_t bundle_size;
+} az_planet_bundle_header_t;
+
+static const char bundle_magic[4] = {'A', 'Z', 'P', 'B'};
+
+static void init_bundle_header(az_planet_bundle_header_t *header) {
+  AZ_ZERO_OBJECT(header);
+  memcpy(header->magic, bundle_magic, sizeof(header->magic));
+  header->version = BUNDLE_VERSION;
+  header->byte_order = BUNDLE_BYTE_ORDER;
+  header->pointer_size = sizeof(void*);
+  header->planet_size = sizeof(az_planet_t);
+  header->room_size = sizeof(az_room_t);
+  header->zone_size = sizeof(az_zone_t);
+  header->hint_size = sizeof(az_hint_t);
+  header->script_size = sizeof(az_script_t);
+  header->instruction_size = sizeof(az_instruction_t);
+  header->baddie_size = sizeof(az_baddie_spec_t);
+  header->door_size = sizeof(az_door_spec_t);
+  header->gravfield_size = sizeof(az_gravfield_spec_t);
+  header->node_size = sizeof(az_node_spec_t);
+  header->wall_size = sizeof(az_wall_spec_t);
+}
+
+#define OFFSET_PTR(type, offset) ((type *)(uintptr_t)(offset))
+
+typedef struct {
+  char *data;
+  size_t size, capacity;
+} az_bundle_writer_t;
+
+// Append a copy of the given data to the bundle, and return its offset (or 0
+// if the size is zero).
+static size_t bundle_append(az_bundle_writer_t *writer, const void *data,
+                            size_t size) {
+  if (size == 0) return 0;
+  const size_t offset = (writer->size + BUNDLE_ALIGNMENT - 1) &
+    ~(size_t)(BUNDLE_ALIGNMENT - 1);
+  if (offset + size > writer->capacity) {
+    size_t new_capacity = (writer->capacity == 0 ? 4096 : writer->capacity);
+    while (offset + size > new_capacity) new_capacity *= 2;
+    char *new_data = realloc(writer->data, new_capacity);
+    if (new_data == NULL) AZ_FATAL("Out of memory.\n");
+    writer->data = new_data;
+    writer->capacity = new_capacity;
+  }
+  memset(writer->data + writer->size, 0, offset - writer->size);
+  memcpy(writer->data + offset, data, size);
+  writer->size = offset + size;
+  return offset;
+}
+
+static size_t bundle_append_string(az_bundle_writer_t *writer,
+                                   const char *string) {
+  if (string == NULL) return 0;
+  return bundle_append(writer, string, strlen(string) + 1);
+}
+
+static az_script_t *bundle_append_script(az_bundle_writer_t *writer,
+                                         const az_script_t *script) {
+  if (script == NULL) return NULL;
+  // Zero the copy first, so that its padding bytes (which an initializer
+  // would leave unspecified) don't make the bundle nondeterministic.
+  az_script_t copy;
+  AZ_ZERO_OBJECT(&copy);
+  copy.num_instructions = script->num_instructions;
+  copy.instructions = OFFSET_PTR(az_instruction_t, bundle_append(
+      writer, script->instructions,
+      script->num_instructions * sizeof(az_instruction_t)));
+  return OFFSET_PTR(az_script_t, bundle_append(writer, &copy, sizeof(copy)));
+}
+
+// Append a copy of the given spec array, with each element's script pointer
+// replaced by the offset of a copy of its script.
+#define BUNDLE_APPEND_SPECS(writer, type, specs, num_specs, script_field) \
+  OFFSET_PTR(type, bundle_append_specs_( \
+      (writer), (specs), (num_specs), sizeof(type), \
+      offsetof(type, script_field)))
+
+static size_t bundle_append_specs_(
+    az_bundle_writer_t *writer, const void *specs, int num_specs,
+    size_t spec_size, size_t script_offset) {
+  if (num_specs <= 0) return 0;
+  char *copy = AZ_ALLOC(num_specs * spec_size, char);
+  memcpy(copy, specs, num_specs * spec_size);
+  for (int i = 0; i < num_specs; ++i) {
+    az_script_t **script_field =
+      (az_script_t **)(copy + i * spec_size + script_offset);
+    *script_field = bundle_append_script(writer, *script_field);
+  }
+  const size_t offset = bundle_append(writer, copy, num_specs * spec_size);
+  az_free(copy);
+  return offset;
+}
+
+static void bundle_append_room(az_bundle_writer_t *writer,
+                               const az_room_t *room, az_room_t *copy_out) {
+  *copy_out = *room;
+  copy_out->on_start = bundle_append_script(writer, room->on_start);
+  copy_out->baddies = BUNDLE_APPEND_SPECS(
+      writer, az_baddie_spec_t, room->baddies, room->num_baddies, on_kill);
+  copy_out->doors = BUNDLE_APPEND_SPECS(
+      writer, az_door_spec_t, room->doors, room->num_doors, on_open);
+  copy_out->gravfields = BUNDLE_APPEND_SPECS(
+      writer, az_gravfield_spec_t, room->gravfields, room->num_gravfields,
+      on_enter);
+  // Nodes may point to wall data (for fake walls), which must be converted
+  // to indices.
+  az_node_spec_t *nodes = AZ_ALLOC(room->num_nodes, az_node_spec_t);
+  for (int i = 0; i < room->num_nodes; ++i) {
+    nodes[i] = room->nodes[i];
+    if (nodes[i].kind == AZ_NODE_FAKE_WALL_FG ||
+        nodes[i].kind == AZ_NODE_FAKE_WALL_BG) {
+      nodes[i].subkind.fake_wall = OFFSET_PTR(
+          const az_wall_data_t, az_wall_data_index(nodes[i].subkind.fake_wall));
+    }
+  }
+  copy_out->nodes = BUNDLE_APPEND_SPECS(
+      writer, az_node_spec_t, nodes, room->num_nodes, on_use);
+  az_free(nodes);
+  // Walls have no scripts, but their wall data must be converted to indices.
+  az_wall_spec_t *walls = AZ_ALLOC(room->num_walls, az_wall_spec_t);
+  for (int i = 0; i < room->num_walls; ++i) {
+    walls[i] = room->walls[i];
+    walls[i].data = OFFSET_PTR(const az_wall_data_t,
+                               az_wall_data_index(room->walls[i].data));
+  }
+  copy_out->walls = OFFSET_PTR(az_wall_spec_t, bundle_append(
+      writer, walls, room->num_walls * sizeof(az_wall_spec_t)));
+  az_free(walls);
+}
+
+bool az_write_planet_bundle(const az_planet_t *planet, FILE *file) {
+  assert(planet != NULL);
+  assert(planet->room_cache == NULL);
+  assert(file != NULL);
+  az_bundle_writer_t writer = {0};
+  az_planet_bundle_header_t header;
+  init_bundle_header(&header);
+  // Reserve space for the header; we'll fill it in at the end.
+  bundle_append(&writer, &header, sizeof(header));
+  header.start_room = planet->start_room;
+  header.on_start =
+    (uintptr_t)bundle_append_script(&writer, planet->on_start);
+  // Zones:
+  header.num_zones = planet->num_zones;
+  az_zone_t *zones = AZ_ALLOC(planet->num_zones, az_zone_t);
+  for (int i = 0; i < planet->num_zones; ++i) {
+    zones[i] = planet->zones[i];
+    zones[i].name = OFFSET_PTR(char, bundle_append_string(
+        &writer, planet->zones[i].name));
+    zones[i].entering_message = OFFSET_PTR(char, bundle_append_string(
+        &writer, planet->zones[i].entering_message));
+  }
+  header.zones = bundle_append(&writer, zones,
+                               planet->num_zones * sizeof(az_zone_t));
+  az_free(zones);
+  // Hints:
+  header.num_hints = planet->num_hints;
+  header.hints = bundle_append(&writer, planet->hints,
+                               planet->num_hints * sizeof(az_hint_t));
+  // Paragraphs:
+  header.num_paragraphs = planet->num_paragraphs;
+  char **paragraphs = AZ_ALLOC(planet->num_paragraphs, char*);
+  for (int i = 0; i < planet->num_paragraphs; ++i) {
+    paragraphs[i] = OFFSET_PTR(char, bundle_append_string(
+        &writer, planet->paragraphs[i]));
+  }
+  header.paragraphs = bundle_append(&writer, paragraphs,
+                                    planet->num_paragraphs * sizeof(char*));
+  az_free(paragraphs);
+  // Rooms:
+  header.num_rooms = planet->num_rooms;
+  az_room_t *rooms = AZ_ALLOC(planet->num_rooms, az_room_t);
+  for (int i = 0; i < planet->num_rooms; ++i) {
+    bundle_append_room(&writer, &planet->rooms[i], &rooms[i]);
+  }
+  header.rooms = bundle_append(&writer, rooms,
+                               planet->num_rooms * sizeof(az_room_t));
+  az_free(rooms);
+  // Finish the header, and write everything out.
+  header.bundle_size = writer.size;
+  memcpy(writer.data, &header, sizeof(header));
+  const bool success = (fwrite(writer.data, writer.size, 1, file) == 1);
+  az_free(writer.data);
+  return success;
+}
+
+/*===========================================================================*/
+
+typedef struct {
+  char *base;
+  size_t size;
+  jmp_buf jump;
+} az_bundle_fixer_t;
+
+#ifdef NDEBUG
+#define FAIL() longjmp(fixer->jump, 1)
+#else
+#define FAIL() do{ \
+    fprintf(stderr, "planet.c: bundle failure at line %d\n", __LINE__); \
+    longjmp(fixer->jump, 1); \
+  } while (0)
+#endif // NDEBUG
+
+// Convert the offset (stored in place of a pointer) of an array of count
+// elements into a pointer into the bundle, checking that the array lies
+// entirely within the bundle.
+static void *fix_up_array(az_bundle_fixer_t *fixer, uintptr_t offset,
+                          size_t elem_size, int count) {
+  if (count < 0) FAIL();
+  if (offset == 0) {
+    if (count != 0) FAIL();
+    return NULL;
+  }
+  if (count == 0 || offset % BUNDLE_ALIGNMENT != 0 || offset > fixer->size ||
+      (fixer->size - offset) / elem_size < (size_t)count) FAIL();
+  return fixer->base + offset;
+}
+
+#define FIX_UP(ptr, count) \
+  ((ptr) = fix_up_array(fixer, (uintptr_t)(ptr), sizeof(*(ptr)), (count)))
+
+static char *fix_up_string(az_bundle_fixer_t *fixer, char *ptr) {
+  const uintptr_t offset = (uintptr_t)ptr;
+  if (offset == 0) return NULL;
+  if (offset >= fixer->size ||
+      memchr(fixer->base + offset, '\0', fixer->size - offset) == NULL) {
+    FAIL();
+  }
+  return fixer->base + offset;
+}
+
+static az_script_t *fix_up_script(az_bundle_fixer_t *fixer,
+                                  az_script_t *script) {
+  if (script == NULL) return NULL;
+  FIX_UP(script, 1);
+  if (script->num_instructions <= 0) FAIL();
+  FIX_UP(script->instructions, script->num_instructions);
+  for (int i = 0; i < script->num_instructions; ++i) {
+    const az_opcode_t opcode = script->instructions[i].opcode;
+    if (opcode < AZ_OP_NOP || opcode > AZ_OP_ERROR) FAIL();
+  }
+  // Bundles don't store verification results, so that the script VM never
+  // has to trust a bundle to tell it which scripts are safe to run unchecked.
+  az_verify_script(script);
+  return script;
+}
+
+static const az_wall_data_t *fix_up_wall_data(
+    az_bundle_fixer_t *fixer, const az_wall_data_t *data) {
+  const uintptr_t index = (uintptr_t)data;
+  if (index >= (uintptr_t)AZ_NUM_WALL_DATAS) FAIL();
+  return az_get_wall_data(index);
+}
+
+static void fix_up_room(az_bundle_fixer_t *fixer, const az_planet_t *planet,
+                        az_room_t *room) {
+  if (room->zone_key < 0 || room->zone_key >= planet->num_zones ||
+      room->background_pattern < 0 ||
+      room->background_pattern >= AZ_NUM_BG_PATTERNS ||
+      room->num_baddies > AZ_MAX_NUM_BADDIES ||
+      room->num_doors > AZ_MAX_NUM_DOORS ||
+      room->num_gravfields > AZ_MAX_NUM_GRAVFIELDS ||
+      room->num_nodes > AZ_MAX_NUM_NODES ||
+      room->num_walls > AZ_MAX_NUM_WALLS) FAIL();
+  room->on_start = fix_up_script(fixer, room->on_start);
+  FIX_UP(room->baddies, room->num_baddies);
+  for (int i = 0; i < room->num_baddies; ++i) {
+    az_baddie_spec_t *baddie = &room->baddies[i];
+    if (baddie->kind <= 0 || baddie->kind > AZ_NUM_BADDIE_KINDS) FAIL();
+    baddie->on_kill = fix_up_script(fixer, baddie->on_kill);
+  }
+  FIX_UP(room->doors, room->num_doors);
+  for (int i = 0; i < room->num_doors; ++i) {
+    az_door_spec_t *door = &room->doors[i];
+    if (door->kind <= 0 || door->kind > AZ_NUM_DOOR_KINDS) FAIL();
+    door->on_open = fix_up_script(fixer, door->on_open);
+  }
+  FIX_UP(room->gravfields, room->num_gravfields);
+  for (int i = 0; i < room->num_gravfields; ++i) {
+    az_gravfield_spec_t *gravfield = &room->gravfields[i];
+    if (gravfield->kind <= 0 || gravfield->kind > AZ_NUM_GRAVFIELD_KINDS) {
+      FAIL();
+    }
+    gravfield->on_enter = fix_up_script(fixer, gravfield->on_enter);
+  }
+  FIX_UP(room->nodes, room->num_nodes);
+  for (int i = 0; i < room->num_nodes; ++i) {
+    az_node_spec_t *node = &room->nodes[i];
+    if (node->kind <= 0 || node->kind > AZ_NUM_NODE_KINDS) FAIL();
+    if (node->kind == AZ_NODE_FAKE_WALL_FG ||
+        node->kind == AZ_NODE_FAKE_WALL_BG) {
+      node->subkind.fake_wall =
+        fix_up_wall_data(fixer, node->subkind.fake_wall);
+    }
+    node->on_use = fix_up_script(fixer, node->on_use);
+  }
+  FIX_UP(room->walls, room->num_walls);
+  for (int i = 0; i < room->num_walls; ++i) {
+    az_wall_spec_t *wall = &room->walls[i];
+    if (wall->kind <= 0 || wall->kind > AZ_NUM_WALL_KINDS) FAIL();
+    wall->data = fix_up_wall_data(fixer, wall->data);
+  }
+}
+
+static void fix_up_bundle(az_bundle_fixer_t *fixer, az_planet_t *planet) {
+  az_planet_bundle_header_t header, expected;
+  if (fixer->size < sizeof(header)) FAIL();
+  memcpy(&header, fixer->base, sizeof(header));
+  init_bundle_header(&expected);
+  if (memcmp(&header, &expected,
+             offsetof(az_planet_bundle_header_t, start_room)) != 0 ||
+      header.bundle_size != fixer->size ||
+      header.num_zones < 1 || header.num_zones > AZ_MAX_NUM_ZONES ||
+      header.num_hints < 0 || header.num_hints > AZ_MAX_NUM_HINTS ||
+      header.num_rooms < 1 || header.num_rooms > AZ_MAX_NUM_ROOMS ||
+      header.num_paragraphs < 0 ||
+      header.num_paragraphs > AZ_MAX_NUM_PARAGRAPHS ||
+      header.start_room < 0 || header.start_room >= header.num_rooms) FAIL();
+  planet->start_room = header.start_room;
+  planet->on_start = fix_up_script(
+      fixer, OFFSET_PTR(az_script_t, header.on_start));
+  planet->num_zones = header.num_zones;
+  planet->zones = OFFSET_PTR(az_zone_t, header.zones);
+  FIX_UP(planet->zones, planet->num_zones);
+  for (int i = 0; i < planet->num_zones; ++i) {
+    az_zone_t *zone = &planet->zones[i];
+    zone->name = fix_up_string(fixer, zone->name);
+    zone->entering_message = fix_up_string(fixer, zone->entering_message);
+    if (zone->name == NULL || zone->entering_message == NULL) FAIL();
+  }
+  planet->num_hints = header.num_hints;
+  planet->hints = OFFSET_PTR(az_hint_t, header.hints);
+  FIX_UP(planet->hints, planet->num_hints);
+  for (int i = 0; i < planet->num_hints; ++i) {
+    if (planet->hints[i].target_room < 0 ||
+        planet->hints[i].target_room >= header.num_rooms) FAIL();
+  }
+  planet->num_paragraphs = header.num_paragraphs;
+  planet->paragraphs = OFFSET_PTR(char*, header.paragraphs);
+  FIX_UP(planet->paragraphs, planet->num_paragraphs);
+  for (int i = 0; i < planet->num_paragraphs; ++i) {
+    planet->paragraphs[i] = fix_up_string(fixer, planet->paragraphs[i]);
+    if (planet->paragraphs[i] == NULL) FAIL();
+  }
+  planet->num_rooms = header.num_rooms;
+  planet->rooms = OFFSET_PTR(az_room_t, header.rooms);
+  FIX_UP(planet->rooms, planet->num_rooms);
+  for (int i = 0; i < planet->num_rooms; ++i) {
+    fix_up_room(fixer, planet, &planet->rooms[i]);
+  }
+}
+
+#undef FIX_UP
+#undef FAIL
+
+// Fix up the given bundle block, and on success, give the planet ownership of
+// it.  On failure, releases the block.
+static bool load_bundle(void *block, size_t size, bool mapped,
+                        az_planet_t *planet_out) {
+  AZ_ZERO_OBJECT(planet_out);
+  az_bundle_fixer_t fixer = { .base = block, .size = size };
+  if (setjmp(fixer.jump) != 0) {
+    if (mapped) az_unmap_file(block, size);
+    else az_free(block);
+    AZ_ZERO_OBJECT(planet_out);
+    return false;
+  }
+  fix_up_bundle(&fixer, planet_out);
+  planet_out->bundle = block;
+  planet_out->bundle_size = size;
+  planet_out->bundle_mapped = mapped;
+  return true;
+}
+
+bool az_load_planet_bundle_from_path(const char *filepath,
+                                     az_planet_t *planet_out) {
+  assert(filepath != NULL);
+  assert(planet_out != NULL);
+  void *block;
+  size_t size;
+  if (!az_map_file(filepath, &block, &size)) return false;
+  return load_bundle(block, size, true, planet_out);
+}
+
+bool az_load_planet_bundle_from_file(FILE *file, az_planet_t *planet_out) {
+  assert(file != NULL);
+  assert(planet_out != NULL);
+  az_planet_bundle_header_t header;
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      header.bundle_size < sizeof(header)) return false;
+  char *block = AZ_ALLOC(header.bundle_size, char);
+  memcpy(block, &header, sizeof(header));
+  if (fread(block + sizeof(header), header.bundle_size - sizeof(header), 1,
+            file) != 1) {
+    az_free(block);
+    return false;
+  }
+  return load_bundle(block, header.bundle_size, false, planet_out);
+}
+
+#undef OFFSET_PTR
+
 /*===========================================================================*/
 
 #define WRITE(...) do { \
@@ -337,12 +1057,29 @@ static bool write_planet_header(const az_planet_t *planet, FILE *file) {
 
 #undef WRITE
 
-static bool save_planet_header(const az_planet_t *planet,
-                               const char *filepath) {
-  FILE *file = fopen(filepath, "w");
-  if (file == NULL) return false;
-  const bool success = write_planet_header(planet, file);
-  fclose(file);
+// Adapts write_planet_header for az_write_file_atomically.
+static bool write_planet_header_to_file(void *planet, FILE *file) {
+  return write_planet_header(planet, file);
+}
+
+bool az_save_planet_header(const az_planet_t *planet,
+                           const char *resource_dir) {
+  assert(planet != NULL);
+  assert(resource_dir != NULL);
+  char *planet_path = az_strprintf("%s/rooms/planet.txt", resource_dir);
+  const bool success = az_write_file_atomically(
+      planet_path, write_planet_header_to_file, (void *)planet);
+  az_free(planet_path);
+  return success;
+}
+
+bool az_save_planet_room(const az_room_t *room, const char *resource_dir,
+                         az_room_key_t key) {
+  assert(room != NULL);
+  assert(resource_dir != NULL);
+  char *room_path = az_strprintf("%s/rooms/room%03d.txt", resource_dir, key);
+  const bool success = az_save_room_to_path(room, room_path);
+  az_free(room_path);
   return success;
 }
 
@@ -350,40 +1087,52 @@ bool az_save_planet(
     const az_planet_t *planet, const char *resource_dir,
     const az_room_key_t *rooms_to_save, int num_rooms_to_save) {
   assert(planet != NULL);
+  assert(planet->room_cache == NULL);
   assert(resource_dir != NULL);
 
   for (int i = 0; i < num_rooms_to_save; ++i) {
-    const int key = rooms_to_save[i];
-    char *room_path = az_strprintf("%s/rooms/room%03d.txt", resource_dir, key);
-    const bool success = az_save_room_to_path(&planet->rooms[key], room_path);
-    free(room_path);
-    if (!success) return false;
+    const az_room_key_t key = rooms_to_save[i];
+    if (!az_save_planet_room(&planet->rooms[key], resource_dir, key)) {
+      return false;
+    }
   }
 
-  char *planet_path = az_strprintf("%s/rooms/planet.txt", resource_dir);
-  const bool success = save_planet_header(planet, planet_path);
-  free(planet_path);
-  return success;
+  return az_save_planet_header(planet, resource_dir);
 }
 
 /*===========================================================================*/
 
 void az_destroy_planet(az_planet_t *planet) {
   assert(planet != NULL);
+  if (planet->room_cache != NULL) destroy_room_cache(planet->room_cache);
+  if (planet->bundle != NULL) {
+    if (planet->bundle_mapped) {
+      az_unmap_file(planet->bundle, planet->bundle_size);
+    } else az_free(planet->bundle);
+    AZ_ZERO_OBJECT(planet);
+    return;
+  }
+  if (planet->arena != NULL) {
+    az_destroy_arena(planet->arena);
+    az_free(planet->arena);
+    AZ_ZERO_OBJECT(planet);
+    return;
+  }
   az_free_script(planet->on_start);
   for (int i = 0; i < planet->num_paragraphs; ++i) {
-    free(planet->paragraphs[i]);
+    az_free(planet->paragraphs[i]);
   }
-  free(planet->paragraphs);
+  az_free(planet->paragraphs);
   for (int i = 0; i < planet->num_zones; ++i) {
-    free(planet->zones[i].name);
-    free(planet->zones[i].entering_message);
+    az_free(planet->zones[i].name);
+    az_free(planet->zones[i].entering_message);
   }
-  free(planet->zones);
+  az_free(planet->zones);
+  az_free(planet->hints);
   for (int i = 0; i < planet->num_rooms; ++i) {
     az_destroy_room(&planet->rooms[i]);
   }
-  free(planet->rooms);
+  az_free(planet->rooms);
   AZ_ZERO_OBJECT(planet);
 }
 
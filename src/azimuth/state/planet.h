@@ -22,12 +22,15 @@
 #define AZIMUTH_STATE_PLANET_H_
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
 
 #include "azimuth/state/dialog.h"
 #include "azimuth/state/player.h"
 #include "azimuth/state/room.h"
 #include "azimuth/state/music.h" // for az_music_key_t
 #include "azimuth/state/script.h"
+#include "azimuth/util/arena.h"
 
 /*===========================================================================*/
 
@@ -54,6 +57,33 @@ typedef struct {
   az_room_key_t target_room;
 } az_hint_t;
 
+// How many rooms' contents a lazily-loaded planet keeps in memory at once.
+#define AZ_ROOM_CACHE_SIZE 16
+
+typedef struct {
+  az_room_key_t key; // -1 if this cache slot is empty
+  unsigned long last_used;
+  az_room_t room; // the room with its full contents loaded
+  az_arena_t arena; // owns the room's contents
+} az_cached_room_t;
+
+// For a lazily-loaded planet, this holds the contents (object specs and
+// scripts) of the most recently used rooms, along with the door destinations
+// of every room, which are needed to decide what to prefetch.
+typedef struct {
+  char *resource_dir;
+  int *exit_starts; // the exits of room i are exits[exit_starts[i]] up to
+                    // (but not including) exits[exit_starts[i + 1]]
+  az_room_key_t *exits;
+  // The cache never evicts the current room (the one most recently passed to
+  // az_get_room_contents) or the previous room, since the space state may
+  // still hold pointers to their scripts.
+  az_room_key_t current_key, previous_key;
+  unsigned long clock;
+  int num_loads; // total number of room files loaded on demand
+  az_cached_room_t entries[AZ_ROOM_CACHE_SIZE];
+} az_room_cache_t;
+
 typedef struct {
   az_room_key_t start_room;
   az_script_t *on_start;
@@ -65,13 +95,81 @@ typedef struct {
   az_hint_t *hints;
   int num_rooms;
   az_room_t *rooms;
+  // If non-NULL, the rooms above only have their metadata loaded (everything
+  // except their object specs and scripts, which are empty), and the full
+  // rooms must be fetched with az_get_room_contents.
+  az_room_cache_t *room_cache;
+  // If non-NULL, then all of the above arrays, strings, and scripts (other
+  // than the room cache, which manages its own memory) were allocated from
+  // this arena, rather than separately.  Lazily-loaded planets are allocated
+  // this way; planets loaded with az_load_planet_text are not, so that the
+  // editor can modify and free their parts individually.
+  az_arena_t *arena;
+  // If non-NULL, then all of the above arrays, strings, and scripts (including
+  // those of the rooms) live in this single block, loaded from a compiled
+  // planet bundle, rather than being allocated separately.
+  void *bundle;
+  size_t bundle_size;
+  bool bundle_mapped; // true if bundle was mapped with az_map_file
 } az_planet_t;
 
+// Load the planet from the given resource directory, using the compiled
+// planet bundle (rooms/planet.bin) if it is up to date with respect to the
+// text files in the rooms directory, and loading the text files lazily (see
+// az_load_planet_lazily) otherwise.
 bool az_load_planet(const char *resource_dir, az_planet_t *planet_out);
 
+// Load the planet by parsing rooms/planet.txt and the roomNNN.txt files in the
+// given resource directory, ignoring any compiled bundle.
+bool az_load_planet_text(const char *resource_dir, az_planet_t *planet_out);
+
+// Like az_load_planet_text, but only load the metadata of each room up front,
+// deferring each room's contents until az_get_room_contents asks for them.
+bool az_load_planet_lazily(const char *resource_dir, az_planet_t *planet_out);
+
+// Return the room with the given key with its full contents.  For a lazily
+// loaded planet, this loads the room's contents first if they aren't cached
+// (which is a fatal error if the room file has become unreadable since the
+// planet was loaded); the returned pointer remains valid until two other
+// rooms have been fetched.  For other planets, this is just the planet's room.
+const az_room_t *az_get_room_contents(const az_planet_t *planet,
+                                      az_room_key_t key);
+
+// For a lazily loaded planet, load the contents of the rooms that the given
+// room's doors lead to (as many as will fit in the cache), so that moving
+// into them won't need to touch the disk.  For other planets, does nothing.
+void az_prefetch_room_neighbors(const az_planet_t *planet, az_room_key_t key);
+
+// Write the planet as a compiled planet bundle, which can be loaded back
+// without any parsing or per-object allocation.  Returns false on I/O error.
+// Like compiled music, a bundle is only meaningful to the build that wrote it;
+// bundles with a mismatched struct layout are rejected on loading.
+bool az_write_planet_bundle(const az_planet_t *planet, FILE *file);
+
+// Load a compiled planet bundle, either by mapping the file at the given path
+// into memory, or by reading it from an open file.  The planet's arrays point
+// directly into the loaded bundle.  Returns false if the bundle is invalid.
+bool az_load_planet_bundle_from_path(const char *filepath,
+                                     az_planet_t *planet_out);
+bool az_load_planet_bundle_from_file(FILE *file, az_planet_t *planet_out);
+
+// Save the given rooms of the planet, and then the planet-level data, into the
+// rooms/ subdirectory of the given resource directory.  Returns false on
+// failure.  Each file is replaced atomically, but a failure partway through
+// can leave some files updated and others not.
 bool az_save_planet(const az_planet_t *planet, const char *resource_dir,
                     const az_room_key_t *rooms_to_save, int num_rooms_to_save);
 
+// Save only the planet-level data (zones, hints, paragraphs, and so on) into
+// the resource directory, leaving the room files alone.  The planet's rooms
+// array is not used, and may be NULL.
+bool az_save_planet_header(const az_planet_t *planet,
+                           const char *resource_dir);
+
+// Save a single room, as room number key, into the resource directory.
+bool az_save_planet_room(const az_room_t *room, const char *resource_dir,
+                         az_room_key_t key);
+
 // Delete the data arrays owned by a planet (but not the planet object itself).
 void az_destroy_planet(az_planet_t *planet);
 
@@ -675,6 +675,15 @@ static const az_proj_data_t proj_data[] = {
   }
 };
 
+AZ_STATIC_ASSERT(AZ_ARRAY_SIZE(proj_data) == AZ_NUM_PROJ_KINDS + 1);
+
+const az_proj_data_t *az_get_proj_data(az_proj_kind_t kind) {
+  assert(kind != AZ_PROJ_NOTHING);
+  const int data_index = (int)kind;
+  assert(0 <= data_index && data_index < AZ_ARRAY_SIZE(proj_data));
+  return &proj_data[data_index];
+}
+
 void az_init_projectile(az_projectile_t *proj, az_proj_kind_t kind,
                         az_vector_t position, double angle, double power,
                         az_uid_t fired_by) {
@@ -682,9 +691,7 @@ void az_init_projectile(az_projectile_t *proj, az_proj_kind_t kind,
   assert(power > 0.0);
   AZ_ZERO_OBJECT(proj);
   proj->kind = kind;
-  const int data_index = (int)kind;
-  assert(0 <= data_index && data_index < AZ_ARRAY_SIZE(proj_data));
-  proj->data = &proj_data[data_index];
+  proj->data = az_get_proj_data(kind);
   proj->position = position;
   proj->velocity = az_vpolar(proj->data->speed, angle);
   proj->angle = angle;
@@ -30,6 +30,10 @@
 
 /*===========================================================================*/
 
+// The number of different projectile kinds there are, not counting
+// AZ_PROJ_NOTHING:
+#define AZ_NUM_PROJ_KINDS 85
+
 typedef enum {
   AZ_PROJ_NOTHING = 0,
   // Ship projectiles:
@@ -172,6 +176,10 @@ typedef struct {
   az_uid_t last_hit_uid;
 } az_projectile_t;
 
+// Get the static projectile data struct for a particular projectile kind.  The
+// kind must not be AZ_PROJ_NOTHING.
+const az_proj_data_t *az_get_proj_data(az_proj_kind_t kind);
+
 // Set reasonable initial field values for a projectile of the given kind,
 // fired from the given position at the given angle.
 void az_init_projectile(az_projectile_t *proj, az_proj_kind_t kind,
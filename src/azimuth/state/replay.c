@@ -0,0 +1,245 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#include "azimuth/state/replay.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "azimuth/state/baddie.h"
+#include "azimuth/state/player.h"
+#include "azimuth/state/projectile.h"
+#include "azimuth/state/ship.h"
+#include "azimuth/state/space.h"
+#include "azimuth/util/key.h"
+#include "azimuth/util/misc.h"
+#include "azimuth/util/prefs.h"
+#include "azimuth/util/vector.h"
+
+/*===========================================================================*/
+
+#define REPLAY_VERSION 1
+#define REPLAY_BYTE_ORDER 0x01020304
+
+// A replay file starts with this header, followed by the saved game's player
+// struct and the preferences struct (stored directly, just like the records
+// after them).
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  // These guard against loading a replay written by an incompatible build:
+  uint32_t byte_order;
+  uint16_t controls_size, player_size, prefs_size, key_size;
+  int32_t saved_game_index;
+  uint32_t seed_z, seed_w;
+  uint8_t saved_game_present, reserved[3];
+} az_replay_header_t;
+
+static const char replay_magic[4] = {'A', 'Z', 'R', 'P'};
+
+static void init_replay_header(az_replay_header_t *header) {
+  AZ_ZERO_OBJECT(header);
+  memcpy(header->magic, replay_magic, sizeof(header->magic));
+  header->version = REPLAY_VERSION;
+  header->byte_order = REPLAY_BYTE_ORDER;
+  header->controls_size = sizeof(az_controls_t);
+  header->player_size = sizeof(az_player_t);
+  header->prefs_size = sizeof(az_preferences_t);
+  header->key_size = sizeof(az_key_id_t);
+}
+
+bool az_write_replay_start(const az_replay_start_t *start, FILE *file) {
+  assert(start != NULL);
+  assert(file != NULL);
+  az_replay_header_t header;
+  init_replay_header(&header);
+  header.saved_game_index = start->saved_game_index;
+  header.seed_z = start->seed.z;
+  header.seed_w = start->seed.w;
+  header.saved_game_present = start->saved_game.present;
+  return (fwrite(&header, sizeof(header), 1, file) == 1 &&
+          fwrite(&start->saved_game.player, sizeof(az_player_t), 1,
+                 file) == 1 &&
+          fwrite(&start->prefs, sizeof(az_preferences_t), 1, file) == 1);
+}
+
+bool az_read_replay_start(FILE *file, az_replay_start_t *start_out) {
+  assert(file != NULL);
+  assert(start_out != NULL);
+  AZ_ZERO_OBJECT(start_out);
+  az_replay_header_t header;
+  if (fread(&header, sizeof(header), 1, file) != 1) return false;
+  az_replay_header_t expected;
+  init_replay_header(&expected);
+  expected.saved_game_index = header.saved_game_index;
+  expected.seed_z = header.seed_z;
+  expected.seed_w = header.seed_w;
+  expected.saved_game_present = header.saved_game_present;
+  if (memcmp(&header, &expected, sizeof(header)) != 0 ||
+      header.saved_game_index < 0 ||
+      header.saved_game_index >= AZ_NUM_SAVED_GAME_SLOTS ||
+      header.saved_game_present > 1) return false;
+  start_out->saved_game_index = header.saved_game_index;
+  start_out->seed = (az_random_seed_t){header.seed_z, header.seed_w};
+  start_out->saved_game.present = header.saved_game_present;
+  return (fread(&start_out->saved_game.player, sizeof(az_player_t), 1,
+                file) == 1 &&
+          fread(&start_out->prefs, sizeof(az_preferences_t), 1, file) == 1);
+}
+
+/*===========================================================================*/
+
+// Each record is stored as a one-byte kind, followed by its data.
+
+bool az_write_replay_record(const az_replay_record_t *record, FILE *file) {
+  assert(record != NULL);
+  assert(file != NULL);
+  const uint8_t kind = record->kind;
+  if (fwrite(&kind, 1, 1, file) != 1) return false;
+  switch (record->kind) {
+    case AZ_RPR_TICK:
+      return (fwrite(&record->data.tick.controls, sizeof(az_controls_t), 1,
+                     file) == 1 &&
+              fwrite(&record->data.tick.checksum, sizeof(uint64_t), 1,
+                     file) == 1);
+    case AZ_RPR_PAUSE:
+      return (fwrite(&record->data.pause.player, sizeof(az_player_t), 1,
+                     file) == 1 &&
+              fwrite(&record->data.pause.prefs, sizeof(az_preferences_t), 1,
+                     file) == 1);
+    case AZ_RPR_KEY:
+      return (fwrite(&record->data.key, sizeof(az_key_id_t), 1, file) == 1);
+  }
+  AZ_ASSERT_UNREACHABLE();
+}
+
+bool az_read_replay_record(FILE *file, az_replay_record_t *record_out) {
+  assert(file != NULL);
+  assert(record_out != NULL);
+  AZ_ZERO_OBJECT(record_out);
+  uint8_t kind;
+  if (fread(&kind, 1, 1, file) != 1) return false;
+  if (kind < AZ_RPR_TICK || kind > AZ_RPR_KEY) return false;
+  record_out->kind = kind;
+  switch (record_out->kind) {
+    case AZ_RPR_TICK:
+      return (fread(&record_out->data.tick.controls, sizeof(az_controls_t), 1,
+                    file) == 1 &&
+              fread(&record_out->data.tick.checksum, sizeof(uint64_t), 1,
+                    file) == 1);
+    case AZ_RPR_PAUSE:
+      return (fread(&record_out->data.pause.player, sizeof(az_player_t), 1,
+                    file) == 1 &&
+              fread(&record_out->data.pause.prefs, sizeof(az_preferences_t),
+                    1, file) == 1);
+    case AZ_RPR_KEY:
+      return (fread(&record_out->data.key, sizeof(az_key_id_t), 1,
+                    file) == 1 &&
+              record_out->data.key >= AZ_KEY_UNKNOWN &&
+              record_out->data.key <= AZ_LAST_KEY_ID);
+  }
+  AZ_ASSERT_UNREACHABLE();
+}
+
+/*===========================================================================*/
+
+// The checksum is a 64-bit FNV-1a hash of the fields below.  Doubles are
+// hashed by their exact bit patterns, since a replay that diverges by even
+// one ulp will eventually diverge visibly.
+
+static void hash_uint64(uint64_t *hash, uint64_t value) {
+  for (int i = 0; i < 8; ++i) {
+    *hash = (*hash ^ (value & 0xff)) * UINT64_C(1099511628211);
+    value >>= 8;
+  }
+}
+
+AZ_STATIC_ASSERT(sizeof(double) == sizeof(uint64_t));
+
+static void hash_double(uint64_t *hash, double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  hash_uint64(hash, bits);
+}
+
+static void hash_vector(uint64_t *hash, az_vector_t vector) {
+  hash_double(hash, vector.x);
+  hash_double(hash, vector.y);
+}
+
+static void hash_ship(uint64_t *hash, const az_ship_t *ship) {
+  const az_player_t *player = &ship->player;
+  hash_double(hash, player->total_time);
+  hash_uint64(hash, (uint64_t)player->current_room);
+  hash_double(hash, player->shields);
+  hash_double(hash, player->energy);
+  hash_uint64(hash, (uint64_t)player->rockets);
+  hash_uint64(hash, (uint64_t)player->bombs);
+  hash_uint64(hash, (uint64_t)player->gun1);
+  hash_uint64(hash, (uint64_t)player->gun2);
+  hash_uint64(hash, (uint64_t)player->next_gun);
+  hash_uint64(hash, (uint64_t)player->ordnance);
+  hash_vector(hash, ship->position);
+  hash_vector(hash, ship->velocity);
+  hash_double(hash, ship->angle);
+  hash_double(hash, ship->gun_charge);
+  hash_double(hash, ship->ordn_charge);
+  hash_double(hash, ship->ordn_cooldown);
+}
+
+uint64_t az_space_state_checksum(const az_space_state_t *state) {
+  uint64_t hash = UINT64_C(14695981039346656037);
+  hash_uint64(&hash, state->clock);
+  hash_uint64(&hash, (uint64_t)state->mode);
+  hash_ship(&hash, &state->ship);
+  AZ_ARRAY_LOOP(baddie, state->baddies) {
+    if (baddie->kind == AZ_BAD_NOTHING) continue;
+    hash_uint64(&hash, (uint64_t)baddie->kind);
+    hash_uint64(&hash, baddie->uid);
+    hash_vector(&hash, baddie->position);
+    hash_vector(&hash, baddie->velocity);
+    hash_double(&hash, baddie->angle);
+    hash_double(&hash, baddie->health);
+    hash_double(&hash, baddie->cooldown);
+    hash_double(&hash, baddie->param);
+    hash_double(&hash, baddie->param2);
+    hash_uint64(&hash, (uint64_t)baddie->state);
+    AZ_ARRAY_LOOP(component, baddie->components) {
+      hash_vector(&hash, component->position);
+      hash_double(&hash, component->angle);
+    }
+  }
+  AZ_ARRAY_LOOP(proj, state->projectiles) {
+    if (proj->kind == AZ_PROJ_NOTHING) continue;
+    hash_uint64(&hash, (uint64_t)proj->kind);
+    hash_vector(&hash, proj->position);
+    hash_vector(&hash, proj->velocity);
+    hash_double(&hash, proj->angle);
+    hash_double(&hash, proj->power);
+    hash_double(&hash, proj->age);
+    hash_uint64(&hash, (uint64_t)proj->param);
+    hash_uint64(&hash, proj->fired_by);
+  }
+  return hash;
+}
+
+/*===========================================================================*/
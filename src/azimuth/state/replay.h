@@ -0,0 +1,102 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#pragma once
+#ifndef AZIMUTH_STATE_REPLAY_H_
+#define AZIMUTH_STATE_REPLAY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h> // for FILE
+
+#include "azimuth/state/player.h"
+#include "azimuth/state/save.h"
+#include "azimuth/state/ship.h"
+#include "azimuth/state/space.h"
+#include "azimuth/util/key.h"
+#include "azimuth/util/prefs.h"
+#include "azimuth/util/random.h"
+
+/*===========================================================================*/
+
+// A replay file records everything that feeds into the space state over one
+// play session, so that the session can later be played back exactly (to
+// reproduce a bug report, or as a repeatable performance workload).  It
+// starts with the conditions at the start of the session, followed by a
+// stream of records: one AZ_RPR_TICK for each tick, each followed by the
+// AZ_RPR_PAUSE and AZ_RPR_KEY records (if any) for what happened between that
+// tick and the next.  Since the records are streamed, a session that is cut
+// short (e.g. by a crash) still leaves a usable replay of everything up to
+// that point.
+
+typedef struct {
+  int saved_game_index;
+  az_saved_game_t saved_game; // the contents of that slot at the start
+  az_preferences_t prefs;
+  az_random_seed_t seed; // the global random seed at the start
+} az_replay_start_t;
+
+typedef enum {
+  AZ_RPR_TICK = 1,
+  AZ_RPR_PAUSE,
+  AZ_RPR_KEY
+} az_replay_record_kind_t;
+
+typedef struct {
+  az_replay_record_kind_t kind;
+  union {
+    struct {
+      az_controls_t controls; // the ship controls in effect for the tick
+      uint64_t checksum; // az_space_state_checksum just after the tick
+    } tick;
+    // The game was paused, and then resumed with these values (the weapon
+    // selections and preferences can both be changed while paused):
+    struct {
+      az_player_t player;
+      az_preferences_t prefs;
+    } pause;
+    az_key_id_t key; // a keystroke handled by the space controller
+  } data;
+} az_replay_record_t;
+
+// Write the start of a replay to the file, and return true on success.
+bool az_write_replay_start(const az_replay_start_t *start, FILE *file);
+
+// Read the start of a replay from the file, and return true on success, or
+// return false if it's malformed or was written by an incompatible build.
+bool az_read_replay_start(FILE *file, az_replay_start_t *start_out);
+
+// Append a record to a replay file, and return true on success.
+bool az_write_replay_record(const az_replay_record_t *record, FILE *file);
+
+// Read the next record from a replay file and return true, or return false if
+// we've reached the end of the replay (or the rest of it is malformed).
+bool az_read_replay_record(FILE *file, az_replay_record_t *record_out);
+
+/*===========================================================================*/
+
+// Compute a checksum of the simulation state that the player's inputs can
+// affect -- the ship and player, and all baddies and projectiles -- so that a
+// replay can tell exactly which tick it first diverges on.  Cosmetic state
+// (particles, specks, camera, etc.) is deliberately left out.
+uint64_t az_space_state_checksum(const az_space_state_t *state);
+
+/*===========================================================================*/
+
+#endif // AZIMUTH_STATE_REPLAY_H_
@@ -24,50 +24,54 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "azimuth/constants.h"
 #include "azimuth/state/upgrade.h"
 #include "azimuth/state/wall.h"
+#include "azimuth/util/arena.h"
+#include "azimuth/util/file.h"
 #include "azimuth/util/misc.h"
+#include "azimuth/util/scan.h"
 
 /*===========================================================================*/
 
 typedef struct {
-  FILE *file;
+  az_scanner_t scanner;
   bool success;
+  int failure_line;
   jmp_buf jump;
   int num_baddies, num_doors, num_gravfields, num_nodes, num_walls;
   az_room_t *room;
+  az_arena_t *arena; // if non-NULL, allocate the room's contents from here
+  // These are only used when loading metadata:
+  az_room_key_t *exits;
+  int num_exits;
 } az_load_room_t;
 
-#ifdef NDEBUG
-#define FAIL() longjmp(loader->jump, 1)
-#else
 #define FAIL() do{ \
-    fprintf(stderr, "room.c: failure at line %d\n", __LINE__); \
+    loader->failure_line = __LINE__; \
     longjmp(loader->jump, 1); \
   } while (0)
-#endif // NDEBUG
 
 #define READ(...) do { \
-    if (fscanf(loader->file, __VA_ARGS__) < AZ_COUNT_ARGS(__VA_ARGS__) - 1) { \
+    if (az_scan(&loader->scanner, __VA_ARGS__) < \
+        AZ_COUNT_ARGS(__VA_ARGS__) - 1) { \
       FAIL(); \
     } \
   } while (false)
 
-#define TRY_GETC(ch) try_getc(ch, loader->file)
-static bool try_getc(char ch, FILE *file) {
-  const char next_ch = fgetc(file);
-  if (next_ch == ch) return true;
-  ungetc(next_ch, file);
-  return false;
-}
+#define TRY_GETC(ch) az_scan_try_char(&loader->scanner, ch)
+
+#define ALLOC(n, type) \
+  (loader->arena == NULL ? AZ_ALLOC((n), type) : \
+   AZ_ARENA_ALLOC(loader->arena, (n), type))
 
 // Read the next non-whitespace character.  If it is '$', return true; if it is
 // '!' or if we reach EOF, return false; otherwise, fail parsing.
 static bool scan_to_script(az_load_room_t *loader) {
   char ch;
-  if (fscanf(loader->file, " %c", &ch) < 1) return false;
+  if (az_scan(&loader->scanner, " %c", &ch) < 1) return false;
   else if (ch == '!') return false;
   else if (ch == '$') return true;
   else FAIL();
@@ -75,9 +79,12 @@ static bool scan_to_script(az_load_room_t *loader) {
 
 static az_script_t *maybe_parse_script(az_load_room_t *loader, char ch) {
   if (!scan_to_script(loader)) return NULL;
-  if (fgetc(loader->file) != ch) FAIL();
-  if (fgetc(loader->file) != ':') FAIL();
-  az_script_t *script = az_fscan_script(loader->file);
+  if (az_scan_getc(&loader->scanner) != ch) FAIL();
+  if (az_scan_getc(&loader->scanner) != ':') FAIL();
+  az_script_t *script = (loader->arena == NULL ?
+                         az_scan_script(&loader->scanner) :
+                         az_arena_scan_script(&loader->scanner,
+                                              loader->arena));
   if (script == NULL) FAIL();
   if (scan_to_script(loader)) FAIL();
   return script;
@@ -115,25 +122,28 @@ static void parse_room_header(az_load_room_t *loader) {
   loader->room->camera_bounds.theta_span = theta_span;
   if (num_baddies < 0 || num_baddies > AZ_MAX_NUM_BADDIES) FAIL();
   loader->num_baddies = num_baddies;
-  loader->room->num_baddies = 0;
-  loader->room->baddies = AZ_ALLOC(num_baddies, az_baddie_spec_t);
   if (num_doors < 0 || num_doors > AZ_MAX_NUM_DOORS) FAIL();
   loader->num_doors = num_doors;
-  loader->room->num_doors = 0;
-  loader->room->doors = AZ_ALLOC(num_doors, az_door_spec_t);
   if (num_gravfields < 0 || num_gravfields > AZ_MAX_NUM_GRAVFIELDS) FAIL();
   loader->num_gravfields = num_gravfields;
-  loader->room->num_gravfields = 0;
-  loader->room->gravfields = AZ_ALLOC(num_gravfields, az_gravfield_spec_t);
   if (num_nodes < 0 || num_nodes > AZ_MAX_NUM_NODES) FAIL();
   loader->num_nodes = num_nodes;
-  loader->room->num_nodes = 0;
-  loader->room->nodes = AZ_ALLOC(num_nodes, az_node_spec_t);
   if (num_walls < 0 || num_walls > AZ_MAX_NUM_WALLS) FAIL();
   loader->num_walls = num_walls;
-  loader->room->num_walls = 0;
-  loader->room->walls = AZ_ALLOC(num_walls, az_wall_spec_t);
-  loader->room->on_start = maybe_parse_script(loader, 's');
+}
+
+static void allocate_room_specs(az_load_room_t *loader) {
+  az_room_t *room = loader->room;
+  room->num_baddies = 0;
+  room->baddies = ALLOC(loader->num_baddies, az_baddie_spec_t);
+  room->num_doors = 0;
+  room->doors = ALLOC(loader->num_doors, az_door_spec_t);
+  room->num_gravfields = 0;
+  room->gravfields = ALLOC(loader->num_gravfields, az_gravfield_spec_t);
+  room->num_nodes = 0;
+  room->nodes = ALLOC(loader->num_nodes, az_node_spec_t);
+  room->num_walls = 0;
+  room->walls = ALLOC(loader->num_walls, az_wall_spec_t);
 }
 
 static void parse_baddie_directive(az_load_room_t *loader) {
@@ -218,6 +228,14 @@ static void parse_gravfield_directive(az_load_room_t *loader) {
   ++loader->room->num_gravfields;
 }
 
+static void add_console_property(az_room_t *room, az_console_kind_t kind) {
+  switch (kind) {
+    case AZ_CONS_COMM:   room->properties |= AZ_ROOMF_WITH_COMM;   break;
+    case AZ_CONS_REFILL: room->properties |= AZ_ROOMF_WITH_REFILL; break;
+    case AZ_CONS_SAVE:   room->properties |= AZ_ROOMF_WITH_SAVE;   break;
+  }
+}
+
 static void parse_node_directive(az_load_room_t *loader) {
   if (loader->room->num_nodes >= loader->num_nodes) FAIL();
   int kind;
@@ -236,11 +254,7 @@ static void parse_node_directive(az_load_room_t *loader) {
       case AZ_NODE_CONSOLE:
         if (subkind < 0 || subkind >= AZ_NUM_CONSOLE_KINDS) FAIL();
         node->subkind.console = (az_console_kind_t)subkind;
-        switch (node->subkind.console) {
-          case AZ_CONS_COMM:   room->properties |= AZ_ROOMF_WITH_COMM;   break;
-          case AZ_CONS_REFILL: room->properties |= AZ_ROOMF_WITH_REFILL; break;
-          case AZ_CONS_SAVE:   room->properties |= AZ_ROOMF_WITH_SAVE;   break;
-        }
+        add_console_property(room, node->subkind.console);
         break;
       case AZ_NODE_UPGRADE:
         if (subkind < 0 || subkind >= AZ_NUM_UPGRADES) FAIL();
@@ -296,7 +310,7 @@ static void parse_wall_directive(az_load_room_t *loader) {
 }
 
 static bool parse_directive(az_load_room_t *loader) {
-  switch (fgetc(loader->file)) {
+  switch (az_scan_getc(&loader->scanner)) {
     case 'B': parse_baddie_directive(loader); return true;
     case 'D': parse_door_directive(loader); return true;
     case 'G': parse_gravfield_directive(loader); return true;
@@ -316,32 +330,133 @@ static void validate_room(az_load_room_t *loader) {
       loader->room->num_walls != loader->num_walls) FAIL();
 }
 
+// Skip the rest of the current directive, including any scripts (which never
+// contain a '!'), leaving the scanner positioned at the next '!' (or EOF).
+static void skip_to_bang(az_load_room_t *loader) {
+  az_scanner_t *scanner = &loader->scanner;
+  const char *bang = memchr(scanner->ptr, '!', scanner->end - scanner->ptr);
+  scanner->ptr = (bang == NULL ? scanner->end : bang);
+}
+
+static void parse_door_metadata(az_load_room_t *loader) {
+  if (loader->num_exits >= loader->num_doors) FAIL();
+  int kind, destination;
+  double x, y, angle;
+  READ("%d x%lf y%lf a%lf r%d", &kind, &x, &y, &angle, &destination);
+  if (destination < 0 || destination >= AZ_MAX_NUM_ROOMS) FAIL();
+  loader->exits[loader->num_exits++] = destination;
+}
+
+static void parse_node_metadata(az_load_room_t *loader) {
+  int kind;
+  READ("%d", &kind);
+  if (kind != AZ_NODE_CONSOLE) return;
+  int subkind;
+  READ("/%d", &subkind);
+  if (subkind < 0 || subkind >= AZ_NUM_CONSOLE_KINDS) FAIL();
+  add_console_property(loader->room, (az_console_kind_t)subkind);
+}
+
+// Parse only as much of the room file as is needed to fill in the room's
+// metadata and door destinations, skipping over everything else.
+static bool parse_metadata_directive(az_load_room_t *loader) {
+  skip_to_bang(loader);
+  if (!TRY_GETC('!')) return false;
+  switch (az_scan_getc(&loader->scanner)) {
+    case 'B': case 'G': case 'W': return true;
+    case 'D': parse_door_metadata(loader); return true;
+    case 'N': parse_node_metadata(loader); return true;
+    default: FAIL();
+  }
+  AZ_ASSERT_UNREACHABLE();
+}
+
+#undef ALLOC
 #undef TRY_GETC
 #undef READ
 #undef FAIL
 
 static void parse_room(az_load_room_t *loader) {
   if (setjmp(loader->jump) != 0) {
-    az_destroy_room(loader->room);
+    // Anything allocated from an arena is reclaimed along with the arena.
+    if (loader->arena == NULL) az_destroy_room(loader->room);
+    else AZ_ZERO_OBJECT(loader->room);
     return;
   }
   parse_room_header(loader);
+  allocate_room_specs(loader);
+  loader->room->on_start = maybe_parse_script(loader, 's');
   while (parse_directive(loader));
   validate_room(loader);
   loader->success = true;
 }
 
-bool az_load_room_from_path(const char *filepath, az_room_t *room_out) {
+static void parse_room_metadata(az_load_room_t *loader) {
+  if (setjmp(loader->jump) != 0) {
+    az_destroy_room(loader->room);
+    return;
+  }
+  parse_room_header(loader);
+  while (parse_metadata_directive(loader));
+  loader->success = true;
+}
+
+bool az_load_room_quietly(const char *filepath, az_arena_t *arena,
+                          az_room_t *room_out, int *failure_line_out) {
   assert(room_out != NULL);
+  assert(failure_line_out != NULL);
   AZ_ZERO_OBJECT(room_out);
-  FILE *file = fopen(filepath, "r");
-  if (file == NULL) return false;
-  az_load_room_t loader = {.file = file, .room = room_out, .success = false};
+  *failure_line_out = 0;
+  size_t size;
+  char *data = az_read_file(filepath, &size);
+  if (data == NULL) return false;
+  az_load_room_t loader = {
+    .room = room_out, .arena = arena, .success = false
+  };
+  az_init_scanner(&loader.scanner, data, size);
   parse_room(&loader);
-  fclose(file);
+  az_free(data);
+  *failure_line_out = loader.failure_line;
+  return loader.success;
+}
+
+bool az_load_room_metadata_quietly(
+    const char *filepath, az_room_t *room_out,
+    az_room_key_t exits_out[AZ_MAX_NUM_DOORS], int *num_exits_out,
+    int *failure_line_out) {
+  assert(room_out != NULL);
+  assert(exits_out != NULL);
+  assert(num_exits_out != NULL);
+  assert(failure_line_out != NULL);
+  AZ_ZERO_OBJECT(room_out);
+  *num_exits_out = 0;
+  *failure_line_out = 0;
+  size_t size;
+  char *data = az_read_file(filepath, &size);
+  if (data == NULL) return false;
+  az_load_room_t loader = {
+    .room = room_out, .success = false, .exits = exits_out
+  };
+  az_init_scanner(&loader.scanner, data, size);
+  parse_room_metadata(&loader);
+  az_free(data);
+  *num_exits_out = loader.num_exits;
+  *failure_line_out = loader.failure_line;
   return loader.success;
 }
 
+bool az_load_room_from_path(const char *filepath, az_room_t *room_out) {
+  int failure_line;
+  const bool success =
+    az_load_room_quietly(filepath, NULL, room_out, &failure_line);
+#ifndef NDEBUG
+  if (failure_line != 0) {
+    fprintf(stderr, "room.c: failure at line %d\n", failure_line);
+  }
+#endif // NDEBUG
+  return success;
+}
+
 /*===========================================================================*/
 
 #define WRITE(...) do { \
@@ -460,12 +575,14 @@ static bool write_room(const az_room_t *room, FILE *file) {
 #undef WRITE
 #undef WRITE_SCRIPT
 
+// Adapts write_room for az_write_file_atomically.
+static bool write_room_to_file(void *room, FILE *file) {
+  return write_room(room, file);
+}
+
 bool az_save_room_to_path(const az_room_t *room, const char *filepath) {
-  FILE *file = fopen(filepath, "w");
-  if (file == NULL) return false;
-  const bool ok = write_room(room, file);
-  fclose(file);
-  return ok;
+  return az_write_file_atomically(filepath, write_room_to_file,
+                                  (void *)room);
 }
 
 /*===========================================================================*/
@@ -473,13 +590,51 @@ bool az_save_room_to_path(const az_room_t *room, const char *filepath) {
 void az_destroy_room(az_room_t *room) {
   assert(room != NULL);
   az_free_script(room->on_start);
-  free(room->baddies);
-  free(room->doors);
-  free(room->nodes);
-  free(room->walls);
+  for (int i = 0; i < room->num_baddies; ++i) {
+    az_free_script(room->baddies[i].on_kill);
+  }
+  az_free(room->baddies);
+  for (int i = 0; i < room->num_doors; ++i) {
+    az_free_script(room->doors[i].on_open);
+  }
+  az_free(room->doors);
+  for (int i = 0; i < room->num_gravfields; ++i) {
+    az_free_script(room->gravfields[i].on_enter);
+  }
+  az_free(room->gravfields);
+  for (int i = 0; i < room->num_nodes; ++i) {
+    az_free_script(room->nodes[i].on_use);
+  }
+  az_free(room->nodes);
+  az_free(room->walls);
   AZ_ZERO_OBJECT(room);
 }
 
+int az_num_room_script_owners(const az_room_t *room, az_script_owner_t owner) {
+  switch (owner) {
+    case AZ_SCRIPT_OWNER_ROOM: return 1;
+    case AZ_SCRIPT_OWNER_BADDIE: return room->num_baddies;
+    case AZ_SCRIPT_OWNER_DOOR: return room->num_doors;
+    case AZ_SCRIPT_OWNER_GRAVFIELD: return room->num_gravfields;
+    case AZ_SCRIPT_OWNER_NODE: return room->num_nodes;
+  }
+  AZ_ASSERT_UNREACHABLE();
+}
+
+const az_script_t *az_room_script_at(const az_room_t *room,
+                                     az_script_owner_t owner, int index) {
+  assert(index >= 0);
+  assert(index < az_num_room_script_owners(room, owner));
+  switch (owner) {
+    case AZ_SCRIPT_OWNER_ROOM: return room->on_start;
+    case AZ_SCRIPT_OWNER_BADDIE: return room->baddies[index].on_kill;
+    case AZ_SCRIPT_OWNER_DOOR: return room->doors[index].on_open;
+    case AZ_SCRIPT_OWNER_GRAVFIELD: return room->gravfields[index].on_enter;
+    case AZ_SCRIPT_OWNER_NODE: return room->nodes[index].on_use;
+  }
+  AZ_ASSERT_UNREACHABLE();
+}
+
 az_vector_t az_room_center(const az_room_t *room) {
   const az_camera_bounds_t *bounds = &room->camera_bounds;
   return (bounds->theta_span >= 6.28 && bounds->min_r < AZ_SCREEN_HEIGHT ?
@@ -32,6 +32,7 @@
 #include "azimuth/state/player.h"
 #include "azimuth/state/script.h"
 #include "azimuth/state/wall.h"
+#include "azimuth/util/arena.h"
 
 /*===========================================================================*/
 
@@ -107,7 +108,8 @@ typedef uint_fast8_t az_room_flags_t;
 #define AZ_ROOMF_WITH_REFILL ((az_room_flags_t)(1u << 5))
 #define AZ_ROOMF_WITH_SAVE   ((az_room_flags_t)(1u << 6))
 
-// Represents one room of the planetoid.  This sturct owns all of its pointers.
+// Represents one room of the planetoid.  This sturct owns all of its pointers
+// (unless it was loaded into an arena; see az_load_room_quietly).
 typedef struct {
   az_zone_key_t zone_key;
   az_room_flags_t properties;
@@ -132,13 +134,54 @@ typedef struct {
 // it.  Returns true on success, false on failure.
 bool az_load_room_from_path(const char *filepath, az_room_t *room_out);
 
+// Like az_load_room_from_path, but rather than printing a diagnostic on failure
+// (in debug builds), stores the line of room.c at which parsing failed (or
+// zero if the file couldn't be read) in *failure_line_out, so that a caller
+// loading many rooms in parallel can report failures in a deterministic order.
+// If arena is non-NULL, the room's spec arrays and scripts are allocated from
+// it, and the room must then be disposed of by clearing or destroying the
+// arena rather than by calling az_destroy_room.
+bool az_load_room_quietly(const char *filepath, az_arena_t *arena,
+                          az_room_t *room_out, int *failure_line_out);
+
+// Like az_load_room_quietly, but only loads the room's metadata (everything
+// except its object specs and scripts, which are left empty), skipping over
+// the rest of the file.  The destinations of the room's doors are stored in
+// exits_out, and the number of doors in *num_exits_out.
+bool az_load_room_metadata_quietly(
+    const char *filepath, az_room_t *room_out,
+    az_room_key_t exits_out[AZ_MAX_NUM_DOORS], int *num_exits_out,
+    int *failure_line_out);
+
 // Attempt to save a room to the file located at the given path.  Return true
-// on success, or false on failure.
+// on success, or false on failure (in which case any existing file at that
+// path is left untouched).
 bool az_save_room_to_path(const az_room_t *room, const char *filepath);
 
 // Delete the data arrays owned by a room (but not the room object itself).
 void az_destroy_room(az_room_t *room);
 
+// The kinds of room object that can own a script:
+typedef enum {
+  AZ_SCRIPT_OWNER_ROOM, // the room's on_start script
+  AZ_SCRIPT_OWNER_BADDIE, // on_kill
+  AZ_SCRIPT_OWNER_DOOR, // on_open
+  AZ_SCRIPT_OWNER_GRAVFIELD, // on_enter
+  AZ_SCRIPT_OWNER_NODE, // on_use
+} az_script_owner_t;
+#define AZ_NUM_SCRIPT_OWNERS 5
+
+// Return the number of objects of the given kind in the room that can own a
+// script (always 1 for AZ_SCRIPT_OWNER_ROOM).  To visit every script in a
+// room, loop over each owner kind and each index below this count, calling
+// az_room_script_at.
+int az_num_room_script_owners(const az_room_t *room, az_script_owner_t owner);
+
+// Return the script owned by the index-th object of the given kind in the
+// room, or NULL if that object has no script.
+const az_script_t *az_room_script_at(const az_room_t *room,
+                                     az_script_owner_t owner, int index);
+
 // Get the position that is (roughly) the center of the room.
 az_vector_t az_room_center(const az_room_t *room);
 
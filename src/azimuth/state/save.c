@@ -21,14 +21,18 @@
 
 #include <assert.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "azimuth/state/planet.h"
 #include "azimuth/state/player.h"
 #include "azimuth/state/upgrade.h"
+#include "azimuth/util/file.h"
 #include "azimuth/util/misc.h"
+#include "azimuth/util/string.h"
 #include "azimuth/util/vector.h"
 
 /*===========================================================================*/
@@ -209,14 +213,93 @@ static bool write_games(const az_saved_games_t *games, FILE *file) {
 
 #undef WRITE_BITFIELD
 
+// Adapts write_games for az_write_file_atomically.
+static bool write_games_to_file(void *data, FILE *file) {
+  return write_games(data, file);
+}
+
+static bool write_games_to_path(const az_saved_games_t *games,
+                                const char *filepath) {
+  // Write atomically, so that a crash (or power loss) mid-save can never
+  // destroy the player's existing saved games.
+  return az_write_file_atomically(filepath, write_games_to_file,
+                                  (void *)games);
+}
+
+/*===========================================================================*/
+
+// State for the background save thread.  Only one background save runs at a
+// time; the fields other than result_ready and result are only touched by
+// the main thread, or by the save thread while it's running.
+static struct {
+  bool thread_running; // true if the thread has been started but not joined
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  bool result_ready; // protected by mutex
+  bool result; // protected by mutex
+  bool exit_handler_registered;
+  char *filepath;
+  az_saved_games_t games; // a snapshot of the games being saved
+} background_save = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+static void *run_background_save(void *arg) {
+  const bool success =
+    write_games_to_path(&background_save.games, background_save.filepath);
+  pthread_mutex_lock(&background_save.mutex);
+  background_save.result = success;
+  background_save.result_ready = true;
+  pthread_mutex_unlock(&background_save.mutex);
+  return NULL;
+}
+
+static void wait_for_background_save(void) {
+  if (!background_save.thread_running) return;
+  pthread_join(background_save.thread, NULL);
+  background_save.thread_running = false;
+}
+
+void az_begin_saving_games_to_path(const az_saved_games_t *games,
+                                   const char *filepath) {
+  assert(games != NULL);
+  assert(filepath != NULL);
+  wait_for_background_save();
+  // Don't let the program exit in the middle of a save (which would be safe,
+  // but would lose the save).
+  if (!background_save.exit_handler_registered) {
+    atexit(wait_for_background_save);
+    background_save.exit_handler_registered = true;
+  }
+  pthread_mutex_lock(&background_save.mutex);
+  background_save.result_ready = false;
+  pthread_mutex_unlock(&background_save.mutex);
+  az_free(background_save.filepath);
+  background_save.filepath = az_strdup(filepath);
+  background_save.games = *games;
+  if (pthread_create(&background_save.thread, NULL, run_background_save,
+                     NULL) == 0) {
+    background_save.thread_running = true;
+  } else run_background_save(NULL);
+}
+
+bool az_poll_saving_games(bool *success_out) {
+  assert(success_out != NULL);
+  pthread_mutex_lock(&background_save.mutex);
+  const bool ready = background_save.result_ready;
+  const bool result = background_save.result;
+  background_save.result_ready = false;
+  pthread_mutex_unlock(&background_save.mutex);
+  if (!ready) return false;
+  wait_for_background_save();
+  *success_out = result;
+  return true;
+}
+
 bool az_save_games_to_path(const az_saved_games_t *games,
                            const char *filepath) {
   assert(games != NULL);
-  FILE *file = fopen(filepath, "w");
-  if (file == NULL) return false;
-  const bool ok = write_games(games, file);
-  fclose(file);
-  return ok;
+  // Don't race with a background save that might be writing the same file.
+  wait_for_background_save();
+  return write_games_to_path(games, filepath);
 }
 
 /*===========================================================================*/
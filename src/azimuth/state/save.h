@@ -58,9 +58,27 @@ bool az_load_games_from_path(const az_planet_t *planet,
                              const char *filepath,
                              az_saved_games_t *games_out);
 
+// Save the games to the given path and return true, or return false on
+// failure.  The file is replaced atomically, so that a crash mid-save never
+// corrupts the existing file.  If a background save is in progress, this
+// waits for it to finish first.
 bool az_save_games_to_path(const az_saved_games_t *games,
                            const char *filepath);
 
+// Like az_save_games_to_path, but save a snapshot of the games on a
+// background thread, so that the caller doesn't have to wait on the disk.  If
+// an earlier background save is still in progress, this waits for it to
+// finish first.  Use az_poll_saving_games to find out how the save went.  A
+// background save still in progress when the program exits is allowed to
+// finish first.
+void az_begin_saving_games_to_path(const az_saved_games_t *games,
+                                   const char *filepath);
+
+// If a background save has finished since the last time this was called, set
+// *success_out to whether it succeeded and return true; otherwise, return
+// false immediately.
+bool az_poll_saving_games(bool *success_out);
+
 /*===========================================================================*/
 
 #endif // AZIMUTH_STATE_SAVE_H_
@@ -20,6 +20,7 @@
 #include "azimuth/state/script.h"
 
 #include <assert.h>
+#include <math.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -27,6 +28,7 @@
 #include <string.h>
 
 #include "azimuth/util/misc.h"
+#include "azimuth/util/vector.h"
 
 /*===========================================================================*/
 
@@ -401,30 +403,30 @@ bool az_sprint_script(const az_script_t *script, char *buffer, int length) {
 
 /*===========================================================================*/
 
-static bool fscan_instructions(FILE *file, int num_instructions,
-                               az_instruction_t *instructions) {
+static bool scan_instructions(az_scanner_t *scanner, int num_instructions,
+                              az_instruction_t *instructions) {
   int label_table[26] = {0};
   char jump_table[num_instructions];
   memset(jump_table, '\0', num_instructions);
   for (int i = 0; i < num_instructions; ++i) {
     char label[2];
-    int num_read;
-    if (fscanf(file, "%1[A-Z]#%n", label, &num_read) == 1) {
+    int num_read = 0;
+    if (az_scan(scanner, "%1[A-Z]#%n", label, &num_read) == 1) {
       const int label_index = label[0] - 'A';
       assert(label_index >= 0 && label_index < AZ_ARRAY_SIZE(label_table));
       label_table[label_index] = i;
       if (num_read != 2) return false;
     }
     char name[12];
-    if (fscanf(file, "%11[a-z]%lf", name,
-               &instructions[i].immediate) == 0 ||
+    if (az_scan(scanner, "%11[a-z]%lf", name,
+                &instructions[i].immediate) == 0 ||
         !opcode_for_name(name, &instructions[i].opcode)) {
       return false;
     }
-    if (fscanf(file, "/%1[@A-Z]", label) == 1) {
+    if (az_scan(scanner, "/%1[@A-Z]", label) == 1) {
       jump_table[i] = label[0];
     }
-    if (fgetc(file) != (i == num_instructions - 1 ? ';' : ',')) {
+    if (az_scan_getc(scanner) != (i == num_instructions - 1 ? ';' : ',')) {
       return false;
     }
   }
@@ -443,46 +445,256 @@ static bool fscan_instructions(FILE *file, int num_instructions,
   return true;
 }
 
-az_script_t *az_fscan_script(FILE *file) {
-  // Scan ahead and determine how many instructions long this script is.
-  fpos_t pos;
-  if (fgetpos(file, &pos) != 0) return NULL;
+// Scan a script, allocating it from the arena if arena is non-NULL, or from
+// the heap otherwise.
+static az_script_t *scan_script(az_scanner_t *scanner, az_arena_t *arena) {
+  // Scan ahead (without consuming anything) and determine how many
+  // instructions long this script is.
   int num_instructions = 1;
-  for (bool finished = false; !finished;) {
-    switch (fgetc(file)) {
-      case EOF: return NULL;
-      case ',': ++num_instructions; break;
-      case ';': finished = true; break;
-      default: break;
-    }
+  for (const char *ptr = scanner->ptr; true; ++ptr) {
+    if (ptr >= scanner->end) return NULL;
+    else if (*ptr == ',') ++num_instructions;
+    else if (*ptr == ';') break;
   }
-  // Go back to the start of the script.
-  if (fsetpos(file, &pos) != 0) return NULL;
-  // Parse the instructions.
+  // Parse the instructions.  (If this fails, any arena memory we used is
+  // simply wasted until the arena is cleared.)
   az_instruction_t *instructions =
-    AZ_ALLOC(num_instructions, az_instruction_t);
-  if (!fscan_instructions(file, num_instructions, instructions)) {
-    free(instructions);
+    (arena == NULL ? AZ_ALLOC(num_instructions, az_instruction_t) :
+     AZ_ARENA_ALLOC(arena, num_instructions, az_instruction_t));
+  if (!scan_instructions(scanner, num_instructions, instructions)) {
+    if (arena == NULL) az_free(instructions);
     return NULL;
   }
-  az_script_t *script = AZ_ALLOC(1, az_script_t);
+  az_script_t *script = (arena == NULL ? AZ_ALLOC(1, az_script_t) :
+                         AZ_ARENA_ALLOC(arena, 1, az_script_t));
   script->num_instructions = num_instructions;
   script->instructions = instructions;
+  az_verify_script(script);
   return script;
 }
 
-az_script_t *az_sscan_script(const char *string, int length) {
-  FILE *file = tmpfile();
-  if (file == NULL) return NULL;
-  az_script_t *script = NULL;
-  if (fputs(string, file) >= 0) {
-    rewind(file);
-    script = az_fscan_script(file);
+az_script_t *az_scan_script(az_scanner_t *scanner) {
+  return scan_script(scanner, NULL);
+}
+
+az_script_t *az_arena_scan_script(az_scanner_t *scanner, az_arena_t *arena) {
+  assert(arena != NULL);
+  return scan_script(scanner, arena);
+}
+
+az_script_t *az_fscan_script(FILE *file) {
+  // Read the script's text, up to and including the terminating semicolon,
+  // into memory, and then scan it from there.
+  size_t size = 0, capacity = 64;
+  char *buffer = AZ_ALLOC(capacity, char);
+  for (int ch = 0; ch != ';';) {
+    ch = fgetc(file);
+    if (ch == EOF) {
+      az_free(buffer);
+      return NULL;
+    }
+    if (size == capacity) {
+      capacity *= 2;
+      char *new_buffer = realloc(buffer, capacity);
+      if (new_buffer == NULL) AZ_FATAL("Out of memory.\n");
+      buffer = new_buffer;
+    }
+    buffer[size++] = (char)ch;
   }
-  fclose(file);
+  az_scanner_t scanner;
+  az_init_scanner(&scanner, buffer, size);
+  az_script_t *script = az_scan_script(&scanner);
+  az_free(buffer);
   return script;
 }
 
+az_script_t *az_sscan_script(const char *string, int length) {
+  assert(length >= 0);
+  // Like the file version, stop at the first NUL, if any.
+  const char *nul = memchr(string, '\0', length);
+  az_scanner_t scanner;
+  az_init_scanner(&scanner, string, (nul == NULL ? length : nul - string));
+  return az_scan_script(&scanner);
+}
+
+/*===========================================================================*/
+
+// Convert the immediate to an int the way the script VM does, but clamped so
+// that absurd values can't overflow.
+static int clamp_immediate(az_instruction_t ins) {
+  return (int)fmin(fmax(ins.immediate, -1000.0), 1000.0);
+}
+
+// Determine how many values the instruction pops off the stack and then
+// pushes back onto it, or return false if the opcode is invalid.
+static bool get_stack_effect(az_instruction_t ins, int *pops_out,
+                             int *pushes_out) {
+  if (ins.opcode < AZ_OP_NOP || ins.opcode > AZ_OP_ERROR) return false;
+  int pops = 0, pushes = 0;
+  switch (ins.opcode) {
+    case AZ_OP_NOP: break;
+    case AZ_OP_PUSH: pushes = 1; break;
+    case AZ_OP_POP: pops = az_imax(1, clamp_immediate(ins)); break;
+    case AZ_OP_DUP:
+      pops = az_imax(1, clamp_immediate(ins));
+      pushes = 2 * pops;
+      break;
+    case AZ_OP_SWAP: {
+      const int cycle = clamp_immediate(ins);
+      pops = pushes = (cycle == 0 ? 2 : abs(cycle));
+    } break;
+    case AZ_OP_ADD: case AZ_OP_SUB: case AZ_OP_MUL: case AZ_OP_DIV:
+    case AZ_OP_MOD: case AZ_OP_MIN: case AZ_OP_MAX:
+      pops = 2; pushes = 1; break;
+    case AZ_OP_ADDI: case AZ_OP_SUBI: case AZ_OP_ISUB: case AZ_OP_MULI:
+    case AZ_OP_DIVI: case AZ_OP_IDIV: case AZ_OP_MODI: case AZ_OP_MINI:
+    case AZ_OP_MAXI:
+      pops = 1; pushes = 1; break;
+    case AZ_OP_ABS: case AZ_OP_MTAU: case AZ_OP_SQRT:
+      pops = 1; pushes = 1; break;
+    case AZ_OP_RAND: pushes = 1; break;
+    case AZ_OP_VADD: case AZ_OP_VSUB: pops = 4; pushes = 2; break;
+    case AZ_OP_VMUL: pops = 3; pushes = 2; break;
+    case AZ_OP_VMULI: pops = 2; pushes = 2; break;
+    case AZ_OP_VNORM: case AZ_OP_VTHETA: pops = 2; pushes = 1; break;
+    case AZ_OP_VPOLAR: pops = 2; pushes = 2; break;
+    case AZ_OP_EQ: case AZ_OP_NE: case AZ_OP_LT: case AZ_OP_GT:
+    case AZ_OP_LE: case AZ_OP_GE:
+      pops = 2; pushes = 1; break;
+    case AZ_OP_EQI: case AZ_OP_NEI: case AZ_OP_LTI: case AZ_OP_GTI:
+    case AZ_OP_LEI: case AZ_OP_GEI:
+      pops = 1; pushes = 1; break;
+    case AZ_OP_TEST: case AZ_OP_HAS: pushes = 1; break;
+    case AZ_OP_SET: case AZ_OP_CLR: case AZ_OP_MAP: break;
+    case AZ_OP_NIX: case AZ_OP_KILL: break;
+    case AZ_OP_GHEAL: case AZ_OP_GANG: case AZ_OP_GSTAT: pushes = 1; break;
+    case AZ_OP_SHEAL: case AZ_OP_SANG: case AZ_OP_SSTAT: pops = 1; break;
+    case AZ_OP_GPOS: pushes = 2; break;
+    case AZ_OP_SPOS: pops = 2; break;
+    case AZ_OP_ACTIV: case AZ_OP_DEACT: break;
+    case AZ_OP_GVEL: pushes = 2; break;
+    case AZ_OP_SVEL: pops = 2; break;
+    case AZ_OP_AUTOP: break;
+    case AZ_OP_TURN: pops = 1; break;
+    case AZ_OP_THRUST: case AZ_OP_CPLUS: break;
+    case AZ_OP_BAD: pops = 4; break;
+    case AZ_OP_SBADK: pops = 1; break;
+    case AZ_OP_BOSS: break;
+    case AZ_OP_OPEN: case AZ_OP_CLOSE: case AZ_OP_LOCK: case AZ_OP_UNLOCK:
+      break;
+    case AZ_OP_GSTR: pushes = 1; break;
+    case AZ_OP_SSTR: pops = 1; break;
+    case AZ_OP_GCAM: pushes = 2; break;
+    case AZ_OP_RCAM: pops = 1; break;
+    case AZ_OP_DARK: break;
+    case AZ_OP_DARKS: pops = 1; break;
+    case AZ_OP_BLINK: case AZ_OP_SHAKE: case AZ_OP_QUAKE: break;
+    case AZ_OP_BOOM: pops = 2; break;
+    case AZ_OP_NUKE: break;
+    case AZ_OP_BOLT: pops = 4; break;
+    case AZ_OP_NPS: pops = 2; break;
+    case AZ_OP_FADO: case AZ_OP_FADI: case AZ_OP_FLASH: case AZ_OP_SCENE:
+    case AZ_OP_SCTXT: case AZ_OP_SKIP:
+      break;
+    case AZ_OP_MSG: case AZ_OP_DLOG: case AZ_OP_PT: case AZ_OP_PB:
+    case AZ_OP_TT: case AZ_OP_TB: case AZ_OP_DEND: case AZ_OP_MLOG:
+    case AZ_OP_TM: case AZ_OP_MEND:
+      break;
+    case AZ_OP_MUS: case AZ_OP_MUSF: case AZ_OP_SND: break;
+    case AZ_OP_WAIT: break;
+    case AZ_OP_WAITS: pops = 1; break;
+    case AZ_OP_DOOM: case AZ_OP_SAFE: break;
+    case AZ_OP_JUMP: break;
+    case AZ_OP_BEQZ: case AZ_OP_BNEZ: pops = 1; break;
+    case AZ_OP_HALT: break;
+    case AZ_OP_HEQZ: case AZ_OP_HNEZ: pops = 1; break;
+    case AZ_OP_VICT: case AZ_OP_ERROR: break;
+  }
+  *pops_out = pops;
+  *pushes_out = pushes;
+  return true;
+}
+
+bool az_verify_script(az_script_t *script) {
+  assert(script != NULL);
+  script->verified = false;
+  script->max_stack_depth = 0;
+  const int num_instructions = script->num_instructions;
+  if (num_instructions < 0) return false;
+  // For each instruction, track the range of stack depths that it can start
+  // with (or -1 if we haven't found a way to reach it yet), and propagate
+  // those ranges along every path through the script until they stop
+  // changing.  Each range can only ever grow, and is bounded by the stack
+  // size, so this always terminates.
+  int *min_depth = AZ_ALLOC(num_instructions, int);
+  int *max_depth = AZ_ALLOC(num_instructions, int);
+  int *worklist = AZ_ALLOC(num_instructions, int);
+  bool *queued = AZ_ALLOC(num_instructions, bool);
+  for (int i = 0; i < num_instructions; ++i) min_depth[i] = max_depth[i] = -1;
+  int num_queued = 0, max_stack_depth = 0;
+  if (num_instructions > 0) {
+    min_depth[0] = max_depth[0] = 0;
+    worklist[num_queued++] = 0;
+    queued[0] = true;
+  }
+  bool success = true;
+  while (success && num_queued > 0) {
+    const int pc = worklist[--num_queued];
+    queued[pc] = false;
+    const az_instruction_t ins = script->instructions[pc];
+    int pops, pushes;
+    if (!get_stack_effect(ins, &pops, &pushes) || min_depth[pc] < pops ||
+        max_depth[pc] - pops + pushes > AZ_SCRIPT_STACK_SIZE ||
+        (ins.opcode == AZ_OP_PUSH && !isfinite(ins.immediate))) {
+      success = false;
+      break;
+    }
+    const int new_min = min_depth[pc] - pops + pushes;
+    const int new_max = max_depth[pc] - pops + pushes;
+    max_stack_depth = az_imax(max_stack_depth, new_max);
+    // Figure out where control can go from here.
+    int successors[2];
+    int num_successors = 0;
+    if (ins.opcode == AZ_OP_JUMP || ins.opcode == AZ_OP_BEQZ ||
+        ins.opcode == AZ_OP_BNEZ) {
+      if (!(fabs(ins.immediate) <= num_instructions)) {
+        success = false;
+        break;
+      }
+      successors[num_successors++] = pc + (int)ins.immediate;
+    }
+    if (ins.opcode != AZ_OP_JUMP && ins.opcode != AZ_OP_HALT &&
+        ins.opcode != AZ_OP_VICT && ins.opcode != AZ_OP_ERROR) {
+      successors[num_successors++] = pc + 1;
+    }
+    for (int i = 0; i < num_successors; ++i) {
+      const int next = successors[i];
+      if (next < 0 || next > num_instructions) {
+        success = false;
+        break;
+      }
+      if (next == num_instructions) continue; // the script ends here
+      if (min_depth[next] >= 0 && min_depth[next] <= new_min &&
+          max_depth[next] >= new_max) continue;
+      min_depth[next] = (min_depth[next] < 0 ? new_min :
+                         az_imin(min_depth[next], new_min));
+      max_depth[next] = az_imax(max_depth[next], new_max);
+      if (!queued[next]) {
+        worklist[num_queued++] = next;
+        queued[next] = true;
+      }
+    }
+  }
+  az_free(queued);
+  az_free(worklist);
+  az_free(max_depth);
+  az_free(min_depth);
+  if (!success) return false;
+  script->verified = true;
+  script->max_stack_depth = max_stack_depth;
+  return true;
+}
+
 /*===========================================================================*/
 
 az_script_t *az_clone_script(const az_script_t *script) {
@@ -492,13 +704,14 @@ az_script_t *az_clone_script(const az_script_t *script) {
   clone->instructions = AZ_ALLOC(clone->num_instructions, az_instruction_t);
   memcpy(clone->instructions, script->instructions,
          clone->num_instructions * sizeof(az_instruction_t));
+  az_verify_script(clone);
   return clone;
 }
 
 void az_free_script(az_script_t *script) {
   if (script == NULL) return;
-  free(script->instructions);
-  free(script);
+  az_free(script->instructions);
+  az_free(script);
 }
 
 /*===========================================================================*/
@@ -24,6 +24,9 @@
 #include <stdbool.h>
 #include <stdio.h> // for FILE
 
+#include "azimuth/util/arena.h"
+#include "azimuth/util/scan.h"
+
 /*===========================================================================*/
 
 typedef enum {
@@ -177,13 +180,19 @@ typedef struct {
 typedef struct {
   int num_instructions;
   az_instruction_t *instructions;
+  // These are filled in by az_verify_script:
+  bool verified; // true if the script can't misuse the stack or jump wildly
+  int max_stack_depth; // only meaningful if verified is true
 } az_script_t;
 
+// The maximum number of values on a script VM's stack.
+#define AZ_SCRIPT_STACK_SIZE 20
+
 typedef struct {
   const az_script_t *script;
   int pc;
   int stack_size;
-  double stack[20];
+  double stack[AZ_SCRIPT_STACK_SIZE];
 } az_script_vm_t;
 
 typedef struct {
@@ -197,9 +206,23 @@ typedef struct {
 bool az_fprint_script(const az_script_t *script, FILE *file);
 bool az_sprint_script(const az_script_t *script, char *buffer, int length);
 
-// Parse, allocate, and return the script, or return NULL on error.
+// Parse, allocate, and return the script, or return NULL on error.  The
+// scanner and file versions leave the input positioned just after the
+// script's terminating semicolon.
+az_script_t *az_scan_script(az_scanner_t *scanner);
 az_script_t *az_fscan_script(FILE *file);
 az_script_t *az_sscan_script(const char *string, int length);
+// Like az_scan_script, but allocate the script from the given arena.  The
+// script must not be passed to az_free_script.
+az_script_t *az_arena_scan_script(az_scanner_t *scanner, az_arena_t *arena);
+
+// Check whether the script, no matter which branches it takes, can ever
+// underflow or overflow the VM stack, jump out of range, or push a non-finite
+// immediate, and record the result (and the script's maximum stack depth) in
+// the script.  The script VM can skip its per-instruction checks for verified
+// scripts.  The parse and clone functions call this automatically; it need
+// only be called again if a script's instructions are modified in place.
+bool az_verify_script(az_script_t *script);
 
 // Allocate and return a copy of the given script.  Returns NULL if given NULL.
 az_script_t *az_clone_script(const az_script_t *script);
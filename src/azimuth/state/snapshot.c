@@ -0,0 +1,467 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#include "azimuth/state/snapshot.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "azimuth/constants.h"
+#include "azimuth/state/baddie.h"
+#include "azimuth/state/node.h"
+#include "azimuth/state/planet.h"
+#include "azimuth/state/projectile.h"
+#include "azimuth/state/room.h"
+#include "azimuth/state/script.h"
+#include "azimuth/state/space.h"
+#include "azimuth/state/wall.h"
+#include "azimuth/util/misc.h"
+#include "azimuth/util/random.h"
+
+/*===========================================================================*/
+// Pointer tokens:
+
+// Within a snapshot, each pointer field of the state is stored instead as a
+// 32-bit token (with 0 standing for NULL).  Baddie and projectile data
+// pointers are simply cleared, since they're determined by the object kind.
+#define TOKEN_PTR(type, token) ((type *)(uintptr_t)(token))
+#define PTR_TOKEN(ptr) ((uint32_t)(uintptr_t)(ptr))
+
+// A script token identifies the planet or room object that owns the script:
+// bits 0-3 give the owner kind, bits 4-19 give the index of the owner within
+// its room, and bits 20-31 give the room key.  The owner kind is either
+// SCRIPT_TOKEN_PLANET, or SCRIPT_TOKEN_ROOM plus an az_script_owner_t.
+#define SCRIPT_TOKEN_PLANET 1 // the planet's on_start script
+#define SCRIPT_TOKEN_ROOM 2
+
+AZ_STATIC_ASSERT(AZ_MAX_NUM_ROOMS <= 0x1000);
+AZ_STATIC_ASSERT(SCRIPT_TOKEN_ROOM + AZ_NUM_SCRIPT_OWNERS <= 0x10);
+
+static uint32_t script_token(uint32_t owner_kind, int index,
+                             az_room_key_t room_key) {
+  assert(owner_kind > 0 && owner_kind <= 0xf);
+  assert(index >= 0 && index <= 0xffff);
+  assert(room_key >= 0 && room_key < AZ_MAX_NUM_ROOMS);
+  return owner_kind | ((uint32_t)index << 4) | ((uint32_t)room_key << 20);
+}
+
+// A paragraph token identifies one of the planet's strings: bits 0-1 say
+// which kind of string, and the remaining bits give its index.
+#define PARAGRAPH_PLANET 1 // one of the planet's paragraphs
+#define PARAGRAPH_ZONE 2 // a zone's entering message
+
+// The token for a wall data pointer is its index plus one.
+static uint32_t wall_data_token(const az_wall_data_t *data) {
+  return (data == NULL ? 0 : 1 + (uint32_t)az_wall_data_index(data));
+}
+
+static bool decode_wall_data(const az_wall_data_t **data) {
+  const uint32_t token = PTR_TOKEN(*data);
+  if (token < 1 || token > (uint32_t)AZ_NUM_WALL_DATAS) return false;
+  *data = az_get_wall_data(token - 1);
+  return true;
+}
+
+/*===========================================================================*/
+// Scripts and paragraphs:
+
+// Call func on each script pointer field of the state that might be in use,
+// stopping early (and returning false) if func ever returns false.
+static bool convert_scripts(
+    az_space_state_t *state,
+    bool (*func)(void *data, const az_script_t **script), void *data) {
+  if (!func(data, &state->sync_vm.script)) return false;
+  if (!func(data, &state->countdown.vm.script)) return false;
+  AZ_ARRAY_LOOP(timer, state->timers) {
+    if (!func(data, &timer->vm.script)) return false;
+  }
+  AZ_ARRAY_LOOP(baddie, state->baddies) {
+    if (!func(data, &baddie->on_kill)) return false;
+  }
+  AZ_ARRAY_LOOP(door, state->doors) {
+    if (!func(data, &door->on_open)) return false;
+  }
+  AZ_ARRAY_LOOP(gravfield, state->gravfields) {
+    if (!func(data, &gravfield->on_enter)) return false;
+  }
+  AZ_ARRAY_LOOP(node, state->nodes) {
+    if (!func(data, &node->on_use)) return false;
+  }
+  return true;
+}
+
+// Call func on each paragraph pointer field of the state (other than the
+// message, which is handled separately), stopping early (and returning false)
+// if func ever returns false.
+static bool convert_paragraphs(
+    az_space_state_t *state, const az_planet_t *planet,
+    bool (*func)(const az_planet_t *planet, const char **paragraph)) {
+  return (func(planet, &state->monologue.paragraph) &&
+          func(planet, &state->dialogue.paragraph) &&
+          func(planet, &state->cutscene.scene_text) &&
+          func(planet, &state->cutscene.next_text));
+}
+
+// Return the token for a script owned by the given room, or 0 if the room
+// doesn't own the script.
+static uint32_t find_script_in_room(const az_room_t *room, az_room_key_t key,
+                                    const az_script_t *script) {
+  assert(script != NULL);
+  for (int owner = 0; owner < AZ_NUM_SCRIPT_OWNERS; ++owner) {
+    const int num_owners = az_num_room_script_owners(room, owner);
+    for (int i = 0; i < num_owners; ++i) {
+      if (script == az_room_script_at(room, owner, i)) {
+        return script_token(SCRIPT_TOKEN_ROOM + owner, i, key);
+      }
+    }
+  }
+  return 0;
+}
+
+static bool encode_script(void *data, const az_script_t **script) {
+  const az_planet_t *planet = data;
+  if (*script == NULL) return true;
+  uint32_t token = 0;
+  if (*script == planet->on_start) {
+    token = script_token(SCRIPT_TOKEN_PLANET, 0, 0);
+  } else if (planet->room_cache != NULL) {
+    // For a lazily-loaded planet, the script must belong to one of the rooms
+    // currently in the cache (normally the current or previous room).
+    AZ_ARRAY_LOOP(entry, planet->room_cache->entries) {
+      if (entry->key < 0) continue;
+      token = find_script_in_room(&entry->room, entry->key, *script);
+      if (token != 0) break;
+    }
+  } else {
+    for (int key = 0; key < planet->num_rooms && token == 0; ++key) {
+      token = find_script_in_room(&planet->rooms[key], key, *script);
+    }
+  }
+  *script = TOKEN_PTR(const az_script_t, token);
+  return (token != 0);
+}
+
+typedef struct {
+  const az_planet_t *planet;
+  // For a lazily-loaded planet, only the current room and one other room
+  // (normally the previous room) are guaranteed to stay loaded at once, so
+  // the snapshot's scripts may only come from those two.
+  az_room_key_t current_key, other_key; // other_key is -1 if not needed
+  const az_room_t *current_room, *other_room;
+} az_script_decoder_t;
+
+// Validate a script token, and note which room it needs loaded.
+static bool note_script_room(void *data, const az_script_t **script) {
+  az_script_decoder_t *decoder = data;
+  const uint32_t token = PTR_TOKEN(*script);
+  if (token == 0) return true;
+  const uint32_t owner_kind = token & 0xf;
+  if (owner_kind == SCRIPT_TOKEN_PLANET) return true;
+  if (owner_kind < SCRIPT_TOKEN_ROOM ||
+      owner_kind >= SCRIPT_TOKEN_ROOM + AZ_NUM_SCRIPT_OWNERS) return false;
+  const az_room_key_t key = token >> 20;
+  if (key >= decoder->planet->num_rooms) return false;
+  if (decoder->planet->room_cache == NULL ||
+      key == decoder->current_key || key == decoder->other_key) return true;
+  if (decoder->other_key >= 0) return false;
+  decoder->other_key = key;
+  return true;
+}
+
+// Convert a script token (already validated by note_script_room) back into a
+// pointer.
+static bool decode_script(void *data, const az_script_t **script) {
+  const az_script_decoder_t *decoder = data;
+  const uint32_t token = PTR_TOKEN(*script);
+  if (token == 0) return true;
+  const uint32_t owner_kind = token & 0xf;
+  const int index = (token >> 4) & 0xffff;
+  const az_room_key_t key = token >> 20;
+  const az_planet_t *planet = decoder->planet;
+  const az_script_t *result = NULL;
+  if (owner_kind == SCRIPT_TOKEN_PLANET) result = planet->on_start;
+  else {
+    const az_script_owner_t owner = owner_kind - SCRIPT_TOKEN_ROOM;
+    const az_room_t *room =
+      (planet->room_cache == NULL ? &planet->rooms[key] :
+       key == decoder->current_key ? decoder->current_room :
+       decoder->other_room);
+    if (index < az_num_room_script_owners(room, owner)) {
+      result = az_room_script_at(room, owner, index);
+    }
+  }
+  *script = result;
+  return (result != NULL);
+}
+
+static bool encode_paragraph(const az_planet_t *planet,
+                             const char **paragraph) {
+  if (*paragraph == NULL) return true;
+  uint32_t token = 0;
+  for (int i = 0; i < planet->num_paragraphs && token == 0; ++i) {
+    if (*paragraph == planet->paragraphs[i]) {
+      token = PARAGRAPH_PLANET | ((uint32_t)i << 2);
+    }
+  }
+  for (int i = 0; i < planet->num_zones && token == 0; ++i) {
+    if (*paragraph == planet->zones[i].entering_message) {
+      token = PARAGRAPH_ZONE | ((uint32_t)i << 2);
+    }
+  }
+  *paragraph = TOKEN_PTR(const char, token);
+  return (token != 0);
+}
+
+static bool decode_paragraph(const az_planet_t *planet,
+                             const char **paragraph) {
+  const uint32_t token = PTR_TOKEN(*paragraph);
+  if (token == 0) return true;
+  const uint32_t index = token >> 2;
+  *paragraph = NULL;
+  switch (token & 0x3) {
+    case PARAGRAPH_PLANET:
+      if (index >= (uint32_t)planet->num_paragraphs) return false;
+      *paragraph = planet->paragraphs[index];
+      break;
+    case PARAGRAPH_ZONE:
+      if (index >= (uint32_t)planet->num_zones) return false;
+      *paragraph = planet->zones[index].entering_message;
+      break;
+  }
+  return (*paragraph != NULL);
+}
+
+/*===========================================================================*/
+// Taking and restoring snapshots:
+
+bool az_take_space_snapshot(const az_space_state_t *state,
+                            az_space_snapshot_t *snapshot_out) {
+  assert(state != NULL);
+  assert(snapshot_out != NULL);
+  const az_planet_t *planet = state->planet;
+  assert(planet != NULL);
+  AZ_ZERO_OBJECT(snapshot_out);
+  snapshot_out->num_rooms = planet->num_rooms;
+  snapshot_out->num_paragraphs = planet->num_paragraphs;
+  snapshot_out->seed = az_get_global_random_seed();
+  az_space_state_t *copy = &snapshot_out->state;
+  *copy = *state;
+  copy->planet = NULL;
+  copy->prefs = NULL;
+  AZ_ZERO_OBJECT(&copy->soundboard);
+
+  // Absent objects may still hold stale pointers (e.g. to the scripts of a
+  // room we've since left), so clear them out entirely.
+  AZ_ARRAY_LOOP(baddie, copy->baddies) {
+    if (baddie->kind == AZ_BAD_NOTHING) AZ_ZERO_OBJECT(baddie);
+    else baddie->data = NULL;
+  }
+  AZ_ARRAY_LOOP(door, copy->doors) {
+    if (door->kind == AZ_DOOR_NOTHING) AZ_ZERO_OBJECT(door);
+  }
+  AZ_ARRAY_LOOP(gravfield, copy->gravfields) {
+    if (gravfield->kind == AZ_GRAV_NOTHING) AZ_ZERO_OBJECT(gravfield);
+  }
+  AZ_ARRAY_LOOP(node, copy->nodes) {
+    if (node->kind == AZ_NODE_NOTHING) AZ_ZERO_OBJECT(node);
+    else if (node->kind == AZ_NODE_FAKE_WALL_FG ||
+             node->kind == AZ_NODE_FAKE_WALL_BG) {
+      node->subkind.fake_wall = TOKEN_PTR(
+          const az_wall_data_t, wall_data_token(node->subkind.fake_wall));
+    }
+  }
+  AZ_ARRAY_LOOP(proj, copy->projectiles) {
+    if (proj->kind == AZ_PROJ_NOTHING) AZ_ZERO_OBJECT(proj);
+    else proj->data = NULL;
+  }
+  AZ_ARRAY_LOOP(wall, copy->walls) {
+    if (wall->kind == AZ_WALL_NOTHING) AZ_ZERO_OBJECT(wall);
+    else {
+      wall->data = TOKEN_PTR(const az_wall_data_t,
+                             wall_data_token(wall->data));
+    }
+  }
+  AZ_ARRAY_LOOP(timer, copy->timers) {
+    if (timer->vm.script == NULL) AZ_ZERO_OBJECT(timer);
+  }
+  if (!copy->countdown.is_active) AZ_ZERO_OBJECT(&copy->countdown.vm);
+  // The boss death animation uses copies of the dead baddies, whose on_kill
+  // scripts have already run.
+  copy->boss_death_mode.boss.data = NULL;
+  copy->boss_death_mode.boss.on_kill = NULL;
+  AZ_ARRAY_LOOP(leg, copy->boss_death_mode.legs) {
+    leg->data = NULL;
+    leg->on_kill = NULL;
+  }
+
+  // Messages may come from static strings in the code, rather than from the
+  // planet, in which case we just drop them (they're transient anyway).
+  if (!encode_paragraph(planet, &copy->message.paragraph)) {
+    AZ_ZERO_OBJECT(&copy->message);
+  }
+  return (convert_scripts(copy, encode_script, (void*)planet) &&
+          convert_paragraphs(copy, planet, encode_paragraph));
+}
+
+static bool is_valid_baddie_kind(az_baddie_kind_t kind) {
+  return ((int)kind >= 0 && (int)kind <= AZ_NUM_BADDIE_KINDS);
+}
+
+static void restore_baddie_data(az_baddie_t *baddie) {
+  baddie->data = (baddie->kind == AZ_BAD_NOTHING ? NULL :
+                  az_get_baddie_data(baddie->kind));
+}
+
+static bool restore_pointers(const az_space_snapshot_t *snapshot,
+                             const az_planet_t *planet,
+                             az_space_state_t *state) {
+  if (snapshot->num_rooms != planet->num_rooms ||
+      snapshot->num_paragraphs != planet->num_paragraphs) return false;
+  const az_room_key_t current_key = state->ship.player.current_room;
+  if (current_key < 0 || current_key >= planet->num_rooms) return false;
+
+  AZ_ARRAY_LOOP(baddie, state->baddies) {
+    if (!is_valid_baddie_kind(baddie->kind)) return false;
+    restore_baddie_data(baddie);
+  }
+  if (!is_valid_baddie_kind(state->boss_death_mode.boss.kind)) return false;
+  restore_baddie_data(&state->boss_death_mode.boss);
+  AZ_ARRAY_LOOP(leg, state->boss_death_mode.legs) {
+    if (!is_valid_baddie_kind(leg->kind)) return false;
+    restore_baddie_data(leg);
+  }
+  AZ_ARRAY_LOOP(proj, state->projectiles) {
+    if ((int)proj->kind < 0 || (int)proj->kind > AZ_NUM_PROJ_KINDS) {
+      return false;
+    }
+    proj->data = (proj->kind == AZ_PROJ_NOTHING ? NULL :
+                  az_get_proj_data(proj->kind));
+  }
+  AZ_ARRAY_LOOP(wall, state->walls) {
+    if (wall->kind != AZ_WALL_NOTHING && !decode_wall_data(&wall->data)) {
+      return false;
+    }
+  }
+  AZ_ARRAY_LOOP(node, state->nodes) {
+    if ((node->kind == AZ_NODE_FAKE_WALL_FG ||
+         node->kind == AZ_NODE_FAKE_WALL_BG) &&
+        !decode_wall_data(&node->subkind.fake_wall)) return false;
+  }
+
+  az_script_decoder_t decoder = {
+    .planet = planet, .current_key = current_key, .other_key = -1
+  };
+  if (!convert_scripts(state, note_script_room, &decoder)) return false;
+  // Fetch the current room last, so that it ends up as the current room of a
+  // lazily-loaded planet's cache.
+  if (decoder.other_key >= 0) {
+    decoder.other_room = az_get_room_contents(planet, decoder.other_key);
+  }
+  decoder.current_room = az_get_room_contents(planet, current_key);
+  if (!convert_scripts(state, decode_script, &decoder)) return false;
+
+  return (decode_paragraph(planet, &state->message.paragraph) &&
+          convert_paragraphs(state, planet, decode_paragraph));
+}
+
+bool az_restore_space_snapshot(const az_space_snapshot_t *snapshot,
+                               const az_planet_t *planet,
+                               const az_preferences_t *prefs,
+                               az_space_state_t *state_out) {
+  assert(snapshot != NULL);
+  assert(planet != NULL);
+  assert(state_out != NULL);
+  *state_out = snapshot->state;
+  if (!restore_pointers(snapshot, planet, state_out)) {
+    AZ_ZERO_OBJECT(state_out);
+    return false;
+  }
+  state_out->planet = planet;
+  state_out->prefs = prefs;
+  az_set_global_random_seed(snapshot->seed);
+  return true;
+}
+
+/*===========================================================================*/
+// Snapshot files:
+
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+
+// A snapshot file is this header, followed by the snapshot's state struct.
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  // These guard against loading a snapshot written by an incompatible build:
+  uint32_t byte_order;
+  uint16_t pointer_size, reserved;
+  uint32_t state_size;
+  int32_t num_rooms, num_paragraphs;
+  uint32_t seed_z, seed_w;
+} az_snapshot_header_t;
+
+static const char snapshot_magic[4] = {'A', 'Z', 'S', 'S'};
+
+static void init_snapshot_header(az_snapshot_header_t *header) {
+  AZ_ZERO_OBJECT(header);
+  memcpy(header->magic, snapshot_magic, sizeof(header->magic));
+  header->version = SNAPSHOT_VERSION;
+  header->byte_order = SNAPSHOT_BYTE_ORDER;
+  header->pointer_size = sizeof(void*);
+  header->state_size = sizeof(az_space_state_t);
+}
+
+bool az_write_space_snapshot(const az_space_snapshot_t *snapshot,
+                             FILE *file) {
+  assert(snapshot != NULL);
+  assert(file != NULL);
+  az_snapshot_header_t header;
+  init_snapshot_header(&header);
+  header.num_rooms = snapshot->num_rooms;
+  header.num_paragraphs = snapshot->num_paragraphs;
+  header.seed_z = snapshot->seed.z;
+  header.seed_w = snapshot->seed.w;
+  return (fwrite(&header, sizeof(header), 1, file) == 1 &&
+          fwrite(&snapshot->state, sizeof(az_space_state_t), 1, file) == 1);
+}
+
+bool az_read_space_snapshot(FILE *file, az_space_snapshot_t *snapshot_out) {
+  assert(file != NULL);
+  assert(snapshot_out != NULL);
+  AZ_ZERO_OBJECT(snapshot_out);
+  az_snapshot_header_t header;
+  if (fread(&header, sizeof(header), 1, file) != 1) return false;
+  az_snapshot_header_t expected;
+  init_snapshot_header(&expected);
+  expected.num_rooms = header.num_rooms;
+  expected.num_paragraphs = header.num_paragraphs;
+  expected.seed_z = header.seed_z;
+  expected.seed_w = header.seed_w;
+  if (memcmp(&header, &expected, sizeof(header)) != 0) return false;
+  snapshot_out->num_rooms = header.num_rooms;
+  snapshot_out->num_paragraphs = header.num_paragraphs;
+  snapshot_out->seed = (az_random_seed_t){header.seed_z, header.seed_w};
+  return (fread(&snapshot_out->state, sizeof(az_space_state_t), 1,
+                file) == 1);
+}
+
+/*===========================================================================*/
@@ -0,0 +1,80 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#pragma once
+#ifndef AZIMUTH_STATE_SNAPSHOT_H_
+#define AZIMUTH_STATE_SNAPSHOT_H_
+
+#include <stdbool.h>
+#include <stdio.h> // for FILE
+
+#include "azimuth/state/planet.h"
+#include "azimuth/state/space.h"
+#include "azimuth/util/prefs.h"
+#include "azimuth/util/random.h"
+
+/*===========================================================================*/
+
+// A snapshot captures the complete mid-room simulation state -- the ship,
+// all objects (including particles and specks), timers, suspended script VMs,
+// the camera, and so on, along with the global random seed -- so that the
+// simulation can later be resumed from exactly that point (for rewinding
+// while debugging, or to start benchmarks from identical states).  Every
+// pointer in the state is replaced by a token identifying its target (e.g. a
+// script is identified by the room object that owns it), so a snapshot can be
+// restored into a different process, as long as the same planet is loaded.
+//
+// A few things are deliberately not captured: the soundboard (which only
+// holds requests not yet flushed to the audio system), and the bottom-of-
+// screen message if it isn't one of the planet's own paragraphs.
+typedef struct {
+  int num_rooms, num_paragraphs; // of the planet the snapshot was taken with
+  az_random_seed_t seed;
+  az_space_state_t state; // with pointers replaced by tokens
+} az_space_snapshot_t;
+
+// Take a snapshot of the state, and return true on success, or return false
+// if the state refers to a script that doesn't belong to the planet (or to
+// one of its currently loaded rooms).
+bool az_take_space_snapshot(const az_space_state_t *state,
+                            az_space_snapshot_t *snapshot_out);
+
+// Restore the state from the snapshot (which must have been taken with the
+// same planet), pointing it at the given planet and preferences, and setting
+// the global random seed to what it was when the snapshot was taken.  Return
+// true on success, or return false if the snapshot is invalid for this
+// planet (in which case *state_out is left zeroed).  For a lazily-loaded
+// planet, this loads the rooms whose scripts the snapshot refers to.
+bool az_restore_space_snapshot(const az_space_snapshot_t *snapshot,
+                               const az_planet_t *planet,
+                               const az_preferences_t *prefs,
+                               az_space_state_t *state_out);
+
+// Write the snapshot to the file, and return true on success.
+bool az_write_space_snapshot(const az_space_snapshot_t *snapshot,
+                             FILE *file);
+
+// Read a snapshot from the file, and return true on success, or return false
+// if the file is malformed or was written by an incompatible build.  (The
+// snapshot's contents are only fully validated once it's restored.)
+bool az_read_space_snapshot(FILE *file, az_space_snapshot_t *snapshot_out);
+
+/*===========================================================================*/
+
+#endif // AZIMUTH_STATE_SNAPSHOT_H_
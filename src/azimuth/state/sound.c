@@ -1018,6 +1018,44 @@ static az_sound_spec_t sound_specs[] = {
 
 AZ_STATIC_ASSERT(AZ_ARRAY_SIZE(sound_specs) == AZ_NUM_SOUND_KEYS + 1);
 
+// Sounds not listed here have AZ_SNDPRI_NORMAL.  Cues that tell the player
+// something they need to know (warnings, their own ship getting hurt, story
+// events) should never be drowned out by a pile of explosions, whereas
+// incidental sounds that tend to come in swarms can make way for others.
+static const az_sound_priority_t sound_priorities[
+    AZ_ARRAY_SIZE(sound_specs)] = {
+  [AZ_SND_ALARM] = AZ_SNDPRI_CRITICAL,
+  [AZ_SND_AZIMUTH_AWAKEN] = AZ_SNDPRI_CRITICAL,
+  [AZ_SND_BOSS_EXPLODE] = AZ_SNDPRI_CRITICAL,
+  [AZ_SND_EXPLODE_SHIP] = AZ_SNDPRI_CRITICAL,
+  [AZ_SND_KLAXON_COUNTDOWN] = AZ_SNDPRI_CRITICAL,
+  [AZ_SND_KLAXON_COUNTDOWN_LOW] = AZ_SNDPRI_CRITICAL,
+  [AZ_SND_KLAXON_SHIELDS_LOW] = AZ_SNDPRI_CRITICAL,
+  [AZ_SND_KLAXON_SHIELDS_VERY_LOW] = AZ_SNDPRI_CRITICAL,
+  [AZ_SND_PLANET_EXPLODE] = AZ_SNDPRI_CRITICAL,
+  [AZ_SND_CHARGED_GUN] = AZ_SNDPRI_HIGH,
+  [AZ_SND_CHARGED_ORDNANCE] = AZ_SNDPRI_HIGH,
+  [AZ_SND_DOOR_CLOSE] = AZ_SNDPRI_HIGH,
+  [AZ_SND_DOOR_OPEN] = AZ_SNDPRI_HIGH,
+  [AZ_SND_HURT_SHIP] = AZ_SNDPRI_HIGH,
+  [AZ_SND_HURT_SHIP_SLIGHTLY] = AZ_SNDPRI_HIGH,
+  [AZ_SND_MENU_CLICK] = AZ_SNDPRI_HIGH,
+  [AZ_SND_MINOR_UPGRADE] = AZ_SNDPRI_HIGH,
+  [AZ_SND_PICKUP_ORDNANCE] = AZ_SNDPRI_HIGH,
+  [AZ_SND_PICKUP_SHIELDS] = AZ_SNDPRI_HIGH,
+  [AZ_SND_SWITCH_ACTIVATE] = AZ_SNDPRI_HIGH,
+  [AZ_SND_SWITCH_CONFIRM] = AZ_SNDPRI_HIGH,
+  [AZ_SND_USE_COMM_CONSOLE] = AZ_SNDPRI_HIGH,
+  [AZ_SND_USE_REFILL_CONSOLE] = AZ_SNDPRI_HIGH,
+  [AZ_SND_USE_SAVE_CONSOLE] = AZ_SNDPRI_HIGH,
+  [AZ_SND_HIT_ARMOR] = AZ_SNDPRI_LOW,
+  [AZ_SND_HIT_WALL] = AZ_SNDPRI_LOW,
+  [AZ_SND_METAL_CLINK] = AZ_SNDPRI_LOW,
+  [AZ_SND_MENU_HOVER] = AZ_SNDPRI_LOW,
+  [AZ_SND_SPLASH] = AZ_SNDPRI_LOW,
+  [AZ_SND_WINGS_FLAPPING] = AZ_SNDPRI_LOW,
+};
+
 /*===========================================================================*/
 
 static az_sound_data_t sound_datas[AZ_ARRAY_SIZE(sound_specs)];
@@ -1042,6 +1080,13 @@ static const az_sound_data_t *sound_data_for_key(az_sound_key_t sound_key) {
   return sound_data;
 }
 
+static az_sound_priority_t priority_for_key(az_sound_key_t sound_key) {
+  const int sound_index = (int)sound_key;
+  assert(sound_index >= 0);
+  assert(sound_index < AZ_ARRAY_SIZE(sound_priorities));
+  return sound_priorities[sound_index];
+}
+
 void az_init_sound_datas(void) {
   assert(!sound_data_initialized);
   for (int i = 1; i < AZ_ARRAY_SIZE(sound_specs); ++i) {
@@ -1049,31 +1094,45 @@ void az_init_sound_datas(void) {
   }
   sound_data_initialized = true;
   atexit(destroy_sound_datas);
+  az_note_static_footprint("sound tables",
+                           sizeof(sound_specs) + sizeof(sound_datas));
   assert(sound_data_for_key(AZ_SND_NOTHING) == NULL);
 }
 
+const az_sound_spec_t *az_get_sound_spec(az_sound_key_t sound_key) {
+  const int sound_index = (int)sound_key;
+  assert(sound_index >= 0);
+  assert(sound_index < AZ_ARRAY_SIZE(sound_specs));
+  return (sound_index == 0 ? NULL : &sound_specs[sound_index]);
+}
+
 /*===========================================================================*/
 
 void az_play_sound(az_soundboard_t *soundboard, az_sound_key_t sound_key) {
-  az_play_sound_data(soundboard, sound_data_for_key(sound_key), 1);
+  az_play_sound_data(soundboard, sound_data_for_key(sound_key), 1,
+                     priority_for_key(sound_key));
 }
 
 void az_play_sound_with_volume(
     az_soundboard_t *soundboard, az_sound_key_t sound_key, float volume) {
-  az_play_sound_data(soundboard, sound_data_for_key(sound_key), volume);
+  az_play_sound_data(soundboard, sound_data_for_key(sound_key), volume,
+                     priority_for_key(sound_key));
 }
 
 void az_loop_sound(az_soundboard_t *soundboard, az_sound_key_t sound_key) {
-  az_loop_sound_data(soundboard, sound_data_for_key(sound_key), 1);
+  az_loop_sound_data(soundboard, sound_data_for_key(sound_key), 1,
+                     priority_for_key(sound_key));
 }
 
 void az_loop_sound_with_volume(
     az_soundboard_t *soundboard, az_sound_key_t sound_key, float volume) {
-  az_loop_sound_data(soundboard, sound_data_for_key(sound_key), volume);
+  az_loop_sound_data(soundboard, sound_data_for_key(sound_key), volume,
+                     priority_for_key(sound_key));
 }
 
 void az_persist_sound(az_soundboard_t *soundboard, az_sound_key_t sound_key) {
-  az_persist_sound_data(soundboard, sound_data_for_key(sound_key), 1);
+  az_persist_sound_data(soundboard, sound_data_for_key(sound_key), 1,
+                        priority_for_key(sound_key));
 }
 
 void az_hold_sound(az_soundboard_t *soundboard, az_sound_key_t sound_key) {
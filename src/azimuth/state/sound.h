@@ -172,6 +172,10 @@ typedef enum {
 
 void az_init_sound_datas(void);
 
+// Return the spec that the given sound is synthesized from, or NULL for
+// AZ_SND_NOTHING.  This can be called before az_init_sound_datas.
+const az_sound_spec_t *az_get_sound_spec(az_sound_key_t sound_key);
+
 // Indicate that we should play the given sound (once).  The sound will not
 // loop, and cannot be cancelled or paused once started.
 void az_play_sound(az_soundboard_t *soundboard, az_sound_key_t sound);
@@ -23,6 +23,7 @@
 #include <math.h>
 #include <stdbool.h>
 
+#include "azimuth/state/planet.h"
 #include "azimuth/state/room.h"
 #include "azimuth/state/uid.h"
 #include "azimuth/state/upgrade.h"
@@ -58,7 +59,8 @@ static void put_uuid(az_space_state_t *state, int slot,
   }
 }
 
-void az_enter_room(az_space_state_t *state, const az_room_t *room) {
+void az_enter_room(az_space_state_t *state, az_room_key_t room_key) {
+  const az_room_t *room = az_get_room_contents(state->planet, room_key);
   state->darkness = state->dark_goal = 0.0;
   // Make a map from UUID table indices to the baddie (if any) carrying that
   // object as cargo.
@@ -174,6 +176,8 @@ void az_enter_room(az_space_state_t *state, const az_room_t *room) {
       }
     }
   }
+  // Get the rooms we might go to next ready ahead of time.
+  az_prefetch_room_neighbors(state->planet, room_key);
 }
 
 /*===========================================================================*/
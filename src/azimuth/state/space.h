@@ -184,11 +184,13 @@ typedef struct {
 // Remove all objects (baddies, doors, etc.), but leave other fields unchanged.
 void az_clear_space(az_space_state_t *state);
 
-// Add all room objects to the space state, on top of whatever objects are
-// already there.  You may want to call az_clear_space first to ensure that
-// there is room for the new objects.  Note that this function does not make
-// any changes to the ship or any other fields.
-void az_enter_room(az_space_state_t *state, const az_room_t *room);
+// Add all objects in the given room to the space state, on top of whatever
+// objects are already there.  You may want to call az_clear_space first to
+// ensure that there is room for the new objects.  Note that this function does
+// not make any changes to the ship or any other fields.  For a lazily-loaded
+// planet, this loads the room's contents if necessary, and prefetches the
+// rooms that its doors lead to.
+void az_enter_room(az_space_state_t *state, az_room_key_t room_key);
 
 // Set the current message (displayed at the bottom of the screen) to the given
 // paragraph.  This will automatically intialize the various fields of
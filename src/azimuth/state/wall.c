@@ -23,6 +23,7 @@
 #include <math.h>
 #include <stdbool.h>
 
+#include "azimuth/util/grid.h"
 #include "azimuth/util/misc.h"
 #include "azimuth/util/polygon.h"
 #include "azimuth/util/vector.h"
@@ -1639,6 +1640,29 @@ bool az_circle_hits_wall(
                                        pos_out, normal_out));
 }
 
+bool az_circle_hits_walls(
+    const az_wall_t *walls, int num_walls, az_circle_grid_t *grid,
+    double radius, az_vector_t start, az_vector_t delta,
+    az_vector_t *pos_out, az_vector_t *normal_out) {
+  assert(num_walls >= 0);
+  assert(grid == NULL || grid->num_circles == num_walls);
+  const int *candidates = NULL;
+  const int num_candidates = (grid == NULL ? num_walls :
+      az_sweep_circle_grid(grid, radius, start, delta, &candidates));
+  bool hit_anything = false;
+  for (int i = 0; i < num_candidates; ++i) {
+    const az_wall_t *wall = &walls[candidates == NULL ? i : candidates[i]];
+    az_vector_t pos;
+    if (az_circle_hits_wall(wall, radius, start, delta, &pos, normal_out)) {
+      if (pos_out != NULL) *pos_out = pos;
+      // Any later hit must come before this one:
+      delta = az_vsub(pos, start);
+      hit_anything = true;
+    }
+  }
+  return hit_anything;
+}
+
 bool az_arc_circle_hits_wall(
     const az_wall_t *wall, double circle_radius,
     az_vector_t start, az_vector_t spin_center, double spin_angle,
@@ -25,6 +25,7 @@
 
 #include "azimuth/state/uid.h"
 #include "azimuth/util/color.h"
+#include "azimuth/util/grid.h"
 #include "azimuth/util/polygon.h"
 #include "azimuth/util/vector.h"
 
@@ -132,6 +133,15 @@ bool az_circle_hits_wall(
     const az_wall_t *wall, double radius, az_vector_t start, az_vector_t delta,
     az_vector_t *pos_out, az_vector_t *normal_out);
 
+// Like az_circle_hits_wall, but for an array of walls, finding the earliest
+// hit if the circle would hit more than one.  If grid is non-NULL, it must be
+// a grid over the walls' bounding circles (in the same order as the array),
+// and is used to skip testing walls that the circle can't possibly reach.
+bool az_circle_hits_walls(
+    const az_wall_t *walls, int num_walls, az_circle_grid_t *grid,
+    double radius, az_vector_t start, az_vector_t delta,
+    az_vector_t *pos_out, az_vector_t *normal_out);
+
 // Determine if a circle with the given radius, travelling in a circular path
 // from start around spin_center by spin_angle radians, will hit the wall.  If
 // it does, the function stores in *angle_out the angle travelled by the circle
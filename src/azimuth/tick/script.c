@@ -24,10 +24,14 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 
 #include "azimuth/state/dialog.h"
 #include "azimuth/state/object.h"
+#include "azimuth/state/planet.h"
+#include "azimuth/state/room.h"
 #include "azimuth/state/script.h"
 #include "azimuth/state/space.h"
 #include "azimuth/tick/object.h"
@@ -68,9 +72,10 @@ static void print_error(const char *msg, const az_script_vm_t *vm) {
 
 // STACK_PUSH(...) takes 1 or more double args, and pushes those values onto
 // the stack (or errors on overflow), in order (so that the last argument will
-// be the new top of the stack).
+// be the new top of the stack).  The overflow check is skipped for verified
+// scripts, which az_verify_script has proven can never overflow.
 #define STACK_PUSH(...) do { \
-    if (vm->stack_size + AZ_COUNT_ARGS(__VA_ARGS__) <= \
+    if (verified || vm->stack_size + AZ_COUNT_ARGS(__VA_ARGS__) <= \
         AZ_ARRAY_SIZE(vm->stack)) { \
       if (!do_stack_push(vm, AZ_COUNT_ARGS(__VA_ARGS__), __VA_ARGS__)) { \
         SCRIPT_ERROR("non-finite result"); \
@@ -100,8 +105,9 @@ static bool do_stack_push(az_script_vm_t *vm, int num_args, ...) {
 // STACK_POP(...) takes 1 or more double* args; it pops that many values off
 // the stack (or errors on underflow), and assigns them to the pointers.  The
 // top of the stack will be stored to the rightmost pointer passed, and so on.
+// As with STACK_PUSH, the underflow check is skipped for verified scripts.
 #define STACK_POP(...) do { \
-    if (vm->stack_size >= AZ_COUNT_ARGS(__VA_ARGS__)) { \
+    if (verified || vm->stack_size >= AZ_COUNT_ARGS(__VA_ARGS__)) { \
       do_stack_pop(vm, AZ_COUNT_ARGS(__VA_ARGS__), __VA_ARGS__); \
     } else SCRIPT_ERROR("stack underflow"); \
   } while (0)
@@ -122,7 +128,8 @@ static void do_stack_pop(az_script_vm_t *vm, int num_args, ...) {
 
 #define DO_JUMP() do { \
     const int new_pc = vm->pc + (int)ins.immediate; \
-    if (new_pc < 0 || new_pc > vm->script->num_instructions) { \
+    if (!verified && \
+        (new_pc < 0 || new_pc > vm->script->num_instructions)) { \
       SCRIPT_ERROR("jump out of range"); \
     } \
     vm->pc = new_pc - 1; \
@@ -141,7 +148,7 @@ static void do_suspend(az_script_vm_t *vm, az_script_vm_t *target_vm) {
 
 #define SUSPEND(target_vm) do { \
     do_suspend(vm, (target_vm)); \
-    return; \
+    return total_steps; \
   } while (0)
 
 /*===========================================================================*/
@@ -242,31 +249,52 @@ static void disable_skips(az_space_state_t *state) {
 
 /*===========================================================================*/
 
-static void run_vm(az_space_state_t *state, az_script_vm_t *vm) {
+// Runs the VM until the script halts or suspends, and returns the number of
+// steps it took.
+static int execute_vm(az_space_state_t *state, az_script_vm_t *vm) {
   assert(vm != NULL);
   assert(vm->script != NULL);
   assert(vm->script->instructions != NULL);
   assert(state != NULL);
   assert(state->sync_vm.script == NULL);
+  // Verified scripts can't misuse the stack or jump out of range, so for
+  // those we can skip the per-instruction checks (see az_verify_script).
+  const bool verified = vm->script->verified;
+  assert(!verified ||
+         vm->script->max_stack_depth <= AZ_ARRAY_SIZE(vm->stack));
+  const int num_instructions = vm->script->num_instructions;
+  const az_instruction_t *instructions = vm->script->instructions;
   int total_steps = 0;
-  while (vm->pc < vm->script->num_instructions) {
+  while (vm->pc < num_instructions) {
     if (++total_steps > AZ_MAX_SCRIPT_STEPS) SCRIPT_ERROR("ran for too long");
-    const az_instruction_t ins = vm->script->instructions[vm->pc];
+    const az_instruction_t ins = instructions[vm->pc];
     switch (ins.opcode) {
       case AZ_OP_NOP: break;
       // Stack manipulation:
       case AZ_OP_PUSH:
-        STACK_PUSH(ins.immediate);
+        if (verified) {
+          // Verified scripts only push finite immediates, so we can push a
+          // whole run of them (as in e.g. "push,push,push,push,bad") at once.
+          vm->stack[vm->stack_size++] = ins.immediate;
+          while (vm->pc + 1 < num_instructions &&
+                 instructions[vm->pc + 1].opcode == AZ_OP_PUSH) {
+            if (++total_steps > AZ_MAX_SCRIPT_STEPS) {
+              SCRIPT_ERROR("ran for too long");
+            }
+            ++vm->pc;
+            vm->stack[vm->stack_size++] = instructions[vm->pc].immediate;
+          }
+        } else STACK_PUSH(ins.immediate);
         break;
       case AZ_OP_POP: {
         const int num = az_imax(1, (int)ins.immediate);
-        if (vm->stack_size < num) SCRIPT_ERROR("stack underflow");
+        if (!verified && vm->stack_size < num) SCRIPT_ERROR("stack underflow");
         vm->stack_size -= num;
       } break;
       case AZ_OP_DUP: {
         const int num = az_imax(1, (int)ins.immediate);
-        if (vm->stack_size < num) SCRIPT_ERROR("stack underflow");
-        if (vm->stack_size + num > AZ_ARRAY_SIZE(vm->stack)) {
+        if (!verified && vm->stack_size < num) SCRIPT_ERROR("stack underflow");
+        if (!verified && vm->stack_size + num > AZ_ARRAY_SIZE(vm->stack)) {
           SCRIPT_ERROR("stack overflow");
         }
         for (int i = 0; i < num; ++i) {
@@ -280,14 +308,14 @@ static void run_vm(az_space_state_t *state, az_script_vm_t *vm) {
         int cycle = (int)ins.immediate;
         if (cycle == 0) cycle = 2;
         if (cycle < 0) {
-          if (cycle < -size) SCRIPT_ERROR("stack underflow");
+          if (!verified && cycle < -size) SCRIPT_ERROR("stack underflow");
           const double temp = vm->stack[size - 1];
           for (int i = 1; i < -cycle; ++i) {
             vm->stack[size - i] = vm->stack[size - (i + 1)];
           }
           vm->stack[size + cycle] = temp;
         } else {
-          if (cycle > size) SCRIPT_ERROR("stack underflow");
+          if (!verified && cycle > size) SCRIPT_ERROR("stack underflow");
           const double temp = vm->stack[size - cycle];
           for (int i = cycle - 1; i >= 1; --i) {
             vm->stack[size - (i + 1)] = vm->stack[size - i];
@@ -365,8 +393,21 @@ static void run_vm(az_space_state_t *state, az_script_vm_t *vm) {
         if (flag_index < 0 || flag_index >= AZ_MAX_NUM_FLAGS) {
           SCRIPT_ERROR("invalid flag index");
         }
-        STACK_PUSH(az_test_flag(&state->ship.player, (az_flag_t)flag_index) ?
-                   1.0 : 0.0);
+        const bool flag =
+          az_test_flag(&state->ship.player, (az_flag_t)flag_index);
+        // In verified scripts, fuse a TEST followed by a conditional branch
+        // into a single step that doesn't go through the stack at all.
+        if (verified && vm->pc + 1 < num_instructions &&
+            (instructions[vm->pc + 1].opcode == AZ_OP_BEQZ ||
+             instructions[vm->pc + 1].opcode == AZ_OP_BNEZ)) {
+          if (++total_steps > AZ_MAX_SCRIPT_STEPS) {
+            SCRIPT_ERROR("ran for too long");
+          }
+          const az_instruction_t branch = instructions[++vm->pc];
+          if (flag == (branch.opcode == AZ_OP_BNEZ)) {
+            vm->pc += (int)branch.immediate - 1;
+          }
+        } else STACK_PUSH(flag ? 1.0 : 0.0);
       } break;
       case AZ_OP_SET: {
         const int flag_index = (int)ins.immediate;
@@ -1062,7 +1103,7 @@ static void run_vm(az_space_state_t *state, az_script_vm_t *vm) {
     }
     ++vm->pc;
     assert(vm->pc >= 0);
-    assert(vm->pc <= vm->script->num_instructions);
+    assert(vm->pc <= num_instructions);
   }
 
  halt:
@@ -1075,8 +1116,161 @@ static void run_vm(az_space_state_t *state, az_script_vm_t *vm) {
   if (state->monologue.step != AZ_MLS_INACTIVE) {
     state->monologue = (az_monologue_state_t){ .step = AZ_MLS_END };
   }
+  return total_steps;
+}
+
+/*===========================================================================*/
+
+// The maximum number of distinct scripts that the profiler can keep track of
+// between reports; runs of any others are only counted in aggregate.
+#define AZ_MAX_PROFILED_SCRIPTS 256
+
+typedef struct {
+  const az_script_t *script;
+  char owner[48];
+  int num_runs;
+  long total_steps;
+  int max_steps;
+  int num_step_limit_hits;
+  double total_seconds;
+} az_script_profile_t;
+
+static bool profiling_enabled = false;
+static int num_profiled_scripts = 0;
+static int num_untracked_runs = 0;
+static az_script_profile_t profiled_scripts[AZ_MAX_PROFILED_SCRIPTS];
+
+static double wall_seconds(void) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (double)now.tv_sec + 1e-6 * (double)now.tv_usec;
+}
+
+static void describe_room_script(az_room_key_t key, az_script_owner_t owner,
+                                 int index, char *buffer, size_t size) {
+  switch (owner) {
+    case AZ_SCRIPT_OWNER_ROOM:
+      snprintf(buffer, size, "room %03d on_start", key);
+      return;
+    case AZ_SCRIPT_OWNER_BADDIE:
+      snprintf(buffer, size, "room %03d baddie %d on_kill", key, index);
+      return;
+    case AZ_SCRIPT_OWNER_DOOR:
+      snprintf(buffer, size, "room %03d door %d on_open", key, index);
+      return;
+    case AZ_SCRIPT_OWNER_GRAVFIELD:
+      snprintf(buffer, size, "room %03d gravfield %d on_enter", key, index);
+      return;
+    case AZ_SCRIPT_OWNER_NODE:
+      snprintf(buffer, size, "room %03d node %d on_use", key, index);
+      return;
+  }
+  AZ_ASSERT_UNREACHABLE();
 }
 
+// Describe where the script came from (e.g. "room 042 door 3 on_open"), by
+// finding it in the planet or in the current room's object specs.
+static void describe_script_owner(const az_space_state_t *state,
+                                  const az_script_t *script,
+                                  char *buffer, size_t size) {
+  const az_planet_t *planet = state->planet;
+  if (script == planet->on_start) {
+    snprintf(buffer, size, "planet on_start");
+    return;
+  }
+  const az_room_key_t key = state->ship.player.current_room;
+  const az_room_t *room = az_get_room_contents(planet, key);
+  for (int owner = 0; owner < AZ_NUM_SCRIPT_OWNERS; ++owner) {
+    const int num_owners = az_num_room_script_owners(room, owner);
+    for (int i = 0; i < num_owners; ++i) {
+      if (script != az_room_script_at(room, owner, i)) continue;
+      describe_room_script(key, owner, i, buffer, size);
+      return;
+    }
+  }
+  snprintf(buffer, size, "unknown script in room %03d", key);
+}
+
+static void record_script_run(const az_space_state_t *state,
+                              const az_script_t *script, int steps,
+                              double seconds) {
+  az_script_profile_t *profile = NULL;
+  for (int i = 0; i < num_profiled_scripts; ++i) {
+    if (profiled_scripts[i].script == script) {
+      profile = &profiled_scripts[i];
+      break;
+    }
+  }
+  if (profile == NULL) {
+    if (num_profiled_scripts >= AZ_MAX_PROFILED_SCRIPTS) {
+      ++num_untracked_runs;
+      return;
+    }
+    profile = &profiled_scripts[num_profiled_scripts++];
+    AZ_ZERO_OBJECT(profile);
+    profile->script = script;
+    describe_script_owner(state, script, profile->owner,
+                          sizeof(profile->owner));
+  }
+  ++profile->num_runs;
+  profile->total_steps += steps;
+  profile->max_steps = az_imax(profile->max_steps, steps);
+  if (steps > AZ_MAX_SCRIPT_STEPS) ++profile->num_step_limit_hits;
+  profile->total_seconds += seconds;
+}
+
+static int compare_profiles(const void *v1, const void *v2) {
+  const az_script_profile_t *profile1 = v1;
+  const az_script_profile_t *profile2 = v2;
+  if (profile1->total_seconds != profile2->total_seconds) {
+    return (profile1->total_seconds > profile2->total_seconds ? -1 : 1);
+  }
+  if (profile1->total_steps != profile2->total_steps) {
+    return (profile1->total_steps > profile2->total_steps ? -1 : 1);
+  }
+  return 0;
+}
+
+void az_enable_script_profiling(void) {
+  if (profiling_enabled) return;
+  profiling_enabled = true;
+  atexit(az_report_script_profile);
+}
+
+void az_report_script_profile(void) {
+  if (num_profiled_scripts == 0 && num_untracked_runs == 0) return;
+  qsort(profiled_scripts, num_profiled_scripts, sizeof(az_script_profile_t),
+        compare_profiles);
+  fprintf(stderr, "Script profile (most expensive first):\n"
+          "       usec    runs    steps   max  limit  owner\n");
+  for (int i = 0; i < num_profiled_scripts; ++i) {
+    const az_script_profile_t *profile = &profiled_scripts[i];
+    fprintf(stderr, "  %9.0f %7d %8ld %5d %6d  %s\n",
+            1e6 * profile->total_seconds, profile->num_runs,
+            profile->total_steps, profile->max_steps,
+            profile->num_step_limit_hits, profile->owner);
+  }
+  if (num_untracked_runs > 0) {
+    fprintf(stderr, "  (plus %d runs of untracked scripts)\n",
+            num_untracked_runs);
+  }
+  num_profiled_scripts = 0;
+  num_untracked_runs = 0;
+}
+
+static void run_vm(az_space_state_t *state, az_script_vm_t *vm) {
+  if (!profiling_enabled) {
+    execute_vm(state, vm);
+    return;
+  }
+  const az_script_t *script = vm->script;
+  const double start = wall_seconds();
+  const int steps = execute_vm(state, vm);
+  record_script_run(state, script, steps, wall_seconds() - start);
+}
+
+/*===========================================================================*/
+
 void az_run_script(az_space_state_t *state, const az_script_t *script) {
   if (script == NULL || script->num_instructions == 0) return;
   az_script_vm_t vm = { .script = script };
@@ -38,4 +38,18 @@ void az_tick_timers(az_space_state_t *state, double time);
 
 /*===========================================================================*/
 
+// Start recording, for each script run, how many times it runs, how many
+// instructions it executes, and how much wall time it takes (including any
+// scripts that it triggers), so that expensive scripts can be found.  A final
+// report is printed when the program exits.
+void az_enable_script_profiling(void);
+
+// If profiling is enabled and any scripts have run since the last report,
+// print a report of them to stderr, sorted by cost, and start over.  The space
+// controller calls this whenever the ship leaves a room or the space event
+// loop exits.
+void az_report_script_profile(void);
+
+/*===========================================================================*/
+
 #endif // AZIMUTH_TICK_SCRIPT_H_
@@ -64,7 +64,7 @@ void az_after_entering_room(az_space_state_t *state) {
     }
   }
   const az_room_t *room =
-    &state->planet->rooms[state->ship.player.current_room];
+    az_get_room_contents(state->planet, state->ship.player.current_room);
   state->camera.quake_vert = 0.0;
   state->camera.r_max_override = 0.0;
   state->console_help_message_cooldown = 0.0;
@@ -320,11 +320,12 @@ static void tick_doorway_mode(az_space_state_t *state, double time) {
         const az_zone_key_t old_zone_key =
           state->planet->rooms[origin_key].zone_key;
         const az_room_key_t dest_key = mode_data->destination;
+        az_report_script_profile();
         az_clear_space(state);
         assert(0 <= dest_key && dest_key < state->planet->num_rooms);
         const az_room_t *new_room = &state->planet->rooms[dest_key];
         const az_zone_key_t new_zone_key = new_room->zone_key;
-        az_enter_room(state, new_room);
+        az_enter_room(state, dest_key);
         state->ship.player.current_room = dest_key;
         // Pick a door to exit out of.
         double best_dist = INFINITY;
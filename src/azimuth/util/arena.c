@@ -0,0 +1,132 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#include "azimuth/util/arena.h"
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "azimuth/util/misc.h"
+
+/*===========================================================================*/
+
+// Every allocation is aligned to (and padded out to a multiple of) this many
+// bytes, which is enough for any of the types we store in arenas.
+#define ARENA_ALIGNMENT ((size_t)16)
+// The size of a normal arena block.  Allocations too big to share a block
+// comfortably get a block of their own.
+#define ARENA_BLOCK_SIZE ((size_t)65536)
+
+// Each block starts with a header linking it to the block before it.
+typedef struct {
+  void *previous;
+} az_arena_header_t;
+
+#define ROUND_UP(size) \
+  (((size) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+#define HEADER_SIZE ROUND_UP(sizeof(az_arena_header_t))
+
+static char *new_block(const char *funcname, size_t capacity,
+                       void *previous) {
+  char *block = az_alloc_(funcname, capacity, 1);
+  ((az_arena_header_t *)block)->previous = previous;
+  return block;
+}
+
+static void free_blocks(void *block) {
+  while (block != NULL) {
+    void *previous = ((az_arena_header_t *)block)->previous;
+    az_free(block);
+    block = previous;
+  }
+}
+
+void *az_arena_alloc_(const char *funcname, az_arena_t *arena, size_t n,
+                      size_t size) {
+  assert(arena != NULL);
+  if (n == 0) return NULL;
+  if (size > (SIZE_MAX - HEADER_SIZE - ARENA_ALIGNMENT) / n) {
+    az_fatal_(funcname, "Out of memory.\n");
+  }
+  const size_t bytes = ROUND_UP(n * size);
+  if (arena->block == NULL || arena->capacity - arena->used < bytes) {
+    // A big allocation gets a block of its own, which we slip in behind the
+    // current block so that the current block's free space isn't wasted.
+    if (arena->block != NULL && HEADER_SIZE + bytes > ARENA_BLOCK_SIZE / 4) {
+      az_arena_header_t *header = (az_arena_header_t *)arena->block;
+      char *block = new_block(funcname, HEADER_SIZE + bytes, header->previous);
+      header->previous = block;
+      ++arena->num_blocks;
+      return block + HEADER_SIZE;
+    }
+    const size_t capacity = (HEADER_SIZE + bytes > ARENA_BLOCK_SIZE ?
+                             HEADER_SIZE + bytes : ARENA_BLOCK_SIZE);
+    arena->block = new_block(funcname, capacity, arena->block);
+    arena->used = HEADER_SIZE;
+    arena->capacity = capacity;
+    ++arena->num_blocks;
+  }
+  void *ptr = arena->block + arena->used;
+  arena->used += bytes;
+  return ptr;
+}
+
+char *az_arena_strdup(az_arena_t *arena, const char *str) {
+  if (str == NULL) return NULL;
+  const size_t size = strlen(str) + 1; // add 1 for trailing '\0'
+  char *copy = AZ_ARENA_ALLOC(arena, size, char);
+  memcpy(copy, str, size);
+  return copy;
+}
+
+char *az_arena_strprintf(az_arena_t *arena, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  const size_t size = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+  char *out = AZ_ARENA_ALLOC(arena, size + 1, char); // add 1 for '\0'
+  va_start(args, format);
+  vsprintf(out, format, args);
+  va_end(args);
+  return out;
+}
+
+void az_clear_arena(az_arena_t *arena) {
+  assert(arena != NULL);
+  if (arena->block == NULL) return;
+  az_arena_header_t *header = (az_arena_header_t *)arena->block;
+  free_blocks(header->previous);
+  header->previous = NULL;
+  // Allocations must come back zeroed, so re-zero the part we've handed out.
+  memset(arena->block + HEADER_SIZE, 0, arena->used - HEADER_SIZE);
+  arena->used = HEADER_SIZE;
+  arena->num_blocks = 1;
+}
+
+void az_destroy_arena(az_arena_t *arena) {
+  assert(arena != NULL);
+  free_blocks(arena->block);
+  AZ_ZERO_OBJECT(arena);
+}
+
+/*===========================================================================*/
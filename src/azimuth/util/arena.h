@@ -0,0 +1,61 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#pragma once
+#ifndef AZIMUTH_UTIL_ARENA_H_
+#define AZIMUTH_UTIL_ARENA_H_
+
+#include <stddef.h> // for size_t
+
+/*===========================================================================*/
+
+// An arena hands out memory from a few large blocks, and frees all of it at
+// once, so that data made up of many small objects that all live and die
+// together can be allocated cheaply and torn down in one go.  Individual
+// allocations can't be freed.  A zeroed az_arena_t is a valid empty arena.
+typedef struct {
+  char *block; // the block currently being allocated from, or NULL
+  size_t used, capacity; // bytes of the current block used/available
+  int num_blocks; // total number of blocks owned by the arena
+} az_arena_t;
+
+// Allocate a zeroed type[n] array from the arena.  Like AZ_ALLOC, this
+// signals a fatal error if memory allocation fails, and returns NULL for n=0.
+// The memory remains valid until the arena is cleared or destroyed.
+#define AZ_ARENA_ALLOC(arena, n, type) \
+  ((type *)az_arena_alloc_(__func__, (arena), (n), sizeof(type)))
+void *az_arena_alloc_(const char *funcname, az_arena_t *arena, size_t n,
+                      size_t size);
+
+// Like az_strdup and az_strprintf, but allocate the string from the arena.
+char *az_arena_strdup(az_arena_t *arena, const char *str);
+char *az_arena_strprintf(az_arena_t *arena, const char *format, ...)
+  __attribute__((__format__(__printf__,2,3)));
+
+// Release everything allocated from the arena, but keep its most recent block
+// around to be reused by future allocations.
+void az_clear_arena(az_arena_t *arena);
+
+// Release everything allocated from the arena, along with all of its blocks,
+// leaving it empty.
+void az_destroy_arena(az_arena_t *arena);
+
+/*===========================================================================*/
+
+#endif // AZIMUTH_UTIL_ARENA_H_
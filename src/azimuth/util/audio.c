@@ -45,28 +45,59 @@ void az_change_music_flag(az_soundboard_t *soundboard, int flag) {
   }
 }
 
+// Combine the volumes of two copies of the same sound started in the same
+// frame.  Since the copies would be perfectly correlated, playing both would
+// just double the amplitude (and likely clip); instead we add their power,
+// which makes a pile of simultaneous sounds louder than one, but not by much.
+static float merge_volumes(float volume1, float volume2) {
+  return fminf(1.0f, sqrtf(volume1 * volume1 + volume2 * volume2));
+}
+
 void az_play_sound_data(az_soundboard_t *soundboard,
-                        const az_sound_data_t *sound_data, float volume) {
+                        const az_sound_data_t *sound_data, float volume,
+                        az_sound_priority_t priority) {
   assert(volume >= 0.0f && volume <= 1.0f);
   if (sound_data == NULL) return;
-  if (soundboard->num_oneshots < AZ_ARRAY_SIZE(soundboard->oneshots)) {
-    // Don't start the same sound more than once in the same frame.
-    for (int i = 0; i < soundboard->num_oneshots; ++i) {
-      if (soundboard->oneshots[i].sound_data == sound_data) {
-        soundboard->oneshots[i].volume =
-          fmaxf(volume, soundboard->oneshots[i].volume);
-        return;
+  // Don't start the same sound more than once in the same frame.
+  for (int i = 0; i < soundboard->num_oneshots; ++i) {
+    if (soundboard->oneshots[i].sound_data == sound_data) {
+      soundboard->oneshots[i].volume =
+        merge_volumes(volume, soundboard->oneshots[i].volume);
+      if (priority > soundboard->oneshots[i].priority) {
+        soundboard->oneshots[i].priority = priority;
       }
+      return;
     }
-    soundboard->oneshots[soundboard->num_oneshots].sound_data = sound_data;
-    soundboard->oneshots[soundboard->num_oneshots].volume = volume;
+  }
+  int index = soundboard->num_oneshots;
+  if (index < AZ_ARRAY_SIZE(soundboard->oneshots)) {
     ++soundboard->num_oneshots;
+  } else {
+    // If there's no room, displace the least important (and then quietest)
+    // oneshot, but only if the new sound is more important than it.
+    index = 0;
+    for (int i = 1; i < soundboard->num_oneshots; ++i) {
+      if (soundboard->oneshots[i].priority <
+          soundboard->oneshots[index].priority ||
+          (soundboard->oneshots[i].priority ==
+           soundboard->oneshots[index].priority &&
+           soundboard->oneshots[i].volume <
+           soundboard->oneshots[index].volume)) index = i;
+    }
+    ++soundboard->num_dropped;
+    if (priority < soundboard->oneshots[index].priority ||
+        (priority == soundboard->oneshots[index].priority &&
+         volume <= soundboard->oneshots[index].volume)) return;
   }
+  soundboard->oneshots[index].sound_data = sound_data;
+  soundboard->oneshots[index].volume = volume;
+  soundboard->oneshots[index].priority = priority;
 }
 
 static void persist_sound_internal(
     az_soundboard_t *soundboard, const az_sound_data_t *sound_data,
-    float volume, bool play, bool loop, bool reset) {
+    float volume, az_sound_priority_t priority, bool play, bool loop,
+    bool reset) {
   assert(volume >= 0.0f && volume <= 1.0f);
   if (sound_data == NULL) return;
   int index;
@@ -75,39 +106,50 @@ static void persist_sound_internal(
   }
   if (soundboard->num_persists == AZ_ARRAY_SIZE(soundboard->persists)) {
     AZ_WARNING_ONCE("No room to persist sound\n");
+    ++soundboard->num_dropped;
     return;
   }
   assert(index == soundboard->num_persists);
   assert(soundboard->num_persists < AZ_ARRAY_SIZE(soundboard->persists));
   ++soundboard->num_persists;
   soundboard->persists[index].sound_data = sound_data;
+  soundboard->persists[index].priority = priority;
  merge:
   assert(soundboard->persists[index].sound_data == sound_data);
   soundboard->persists[index].volume =
     fmaxf(volume, soundboard->persists[index].volume);
+  if (priority > soundboard->persists[index].priority) {
+    soundboard->persists[index].priority = priority;
+  }
   soundboard->persists[index].play |= play;
   soundboard->persists[index].loop |= loop;
   soundboard->persists[index].reset |= reset;
 }
 
 void az_loop_sound_data(az_soundboard_t *soundboard,
-                        const az_sound_data_t *sound_data, float volume) {
-  persist_sound_internal(soundboard, sound_data, volume, true, true, false);
+                        const az_sound_data_t *sound_data, float volume,
+                        az_sound_priority_t priority) {
+  persist_sound_internal(soundboard, sound_data, volume, priority,
+                         true, true, false);
 }
 
 void az_persist_sound_data(az_soundboard_t *soundboard,
-                           const az_sound_data_t *sound_data, float volume) {
-  persist_sound_internal(soundboard, sound_data, volume, true, false, false);
+                           const az_sound_data_t *sound_data, float volume,
+                           az_sound_priority_t priority) {
+  persist_sound_internal(soundboard, sound_data, volume, priority,
+                         true, false, false);
 }
 
 void az_hold_sound_data(az_soundboard_t *soundboard,
                         const az_sound_data_t *sound_data) {
-  persist_sound_internal(soundboard, sound_data, 0, false, false, false);
+  persist_sound_internal(soundboard, sound_data, 0, AZ_SNDPRI_LOW,
+                         false, false, false);
 }
 
 void az_reset_sound_data(az_soundboard_t *soundboard,
                          const az_sound_data_t *sound_data) {
-  persist_sound_internal(soundboard, sound_data, 0, false, false, true);
+  persist_sound_internal(soundboard, sound_data, 0, AZ_SNDPRI_LOW,
+                         false, false, true);
 }
 
 /*===========================================================================*/
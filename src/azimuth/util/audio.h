@@ -28,6 +28,16 @@
 
 /*===========================================================================*/
 
+// When there are more sounds requested than we have room to play, sounds with
+// higher priority take precedence over (and can cut off) sounds with lower
+// priority.
+typedef enum {
+  AZ_SNDPRI_LOW = -1,
+  AZ_SNDPRI_NORMAL = 0,
+  AZ_SNDPRI_HIGH,
+  AZ_SNDPRI_CRITICAL
+} az_sound_priority_t;
+
 // A soundboard keeps track of what sounds/music we want to play next.  It will
 // be periodically read and flushed by our audio system.  To initialize it,
 // simply zero it with a memset.  One should not manipulate the fields of this
@@ -41,15 +51,20 @@ typedef struct {
   struct {
     const az_sound_data_t *sound_data;
     float volume; // 0 to 1
+    az_sound_priority_t priority;
   } oneshots[10];
   int num_persists;
   struct {
     const az_sound_data_t *sound_data;
     float volume; // 0 to 1
+    az_sound_priority_t priority;
     bool play;
     bool loop;
     bool reset;
   } persists[10];
+  // How many sound requests this frame were discarded (or displaced by
+  // higher-priority requests) for lack of room on the soundboard.
+  int num_dropped;
 } az_soundboard_t;
 
 /*===========================================================================*/
@@ -62,16 +77,20 @@ void az_change_music_data(az_soundboard_t *soundboard, const az_music_t *music,
 void az_change_music_flag(az_soundboard_t *soundboard, int flag);
 
 // Indicate that we should play the given sound (once).  The sound will not
-// loop, and cannot be cancelled or paused once started.
+// loop, and cannot be cancelled or paused once started.  If the same sound is
+// requested more than once in the same frame, the requests are merged into a
+// single, louder sound.
 void az_play_sound_data(az_soundboard_t *soundboard,
-                        const az_sound_data_t *sound_data, float volume);
+                        const az_sound_data_t *sound_data, float volume,
+                        az_sound_priority_t priority);
 
 // Indicate that we should start playing, or continue to play, the given sound.
 // To keep the sound going, we must call this function every frame with the
 // same sound, otherwise the sound will stop.  As long as we keep calling this
 // function, the sound will continue to loop.
 void az_loop_sound_data(az_soundboard_t *soundboard,
-                        const az_sound_data_t *sound_data, float volume);
+                        const az_sound_data_t *sound_data, float volume,
+                        az_sound_priority_t priority);
 
 // Indicate that we should start playing, or continue to play, the given sound.
 // To keep the sound going, we must call this function every frame with the
@@ -79,7 +98,8 @@ void az_loop_sound_data(az_soundboard_t *soundboard,
 // and won't restart until we either stop calling this function for at least
 // one frame before calling it again, or we call az_reset_sound.
 void az_persist_sound_data(az_soundboard_t *soundboard,
-                           const az_sound_data_t *sound_data, float volume);
+                           const az_sound_data_t *sound_data, float volume,
+                           az_sound_priority_t priority);
 
 // Indicate that, if the given persisted or looped sound is currently playing,
 // we should pause it for this frame.  To keep the sound from resetting, we
@@ -0,0 +1,149 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+
+#include "azimuth/util/file.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "azimuth/util/misc.h"
+#include "azimuth/util/string.h"
+
+/*===========================================================================*/
+
+bool az_file_is_up_to_date(const char *path, const char *source_path) {
+  struct stat path_stat, source_stat;
+  if (stat(path, &path_stat) != 0) return false;
+  if (stat(source_path, &source_stat) != 0) return true;
+  return path_stat.st_mtime >= source_stat.st_mtime;
+}
+
+bool az_map_file(const char *path, void **data_out, size_t *size_out) {
+  assert(data_out != NULL);
+  assert(size_out != NULL);
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+    close(fd);
+    return false;
+  }
+  const size_t size = (size_t)file_stat.st_size;
+  void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  // The mapping stays valid after the file descriptor is closed.
+  close(fd);
+  if (data == MAP_FAILED) return false;
+  *data_out = data;
+  *size_out = size;
+  return true;
+}
+
+void az_unmap_file(void *data, size_t size) {
+  if (data == NULL) return;
+  munmap(data, size);
+}
+
+char *az_read_file(const char *path, size_t *size_out) {
+  assert(size_out != NULL);
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size < 0) {
+    close(fd);
+    return NULL;
+  }
+  const size_t size = (size_t)file_stat.st_size;
+  char *data = AZ_ALLOC(size + 1, char);
+  size_t num_read = 0;
+  while (num_read < size) {
+    const ssize_t result = read(fd, data + num_read, size - num_read);
+    if (result <= 0) break;
+    num_read += (size_t)result;
+  }
+  close(fd);
+  if (num_read != size) {
+    az_free(data);
+    return NULL;
+  }
+  data[size] = '\0';
+  *size_out = size;
+  return data;
+}
+
+// Flush the file's contents to disk.  (Any descriptor for the file will do
+// for fsync, which saves us from needing fileno, which C99 doesn't have.)
+static bool sync_file(const char *path) {
+  const int fd = open(path, O_WRONLY);
+  if (fd < 0) return false;
+  const bool ok = (fsync(fd) == 0);
+  close(fd);
+  return ok;
+}
+
+// Flush the directory containing the file to disk, so that a rename into it
+// survives a crash.  Some filesystems don't support syncing directories (and
+// fail with EINVAL); there's nothing more we can do on those, so that counts
+// as success.
+static bool sync_parent_directory(const char *path) {
+  const char *slash = strrchr(path, '/');
+  char *dir_path = (slash == NULL ? az_strdup(".") :
+                    az_strprintf("%.*s", (int)(slash - path + 1), path));
+  const int fd = open(dir_path, O_RDONLY);
+  az_free(dir_path);
+  if (fd < 0) return false;
+  const bool ok = (fsync(fd) == 0 || errno == EINVAL);
+  close(fd);
+  return ok;
+}
+
+bool az_write_file_atomically(const char *path,
+                              bool (*write_func)(void *data, FILE *file),
+                              void *data) {
+  assert(path != NULL);
+  assert(write_func != NULL);
+  char *temp_path = az_strprintf("%s.tmp", path);
+  FILE *file = fopen(temp_path, "w");
+  bool ok = false;
+  if (file != NULL) {
+    ok = write_func(data, file);
+    if (fclose(file) != 0) ok = false;
+    // The new contents must be on disk before the rename makes them visible
+    // under the real name, or else a crash could leave a truncated file there.
+    if (ok) ok = sync_file(temp_path);
+    if (ok) ok = (rename(temp_path, path) == 0);
+    if (!ok) remove(temp_path);
+    // Likewise, the rename itself isn't durable until the directory entry
+    // has been written out.
+    else ok = sync_parent_directory(path);
+  }
+  az_free(temp_path);
+  return ok;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,67 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+
+#pragma once
+#ifndef AZIMUTH_UTIL_FILE_H_
+#define AZIMUTH_UTIL_FILE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h> // for FILE
+
+/*===========================================================================*/
+
+// Returns true if the file at the first path exists, and was last modified no
+// earlier than the file at the second path (or if the second file doesn't
+// exist).  This is used to decide whether a compiled cache of a data file is
+// still fresh.
+bool az_file_is_up_to_date(const char *path, const char *source_path);
+
+// Map the entire (non-empty) file at the given path into memory and return
+// true, or return false on failure.  The mapping is copy-on-write: it may be
+// modified in place, but changes are private to this process and are never
+// written back to the file.  The mapping must later be released with
+// az_unmap_file.
+bool az_map_file(const char *path, void **data_out, size_t *size_out);
+
+void az_unmap_file(void *data, size_t size);
+
+// Read the entire file at the given path into a newly-allocated buffer, which
+// the caller must free, or return NULL on failure.  The buffer is always
+// NUL-terminated (the terminator is not counted in *size_out), so that text
+// files can be parsed in place with an az_scanner_t (see util/scan.h).
+char *az_read_file(const char *path, size_t *size_out);
+
+// Replace the file at the given path with whatever write_func(data, file)
+// writes, and return true, or return false (leaving the old file untouched)
+// if anything fails, including write_func itself returning false.  The new
+// contents are written to a temporary file beside the given path, flushed all
+// the way to disk, and then renamed over the old file, so that a crash at any
+// point leaves either the complete old file or the complete new one.  The
+// directory is then synced too, so that the replacement survives a power loss;
+// if only that last step fails, this returns false even though the new file
+// is already in place.
+bool az_write_file_atomically(const char *path,
+                              bool (*write_func)(void *data, FILE *file),
+                              void *data);
+
+/*===========================================================================*/
+
+#endif // AZIMUTH_UTIL_FILE_H_
@@ -0,0 +1,264 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#include "azimuth/util/grid.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "azimuth/util/misc.h"
+#include "azimuth/util/vector.h"
+
+/*===========================================================================*/
+
+// Keep the number of cells within a small multiple of the number of circles,
+// so that a few far-flung circles can't make the grid huge.
+#define MAX_CELLS_PER_CIRCLE 4
+#define MIN_MAX_CELLS 64
+
+static int clamp_cell(double coord, double cell_size, int num_cells) {
+  const double cell = floor(coord / cell_size);
+  return (cell < 0.0 ? 0 : cell >= num_cells ? num_cells - 1 : (int)cell);
+}
+
+// Find the range of cells (inclusive) that the given box overlaps, treating
+// the outermost cells as extending out forever.
+static void get_cell_range(const az_circle_grid_t *grid,
+                           az_vector_t min_corner, az_vector_t max_corner,
+                           int *min_col, int *max_col,
+                           int *min_row, int *max_row) {
+  const az_vector_t min_rel = az_vsub(min_corner, grid->origin);
+  const az_vector_t max_rel = az_vsub(max_corner, grid->origin);
+  *min_col = clamp_cell(min_rel.x, grid->cell_size, grid->num_cols);
+  *max_col = clamp_cell(max_rel.x, grid->cell_size, grid->num_cols);
+  *min_row = clamp_cell(min_rel.y, grid->cell_size, grid->num_rows);
+  *max_row = clamp_cell(max_rel.y, grid->cell_size, grid->num_rows);
+}
+
+static void get_circle_cell_range(const az_circle_grid_t *grid,
+                                  const az_grid_circle_t *circle,
+                                  int *min_col, int *max_col,
+                                  int *min_row, int *max_row) {
+  const az_vector_t extent = {circle->radius, circle->radius};
+  get_cell_range(grid, az_vsub(circle->center, extent),
+                 az_vadd(circle->center, extent),
+                 min_col, max_col, min_row, max_row);
+}
+
+void az_build_circle_grid(az_circle_grid_t *grid, int num_circles,
+                          const az_grid_circle_t *circles,
+                          double min_cell_size) {
+  assert(num_circles >= 0);
+  assert(min_cell_size > 0.0);
+  az_destroy_circle_grid(grid);
+  if (num_circles == 0) return;
+  grid->num_circles = num_circles;
+  grid->circles = AZ_ALLOC(num_circles, az_grid_circle_t);
+  memcpy(grid->circles, circles, num_circles * sizeof(az_grid_circle_t));
+
+  // Size the grid to cover the bounding box of all the circles:
+  az_vector_t min_corner = {INFINITY, INFINITY};
+  az_vector_t max_corner = {-INFINITY, -INFINITY};
+  for (int i = 0; i < num_circles; ++i) {
+    const az_grid_circle_t *circle = &circles[i];
+    assert(circle->radius >= 0.0);
+    min_corner.x = fmin(min_corner.x, circle->center.x - circle->radius);
+    min_corner.y = fmin(min_corner.y, circle->center.y - circle->radius);
+    max_corner.x = fmax(max_corner.x, circle->center.x + circle->radius);
+    max_corner.y = fmax(max_corner.y, circle->center.y + circle->radius);
+  }
+  const double width = max_corner.x - min_corner.x;
+  const double height = max_corner.y - min_corner.y;
+  const double max_cells =
+    (double)az_imax(MIN_MAX_CELLS, MAX_CELLS_PER_CIRCLE * num_circles);
+  double cell_size = fmax(min_cell_size, sqrt(width * height / max_cells));
+  // A long, thin bounding box can still need too many cells at this size, so
+  // keep growing the cells until they fit the budget.
+  while ((floor(width / cell_size) + 1.0) *
+         (floor(height / cell_size) + 1.0) > max_cells) {
+    cell_size *= 1.5;
+  }
+  grid->cell_size = cell_size;
+  grid->origin = min_corner;
+  grid->num_cols = 1 + (int)floor(width / cell_size);
+  grid->num_rows = 1 + (int)floor(height / cell_size);
+  const int num_cells = grid->num_cols * grid->num_rows;
+
+  // Count how many circles overlap each cell, and turn those counts into the
+  // end offset of each cell's run of entries:
+  grid->cell_starts = AZ_ALLOC(num_cells + 1, int);
+  for (int i = 0; i < num_circles; ++i) {
+    int min_col, max_col, min_row, max_row;
+    get_circle_cell_range(grid, &circles[i], &min_col, &max_col,
+                          &min_row, &max_row);
+    for (int row = min_row; row <= max_row; ++row) {
+      for (int col = min_col; col <= max_col; ++col) {
+        ++grid->cell_starts[row * grid->num_cols + col];
+      }
+    }
+  }
+  for (int cell = 1; cell <= num_cells; ++cell) {
+    grid->cell_starts[cell] += grid->cell_starts[cell - 1];
+  }
+  // Fill in the entries back to front, which leaves each cell_starts entry
+  // pointing at the start of its run, and each run in increasing order:
+  grid->cell_entries = AZ_ALLOC(grid->cell_starts[num_cells], int);
+  for (int i = num_circles - 1; i >= 0; --i) {
+    int min_col, max_col, min_row, max_row;
+    get_circle_cell_range(grid, &circles[i], &min_col, &max_col,
+                          &min_row, &max_row);
+    for (int row = min_row; row <= max_row; ++row) {
+      for (int col = min_col; col <= max_col; ++col) {
+        grid->cell_entries[--grid->cell_starts[row * grid->num_cols +
+                                               col]] = i;
+      }
+    }
+  }
+  // A query visits each entry at most once, so this is enough room for its
+  // results, even before removing duplicates:
+  grid->results = AZ_ALLOC(grid->cell_starts[num_cells], int);
+}
+
+static int compare_ints(const void *v1, const void *v2) {
+  const int i1 = *(const int *)v1;
+  const int i2 = *(const int *)v2;
+  return (i1 < i2 ? -1 : i1 > i2 ? 1 : 0);
+}
+
+// Sort the results, and remove any duplicates.  Returns the new count.
+static int sort_results(az_circle_grid_t *grid, int num_results) {
+  qsort(grid->results, num_results, sizeof(int), compare_ints);
+  int num_unique = 0;
+  for (int i = 0; i < num_results; ++i) {
+    if (num_unique == 0 || grid->results[num_unique - 1] != grid->results[i]) {
+      grid->results[num_unique++] = grid->results[i];
+    }
+  }
+  return num_unique;
+}
+
+int az_query_circle_grid(az_circle_grid_t *grid, az_vector_t min_corner,
+                         az_vector_t max_corner, const int **indices_out) {
+  assert(min_corner.x <= max_corner.x);
+  assert(min_corner.y <= max_corner.y);
+  *indices_out = grid->results;
+  if (grid->num_circles == 0) return 0;
+  int min_col, max_col, min_row, max_row;
+  get_cell_range(grid, min_corner, max_corner, &min_col, &max_col,
+                 &min_row, &max_row);
+  int num_results = 0;
+  for (int row = min_row; row <= max_row; ++row) {
+    for (int col = min_col; col <= max_col; ++col) {
+      const int cell = row * grid->num_cols + col;
+      for (int k = grid->cell_starts[cell];
+           k < grid->cell_starts[cell + 1]; ++k) {
+        const int index = grid->cell_entries[k];
+        const az_grid_circle_t *circle = &grid->circles[index];
+        if (circle->center.x + circle->radius < min_corner.x ||
+            circle->center.x - circle->radius > max_corner.x ||
+            circle->center.y + circle->radius < min_corner.y ||
+            circle->center.y - circle->radius > max_corner.y) continue;
+        // A circle that spans several cells appears in each of them, so only
+        // report it from the first such cell that this query visits.
+        int circle_min_col, circle_max_col, circle_min_row, circle_max_row;
+        get_circle_cell_range(grid, circle, &circle_min_col, &circle_max_col,
+                              &circle_min_row, &circle_max_row);
+        if (col != az_imax(min_col, circle_min_col) ||
+            row != az_imax(min_row, circle_min_row)) continue;
+        assert(num_results < grid->num_circles);
+        grid->results[num_results++] = index;
+      }
+    }
+  }
+  return sort_results(grid, num_results);
+}
+
+int az_sweep_circle_grid(az_circle_grid_t *grid, double radius,
+                         az_vector_t start, az_vector_t delta,
+                         const int **indices_out) {
+  assert(radius >= 0.0);
+  *indices_out = grid->results;
+  if (grid->num_circles == 0) return 0;
+  const az_vector_t end = az_vadd(start, delta);
+  // Pad the swept area by a hair, so that rounding error when working out
+  // which cells it crosses can't make us miss any; the exact distance check
+  // below has the final say anyway.
+  const double pad = radius + 1e-6 * grid->cell_size;
+  const az_vector_t extent = {pad, pad};
+  int min_col, max_col, min_row, max_row;
+  const az_vector_t min_corner = {fmin(start.x, end.x), fmin(start.y, end.y)};
+  const az_vector_t max_corner = {fmax(start.x, end.x), fmax(start.y, end.y)};
+  get_cell_range(grid, az_vsub(min_corner, extent),
+                 az_vadd(max_corner, extent),
+                 &min_col, &max_col, &min_row, &max_row);
+  const double delta_sq = az_vdot(delta, delta);
+  int num_results = 0;
+  for (int row = min_row; row <= max_row; ++row) {
+    // Find the part of the segment within reach of this row of cells (the
+    // outermost rows reach out forever), and thus which columns it crosses:
+    const double band_min = (row == 0 ? -INFINITY :
+        grid->origin.y + row * grid->cell_size - pad);
+    const double band_max = (row == grid->num_rows - 1 ? INFINITY :
+        grid->origin.y + (row + 1) * grid->cell_size + pad);
+    double t_min = 0.0, t_max = 1.0;
+    if (delta.y != 0.0) {
+      const double t1 = (band_min - start.y) / delta.y;
+      const double t2 = (band_max - start.y) / delta.y;
+      t_min = fmax(t_min, fmin(t1, t2));
+      t_max = fmin(t_max, fmax(t1, t2));
+      if (t_min > t_max) continue;
+    } else if (start.y < band_min || start.y > band_max) continue;
+    const double x1 = start.x + t_min * delta.x;
+    const double x2 = start.x + t_max * delta.x;
+    const az_vector_t row_min = {fmin(x1, x2) - pad, start.y};
+    const az_vector_t row_max = {fmax(x1, x2) + pad, start.y};
+    int row_min_col, row_max_col, ignored_min_row, ignored_max_row;
+    get_cell_range(grid, row_min, row_max, &row_min_col, &row_max_col,
+                   &ignored_min_row, &ignored_max_row);
+    for (int col = row_min_col; col <= row_max_col; ++col) {
+      const int cell = row * grid->num_cols + col;
+      for (int k = grid->cell_starts[cell];
+           k < grid->cell_starts[cell + 1]; ++k) {
+        const int index = grid->cell_entries[k];
+        const az_grid_circle_t *circle = &grid->circles[index];
+        // Check the distance from the circle's center to the segment:
+        const az_vector_t rel = az_vsub(circle->center, start);
+        const double t = (delta_sq == 0.0 ? 0.0 :
+                          fmax(0.0, fmin(1.0, az_vdot(rel, delta) /
+                                         delta_sq)));
+        if (az_vwithin(rel, az_vmul(delta, t), circle->radius + radius)) {
+          grid->results[num_results++] = index;
+        }
+      }
+    }
+  }
+  return sort_results(grid, num_results);
+}
+
+void az_destroy_circle_grid(az_circle_grid_t *grid) {
+  az_free(grid->circles);
+  az_free(grid->cell_starts);
+  az_free(grid->cell_entries);
+  az_free(grid->results);
+  AZ_ZERO_OBJECT(grid);
+}
+
+/*===========================================================================*/
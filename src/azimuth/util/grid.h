@@ -0,0 +1,78 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#pragma once
+#ifndef AZIMUTH_UTIL_GRID_H_
+#define AZIMUTH_UTIL_GRID_H_
+
+#include "azimuth/util/vector.h"
+
+/*===========================================================================*/
+
+// A circle grid is a uniform-grid spatial index over a fixed set of circles
+// (typically the bounding circles of some objects), for quickly finding the
+// few circles near a point or within a box without testing every one.  The
+// grid is built in one go and doesn't track later changes to the circles; to
+// account for those, build it again.  A zeroed az_circle_grid_t is a valid
+// empty grid.
+typedef struct {
+  az_vector_t center;
+  double radius;
+} az_grid_circle_t;
+
+typedef struct {
+  int num_circles;
+  az_grid_circle_t *circles; // copies of the indexed circles
+  double cell_size;
+  az_vector_t origin; // position of the bottom-left corner of the grid
+  int num_cols, num_rows;
+  int *cell_starts; // num_cols * num_rows + 1 offsets into cell_entries
+  int *cell_entries; // indices of circles overlapping each cell, by cell
+  int *results; // scratch space for query results (one slot per cell entry)
+} az_circle_grid_t;
+
+// Rebuild the grid to index the given circles (releasing whatever it indexed
+// before).  Cells are square, with sides at least min_cell_size long, and are
+// made larger when needed to keep the grid small for spread-out circles.
+void az_build_circle_grid(az_circle_grid_t *grid, int num_circles,
+                          const az_grid_circle_t *circles,
+                          double min_cell_size);
+
+// Find the circles whose axis-aligned bounding squares overlap the given box
+// (a point query is just a box whose corners are equal).  Returns the number
+// of matches and sets *indices_out to point to their indices in increasing
+// order; that array remains valid until the next query or rebuild.
+int az_query_circle_grid(az_circle_grid_t *grid, az_vector_t min_corner,
+                         az_vector_t max_corner, const int **indices_out);
+
+// Find the circles that a circle of the given radius would touch while
+// travelling delta from start; that is, those whose distance from the line
+// segment from start to start + delta is at most their radius plus the given
+// radius.  Only the cells along the segment are examined, so this is cheap even
+// for long sweeps.  Returns the matches the same way as az_query_circle_grid.
+int az_sweep_circle_grid(az_circle_grid_t *grid, double radius,
+                         az_vector_t start, az_vector_t delta,
+                         const int **indices_out);
+
+// Free the memory owned by the grid, leaving it empty.
+void az_destroy_circle_grid(az_circle_grid_t *grid);
+
+/*===========================================================================*/
+
+#endif // AZIMUTH_UTIL_GRID_H_
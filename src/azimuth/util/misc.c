@@ -19,7 +19,11 @@
 
 #include "azimuth/util/misc.h"
 
+#include <assert.h>
+#include <pthread.h>
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -39,15 +43,28 @@ void az_fatal_(const char *funcname, const char *format, ...) {
   exit(EXIT_FAILURE);
 }
 
+static void track_alloc(const char *funcname, void *ptr, size_t size);
+static void untrack_alloc(void *ptr);
+static bool tracking_enabled = false;
+
 void *az_alloc_(const char *funcname, size_t n, size_t size) {
   if (n == 0) return NULL;
   void *ptr = calloc(n, size);
   if (ptr == NULL) {
     az_fatal_(funcname, "Out of memory.\n");
   }
+  if (tracking_enabled) track_alloc(funcname, ptr, n * size);
   return ptr;
 }
 
+void az_free(void *ptr) {
+  if (ptr == NULL) return;
+  // Untrack the pointer before freeing it, so that another thread can't be
+  // handed the same address and track it first.
+  if (tracking_enabled) untrack_alloc(ptr);
+  free(ptr);
+}
+
 AZ_STATIC_ASSERT(AZ_COUNT_ARGS(a) == 1);
 AZ_STATIC_ASSERT(AZ_COUNT_ARGS(a,b) == 2);
 AZ_STATIC_ASSERT(AZ_COUNT_ARGS(a,b,c) == 3);
@@ -57,3 +74,246 @@ AZ_STATIC_ASSERT(AZ_COUNT_ARGS(a,b,c,d,e,f,g,h,i,j,k,l,m) == 13);
 AZ_STATIC_ASSERT(AZ_COUNT_ARGS(a,b,c,d,e,f,g,h,i,j,k,l,m,n,o) == 15);
 
 /*===========================================================================*/
+// Allocation tracking:
+
+// The size of the (fixed-size) hash table of allocation tags.  If it fills
+// up, further functions are all lumped together under one overflow tag.
+#define MAX_NUM_ALLOC_TAGS 1024
+#define MAX_NUM_FOOTPRINTS 32
+
+typedef struct {
+  const char *funcname; // NULL if this tag slot is unused
+  size_t num_allocs; // total number of allocations ever made
+  size_t live_count, live_bytes, peak_bytes;
+} az_alloc_tag_t;
+
+typedef struct {
+  void *ptr; // NULL if this table slot is unused
+  size_t size;
+  az_alloc_tag_t *tag;
+} az_tracked_alloc_t;
+
+// Everything here but the footprints is protected by the mutex, since rooms
+// (for example) are loaded on several threads at once.
+static struct {
+  pthread_mutex_t mutex;
+  size_t live_bytes, peak_bytes;
+  int num_tags;
+  az_alloc_tag_t tags[MAX_NUM_ALLOC_TAGS];
+  az_alloc_tag_t overflow_tag;
+  // A hash table (with linear probing) of all live tracked allocations:
+  size_t num_allocs, capacity;
+  az_tracked_alloc_t *allocs;
+  int num_footprints;
+  struct { const char *name; size_t size; } footprints[MAX_NUM_FOOTPRINTS];
+} tracking = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+static size_t hash_pointer(const void *ptr) {
+  const uintptr_t bits = (uintptr_t)ptr;
+  return (size_t)((bits >> 4) ^ (bits >> 16)) * 2654435761u;
+}
+
+static az_alloc_tag_t *get_alloc_tag(const char *funcname) {
+  // Tags are keyed by the address of the __func__ string, which is much
+  // cheaper than comparing names; functions from different files that share
+  // a name get merged together in the report.
+  for (size_t i = hash_pointer(funcname) % MAX_NUM_ALLOC_TAGS; true;
+       i = (i + 1) % MAX_NUM_ALLOC_TAGS) {
+    az_alloc_tag_t *tag = &tracking.tags[i];
+    if (tag->funcname == funcname) return tag;
+    if (tag->funcname == NULL) {
+      if (tracking.num_tags >= MAX_NUM_ALLOC_TAGS / 2) {
+        return &tracking.overflow_tag;
+      }
+      ++tracking.num_tags;
+      tag->funcname = funcname;
+      return tag;
+    }
+  }
+}
+
+static az_tracked_alloc_t *find_tracked_alloc(void *ptr) {
+  const size_t mask = tracking.capacity - 1;
+  for (size_t i = hash_pointer(ptr) & mask; true; i = (i + 1) & mask) {
+    az_tracked_alloc_t *alloc = &tracking.allocs[i];
+    if (alloc->ptr == ptr || alloc->ptr == NULL) return alloc;
+  }
+}
+
+static void remove_tracked_alloc(az_tracked_alloc_t *alloc) {
+  alloc->tag->live_bytes -= alloc->size;
+  --alloc->tag->live_count;
+  tracking.live_bytes -= alloc->size;
+  --tracking.num_allocs;
+  // Shift back any later entries in this probe run that would otherwise no
+  // longer be reachable from their home slot.
+  const size_t mask = tracking.capacity - 1;
+  size_t hole = alloc - tracking.allocs;
+  for (size_t i = (hole + 1) & mask; tracking.allocs[i].ptr != NULL;
+       i = (i + 1) & mask) {
+    const size_t home = hash_pointer(tracking.allocs[i].ptr) & mask;
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      tracking.allocs[hole] = tracking.allocs[i];
+      hole = i;
+    }
+  }
+  tracking.allocs[hole].ptr = NULL;
+}
+
+static void grow_alloc_table(void) {
+  az_tracked_alloc_t *old_allocs = tracking.allocs;
+  const size_t old_capacity = tracking.capacity;
+  tracking.capacity = (old_capacity == 0 ? 4096 : 2 * old_capacity);
+  // Use calloc directly, since this memory mustn't itself be tracked.
+  tracking.allocs = calloc(tracking.capacity, sizeof(az_tracked_alloc_t));
+  if (tracking.allocs == NULL) AZ_FATAL("Out of memory.\n");
+  for (size_t i = 0; i < old_capacity; ++i) {
+    if (old_allocs[i].ptr != NULL) {
+      *find_tracked_alloc(old_allocs[i].ptr) = old_allocs[i];
+    }
+  }
+  free(old_allocs);
+}
+
+static void track_alloc(const char *funcname, void *ptr, size_t size) {
+  pthread_mutex_lock(&tracking.mutex);
+  if (2 * (tracking.num_allocs + 1) > tracking.capacity) grow_alloc_table();
+  az_tracked_alloc_t *alloc = find_tracked_alloc(ptr);
+  // If this address is already in the table, the memory there must have been
+  // freed (or realloc'd) without going through az_free.
+  if (alloc->ptr != NULL) {
+    remove_tracked_alloc(alloc);
+    alloc = find_tracked_alloc(ptr);
+  }
+  az_alloc_tag_t *tag = get_alloc_tag(funcname);
+  *alloc = (az_tracked_alloc_t){ .ptr = ptr, .size = size, .tag = tag };
+  ++tracking.num_allocs;
+  ++tag->num_allocs;
+  ++tag->live_count;
+  tag->live_bytes += size;
+  if (tag->live_bytes > tag->peak_bytes) tag->peak_bytes = tag->live_bytes;
+  tracking.live_bytes += size;
+  if (tracking.live_bytes > tracking.peak_bytes) {
+    tracking.peak_bytes = tracking.live_bytes;
+  }
+  pthread_mutex_unlock(&tracking.mutex);
+}
+
+static void untrack_alloc(void *ptr) {
+  pthread_mutex_lock(&tracking.mutex);
+  if (tracking.capacity > 0) {
+    az_tracked_alloc_t *alloc = find_tracked_alloc(ptr);
+    if (alloc->ptr != NULL) remove_tracked_alloc(alloc);
+  }
+  pthread_mutex_unlock(&tracking.mutex);
+}
+
+static int compare_tag_names(const void *v1, const void *v2) {
+  const az_alloc_tag_t *tag1 = v1, *tag2 = v2;
+  return strcmp(tag1->funcname, tag2->funcname);
+}
+
+static int compare_tag_peaks(const void *v1, const void *v2) {
+  const az_alloc_tag_t *tag1 = v1, *tag2 = v2;
+  return (tag1->peak_bytes < tag2->peak_bytes ? 1 :
+          tag1->peak_bytes > tag2->peak_bytes ? -1 :
+          strcmp(tag1->funcname, tag2->funcname));
+}
+
+void az_enable_alloc_tracking(void) {
+  if (tracking_enabled) return;
+  tracking_enabled = true;
+  tracking.overflow_tag.funcname = "(other)";
+}
+
+void az_disable_alloc_tracking(void) {
+  if (!tracking_enabled) return;
+  tracking_enabled = false;
+  pthread_mutex_lock(&tracking.mutex);
+  free(tracking.allocs);
+  tracking.allocs = NULL;
+  tracking.num_allocs = tracking.capacity = 0;
+  tracking.live_bytes = tracking.peak_bytes = 0;
+  tracking.num_tags = 0;
+  AZ_ZERO_ARRAY(tracking.tags);
+  AZ_ZERO_OBJECT(&tracking.overflow_tag);
+  pthread_mutex_unlock(&tracking.mutex);
+}
+
+bool az_is_tracking_allocs(void) {
+  return tracking_enabled;
+}
+
+size_t az_tracked_live_bytes(void) {
+  pthread_mutex_lock(&tracking.mutex);
+  const size_t live_bytes = tracking.live_bytes;
+  pthread_mutex_unlock(&tracking.mutex);
+  return live_bytes;
+}
+
+void az_note_static_footprint(const char *name, size_t size) {
+  assert(name != NULL);
+  for (int i = 0; i < tracking.num_footprints; ++i) {
+    if (strcmp(tracking.footprints[i].name, name) == 0) {
+      tracking.footprints[i].size = size;
+      return;
+    }
+  }
+  if (tracking.num_footprints >= MAX_NUM_FOOTPRINTS) return;
+  tracking.footprints[tracking.num_footprints].name = name;
+  tracking.footprints[tracking.num_footprints].size = size;
+  ++tracking.num_footprints;
+}
+
+void az_report_alloc_tracking(void) {
+  if (!tracking_enabled) return;
+  fprintf(stderr, "Static footprint:\n");
+  size_t static_total = 0;
+  for (int i = 0; i < tracking.num_footprints; ++i) {
+    fprintf(stderr, "  %-32s %10zu bytes\n", tracking.footprints[i].name,
+            tracking.footprints[i].size);
+    static_total += tracking.footprints[i].size;
+  }
+  fprintf(stderr, "  %-32s %10zu bytes\n", "(total)", static_total);
+
+  // Copy out the tags (so we can sort them without holding the lock for
+  // long), and merge together any tags for functions with the same name.
+  pthread_mutex_lock(&tracking.mutex);
+  const size_t live_bytes = tracking.live_bytes;
+  const size_t peak_bytes = tracking.peak_bytes;
+  const size_t live_count = tracking.num_allocs;
+  int num_tags = 0;
+  az_alloc_tag_t tags[MAX_NUM_ALLOC_TAGS + 1];
+  AZ_ARRAY_LOOP(tag, tracking.tags) {
+    if (tag->funcname != NULL) tags[num_tags++] = *tag;
+  }
+  if (tracking.overflow_tag.num_allocs > 0) {
+    tags[num_tags++] = tracking.overflow_tag;
+  }
+  pthread_mutex_unlock(&tracking.mutex);
+  qsort(tags, num_tags, sizeof(az_alloc_tag_t), compare_tag_names);
+  int num_merged = 0;
+  for (int i = 0; i < num_tags; ++i) {
+    if (num_merged > 0 &&
+        strcmp(tags[num_merged - 1].funcname, tags[i].funcname) == 0) {
+      az_alloc_tag_t *merged = &tags[num_merged - 1];
+      merged->num_allocs += tags[i].num_allocs;
+      merged->live_count += tags[i].live_count;
+      merged->live_bytes += tags[i].live_bytes;
+      merged->peak_bytes += tags[i].peak_bytes; // an upper bound
+    } else tags[num_merged++] = tags[i];
+  }
+  qsort(tags, num_merged, sizeof(az_alloc_tag_t), compare_tag_peaks);
+
+  fprintf(stderr, "Heap: %zu bytes live in %zu allocations, %zu bytes peak\n",
+          live_bytes, live_count, peak_bytes);
+  fprintf(stderr, "  %-32s %10s %8s %10s %8s\n", "allocating function",
+          "live bytes", "live", "peak bytes", "allocs");
+  for (int i = 0; i < num_merged; ++i) {
+    fprintf(stderr, "  %-32s %10zu %8zu %10zu %8zu\n", tags[i].funcname,
+            tags[i].live_bytes, tags[i].live_count, tags[i].peak_bytes,
+            tags[i].num_allocs);
+  }
+}
+
+/*===========================================================================*/
@@ -21,6 +21,7 @@
 #ifndef AZIMUTH_UTIL_MISC_H_
 #define AZIMUTH_UTIL_MISC_H_
 
+#include <stdbool.h>
 #include <stddef.h> // for size_t
 
 /*===========================================================================*/
@@ -55,6 +56,34 @@ void az_fatal_(const char *funcname, const char *format, ...)
 void *az_alloc_(const char *funcname, size_t n, size_t size)
   __attribute__((__malloc__));
 
+// Free memory allocated with AZ_ALLOC.  This is the same as calling free(),
+// except that it keeps allocation tracking (see below) up to date; it is also
+// safe to use on memory that didn't come from AZ_ALLOC.  Does nothing if
+// given NULL.
+void az_free(void *ptr);
+
+// Start tracking every AZ_ALLOC allocation, tagged by the function that made
+// it.  This must be called before any other threads start.  Memory freed with
+// plain free() (or realloc'd) rather than az_free is still counted as live
+// until its address is reused.
+void az_enable_alloc_tracking(void);
+// Stop tracking allocations, and forget everything tracked so far (other than
+// static footprints).  Like az_enable_alloc_tracking, this must be called
+// while no other threads are running.
+void az_disable_alloc_tracking(void);
+bool az_is_tracking_allocs(void);
+
+// Return the total size of all live tracked allocations.
+size_t az_tracked_live_bytes(void);
+
+// Record the size of a large statically-allocated object (the name must be a
+// string literal), to be listed by az_report_alloc_tracking.
+void az_note_static_footprint(const char *name, size_t size);
+
+// If tracking is enabled, print the static footprints and the live, peak, and
+// total allocations for each allocating function to stderr.
+void az_report_alloc_tracking(void);
+
 // Use this macro to indicate that this point in the code should never be
 // reached at runtime.  If it is reached anyway (presumably due to a bug), it
 // will terminate the program with a fatal error.
@@ -122,10 +122,10 @@ az_music_parser_t *new_music_parser(
 void free_music_parser(az_music_parser_t *parser) {
   AZ_ARRAY_LOOP(part, parser->parts) {
     AZ_ARRAY_LOOP(track, part->tracks) {
-      free(track->notes);
+      az_free(track->notes);
     }
   }
-  free(parser);
+  az_free(parser);
 }
 
 /*===========================================================================*/
@@ -720,16 +720,226 @@ bool az_parse_music_from_file(
 
 void az_destroy_music(az_music_t *music) {
   if (music == NULL) return;
-  free(music->title);
+  if (music->block != NULL) {
+    az_free(music->block);
+    AZ_ZERO_OBJECT(music);
+    return;
+  }
+  az_free(music->title);
   for (int p = 0; p < music->num_parts; ++p) {
     az_music_part_t *part = &music->parts[p];
-    AZ_ARRAY_LOOP(track, part->tracks) free(track->notes);
+    AZ_ARRAY_LOOP(track, part->tracks) az_free(track->notes);
   }
-  free(music->parts);
-  free(music->instructions);
+  az_free(music->parts);
+  az_free(music->instructions);
   AZ_ZERO_OBJECT(music);
 }
 
+/*===========================================================================*/
+// Compiled music:
+
+#define COMPILED_MUSIC_VERSION 1
+
+// A compiled music file consists of this header, followed by a block of
+// exactly block_size bytes, which gets loaded verbatim into a single
+// allocation.  The block contains (in this order, to keep everything aligned)
+// the parts array, all tracks' notes, the instructions array, and the
+// NUL-terminated title (if any).  Within the block, each track's notes pointer
+// is instead stored as 1 + the index of its first note (or 0 for no notes),
+// and each drum note's data pointer as 1 + the index of the drum in the kit.
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  // These guard against loading a file written by an incompatible build:
+  uint32_t byte_order;
+  uint16_t pointer_size, part_size, note_size, instruction_size;
+  uint32_t num_parts, num_notes, num_instructions, title_size, block_size;
+} az_compiled_music_header_t;
+
+static const char compiled_music_magic[4] = {'A', 'Z', 'M', 'U'};
+#define COMPILED_MUSIC_BYTE_ORDER 0x01020304
+
+static void init_compiled_music_header(
+    az_compiled_music_header_t *header, int num_parts, int num_notes,
+    int num_instructions, int title_size) {
+  AZ_ZERO_OBJECT(header);
+  memcpy(header->magic, compiled_music_magic, sizeof(header->magic));
+  header->version = COMPILED_MUSIC_VERSION;
+  header->byte_order = COMPILED_MUSIC_BYTE_ORDER;
+  header->pointer_size = sizeof(void*);
+  header->part_size = sizeof(az_music_part_t);
+  header->note_size = sizeof(az_music_note_t);
+  header->instruction_size = sizeof(az_music_instruction_t);
+  header->num_parts = num_parts;
+  header->num_notes = num_notes;
+  header->num_instructions = num_instructions;
+  header->title_size = title_size;
+  header->block_size = num_parts * sizeof(az_music_part_t) +
+    num_notes * sizeof(az_music_note_t) +
+    num_instructions * sizeof(az_music_instruction_t) + title_size;
+}
+
+bool az_write_compiled_music(
+    const az_music_t *music, int num_drums, const az_sound_data_t *drums,
+    FILE *file) {
+  assert(music != NULL);
+  assert(file != NULL);
+  int num_notes = 0;
+  for (int p = 0; p < music->num_parts; ++p) {
+    AZ_ARRAY_LOOP(track, music->parts[p].tracks) {
+      num_notes += track->num_notes;
+    }
+  }
+  const int title_size =
+    (music->title == NULL ? 0 : (int)strlen(music->title) + 1);
+  az_compiled_music_header_t header;
+  init_compiled_music_header(&header, music->num_parts, num_notes,
+                             music->num_instructions, title_size);
+  if (fwrite(&header, sizeof(header), 1, file) != 1) return false;
+
+  // Write the parts, with each track's notes pointer replaced by an index.
+  int note_index = 0;
+  for (int p = 0; p < music->num_parts; ++p) {
+    az_music_part_t part = music->parts[p];
+    AZ_ARRAY_LOOP(track, part.tracks) {
+      track->notes = (track->num_notes == 0 ? NULL :
+                      (az_music_note_t*)(uintptr_t)(1 + note_index));
+      note_index += track->num_notes;
+    }
+    if (fwrite(&part, sizeof(part), 1, file) != 1) return false;
+  }
+  assert(note_index == num_notes);
+  // Write the notes, with each drum pointer replaced by an index.
+  for (int p = 0; p < music->num_parts; ++p) {
+    AZ_ARRAY_LOOP(track, music->parts[p].tracks) {
+      for (int i = 0; i < track->num_notes; ++i) {
+        az_music_note_t note = track->notes[i];
+        if (note.type == AZ_NOTE_DRUM) {
+          const ptrdiff_t drum_index = note.attributes.drum.data - drums;
+          assert(drum_index >= 0 && drum_index < num_drums);
+          note.attributes.drum.data =
+            (const az_sound_data_t*)(uintptr_t)(1 + drum_index);
+        }
+        if (fwrite(&note, sizeof(note), 1, file) != 1) return false;
+      }
+    }
+  }
+  if (music->num_instructions > 0 &&
+      fwrite(music->instructions, sizeof(az_music_instruction_t),
+             music->num_instructions, file) !=
+      (size_t)music->num_instructions) {
+    return false;
+  }
+  if (title_size > 0 &&
+      fwrite(music->title, 1, title_size, file) != (size_t)title_size) {
+    return false;
+  }
+  return true;
+}
+
+bool az_load_compiled_music_from_path(
+    const char *filepath, int num_drums, const az_sound_data_t *drums,
+    az_music_t *music_out) {
+  FILE *file = fopen(filepath, "rb");
+  if (file == NULL) return false;
+  const bool success =
+    az_load_compiled_music_from_file(file, num_drums, drums, music_out);
+  fclose(file);
+  return success;
+}
+
+bool az_load_compiled_music_from_file(
+    FILE *file, int num_drums, const az_sound_data_t *drums,
+    az_music_t *music_out) {
+  assert(file != NULL);
+  assert(music_out != NULL);
+  AZ_ZERO_OBJECT(music_out);
+  az_compiled_music_header_t header;
+  if (fread(&header, sizeof(header), 1, file) != 1) return false;
+  az_compiled_music_header_t expected;
+  init_compiled_music_header(&expected, header.num_parts, header.num_notes,
+                             header.num_instructions, header.title_size);
+  if (memcmp(&header, &expected, sizeof(header)) != 0 ||
+      header.num_parts > MAX_NUM_PARTS ||
+      header.num_notes > MAX_NUM_PARTS * AZ_MUSIC_NUM_TRACKS *
+      MAX_NOTES_PER_TRACK ||
+      header.num_instructions > MAX_SPEC_LENGTH ||
+      header.title_size > MAX_TITLE_LENGTH + 1) return false;
+  if (header.block_size == 0) return true;
+  const int num_parts = header.num_parts;
+  const int num_notes = header.num_notes;
+  const int num_instructions = header.num_instructions;
+  const int title_size = header.title_size;
+
+  char *block = AZ_ALLOC(header.block_size, char);
+  if (fread(block, header.block_size, 1, file) != 1) goto error;
+  az_music_part_t *parts = (az_music_part_t*)block;
+  az_music_note_t *notes =
+    (az_music_note_t*)(block + num_parts * sizeof(az_music_part_t));
+  az_music_instruction_t *instructions =
+    (az_music_instruction_t*)(notes + num_notes);
+  char *title = (char*)(instructions + num_instructions);
+
+  // Convert indices back into pointers, validating them as we go.
+  for (int p = 0; p < num_parts; ++p) {
+    AZ_ARRAY_LOOP(track, parts[p].tracks) {
+      if (track->num_notes == 0) {
+        if (track->notes != NULL) goto error;
+        continue;
+      }
+      const uintptr_t index = (uintptr_t)track->notes;
+      if (track->num_notes < 0 || index < 1 ||
+          index - 1 + track->num_notes > (uintptr_t)num_notes) goto error;
+      track->notes = notes + (index - 1);
+    }
+  }
+  for (int i = 0; i < num_notes; ++i) {
+    az_music_note_t *note = &notes[i];
+    if (note->type < AZ_NOTE_REST || note->type > AZ_NOTE_WAVEFORM) {
+      goto error;
+    }
+    if (note->type == AZ_NOTE_DRUM) {
+      const uintptr_t index = (uintptr_t)note->attributes.drum.data;
+      if (index < 1 || index > (uintptr_t)num_drums) goto error;
+      note->attributes.drum.data = drums + (index - 1);
+    }
+  }
+  for (int i = 0; i < num_instructions; ++i) {
+    const az_music_instruction_t *ins = &instructions[i];
+    switch (ins->opcode) {
+      case AZ_MUSOP_NOP:
+      case AZ_MUSOP_SETF: break;
+      case AZ_MUSOP_PLAY:
+        if (ins->index < 0 || ins->index >= num_parts) goto error;
+        break;
+      case AZ_MUSOP_BFEQ:
+      case AZ_MUSOP_BFNE:
+      case AZ_MUSOP_JUMP:
+        if (ins->index < 0 || ins->index > num_instructions) {
+          goto error;
+        }
+        break;
+      default: goto error;
+    }
+  }
+  if (title_size > 0 && title[title_size - 1] != '\0') {
+    goto error;
+  }
+
+  music_out->block = block;
+  music_out->title = (title_size > 0 ? title : NULL);
+  music_out->num_parts = num_parts;
+  music_out->parts = (num_parts > 0 ? parts : NULL);
+  music_out->num_instructions = num_instructions;
+  music_out->instructions =
+    (num_instructions > 0 ? instructions : NULL);
+  return true;
+
+ error:
+  az_free(block);
+  return false;
+}
+
 /*===========================================================================*/
 
 #define SECONDS_PER_SAMPLE (1.0 / (double)(AZ_AUDIO_RATE))
@@ -738,12 +948,14 @@ void az_destroy_music(az_music_t *music) {
 // The wave amplitude produced by an L100 note:
 #define BASE_LOUDNESS 6500.0
 
-static uint64_t generate_noise(void) {
+#define INITIAL_NOISE_SEED UINT64_C(123456789123456789)
+
+static uint64_t generate_noise(az_music_synth_t *synth) {
   // This is a simple linear congruential generator, using the parameters
   // suggested by http://nuclear.llnl.gov/CNP/rng/rngman/node4.html
-  static uint64_t seed = UINT64_C(123456789123456789);
-  seed = UINT64_C(2862933555777941757) * seed + UINT64_C(3037000493);
-  return seed;
+  synth->noise_seed = UINT64_C(2862933555777941757) * synth->noise_seed +
+    UINT64_C(3037000493);
+  return synth->noise_seed;
 }
 
 static void synth_begin_next_part(az_music_synth_t *synth) {
@@ -787,95 +999,212 @@ static void synth_begin_next_part(az_music_synth_t *synth) {
 }
 
 static void synth_advance(az_music_synth_t *synth) {
-  while (true) {
-    assert(synth->music != NULL);
-    if (synth->stopped) return;
-    int num_tracks_finished = 0;
-    AZ_ARRAY_LOOP(voice, synth->voices) {
-      while (true) {
-        assert(voice->track != NULL);
-        if (voice->note_index >= voice->track->num_notes) {
-          ++num_tracks_finished;
+  assert(synth->music != NULL);
+  if (synth->stopped) return;
+  int num_tracks_finished = 0;
+  AZ_ARRAY_LOOP(voice, synth->voices) {
+    while (true) {
+      assert(voice->track != NULL);
+      if (voice->note_index >= voice->track->num_notes) {
+        ++num_tracks_finished;
+        break;
+      }
+      const az_music_note_t *note = &voice->track->notes[voice->note_index];
+      switch (note->type) {
+        case AZ_NOTE_REST:
+          if (voice->time_from_note_start < note->attributes.rest.duration) {
+            goto sustain;
+          }
+          voice->time_from_note_start -= note->attributes.rest.duration;
+          break;
+        case AZ_NOTE_TONE:
+          if (voice->time_from_note_start < note->attributes.tone.duration) {
+            goto sustain;
+          }
+          voice->time_from_note_start -= note->attributes.tone.duration;
+          break;
+        case AZ_NOTE_DRUM:
+          if (voice->time_from_note_start <
+              note->attributes.drum.duration) {
+            goto sustain;
+          }
+          voice->time_from_note_start -= note->attributes.drum.duration;
+          break;
+        case AZ_NOTE_DUTYMOD:
+          voice->dutymod_depth = note->attributes.dutymod.depth;
+          voice->dutymod_speed = note->attributes.dutymod.speed;
+          break;
+        case AZ_NOTE_ENVELOPE:
+          voice->attack_time = note->attributes.envelope.attack_time;
+          voice->decay_fraction = note->attributes.envelope.decay_fraction;
+          break;
+        case AZ_NOTE_LOUDNESS:
+          voice->loudness = BASE_LOUDNESS * note->attributes.loudness.volume;
+          assert(voice->loudness >= 0.0);
+          break;
+        case AZ_NOTE_VIBRATO:
+          voice->vibrato_depth = note->attributes.vibrato.depth;
+          voice->vibrato_speed = note->attributes.vibrato.speed;
+          break;
+        case AZ_NOTE_WAVEFORM:
+          voice->waveform = note->attributes.waveform.kind;
+          voice->duty = note->attributes.waveform.duty;
           break;
-        }
-        const az_music_note_t *note = &voice->track->notes[voice->note_index];
-        switch (note->type) {
-          case AZ_NOTE_REST:
-            if (voice->time_from_note_start < note->attributes.rest.duration) {
-              goto sustain;
-            }
-            voice->time_from_note_start -= note->attributes.rest.duration;
-            break;
-          case AZ_NOTE_TONE:
-            if (voice->time_from_note_start < note->attributes.tone.duration) {
-              goto sustain;
-            }
-            voice->time_from_note_start -= note->attributes.tone.duration;
-            break;
-          case AZ_NOTE_DRUM:
-            if (voice->time_from_note_start <
-                note->attributes.drum.duration) {
-              goto sustain;
-            }
-            voice->time_from_note_start -= note->attributes.drum.duration;
-            break;
-          case AZ_NOTE_DUTYMOD:
-            voice->dutymod_depth = note->attributes.dutymod.depth;
-            voice->dutymod_speed = note->attributes.dutymod.speed;
-            break;
-          case AZ_NOTE_ENVELOPE:
-            voice->attack_time = note->attributes.envelope.attack_time;
-            voice->decay_fraction = note->attributes.envelope.decay_fraction;
-            break;
-          case AZ_NOTE_LOUDNESS:
-            voice->loudness = BASE_LOUDNESS * note->attributes.loudness.volume;
-            assert(voice->loudness >= 0.0);
-            break;
-          case AZ_NOTE_VIBRATO:
-            voice->vibrato_depth = note->attributes.vibrato.depth;
-            voice->vibrato_speed = note->attributes.vibrato.speed;
-            break;
-          case AZ_NOTE_WAVEFORM:
-            voice->waveform = note->attributes.waveform.kind;
-            voice->duty = note->attributes.waveform.duty;
-            break;
-        }
-        ++voice->note_index;
-        voice->drum_index = 0;
       }
-    sustain:
-      synth->steps_since_last_sustain = 0;
+      ++voice->note_index;
+      voice->drum_index = 0;
+    }
+  sustain:
+    synth->steps_since_last_sustain = 0;
+  }
+  // If every track has finished, then the next part will begin (and consult
+  // the flag) at the start of the next sample.
+  if (num_tracks_finished == AZ_MUSIC_NUM_TRACKS) synth->part_finished = true;
+}
+
+/*===========================================================================*/
+// Band-limited oscillators:
+
+// Number of entries in the sine wavetable (must be a power of two):
+#define SINE_TABLE_SIZE 1024
+
+// One extra entry at the end, so that we can interpolate without wrapping.
+static double sine_table[SINE_TABLE_SIZE + 1];
+static bool sine_table_initialized = false;
+
+static void init_sine_table(void) {
+  if (sine_table_initialized) return;
+  for (int i = 0; i <= SINE_TABLE_SIZE; ++i) {
+    sine_table[i] = sin(i * (AZ_TWO_PI / SINE_TABLE_SIZE));
+  }
+  sine_table_initialized = true;
+}
+
+// Approximate sin(radians) by linear interpolation into the sine wavetable.
+static double table_sin(double radians) {
+  assert(sine_table_initialized);
+  const double position = radians * (SINE_TABLE_SIZE / AZ_TWO_PI);
+  const double floored = floor(position);
+  const int index = (int)((int64_t)floored & (SINE_TABLE_SIZE - 1));
+  const double frac = position - floored;
+  return sine_table[index] + frac * (sine_table[index + 1] - sine_table[index]);
+}
+
+// Polynomial approximation of the residual between a band-limited step and a
+// naive step of height 2, for phase t (0 to 1) and phase increment dt.
+static double poly_blep(double t, double dt) {
+  if (t < dt) {
+    t /= dt;
+    return t + t - t * t - 1.0;
+  } else if (t > 1.0 - dt) {
+    t = (t - 1.0) / dt;
+    return t * t + t + t + 1.0;
+  }
+  return 0.0;
+}
+
+// Integrated version of poly_blep, for smoothing corners (discontinuities in
+// slope) rather than steps.
+static double poly_blamp(double t, double dt) {
+  if (t < dt) {
+    t = t / dt - 1.0;
+    return -(1.0 / 3.0) * t * t * t;
+  } else if (t > 1.0 - dt) {
+    t = (t - 1.0) / dt + 1.0;
+    return (1.0 / 3.0) * t * t * t;
+  }
+  return 0.0;
+}
+
+// Return the amplitude (-1 to 1) of the voice's tone at the current sample,
+// and advance its phase by one sample.
+static double bandlimited_tone(az_music_synth_t *synth,
+                               az_music_voice_t *voice, double frequency,
+                               double duty) {
+  const double dt = fmin(frequency * SECONDS_PER_SAMPLE, 0.5);
+  const double phase = voice->phase;
+  double amplitude = 0.0;
+  switch (voice->waveform) {
+    case AZ_NOISE_WAVE:
+      // Noise has no pitch for aliasing to distort, so we just point-sample
+      // the same bit pattern the supersampling oscillator uses.
+      amplitude = ((voice->noise_bits >> (int)(64.0 * phase)) & 0x1 ?
+                   1.0 : -1.0);
+      break;
+    case AZ_SINE_WAVE:
+      amplitude = table_sin(phase * AZ_TWO_PI);
+      break;
+    case AZ_SQUARE_WAVE: {
+      double falling = phase - duty;
+      if (falling < 0.0) falling += 1.0;
+      amplitude = (phase < duty ? 1.0 : -1.0) +
+        poly_blep(phase, dt) - poly_blep(falling, dt);
+    } break;
+    case AZ_TRIANGLE_WAVE: {
+      // Keep both corners at least one sample apart, so that a duty of 0 or 1
+      // (i.e. a sawtooth) still gets smoothed rather than dividing by zero.
+      const double tduty = fmin(fmax(dt, duty), 1.0 - dt);
+      double peak = phase - tduty;
+      if (peak < 0.0) peak += 1.0;
+      amplitude = (phase < tduty ?
+                   2.0 * (phase / tduty) - 1.0 :
+                   1.0 - 2.0 * ((phase - tduty) / (1.0 - tduty))) +
+        (dt / (tduty * (1.0 - tduty))) *
+        (poly_blamp(phase, dt) - poly_blamp(peak, dt));
+    } break;
+    case AZ_SAWTOOTH_WAVE:
+    case AZ_WOBBLE_WAVE:
+      AZ_ASSERT_UNREACHABLE();
+  }
+  voice->phase += dt;
+  if (voice->phase >= 1.0) {
+    voice->phase -= floor(voice->phase);
+    if (voice->waveform == AZ_NOISE_WAVE) {
+      voice->noise_bits = generate_noise(synth);
     }
-    if (num_tracks_finished < AZ_MUSIC_NUM_TRACKS) return;
-    synth_begin_next_part(synth);
   }
+  return amplitude;
 }
 
+/*===========================================================================*/
+
 void az_reset_music_synth(az_music_synth_t *synth, const az_music_t *music,
                           int flag) {
   assert(synth != NULL);
+  const az_music_oscillator_t oscillator = synth->oscillator;
   AZ_ZERO_OBJECT(synth);
+  synth->oscillator = oscillator;
+  if (oscillator == AZ_MUSIC_OSC_BANDLIMITED) init_sine_table();
   if (music == NULL) return;
   synth->music = music;
   synth->flag = flag;
+  synth->noise_seed = INITIAL_NOISE_SEED;
   AZ_ARRAY_LOOP(voice, synth->voices) {
     voice->waveform = AZ_SQUARE_WAVE;
     voice->duty = 0.5;
     voice->loudness = BASE_LOUDNESS;
-    voice->noise_bits = generate_noise();
+    voice->noise_bits = generate_noise(synth);
   }
   synth_begin_next_part(synth);
   synth_advance(synth);
 }
 
-void az_synthesize_music(az_music_synth_t *synth, int16_t *samples,
-                         int num_samples) {
+static int synthesize(az_music_synth_t *synth, int16_t *samples,
+                      int num_samples, bool stop_at_part_end) {
   assert(synth != NULL);
   if (synth->music == NULL) {
     memset(samples, 0, num_samples * sizeof(int16_t));
-    return;
+    return num_samples;
   }
-  for (int sample_index = 0; sample_index < num_samples; ++sample_index) {
+  const bool bandlimited = (synth->oscillator == AZ_MUSIC_OSC_BANDLIMITED);
+  int sample_index = 0;
+  for (; sample_index < num_samples; ++sample_index) {
+    while (synth->part_finished && !synth->stopped) {
+      if (stop_at_part_end && sample_index > 0) return sample_index;
+      synth->part_finished = false;
+      synth_begin_next_part(synth);
+      synth_advance(synth);
+    }
     if (synth->stopped) break;
     int sample = 0;
     AZ_ARRAY_LOOP(voice, synth->voices) {
@@ -884,44 +1213,58 @@ void az_synthesize_music(az_music_synth_t *synth, int16_t *samples,
       if (voice->note_index >= track->num_notes) continue;
       const az_music_note_t *note = &track->notes[voice->note_index];
       if (note->type == AZ_NOTE_TONE) {
-        const double vibrato = 1.0 + voice->vibrato_depth *
-          sin(voice->time_from_note_start * voice->vibrato_speed);
-        const double period =
-          1.0 / (note->attributes.tone.frequency * vibrato);
-        const int iperiod = (int)(AZ_AUDIO_RATE * SYNTH_SUPERSAMPLE * period);
         double amplitude = 0.0;
-        for (int s = 0; s < SYNTH_SUPERSAMPLE; ++s) {
-          ++voice->iphase;
-          if (voice->iphase >= iperiod) {
-            voice->iphase %= iperiod;
-            if (voice->waveform == AZ_NOISE_WAVE) {
-              voice->noise_bits = generate_noise();
-            }
-          }
-          const double phase = (double)voice->iphase / (double)iperiod;
+        if (bandlimited) {
+          const double vibrato = 1.0 + voice->vibrato_depth *
+            table_sin(voice->time_from_note_start * voice->vibrato_speed);
+          const double duty = voice->duty *
+            (1.0 + voice->dutymod_depth *
+             table_sin(voice->time_from_note_start * voice->dutymod_speed));
+          amplitude = bandlimited_tone(
+              synth, voice, note->attributes.tone.frequency * vibrato, duty);
+        } else {
+          const double vibrato = 1.0 + voice->vibrato_depth *
+            sin(voice->time_from_note_start * voice->vibrato_speed);
+          const double period =
+            1.0 / (note->attributes.tone.frequency * vibrato);
+          const int iperiod =
+            (int)(AZ_AUDIO_RATE * SYNTH_SUPERSAMPLE * period);
+          // The duty modulation only depends on the time, which doesn't
+          // change between supersamples.
           const double duty = voice->duty *
             (1.0 + voice->dutymod_depth *
              sin(voice->time_from_note_start * voice->dutymod_speed));
-          switch (voice->waveform) {
-            case AZ_NOISE_WAVE:
-              amplitude += ((voice->noise_bits >>
-                             (64 * voice->iphase / iperiod)) & 0x1 ?
-                            1.0 : -1.0);
-              break;
-            case AZ_SINE_WAVE:
-              amplitude += sin(phase * AZ_TWO_PI);
-              break;
-            case AZ_SQUARE_WAVE:
-              amplitude += (phase < duty ? 1.0 : -1.0);
-              break;
-            case AZ_TRIANGLE_WAVE:
-              amplitude += (phase < duty ? 2.0 * (phase / duty) - 1.0 :
-                            1.0 - 2.0 * ((phase - duty) / (1.0 - duty)));
-              break;
-            case AZ_SAWTOOTH_WAVE:
-            case AZ_WOBBLE_WAVE:
-              AZ_ASSERT_UNREACHABLE();
+          for (int s = 0; s < SYNTH_SUPERSAMPLE; ++s) {
+            ++voice->iphase;
+            if (voice->iphase >= iperiod) {
+              voice->iphase %= iperiod;
+              if (voice->waveform == AZ_NOISE_WAVE) {
+                voice->noise_bits = generate_noise(synth);
+              }
+            }
+            const double phase = (double)voice->iphase / (double)iperiod;
+            switch (voice->waveform) {
+              case AZ_NOISE_WAVE:
+                amplitude += ((voice->noise_bits >>
+                               (64 * voice->iphase / iperiod)) & 0x1 ?
+                              1.0 : -1.0);
+                break;
+              case AZ_SINE_WAVE:
+                amplitude += sin(phase * AZ_TWO_PI);
+                break;
+              case AZ_SQUARE_WAVE:
+                amplitude += (phase < duty ? 1.0 : -1.0);
+                break;
+              case AZ_TRIANGLE_WAVE:
+                amplitude += (phase < duty ? 2.0 * (phase / duty) - 1.0 :
+                              1.0 - 2.0 * ((phase - duty) / (1.0 - duty)));
+                break;
+              case AZ_SAWTOOTH_WAVE:
+              case AZ_WOBBLE_WAVE:
+                AZ_ASSERT_UNREACHABLE();
+            }
           }
+          amplitude /= SYNTH_SUPERSAMPLE;
         }
         const double decay_time =
           note->attributes.tone.duration * voice->decay_fraction;
@@ -933,7 +1276,7 @@ void az_synthesize_music(az_music_synth_t *synth, int16_t *samples,
           (voice->time_from_note_start < voice->attack_time ?
            voice->time_from_note_start / voice->attack_time : 1.0) *
           (time_remaining < decay_time ? time_remaining / decay_time : 1.0);
-        sample += (amplitude / SYNTH_SUPERSAMPLE) * envelope * voice->loudness;
+        sample += amplitude * envelope * voice->loudness;
       } else if (note->type == AZ_NOTE_DRUM) {
         const az_sound_data_t *data = note->attributes.drum.data;
         if (voice->drum_index < data->num_samples) {
@@ -952,6 +1295,17 @@ void az_synthesize_music(az_music_synth_t *synth, int16_t *samples,
     }
     synth_advance(synth);
   }
+  return sample_index;
+}
+
+void az_synthesize_music(az_music_synth_t *synth, int16_t *samples,
+                         int num_samples) {
+  synthesize(synth, samples, num_samples, false);
+}
+
+int az_synthesize_music_part(az_music_synth_t *synth, int16_t *samples,
+                             int num_samples) {
+  return synthesize(synth, samples, num_samples, true);
 }
 
 /*===========================================================================*/
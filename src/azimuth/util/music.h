@@ -108,6 +108,10 @@ typedef struct {
   az_music_part_t *parts;
   int num_instructions;
   az_music_instruction_t *instructions;
+  // If non-NULL, then the title, parts, notes, and instructions all live in
+  // this single allocation (as loaded from compiled music), rather than being
+  // allocated separately.
+  void *block;
 } az_music_t;
 
 bool az_parse_music_from_path(
@@ -120,28 +124,70 @@ bool az_parse_music_from_file(
 
 void az_destroy_music(az_music_t *music);
 
+// Compiled music is a compact binary serialization of an az_music_t, which
+// can be loaded with a single read into a single allocation, without any
+// parsing.  It is meant as a cache of the text format for the machine that
+// compiled it, and is rejected (returning false) if it was written by a build
+// with a different struct layout.  The same drum kit must be passed in when
+// writing and loading.
+bool az_write_compiled_music(
+    const az_music_t *music, int num_drums, const az_sound_data_t *drums,
+    FILE *file);
+
+bool az_load_compiled_music_from_path(
+    const char *filepath, int num_drums, const az_sound_data_t *drums,
+    az_music_t *music_out);
+
+bool az_load_compiled_music_from_file(
+    FILE *file, int num_drums, const az_sound_data_t *drums,
+    az_music_t *music_out);
+
 /*===========================================================================*/
 
+// Selects how a music synth generates tone waveforms.
+typedef enum {
+  // Evaluate each oscillator several times per output sample and average the
+  // results.  This is the original synthesis method, and is bit-exact with
+  // older versions of the game.
+  AZ_MUSIC_OSC_SUPERSAMPLE = 0,
+  // Evaluate each oscillator once per output sample, using a sine wavetable,
+  // and PolyBLEP/PolyBLAMP corrections at waveform discontinuities to
+  // suppress aliasing.  This is several times cheaper than supersampling.
+  AZ_MUSIC_OSC_BANDLIMITED,
+} az_music_oscillator_t;
+
 typedef struct {
+  const az_music_track_t *track;
+  int note_index;
+  size_t drum_index;
+  double time_from_note_start;
+  az_sound_wave_kind_t waveform;
+  double duty;
+  double loudness;
+  double attack_time, decay_fraction;
+  double dutymod_depth, dutymod_speed;
+  double vibrato_depth, vibrato_speed;
+  int iphase; // used by AZ_MUSIC_OSC_SUPERSAMPLE
+  double phase; // used by AZ_MUSIC_OSC_BANDLIMITED; 0.0 to 1.0
+  uint64_t noise_bits;
+} az_music_voice_t;
+
+typedef struct {
+  // Which oscillator implementation to use.  Unlike the other fields, this is
+  // preserved by az_reset_music_synth, so it can be set once up front.
+  az_music_oscillator_t oscillator;
   const az_music_t *music;
   int flag;
   int pc;
   int steps_since_last_sustain;
   double time_index;
-  struct {
-    const az_music_track_t *track;
-    int note_index;
-    size_t drum_index;
-    double time_from_note_start;
-    az_sound_wave_kind_t waveform;
-    double duty;
-    double loudness;
-    double attack_time, decay_fraction;
-    double dutymod_depth, dutymod_speed;
-    double vibrato_depth, vibrato_speed;
-    int iphase;
-    uint64_t noise_bits;
-  } voices[AZ_MUSIC_NUM_TRACKS];
+  // Each synth has its own noise generator, so that its output depends only
+  // on its music and flag, and not on what other synths have played.
+  uint64_t noise_seed;
+  az_music_voice_t voices[AZ_MUSIC_NUM_TRACKS];
+  // True if every track of the current part has finished; the synth will
+  // consult its flag and begin the next part at the start of the next sample.
+  bool part_finished;
   bool stopped;
 } az_music_synth_t;
 
@@ -151,6 +197,14 @@ void az_reset_music_synth(az_music_synth_t *synth, const az_music_t *music,
 void az_synthesize_music(az_music_synth_t *synth, int16_t *samples,
                          int num_samples);
 
+// Like az_synthesize_music, but stops early if the current part finishes, so
+// that the caller has a chance to change the flag before the next part begins
+// (if the part has already finished when this is called, the next part begins
+// right away).  Also stops early if the music stops.  Returns the number of
+// samples written.
+int az_synthesize_music_part(az_music_synth_t *synth, int16_t *samples,
+                             int num_samples);
+
 /*===========================================================================*/
 
 #endif // AZIMUTH_UTIL_MUSIC_H_
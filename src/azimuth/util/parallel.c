@@ -0,0 +1,91 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#include "azimuth/util/parallel.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <unistd.h>
+
+/*===========================================================================*/
+
+// There's no point in having lots more threads than CPUs, and the work we do
+// in parallel (e.g. file parsing) doesn't scale much past this anyway.
+#define AZ_MAX_NUM_WORKERS 16
+
+typedef struct {
+  void (*func)(void *data, int index);
+  void *data;
+  int count;
+  pthread_mutex_t mutex;
+  int next_index; // protected by mutex
+} az_parallel_job_t;
+
+static void *run_worker(void *arg) {
+  az_parallel_job_t *job = arg;
+  while (true) {
+    pthread_mutex_lock(&job->mutex);
+    const int index = job->next_index++;
+    pthread_mutex_unlock(&job->mutex);
+    if (index >= job->count) break;
+    job->func(job->data, index);
+  }
+  return NULL;
+}
+
+static int num_cpus(void) {
+  const long num = sysconf(_SC_NPROCESSORS_ONLN);
+  return (num < 1 ? 1 : num > AZ_MAX_NUM_WORKERS ? AZ_MAX_NUM_WORKERS :
+          (int)num);
+}
+
+void az_parallel_for(int count, void (*func)(void *data, int index),
+                     void *data) {
+  assert(count >= 0);
+  assert(func != NULL);
+  if (count == 0) return;
+  const int num_workers = (count < num_cpus() ? count : num_cpus());
+  if (num_workers <= 1) {
+    for (int i = 0; i < count; ++i) func(data, i);
+    return;
+  }
+  az_parallel_job_t job = {
+    .func = func, .data = data, .count = count, .next_index = 0
+  };
+  if (pthread_mutex_init(&job.mutex, NULL) != 0) {
+    for (int i = 0; i < count; ++i) func(data, i);
+    return;
+  }
+  // The calling thread acts as one of the workers.
+  pthread_t threads[AZ_MAX_NUM_WORKERS];
+  int num_threads = 0;
+  while (num_threads < num_workers - 1 &&
+         pthread_create(&threads[num_threads], NULL, run_worker, &job) == 0) {
+    ++num_threads;
+  }
+  run_worker(&job);
+  for (int i = 0; i < num_threads; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  pthread_mutex_destroy(&job.mutex);
+}
+
+/*===========================================================================*/
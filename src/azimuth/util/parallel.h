@@ -0,0 +1,36 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+#pragma once
+#ifndef AZIMUTH_UTIL_PARALLEL_H_
+#define AZIMUTH_UTIL_PARALLEL_H_
+
+/*===========================================================================*/
+
+// Call func(data, index) once for each index from 0 to count - 1, spreading
+// the calls across a pool of worker threads (one per CPU, including the
+// calling thread), and return once all of them have finished.  The calls may
+// happen in any order and at the same time as each other, so func must only
+// write to state that belongs to its own index.  If worker threads can't be
+// started, the remaining calls simply run on the calling thread.
+void az_parallel_for(int count, void (*func)(void *data, int index),
+                     void *data);
+
+/*===========================================================================*/
+
+#endif // AZIMUTH_UTIL_PARALLEL_H_
@@ -62,6 +62,13 @@ int az_randint(int min, int max);
 // radius of the origin.
 az_vector_t az_random_point_in_circle(double radius);
 
+// Get or set the global random seed (used by the above functions).  Restoring
+// a seed previously obtained from az_get_global_random_seed makes the global
+// sequence repeat from that point, which is what lets replays be
+// deterministic.
+az_random_seed_t az_get_global_random_seed(void);
+void az_set_global_random_seed(az_random_seed_t seed);
+
 /*===========================================================================*/
 
 #endif // AZIMUTH_UTIL_RANDOM_H_
@@ -0,0 +1,274 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#include "azimuth/util/scan.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "azimuth/util/misc.h"
+
+/*===========================================================================*/
+
+// The longest number literal that az_scan will accept.  Our data files are
+// written with "%.17g" and the like, which never come anywhere close.
+#define AZ_MAX_NUMBER_LENGTH 79
+
+void az_init_scanner(az_scanner_t *scanner, const char *data, size_t size) {
+  assert(scanner != NULL);
+  assert(data != NULL || size == 0);
+  scanner->ptr = data;
+  scanner->end = data + size;
+}
+
+int az_scan_getc(az_scanner_t *scanner) {
+  if (scanner->ptr >= scanner->end) return EOF;
+  return (unsigned char)*(scanner->ptr++);
+}
+
+int az_scan_peek(const az_scanner_t *scanner) {
+  if (scanner->ptr >= scanner->end) return EOF;
+  return (unsigned char)*scanner->ptr;
+}
+
+bool az_scan_try_char(az_scanner_t *scanner, char ch) {
+  if (scanner->ptr >= scanner->end || *scanner->ptr != ch) return false;
+  ++scanner->ptr;
+  return true;
+}
+
+static void skip_space(az_scanner_t *scanner) {
+  while (scanner->ptr < scanner->end &&
+         isspace((unsigned char)*scanner->ptr)) {
+    ++scanner->ptr;
+  }
+}
+
+// Copy the longest run of characters at the scanner's position that could
+// possibly be part of a number literal into the buffer, NUL-terminated, so
+// that it can be handed to strtol/strtod without running off the end of the
+// scanner's (not necessarily NUL-terminated) buffer.  The scanner itself is
+// not advanced.
+static void copy_number_token(const az_scanner_t *scanner,
+                              char buffer[AZ_MAX_NUMBER_LENGTH + 1]) {
+  int length = 0;
+  for (const char *ptr = scanner->ptr;
+       ptr < scanner->end && length < AZ_MAX_NUMBER_LENGTH; ++ptr) {
+    const char ch = *ptr;
+    if (!isalnum((unsigned char)ch) && ch != '.' && ch != '+' &&
+        ch != '-') break;
+    buffer[length++] = ch;
+  }
+  buffer[length] = '\0';
+}
+
+// Try to parse a plain decimal number (an optional sign, digits, and an
+// optional fractional part) starting at ptr, without calling strtod.  If the
+// mantissa fits exactly in a double and there are at most 22 fractional
+// digits, then a single division by an exact power of ten gives the same
+// correctly-rounded result that strtod would (this is Clinger's fast path).
+// Returns a pointer to the end of the number on success, or NULL if the
+// number isn't of this simple form and needs the general path.
+static const char *fast_scan_double(const char *ptr, const char *end,
+                                    double *value_out) {
+  static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+    1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  bool negative = false;
+  if (ptr < end && (*ptr == '-' || *ptr == '+')) negative = (*ptr++ == '-');
+  uint64_t mantissa = 0;
+  int num_digits = 0, num_fraction_digits = 0;
+  for (; ptr < end && isdigit((unsigned char)*ptr); ++ptr, ++num_digits) {
+    if (num_digits >= 16) return NULL;
+    mantissa = 10 * mantissa + (uint64_t)(*ptr - '0');
+  }
+  if (ptr < end && *ptr == '.') {
+    for (++ptr; ptr < end && isdigit((unsigned char)*ptr);
+         ++ptr, ++num_digits, ++num_fraction_digits) {
+      if (num_digits >= 16) return NULL;
+      mantissa = 10 * mantissa + (uint64_t)(*ptr - '0');
+    }
+  }
+  if (num_digits == 0 || mantissa > (UINT64_C(1) << 53) ||
+      num_fraction_digits >= AZ_ARRAY_SIZE(powers_of_ten)) return NULL;
+  // Exponents, hex floats, and the like go through strtod.
+  if (ptr < end && (isalnum((unsigned char)*ptr) || *ptr == '.')) {
+    return NULL;
+  }
+  const double value =
+    (double)mantissa / powers_of_ten[num_fraction_digits];
+  *value_out = (negative ? -value : value);
+  return ptr;
+}
+
+// Like fast_scan_double, but for a decimal int with at most nine digits.
+static const char *fast_scan_int(const char *ptr, const char *end,
+                                 int *value_out) {
+  bool negative = false;
+  if (ptr < end && (*ptr == '-' || *ptr == '+')) negative = (*ptr++ == '-');
+  int value = 0, num_digits = 0;
+  for (; ptr < end && isdigit((unsigned char)*ptr); ++ptr, ++num_digits) {
+    if (num_digits >= 9) return NULL;
+    value = 10 * value + (*ptr - '0');
+  }
+  if (num_digits == 0) return NULL;
+  *value_out = (negative ? -value : value);
+  return ptr;
+}
+
+// Parse the character set of a %[...] conversion, starting just after the
+// '[', and return a pointer to the closing ']'.
+static const char *parse_char_set(const char *format,
+                                  bool set_out[UCHAR_MAX + 1]) {
+  assert(*format != '^' && *format != ']');
+  for (; *format != ']'; ++format) {
+    assert(*format != '\0');
+    if (format[1] == '-' && format[2] != ']' && format[2] != '\0') {
+      for (int ch = (unsigned char)format[0];
+           ch <= (unsigned char)format[2]; ++ch) {
+        set_out[ch] = true;
+      }
+      format += 2;
+    } else set_out[(unsigned char)*format] = true;
+  }
+  return format;
+}
+
+int az_scan(az_scanner_t *scanner, const char *format, ...) {
+  assert(scanner != NULL);
+  assert(format != NULL);
+  va_list args;
+  va_start(args, format);
+  const char *start = scanner->ptr;
+  int num_assigned = 0;
+  bool input_failure = false;
+  for (const char *fmt = format; *fmt != '\0'; ++fmt) {
+    // Whitespace in the format matches any amount of whitespace (even none).
+    if (isspace((unsigned char)*fmt)) {
+      skip_space(scanner);
+      continue;
+    }
+    // Any other non-conversion character must be matched exactly.
+    if (*fmt != '%') {
+      if (scanner->ptr >= scanner->end) {
+        input_failure = true;
+        break;
+      }
+      if (*scanner->ptr != *fmt) break;
+      ++scanner->ptr;
+      continue;
+    }
+    ++fmt;
+    int width = 0;
+    while (isdigit((unsigned char)*fmt)) width = 10 * width + (*fmt++ - '0');
+    if (*fmt == 'n') {
+      *va_arg(args, int*) = (int)(scanner->ptr - start);
+      continue;
+    }
+    if (*fmt == 'c') {
+      assert(width == 0);
+      if (scanner->ptr >= scanner->end) {
+        input_failure = true;
+        break;
+      }
+      *va_arg(args, char*) = *(scanner->ptr++);
+      ++num_assigned;
+      continue;
+    }
+    if (*fmt == '[') {
+      assert(width > 0);
+      bool set[UCHAR_MAX + 1] = {false};
+      fmt = parse_char_set(fmt + 1, set);
+      char *string = va_arg(args, char*);
+      int length = 0;
+      while (length < width && scanner->ptr < scanner->end &&
+             set[(unsigned char)*scanner->ptr]) {
+        string[length++] = *(scanner->ptr++);
+      }
+      if (length == 0) {
+        input_failure = (scanner->ptr >= scanner->end);
+        break;
+      }
+      string[length] = '\0';
+      ++num_assigned;
+      continue;
+    }
+    // Numeric conversions skip leading whitespace.
+    assert(width == 0);
+    skip_space(scanner);
+    if (scanner->ptr >= scanner->end) {
+      input_failure = true;
+      break;
+    }
+    if (*fmt == 'd') {
+      int value;
+      const char *number_end =
+        fast_scan_int(scanner->ptr, scanner->end, &value);
+      if (number_end != NULL) {
+        *va_arg(args, int*) = value;
+        scanner->ptr = number_end;
+        ++num_assigned;
+        continue;
+      }
+    } else if (*fmt == 'l') {
+      double value;
+      const char *number_end =
+        fast_scan_double(scanner->ptr, scanner->end, &value);
+      if (number_end != NULL) {
+        *va_arg(args, double*) = value;
+        scanner->ptr = number_end;
+        ++fmt;
+        ++num_assigned;
+        continue;
+      }
+    }
+    char buffer[AZ_MAX_NUMBER_LENGTH + 1];
+    copy_number_token(scanner, buffer);
+    char *number_end = buffer;
+    if (*fmt == 'd') {
+      const long value = strtol(buffer, &number_end, 10);
+      if (number_end == buffer) break;
+      *va_arg(args, int*) = (int)value;
+    } else if (*fmt == 'u') {
+      const unsigned long value = strtoul(buffer, &number_end, 10);
+      if (number_end == buffer) break;
+      *va_arg(args, unsigned int*) = (unsigned int)value;
+    } else {
+      assert(fmt[0] == 'l' && fmt[1] == 'f');
+      ++fmt;
+      const double value = strtod(buffer, &number_end);
+      if (number_end == buffer) break;
+      *va_arg(args, double*) = value;
+    }
+    scanner->ptr += number_end - buffer;
+    ++num_assigned;
+  }
+  va_end(args);
+  return (input_failure && num_assigned == 0 ? EOF : num_assigned);
+}
+
+/*===========================================================================*/
@@ -0,0 +1,62 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+#pragma once
+#ifndef AZIMUTH_UTIL_SCAN_H_
+#define AZIMUTH_UTIL_SCAN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h> // for EOF
+
+/*===========================================================================*/
+
+// A read cursor over a text buffer that is already in memory (e.g. from
+// az_read_file).  Scanning never copies or modifies the underlying buffer,
+// which must outlive the scanner.
+typedef struct {
+  const char *ptr; // the next character to be read
+  const char *end; // one past the last character of the buffer
+} az_scanner_t;
+
+void az_init_scanner(az_scanner_t *scanner, const char *data, size_t size);
+
+// Return the next character (as an unsigned char) and advance past it, or
+// return EOF if there are no more characters.
+int az_scan_getc(az_scanner_t *scanner);
+
+// Return the next character (as an unsigned char) without advancing, or return
+// EOF if there are no more characters.
+int az_scan_peek(const az_scanner_t *scanner);
+
+// If the next character is ch, advance past it and return true; otherwise
+// return false without advancing.
+bool az_scan_try_char(az_scanner_t *scanner, char ch);
+
+// Behaves like fscanf, but reads from the scanner.  Only the subset of
+// fscanf's format language used by our data files is supported: whitespace,
+// literal characters, and the %d, %u, %lf, %c, %n, and %N[...] conversions
+// (with no flags or modifiers other than those shown, and no negated sets).
+// Returns the number of conversions assigned, or EOF if the input ran out
+// before the first conversion.
+int az_scan(az_scanner_t *scanner, const char *format, ...)
+  __attribute__((__format__(__scanf__,2,3)));
+
+/*===========================================================================*/
+
+#endif // AZIMUTH_UTIL_SCAN_H_
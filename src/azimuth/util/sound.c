@@ -21,7 +21,9 @@
 
 #include <assert.h>
 #include <math.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -65,188 +67,183 @@
 // Many thanks to DrPetter for developing sfxr, and for releasing it as Free
 // Software.
 
-static struct {
-  int phase;
-  double fperiod, fmaxperiod, fslide, fdslide;
-  int period;
-  float square_duty, square_slide;
-  int env_stage;
-  int env_time;
-  int env_length[3];
-  float env_vol;
-  float fphase, fdphase;
-  int iphase;
-  float phaser_buffer[1024];
-  int ipp;
-  float noise_buffer[32];
-  float fltp, fltdp, fltw, fltw_d;
-  float fltdmp, fltphp, flthp, flthp_d;
-  float vib_phase, vib_speed, vib_amp;
-  int rep_time, rep_limit;
-  int arp_time, arp_limit;
-  double arp_mod;
-  size_t num_samples;
-  int16_t samples[128 * 1024];
-} synth;
-
-// Fill each entry in synth.noise_buffer with a random float from -1 to 1.
-static void refill_noise_buffer(void) {
+// Fill each entry in synth->noise_buffer with a random float from -1 to 1.
+static void refill_noise_buffer(az_sound_synth_t *synth) {
   // Xorshift RNG (see http://en.wikipedia.org/wiki/Xorshift)
-  static uint32_t x = 123456789;
-  static uint32_t y = 362436069;
-  static uint32_t z = 521288629;
-  static uint32_t w = 88675123;
+  uint32_t x = synth->noise_state[0];
+  uint32_t y = synth->noise_state[1];
+  uint32_t z = synth->noise_state[2];
+  uint32_t w = synth->noise_state[3];
   for (int i = 0; i < 32; ++i) {
     const uint32_t t = x ^ (x << 11);
     x = y; y = z; z = w;
     w = w ^ (w >> 19) ^ t ^ (t >> 8);
-    synth.noise_buffer[i] = (w * 4.656612874161595e-10) - 1.0;
+    synth->noise_buffer[i] = (w * 4.656612874161595e-10) - 1.0;
   }
+  synth->noise_state[0] = x;
+  synth->noise_state[1] = y;
+  synth->noise_state[2] = z;
+  synth->noise_state[3] = w;
 }
 
 // Reset the sfxr synth.  This code is taken directly from sfxr, with only
 // minor changes.
-static void reset_synth(const az_sound_spec_t *spec, bool restart) {
-  if (!restart) synth.phase = 0;
-  synth.fperiod = 100.0 / (spec->start_freq * spec->start_freq + 0.001);
-  synth.period = (int)synth.fperiod;
-  synth.fmaxperiod = 100.0 / (spec->freq_limit * spec->freq_limit + 0.001);
-  synth.fslide = 1.0 - pow(spec->freq_slide, 3.0) * 0.01;
-  synth.fdslide = -pow(spec->freq_delta_slide, 3.0) * 0.000001;
-  synth.square_duty = 0.5f - spec->square_duty * 0.5f;
-  synth.square_slide = -spec->duty_sweep * 0.00005f;
+static void reset_synth(az_sound_synth_t *synth, bool restart) {
+  const az_sound_spec_t *spec = &synth->spec;
+  if (!restart) synth->phase = 0;
+  synth->fperiod = 100.0 / (spec->start_freq * spec->start_freq + 0.001);
+  synth->period = (int)synth->fperiod;
+  synth->fmaxperiod = 100.0 / (spec->freq_limit * spec->freq_limit + 0.001);
+  synth->fslide = 1.0 - pow(spec->freq_slide, 3.0) * 0.01;
+  synth->fdslide = -pow(spec->freq_delta_slide, 3.0) * 0.000001;
+  synth->square_duty = 0.5f - spec->square_duty * 0.5f;
+  synth->square_slide = -spec->duty_sweep * 0.00005f;
   if (spec->arp_mod >= 0.0f) {
-    synth.arp_mod = 1.0 - pow(spec->arp_mod, 2.0) * 0.9;
+    synth->arp_mod = 1.0 - pow(spec->arp_mod, 2.0) * 0.9;
   } else {
-    synth.arp_mod = 1.0 + pow(spec->arp_mod, 2.0) * 10.0;
+    synth->arp_mod = 1.0 + pow(spec->arp_mod, 2.0) * 10.0;
   }
-  synth.arp_time = 0;
-  synth.arp_limit = (int)(pow(1.0 - spec->arp_speed, 2.0) * 20000 + 32);
-  if (spec->arp_speed == 1.0f) synth.arp_limit = 0;
+  synth->arp_time = 0;
+  synth->arp_limit = (int)(pow(1.0 - spec->arp_speed, 2.0) * 20000 + 32);
+  if (spec->arp_speed == 1.0f) synth->arp_limit = 0;
   if (!restart) {
     // Reset filter:
-    synth.fltp = 0.0f;
-    synth.fltdp = 0.0f;
-    synth.fltw = pow(1.0 - spec->lpf_cutoff, 3.0) * 0.1f;
-    synth.fltw_d = 1.0f + spec->lpf_ramp * 0.0001f;
-    synth.fltdmp = 5.0f / (1.0f + pow(spec->lpf_resonance, 2.0) * 20.0f) *
-      (0.01f + synth.fltw);
-    if (synth.fltdmp > 0.8f) synth.fltdmp = 0.8f;
-    synth.fltphp = 0.0f;
-    synth.flthp = pow(spec->hpf_cutoff, 2.0) * 0.1f;
-    synth.flthp_d = 1.0 + spec->hpf_ramp * 0.0003f;
+    synth->fltp = 0.0f;
+    synth->fltdp = 0.0f;
+    synth->fltw = pow(1.0 - spec->lpf_cutoff, 3.0) * 0.1f;
+    synth->fltw_d = 1.0f + spec->lpf_ramp * 0.0001f;
+    synth->fltdmp = 5.0f / (1.0f + pow(spec->lpf_resonance, 2.0) * 20.0f) *
+      (0.01f + synth->fltw);
+    if (synth->fltdmp > 0.8f) synth->fltdmp = 0.8f;
+    synth->fltphp = 0.0f;
+    synth->flthp = pow(spec->hpf_cutoff, 2.0) * 0.1f;
+    synth->flthp_d = 1.0 + spec->hpf_ramp * 0.0003f;
     // Reset vibrato:
-    synth.vib_phase = 0.0f;
-    synth.vib_speed = pow(spec->vibrato_speed, 2.0) * 0.01f;
-    synth.vib_amp = spec->vibrato_depth * 0.5f;
+    synth->vib_phase = 0.0f;
+    synth->vib_speed = pow(spec->vibrato_speed, 2.0) * 0.01f;
+    synth->vib_amp = spec->vibrato_depth * 0.5f;
     // Reset envelope:
-    synth.env_vol = 0.0f;
-    synth.env_stage = 0;
-    synth.env_time = 0;
-    synth.env_length[0] =
+    synth->env_vol = 0.0f;
+    synth->env_stage = 0;
+    synth->env_time = 0;
+    synth->env_length[0] =
       (int)(spec->env_attack * spec->env_attack * 100000.0f);
-    synth.env_length[1] =
+    synth->env_length[1] =
       (int)(spec->env_sustain * spec->env_sustain * 100000.0f);
-    synth.env_length[2] =
+    synth->env_length[2] =
       (int)(spec->env_decay * spec->env_decay * 100000.0f);
     // Reset phaser:
-    synth.fphase = pow(spec->phaser_offset, 2.0) * 1020.0f;
-    if (spec->phaser_offset < 0.0f) synth.fphase = -synth.fphase;
-    synth.fdphase = pow(spec->phaser_sweep, 2.0);
-    if (spec->phaser_sweep < 0.0f) synth.fdphase = -synth.fdphase;
-    synth.iphase = abs((int)synth.fphase);
-    synth.ipp = 0;
-    AZ_ZERO_ARRAY(synth.phaser_buffer);
+    synth->fphase = pow(spec->phaser_offset, 2.0) * 1020.0f;
+    if (spec->phaser_offset < 0.0f) synth->fphase = -synth->fphase;
+    synth->fdphase = pow(spec->phaser_sweep, 2.0);
+    if (spec->phaser_sweep < 0.0f) synth->fdphase = -synth->fdphase;
+    synth->iphase = abs((int)synth->fphase);
+    synth->ipp = 0;
+    AZ_ZERO_ARRAY(synth->phaser_buffer);
     // Refill noise buffer:
-    refill_noise_buffer();
+    refill_noise_buffer(synth);
     // Reset repeat:
-    synth.rep_time = 0;
-    synth.rep_limit =
+    synth->rep_time = 0;
+    synth->rep_limit =
       (int)(pow(1.0f - spec->repeat_speed, 2.0f) * 20000 + 32);
-    if (spec->repeat_speed == 0.0f) synth.rep_limit = 0;
+    if (spec->repeat_speed == 0.0f) synth->rep_limit = 0;
   }
 }
 
-// Generate the given sound effect and populate the synth.samples array.
-// This code is taken directly from sfxr, with only minor changes.
-static void synth_sound(const az_sound_spec_t *spec) {
-  synth.num_samples = 0;
-  reset_synth(spec, false);
-  float filesample = 0.0f;
-  int fileacc = 0;
-  bool finished = false;
+void az_reset_sound_synth(az_sound_synth_t *synth,
+                          const az_sound_spec_t *spec) {
+  assert(synth != NULL);
+  assert(spec != NULL);
+  AZ_ZERO_OBJECT(synth);
+  synth->spec = *spec;
+  synth->noise_state[0] = 123456789;
+  synth->noise_state[1] = 362436069;
+  synth->noise_state[2] = 521288629;
+  synth->noise_state[3] = 88675123;
+  reset_synth(synth, false);
+}
 
-  while (synth.num_samples < AZ_ARRAY_SIZE(synth.samples) && !finished) {
-    ++synth.rep_time;
-    if (synth.rep_limit != 0 && synth.rep_time >= synth.rep_limit) {
-      synth.rep_time = 0;
-      reset_synth(spec, true);
+// Generate more of the sound effect.  This code is taken directly from sfxr,
+// with only minor changes.
+int az_synthesize_sound(az_sound_synth_t *synth, int16_t *samples,
+                        int num_samples) {
+  assert(synth != NULL);
+  assert(samples != NULL || num_samples == 0);
+  assert(num_samples >= 0);
+  const az_sound_spec_t *spec = &synth->spec;
+  int num_written = 0;
+  while (num_written < num_samples && !synth->finished) {
+    ++synth->rep_time;
+    if (synth->rep_limit != 0 && synth->rep_time >= synth->rep_limit) {
+      synth->rep_time = 0;
+      reset_synth(synth, true);
     }
 
     // frequency envelopes/arpeggios
-    ++synth.arp_time;
-    if (synth.arp_limit != 0 && synth.arp_time >= synth.arp_limit) {
-      synth.arp_limit = 0;
-      synth.fperiod *= synth.arp_mod;
+    ++synth->arp_time;
+    if (synth->arp_limit != 0 && synth->arp_time >= synth->arp_limit) {
+      synth->arp_limit = 0;
+      synth->fperiod *= synth->arp_mod;
     }
-    synth.fslide += synth.fdslide;
-    synth.fperiod *= synth.fslide;
-    if (synth.fperiod > synth.fmaxperiod) {
-      synth.fperiod = synth.fmaxperiod;
-      if (spec->freq_limit > 0.0f) finished = true;
+    synth->fslide += synth->fdslide;
+    synth->fperiod *= synth->fslide;
+    if (synth->fperiod > synth->fmaxperiod) {
+      synth->fperiod = synth->fmaxperiod;
+      if (spec->freq_limit > 0.0f) synth->finished = true;
     }
-    float rfperiod = synth.fperiod;
-    if (synth.vib_amp > 0.0f) {
-      synth.vib_phase += synth.vib_speed;
-      rfperiod = synth.fperiod * (1.0 + sin(synth.vib_phase) * synth.vib_amp);
+    float rfperiod = synth->fperiod;
+    if (synth->vib_amp > 0.0f) {
+      synth->vib_phase += synth->vib_speed;
+      rfperiod = synth->fperiod *
+        (1.0 + sin(synth->vib_phase) * synth->vib_amp);
     }
-    synth.period = (int)rfperiod;
-    if (synth.period < 8) synth.period = 8;
-    synth.square_duty += synth.square_slide;
-    if (synth.square_duty < 0.0f) synth.square_duty=0.0f;
-    if (synth.square_duty > 0.5f) synth.square_duty=0.5f;
+    synth->period = (int)rfperiod;
+    if (synth->period < 8) synth->period = 8;
+    synth->square_duty += synth->square_slide;
+    if (synth->square_duty < 0.0f) synth->square_duty=0.0f;
+    if (synth->square_duty > 0.5f) synth->square_duty=0.5f;
     // volume envelope
-    synth.env_time++;
-    if (synth.env_time > synth.env_length[synth.env_stage]) {
-      synth.env_time = 0;
-      ++synth.env_stage;
-      if (synth.env_stage == 3) finished = true;
+    synth->env_time++;
+    if (synth->env_time > synth->env_length[synth->env_stage]) {
+      synth->env_time = 0;
+      ++synth->env_stage;
+      if (synth->env_stage == 3) synth->finished = true;
     }
-    if (synth.env_stage == 0)
-      synth.env_vol = (float)synth.env_time / synth.env_length[0];
-    if (synth.env_stage == 1)
-      synth.env_vol = 1.0f +
-        pow(1.0f - (float)synth.env_time / synth.env_length[1], 1.0f) *
+    if (synth->env_stage == 0)
+      synth->env_vol = (float)synth->env_time / synth->env_length[0];
+    if (synth->env_stage == 1)
+      synth->env_vol = 1.0f +
+        pow(1.0f - (float)synth->env_time / synth->env_length[1], 1.0f) *
         2.0f * spec->env_punch;
-    if (synth.env_stage==2)
-      synth.env_vol = 1.0f - (float)synth.env_time / synth.env_length[2];
+    if (synth->env_stage==2)
+      synth->env_vol = 1.0f - (float)synth->env_time / synth->env_length[2];
 
     // phaser step
-    synth.fphase += synth.fdphase;
-    synth.iphase = abs((int)synth.fphase);
-    if (synth.iphase > 1023) synth.iphase = 1023;
+    synth->fphase += synth->fdphase;
+    synth->iphase = abs((int)synth->fphase);
+    if (synth->iphase > 1023) synth->iphase = 1023;
 
-    if (synth.flthp_d != 0.0f) {
-      synth.flthp *= synth.flthp_d;
-      if (synth.flthp < 0.00001f) synth.flthp=0.00001f;
-      if (synth.flthp > 0.1f) synth.flthp=0.1f;
+    if (synth->flthp_d != 0.0f) {
+      synth->flthp *= synth->flthp_d;
+      if (synth->flthp < 0.00001f) synth->flthp=0.00001f;
+      if (synth->flthp > 0.1f) synth->flthp=0.1f;
     }
 
     float ssample = 0.0f;
     for (int si = 0; si < 8; ++si) { // 8x supersampling
       float sample = 0.0f;
-      synth.phase++;
-      if (synth.phase >= synth.period) {
-        synth.phase %= synth.period;
+      synth->phase++;
+      if (synth->phase >= synth->period) {
+        synth->phase %= synth->period;
         if (spec->wave_kind == AZ_NOISE_WAVE) {
-          refill_noise_buffer();
+          refill_noise_buffer(synth);
         }
       }
       // base waveform
-      float fp = (float)synth.phase / synth.period;
+      float fp = (float)synth->phase / synth->period;
       switch (spec->wave_kind) {
         case AZ_NOISE_WAVE:
-          sample = synth.noise_buffer[synth.phase * 32 / synth.period];
+          sample = synth->noise_buffer[synth->phase * 32 / synth->period];
           break;
         case AZ_SAWTOOTH_WAVE:
           sample = 1.0f - fp * 2.0f;
@@ -255,7 +252,7 @@ static void synth_sound(const az_sound_spec_t *spec) {
           sample = (float)sin(fp * AZ_TWO_PI);
           break;
         case AZ_SQUARE_WAVE:
-          sample = (fp < synth.square_duty ? 0.5f : -0.5f);
+          sample = (fp < synth->square_duty ? 0.5f : -0.5f);
           break;
         case AZ_TRIANGLE_WAVE:
           sample = 4.0f * fabs(fp - 0.5f) - 1.0f;
@@ -266,28 +263,29 @@ static void synth_sound(const az_sound_spec_t *spec) {
           break;
       }
       // lp filter
-      float pp = synth.fltp;
-      synth.fltw *= synth.fltw_d;
-      if (synth.fltw < 0.0f) synth.fltw = 0.0f;
-      if (synth.fltw > 0.1f) synth.fltw = 0.1f;
+      float pp = synth->fltp;
+      synth->fltw *= synth->fltw_d;
+      if (synth->fltw < 0.0f) synth->fltw = 0.0f;
+      if (synth->fltw > 0.1f) synth->fltw = 0.1f;
       if (spec->lpf_cutoff != 0.0f) {
-        synth.fltdp += (sample - synth.fltp) * synth.fltw;
-        synth.fltdp -= synth.fltdp * synth.fltdmp;
+        synth->fltdp += (sample - synth->fltp) * synth->fltw;
+        synth->fltdp -= synth->fltdp * synth->fltdmp;
       } else {
-        synth.fltp = sample;
-        synth.fltdp = 0.0f;
+        synth->fltp = sample;
+        synth->fltdp = 0.0f;
       }
-      synth.fltp += synth.fltdp;
+      synth->fltp += synth->fltdp;
       // hp filter
-      synth.fltphp += synth.fltp - pp;
-      synth.fltphp -= synth.fltphp * synth.flthp;
-      sample = synth.fltphp;
+      synth->fltphp += synth->fltp - pp;
+      synth->fltphp -= synth->fltphp * synth->flthp;
+      sample = synth->fltphp;
       // phaser
-      synth.phaser_buffer[synth.ipp & 1023] = sample;
-      sample += synth.phaser_buffer[(synth.ipp - synth.iphase + 1024) & 1023];
-      synth.ipp = (synth.ipp + 1) & 1023;
+      synth->phaser_buffer[synth->ipp & 1023] = sample;
+      sample +=
+        synth->phaser_buffer[(synth->ipp - synth->iphase + 1024) & 1023];
+      synth->ipp = (synth->ipp + 1) & 1023;
       // final accumulation and envelope application
-      ssample += sample * synth.env_vol;
+      ssample += sample * synth->env_vol;
     }
     const float master_vol = 0.05f;
     ssample = ssample / 8 * master_vol;
@@ -297,15 +295,19 @@ static void synth_sound(const az_sound_spec_t *spec) {
     ssample *= 4.0f; // arbitrary gain to get reasonable output volume...
     if (ssample > 1.0f) ssample = 1.0f;
     if (ssample < -1.0f) ssample = -1.0f;
-    filesample += ssample;
-    ++fileacc;
-    if (fileacc == 2) {
-      filesample /= fileacc;
-      fileacc = 0;
-      synth.samples[synth.num_samples++] = (int16_t)(filesample * 32000);
-      filesample = 0.0f;
+    synth->filesample += ssample;
+    ++synth->fileacc;
+    if (synth->fileacc == 2) {
+      synth->filesample /= synth->fileacc;
+      synth->fileacc = 0;
+      samples[num_written++] = (int16_t)(synth->filesample * 32000);
+      synth->filesample = 0.0f;
+      if (++synth->num_samples >= AZ_MAX_SOUND_SAMPLES) {
+        synth->finished = true;
+      }
     }
   }
+  return num_written;
 }
 
 /*===========================================================================*/
@@ -313,16 +315,114 @@ static void synth_sound(const az_sound_spec_t *spec) {
 void az_create_sound_data(const az_sound_spec_t *spec, az_sound_data_t *data) {
   assert(spec != NULL);
   assert(data != NULL);
-  synth_sound(spec);
-  data->num_samples = synth.num_samples;
-  data->samples = AZ_ALLOC(synth.num_samples, int16_t);
-  memcpy(data->samples, synth.samples, synth.num_samples * sizeof(int16_t));
+  az_sound_synth_t synth;
+  az_reset_sound_synth(&synth, spec);
+  int16_t *samples = AZ_ALLOC(AZ_MAX_SOUND_SAMPLES, int16_t);
+  const int num_samples =
+    az_synthesize_sound(&synth, samples, AZ_MAX_SOUND_SAMPLES);
+  assert(synth.finished);
+  data->num_samples = num_samples;
+  data->samples = AZ_ALLOC(num_samples, int16_t);
+  memcpy(data->samples, samples, num_samples * sizeof(int16_t));
+  az_free(samples);
 }
 
 void az_destroy_sound_data(az_sound_data_t *data) {
   assert(data != NULL);
-  free(data->samples);
+  az_free(data->samples);
   AZ_ZERO_OBJECT(data);
 }
 
 /*===========================================================================*/
+// WAV output:
+
+static bool write_u16le(FILE *file, uint16_t value) {
+  return (fputc(value & 0xff, file) != EOF &&
+          fputc((value >> 8) & 0xff, file) != EOF);
+}
+
+static bool write_u32le(FILE *file, uint32_t value) {
+  return (write_u16le(file, value & 0xffff) &&
+          write_u16le(file, (value >> 16) & 0xffff));
+}
+
+static bool read_u16le(FILE *file, uint16_t *value_out) {
+  const int lo = fgetc(file);
+  const int hi = fgetc(file);
+  if (lo == EOF || hi == EOF) return false;
+  *value_out = (uint16_t)(lo | (hi << 8));
+  return true;
+}
+
+static bool read_u32le(FILE *file, uint32_t *value_out) {
+  uint16_t lo, hi;
+  if (!read_u16le(file, &lo) || !read_u16le(file, &hi)) return false;
+  *value_out = lo | ((uint32_t)hi << 16);
+  return true;
+}
+
+static bool read_tag(FILE *file, const char *tag) {
+  const size_t length = strlen(tag);
+  char buffer[8];
+  assert(length <= sizeof(buffer));
+  return (fread(buffer, 1, length, file) == length &&
+          memcmp(buffer, tag, length) == 0);
+}
+
+bool az_write_wav_file(FILE *file, const int16_t *samples,
+                       size_t num_samples) {
+  assert(file != NULL);
+  assert(samples != NULL || num_samples == 0);
+  const uint32_t data_size = num_samples * sizeof(int16_t);
+  if (!(fputs("RIFF", file) != EOF && write_u32le(file, 36 + data_size) &&
+        fputs("WAVEfmt ", file) != EOF &&
+        write_u32le(file, 16) && // fmt chunk size
+        write_u16le(file, 1) && // PCM format
+        write_u16le(file, 1) && // mono
+        write_u32le(file, AZ_AUDIO_RATE) &&
+        write_u32le(file, AZ_AUDIO_RATE * sizeof(int16_t)) && // bytes/sec
+        write_u16le(file, sizeof(int16_t)) && // block alignment
+        write_u16le(file, 16) && // bits per sample
+        fputs("data", file) != EOF && write_u32le(file, data_size))) {
+    return false;
+  }
+  for (size_t i = 0; i < num_samples; ++i) {
+    if (!write_u16le(file, (uint16_t)samples[i])) return false;
+  }
+  return true;
+}
+
+bool az_read_wav_file(FILE *file, int16_t **samples_out,
+                      size_t *num_samples_out) {
+  assert(file != NULL);
+  assert(samples_out != NULL);
+  assert(num_samples_out != NULL);
+  uint32_t riff_size, fmt_size, rate, byte_rate, data_size;
+  uint16_t format, channels, block_align, bits;
+  if (!(read_tag(file, "RIFF") && read_u32le(file, &riff_size) &&
+        read_tag(file, "WAVEfmt ") && read_u32le(file, &fmt_size) &&
+        read_u16le(file, &format) && read_u16le(file, &channels) &&
+        read_u32le(file, &rate) && read_u32le(file, &byte_rate) &&
+        read_u16le(file, &block_align) && read_u16le(file, &bits) &&
+        read_tag(file, "data") && read_u32le(file, &data_size))) {
+    return false;
+  }
+  if (fmt_size != 16 || format != 1 || channels != 1 ||
+      rate != AZ_AUDIO_RATE || bits != 16 ||
+      data_size % sizeof(int16_t) != 0) return false;
+  const size_t num_samples = data_size / sizeof(int16_t);
+  int16_t *samples = AZ_ALLOC(num_samples, int16_t);
+  for (size_t i = 0; i < num_samples; ++i) {
+    uint16_t sample;
+    if (!read_u16le(file, &sample)) {
+      az_free(samples);
+      return false;
+    }
+    samples[i] = (int16_t)sample;
+  }
+  *samples_out = samples;
+  *num_samples_out = num_samples;
+  return true;
+}
+
+/*===========================================================================*/
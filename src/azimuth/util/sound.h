@@ -21,8 +21,10 @@
 #ifndef AZIMUTH_UTIL_SOUND_H_
 #define AZIMUTH_UTIL_SOUND_H_
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 /*===========================================================================*/
 
@@ -57,10 +59,66 @@ typedef struct {
   int16_t *samples;
 } az_sound_data_t;
 
+// The most samples that a single sound effect can have (about six seconds):
+#define AZ_MAX_SOUND_SAMPLES (128 * 1024)
+
+// The state of a sound effect synthesizer, for generating a sound effect a
+// piece at a time.  Other than finished, the fields are private.
+typedef struct {
+  az_sound_spec_t spec;
+  int phase;
+  double fperiod, fmaxperiod, fslide, fdslide;
+  int period;
+  float square_duty, square_slide;
+  int env_stage;
+  int env_time;
+  int env_length[3];
+  float env_vol;
+  float fphase, fdphase;
+  int iphase;
+  float phaser_buffer[1024];
+  int ipp;
+  // Each synth has its own noise generator, so that its output depends only
+  // on its spec, and not on what other synths have generated.
+  uint32_t noise_state[4];
+  float noise_buffer[32];
+  float fltp, fltdp, fltw, fltw_d;
+  float fltdmp, fltphp, flthp, flthp_d;
+  float vib_phase, vib_speed, vib_amp;
+  int rep_time, rep_limit;
+  int arp_time, arp_limit;
+  double arp_mod;
+  float filesample;
+  int fileacc;
+  size_t num_samples; // total number of samples generated so far
+  bool finished; // true once the whole sound effect has been generated
+} az_sound_synth_t;
+
+void az_reset_sound_synth(az_sound_synth_t *synth,
+                          const az_sound_spec_t *spec);
+
+// Generate up to num_samples more samples of the sound effect, stopping early
+// if the sound effect finishes (which it always does within
+// AZ_MAX_SOUND_SAMPLES samples in total).  Returns the number of samples
+// written.
+int az_synthesize_sound(az_sound_synth_t *synth, int16_t *samples,
+                        int num_samples);
+
 void az_create_sound_data(const az_sound_spec_t *spec, az_sound_data_t *data);
 
 void az_destroy_sound_data(az_sound_data_t *data);
 
+// Write the samples to the file as a mono, 16-bit, AZ_AUDIO_RATE WAV file.
+// Returns true on success, or false on an I/O error.
+bool az_write_wav_file(FILE *file, const int16_t *samples, size_t num_samples);
+
+// Read samples from a WAV file in the format written by az_write_wav_file.
+// On success, sets *samples_out to a newly-allocated array of samples (which
+// the caller must free) and returns true.  Returns false on an I/O error or if
+// the file is in any other format.
+bool az_read_wav_file(FILE *file, int16_t **samples_out,
+                      size_t *num_samples_out);
+
 /*===========================================================================*/
 
 #endif // AZIMUTH_UTIL_SOUND_H_
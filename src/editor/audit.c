@@ -21,13 +21,19 @@
 
 #include <assert.h>
 #include <math.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "azimuth/state/planet.h"
+#include "azimuth/state/room.h"
 #include "azimuth/state/script.h"
 #include "azimuth/state/upgrade.h"
 #include "azimuth/util/misc.h"
+#include "azimuth/util/parallel.h"
+#include "azimuth/util/vector.h"
 
 /*===========================================================================*/
 
@@ -43,24 +49,9 @@ static int count_save_points(const az_room_t *room) {
   return num_save_points;
 }
 
-static int room_contains_upgrade(const az_room_t *room, az_upgrade_t upgrade) {
-  for (int i = 0; i < room->num_nodes; ++i) {
-    const az_node_spec_t *node = &room->nodes[i];
-    if (node->kind == AZ_NODE_UPGRADE &&
-        node->subkind.upgrade == upgrade) {
-      return true;
-    }
-  }
-  return false;
-}
-
-static bool room_has_door_to(const az_room_t *room, int dest_index) {
-  for (int i = 0; i < room->num_doors; ++i) {
-    const az_door_spec_t *door = &room->doors[i];
-    if (door->kind != AZ_DOOR_FORCEFIELD &&
-        door->destination == dest_index) {
-      return true;
-    }
+static bool room_has_exit_to(const az_audit_room_t *room, int dest_index) {
+  for (int i = 0; i < room->num_exits; ++i) {
+    if (room->exits[i] == dest_index) return true;
   }
   return false;
 }
@@ -86,23 +77,65 @@ static bool script_contains_instruction(const az_script_t *script,
 
 /*===========================================================================*/
 
-#define GENERAL_ERROR(...) do { \
-    printf("\x1b[31m"); \
-    printf(__VA_ARGS__); \
-    printf("\x1b[m\n"); \
-    ok = false; \
-  } while (0)
+static void clear_log(az_audit_log_t *log) {
+  log->num_errors = 0;
+  log->length = 0;
+  if (log->text != NULL) log->text[0] = '\0';
+}
+
+static void destroy_log(az_audit_log_t *log) {
+  az_free(log->text);
+  AZ_ZERO_OBJECT(log);
+}
+
+// Append a line to the log.
+static void add_error(az_audit_log_t *log, const char *format, ...)
+  __attribute__((__format__(__printf__,2,3)));
+
+static void add_error(az_audit_log_t *log, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  const int size = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+  assert(size >= 0);
+  const size_t needed = log->length + size + 2;
+  if (needed > log->capacity) {
+    const size_t new_capacity =
+      (needed > 2 * log->capacity ? needed : 2 * log->capacity);
+    char *new_text = AZ_ALLOC(new_capacity, char);
+    if (log->length > 0) memcpy(new_text, log->text, log->length);
+    az_free(log->text);
+    log->text = new_text;
+    log->capacity = new_capacity;
+  }
+  va_start(args, format);
+  vsnprintf(log->text + log->length, size + 1, format, args);
+  va_end(args);
+  log->length += size;
+  log->text[log->length++] = '\n';
+  log->text[log->length] = '\0';
+  ++log->num_errors;
+}
 
-#define ROOM_ERROR(...) do { \
-    printf("\x1b[31mRoom %d: ", room_index); \
-    printf(__VA_ARGS__); \
-    printf("\x1b[m\n"); \
-    ok = false; \
-  } while (0)
+static void print_log(const az_audit_log_t *log, int room_index) {
+  const char *line = log->text;
+  for (int i = 0; i < log->num_errors; ++i) {
+    const char *end = strchr(line, '\n');
+    assert(end != NULL);
+    if (room_index >= 0) {
+      printf("\x1b[31mRoom %d: %.*s\x1b[m\n", room_index, (int)(end - line),
+             line);
+    } else printf("\x1b[31m%.*s\x1b[m\n", (int)(end - line), line);
+    line = end + 1;
+  }
+}
 
-static bool audit_script(int room_index, const az_script_t *script) {
-  if (script == NULL) return true;
-  bool ok = true;
+/*===========================================================================*/
+
+#define ROOM_ERROR(...) add_error(log, __VA_ARGS__)
+
+static void audit_script(az_audit_log_t *log, const az_script_t *script) {
+  if (script == NULL) return;
   const bool has_dlog = script_contains_opcode(script, AZ_OP_DLOG);
   const bool has_mlog = script_contains_opcode(script, AZ_OP_MLOG);
   const bool has_skip1 = script_contains_instruction(script, AZ_OP_SKIP, 1);
@@ -124,186 +157,281 @@ static bool audit_script(int room_index, const az_script_t *script) {
   if (has_skip1 && !script_contains_instruction(script, AZ_OP_SKIP, 0)) {
     ROOM_ERROR("Script has skip1 instruction, but no skip0");
   }
-  return ok;
 }
 
-#define CHECK_SCRIPT(script) do { \
-    if (!audit_script(room_index, (script))) ok = false; \
-  } while (0)
-
-bool az_audit_scenario(const az_planet_t *planet) {
-  bool ok = audit_script(-1, planet->on_start);
-  bool upgrade_exists[AZ_NUM_UPGRADES] = {false};
-  for (int room_index = 0; room_index < planet->num_rooms; ++room_index) {
-    const az_room_t *room = &planet->rooms[room_index];
-    // Check background pattern.
-    if (room->background_pattern == AZ_BG_SOLID_BLACK) {
-      ROOM_ERROR("No background pattern");
+// Run all the checks that only need this one room, and record what the
+// cross-room checks need to know about it.  Called in parallel (see
+// az_parallel_for), so this must only touch the result for its own room.
+static void audit_room(const az_room_t *room, int room_index,
+                       az_audit_room_t *result) {
+  az_audit_log_t *log = &result->local_errors;
+  clear_log(log);
+  result->audited = true;
+  result->zone_key = room->zone_key;
+  result->sets_music = script_contains_opcode(room->on_start, AZ_OP_MUS);
+  result->num_exits = 0;
+  AZ_ZERO_OBJECT(&result->upgrades);
+  // Check background pattern.
+  if (room->background_pattern == AZ_BG_SOLID_BLACK) {
+    ROOM_ERROR("No background pattern");
+  }
+  // Check on_start script.
+  audit_script(log, room->on_start);
+  // Check save points.
+  const int num_save_points = count_save_points(room);
+  if (num_save_points > 1) ROOM_ERROR("Multiple save points");
+  if (num_save_points > 0) {
+    if (!script_contains_instruction(room->on_start, AZ_OP_MSG, 0)) {
+      ROOM_ERROR("Save point without msg0");
     }
-    // Check on_start script.
-    CHECK_SCRIPT(room->on_start);
-    // Check save points.
-    const int num_save_points = count_save_points(room);
-    if (num_save_points > 1) ROOM_ERROR("Multiple save points");
-    if (num_save_points > 0) {
-      if (!script_contains_instruction(room->on_start, AZ_OP_MSG, 0)) {
-        ROOM_ERROR("Save point without msg0");
-      }
-      if (!script_contains_opcode(room->on_start, AZ_OP_MUS)) {
-        ROOM_ERROR("Save point without music");
+    if (!result->sets_music) ROOM_ERROR("Save point without music");
+  }
+  // Check for duplicate walls.
+  for (int i = 0; i < room->num_walls; ++i) {
+    const az_wall_spec_t *wall = &room->walls[i];
+    for (int j = i + 1; j < room->num_walls; ++j) {
+      const az_wall_spec_t *other_wall = &room->walls[j];
+      if (other_wall->data == wall->data &&
+          az_vwithin(other_wall->position, wall->position, 10.0) &&
+          fabs(az_mod2pi(other_wall->angle - wall->angle)) < AZ_DEG2RAD(1)) {
+        ROOM_ERROR("Duplicate wall at (%.02f, %.02f)",
+                   wall->position.x, wall->position.y);
       }
     }
-    // Check for duplicate walls.
-    for (int i = 0; i < room->num_walls; ++i) {
-      const az_wall_spec_t *wall = &room->walls[i];
-      for (int j = i + 1; j < room->num_walls; ++j) {
-        const az_wall_spec_t *other_wall = &room->walls[j];
-        if (other_wall->data == wall->data &&
-            az_vwithin(other_wall->position, wall->position, 10.0) &&
-            fabs(az_mod2pi(other_wall->angle - wall->angle)) < AZ_DEG2RAD(1)) {
-          ROOM_ERROR("Duplicate wall at (%.02f, %.02f)",
-                     wall->position.x, wall->position.y);
-        }
+  }
+  // Check for duplicate fake-wall nodes.
+  for (int i = 0; i < room->num_nodes; ++i) {
+    const az_node_spec_t *node = &room->nodes[i];
+    if (node->kind != AZ_NODE_FAKE_WALL_FG &&
+        node->kind != AZ_NODE_FAKE_WALL_BG) continue;
+    for (int j = i + 1; j < room->num_nodes; ++j) {
+      const az_node_spec_t *other_node = &room->nodes[j];
+      if (other_node->kind == node->kind &&
+          other_node->subkind.fake_wall == node->subkind.fake_wall &&
+          az_vwithin(other_node->position, node->position, 10.0) &&
+          fabs(az_mod2pi(other_node->angle - node->angle)) < AZ_DEG2RAD(1)) {
+        ROOM_ERROR("Duplicate node at (%.02f, %.02f)",
+                   node->position.x, node->position.y);
       }
     }
-    // Check for duplicate fake-wall nodes.
-    for (int i = 0; i < room->num_nodes; ++i) {
-      const az_node_spec_t *node = &room->nodes[i];
-      if (node->kind != AZ_NODE_FAKE_WALL_FG &&
-          node->kind != AZ_NODE_FAKE_WALL_BG) continue;
-      for (int j = i + 1; j < room->num_nodes; ++j) {
-        const az_node_spec_t *other_node = &room->nodes[j];
-        if (other_node->kind == node->kind &&
-            other_node->subkind.fake_wall == node->subkind.fake_wall &&
-            az_vwithin(other_node->position, node->position, 10.0) &&
-            fabs(az_mod2pi(other_node->angle - node->angle)) < AZ_DEG2RAD(1)) {
-          ROOM_ERROR("Duplicate node at (%.02f, %.02f)",
-                     node->position.x, node->position.y);
-        }
+  }
+  // Check baddies.
+  for (int i = 0; i < room->num_baddies; ++i) {
+    const az_baddie_spec_t *baddie = &room->baddies[i];
+    // Check on_kill script.
+    audit_script(log, baddie->on_kill);
+  }
+  // Check doors.
+  for (int i = 0; i < room->num_doors; ++i) {
+    const az_door_spec_t *door = &room->doors[i];
+    // Check that forcefield doors don't have scripts.
+    if (door->kind == AZ_DOOR_FORCEFIELD) {
+      if (door->on_open != NULL) {
+        ROOM_ERROR("Forcefield door with an on_open script");
       }
+      continue;
     }
-    // Check baddies.
-    for (int i = 0; i < room->num_baddies; ++i) {
-      const az_baddie_spec_t *baddie = &room->baddies[i];
-      // Check on_kill script.
-      CHECK_SCRIPT(baddie->on_kill);
+    // Check on_open script.
+    audit_script(log, door->on_open);
+    // Check that door destination is legitimate.
+    if (door->destination == room_index) {
+      ROOM_ERROR("Door at (%.02f, %.02f) leads to itself",
+                 door->position.x, door->position.y);
+      continue;
     }
-    // Check doors.
-    for (int i = 0; i < room->num_doors; ++i) {
-      const az_door_spec_t *door = &room->doors[i];
-      // Check that forcefield doors don't have scripts.
-      if (door->kind == AZ_DOOR_FORCEFIELD) {
-        if (door->on_open != NULL) {
-          ROOM_ERROR("Forcefield door with an on_open script");
+    // The cross-room checks will check the destination room.
+    assert(result->num_exits < AZ_ARRAY_SIZE(result->exits));
+    result->exits[result->num_exits++] = door->destination;
+    if (door->kind == AZ_DOOR_ROCKET || door->kind == AZ_DOOR_HYPER_ROCKET ||
+        door->kind == AZ_DOOR_BOMB || door->kind == AZ_DOOR_MEGA_BOMB) {
+      // Check that each ordnance door has a UUID.
+      if (door->uuid_slot == 0) {
+        ROOM_ERROR("Door at (%.02f, %.02f) doesn't have a UUID",
+                   door->position.x, door->position.y);
+      } else {
+        // Check that opening an ordnance door sets a flag.
+        if (!script_contains_opcode(door->on_open, AZ_OP_SET)) {
+          ROOM_ERROR("Door with UUID %d doesn't set a flag when opened",
+                     door->uuid_slot);
+        }
+        // Check that on_start script can unlock the door.
+        if (!script_contains_instruction(room->on_start, AZ_OP_UNLOCK,
+                                         door->uuid_slot)) {
+          ROOM_ERROR("Door with UUID %d doesn't get unlocked by on_start",
+                     door->uuid_slot);
         }
-        continue;
       }
-      // Check on_open script.
-      CHECK_SCRIPT(door->on_open);
-      // Check that door destination is legitimate.
-      if (door->destination == room_index) {
-        ROOM_ERROR("Door at (%.02f, %.02f) leads to itself",
-                   door->position.x, door->position.y);
-        continue;
+    }
+  }
+  // Check gravfields.
+  for (int i = 0; i < room->num_gravfields; ++i) {
+    const az_gravfield_spec_t *gravfield = &room->gravfields[i];
+    // Check on_enter script.
+    audit_script(log, gravfield->on_enter);
+    // Check that liquids are vertical.
+    if (az_is_liquid(gravfield->kind)) {
+      const double expected_angle =
+        (az_vdot(az_vpolar(1, gravfield->angle), gravfield->position) >= 0 ?
+         az_vtheta(gravfield->position) :
+         az_vtheta(az_vneg(gravfield->position)));
+      if (fabs(az_mod2pi(gravfield->angle - expected_angle)) > 0.00001) {
+        ROOM_ERROR("Liquid at (%.02f, %.02f) not vertical",
+                   gravfield->position.x, gravfield->position.y);
+      }
+    }
+  }
+  // Check nodes.
+  for (int i = 0; i < room->num_nodes; ++i) {
+    const az_node_spec_t *node = &room->nodes[i];
+    // Check the node's on_use script.
+    if (node->kind == AZ_NODE_CONSOLE || node->kind == AZ_NODE_UPGRADE) {
+      audit_script(log, node->on_use);
+    } else if (node->on_use != NULL) {
+      ROOM_ERROR("Node kind %d with an on_use script", (int)node->kind);
+    }
+    // Check that comm consoles have dialogue.
+    if (node->kind == AZ_NODE_CONSOLE &&
+        node->subkind.console == AZ_CONS_COMM &&
+        !script_contains_opcode(node->on_use, AZ_OP_DLOG)) {
+      ROOM_ERROR("Comm console without dialogue");
+    }
+    // Check upgrades.
+    if (node->kind == AZ_NODE_UPGRADE) {
+      const az_upgrade_t upgrade = node->subkind.upgrade;
+      assert((int)upgrade >= 0 && upgrade < AZ_NUM_UPGRADES);
+      // The cross-room checks will check for duplicate upgrades.
+      az_upgrades_add(&result->upgrades, upgrade);
+      // Check that getting the upgrade plays mus14 or snd5.
+      if (!script_contains_instruction(node->on_use, AZ_OP_MUS, 14) &&
+          !script_contains_instruction(node->on_use, AZ_OP_SND, 5)) {
+        ROOM_ERROR("Upgrade #%d (%s) doesn't play mus14 or snd5",
+                   (int)upgrade, az_upgrade_name(upgrade));
       }
+    }
+  }
+}
+
+// Run the checks that involve more than one room, using the summaries that
+// audit_room recorded for each room.
+static void audit_cross_room(az_audit_t *audit) {
+  for (int room_index = 0; room_index < audit->num_rooms; ++room_index) {
+    az_audit_room_t *room = &audit->rooms[room_index];
+    assert(room->audited);
+    az_audit_log_t *log = &room->cross_errors;
+    clear_log(log);
+    for (int i = 0; i < room->num_exits; ++i) {
       // Check that destination room has a door leading back here.
-      const int dest_index = door->destination;
+      const int dest_index = room->exits[i];
       assert(dest_index >= 0);
-      assert(dest_index < planet->num_rooms);
-      const az_room_t *dest_room = &planet->rooms[door->destination];
-      if (!room_has_door_to(dest_room, room_index)) {
+      assert(dest_index < audit->num_rooms);
+      const az_audit_room_t *dest_room = &audit->rooms[dest_index];
+      if (!room_has_exit_to(dest_room, room_index)) {
         ROOM_ERROR("Door to room %d doesn't have an exit", dest_index);
       }
       // Check that if this room is next to another zone, it sets the music.
-      if (dest_room->zone_key != room->zone_key &&
-          !script_contains_opcode(room->on_start, AZ_OP_MUS)) {
+      if (dest_room->zone_key != room->zone_key && !room->sets_music) {
         ROOM_ERROR("Next to another zone, but doesn't set music");
       }
-      if (door->kind == AZ_DOOR_ROCKET || door->kind == AZ_DOOR_HYPER_ROCKET ||
-          door->kind == AZ_DOOR_BOMB || door->kind == AZ_DOOR_MEGA_BOMB) {
-        // Check that each ordnance door has a UUID.
-        if (door->uuid_slot == 0) {
-          ROOM_ERROR("Door at (%.02f, %.02f) doesn't have a UUID",
-                     door->position.x, door->position.y);
-        } else {
-          // Check that opening an ordnance door sets a flag.
-          if (!script_contains_opcode(door->on_open, AZ_OP_SET)) {
-            ROOM_ERROR("Door with UUID %d doesn't set a flag when opened",
-                       door->uuid_slot);
-          }
-          // Check that on_start script can unlock the door.
-          if (!script_contains_instruction(room->on_start, AZ_OP_UNLOCK,
-                                           door->uuid_slot)) {
-            ROOM_ERROR("Door with UUID %d doesn't get unlocked by on_start",
-                       door->uuid_slot);
-          }
-        }
-      }
     }
-    // Check gravfields.
-    for (int i = 0; i < room->num_gravfields; ++i) {
-      const az_gravfield_spec_t *gravfield = &room->gravfields[i];
-      // Check on_enter script.
-      CHECK_SCRIPT(gravfield->on_enter);
-      // Check that liquids are vertical.
-      if (az_is_liquid(gravfield->kind)) {
-        const double expected_angle =
-          (az_vdot(az_vpolar(1, gravfield->angle), gravfield->position) >= 0 ?
-           az_vtheta(gravfield->position) :
-           az_vtheta(az_vneg(gravfield->position)));
-        if (fabs(az_mod2pi(gravfield->angle - expected_angle)) > 0.00001) {
-          ROOM_ERROR("Liquid at (%.02f, %.02f) not vertical",
-                     gravfield->position.x, gravfield->position.y);
+  }
+  // Check for duplicate upgrades, and that all upgrades exist.
+  for (int i = 0; i < AZ_NUM_UPGRADES; ++i) {
+    const az_upgrade_t upgrade = (az_upgrade_t)i;
+    bool exists = false;
+    for (int room_index = 0; room_index < audit->num_rooms; ++room_index) {
+      az_audit_room_t *room = &audit->rooms[room_index];
+      if (!az_upgrades_have(&room->upgrades, upgrade)) continue;
+      exists = true;
+      az_audit_log_t *log = &room->cross_errors;
+      for (int other_room_index = room_index + 1;
+           other_room_index < audit->num_rooms; ++other_room_index) {
+        if (az_upgrades_have(&audit->rooms[other_room_index].upgrades,
+                             upgrade)) {
+          ROOM_ERROR("Upgrade #%d (%s) also appears in room %d",
+                     i, az_upgrade_name(upgrade), other_room_index);
         }
       }
     }
-    // Check nodes.
-    for (int i = 0; i < room->num_nodes; ++i) {
-      const az_node_spec_t *node = &room->nodes[i];
-      // Check the node's on_use script.
-      if (node->kind == AZ_NODE_CONSOLE || node->kind == AZ_NODE_UPGRADE) {
-        CHECK_SCRIPT(node->on_use);
-      } else if (node->on_use != NULL) {
-        ROOM_ERROR("Node kind %d with an on_use script", (int)node->kind);
-      }
-      // Check that comm consoles have dialogue.
-      if (node->kind == AZ_NODE_CONSOLE &&
-          node->subkind.console == AZ_CONS_COMM &&
-          !script_contains_opcode(node->on_use, AZ_OP_DLOG)) {
-        ROOM_ERROR("Comm console without dialogue");
-      }
-      // Check upgrades.
-      if (node->kind == AZ_NODE_UPGRADE) {
-        const az_upgrade_t upgrade = node->subkind.upgrade;
-        assert((int)upgrade >= 0 && upgrade < AZ_ARRAY_SIZE(upgrade_exists));
-        upgrade_exists[upgrade] = true;
-        // Check that getting the upgrade plays mus14 or snd5.
-        if (!script_contains_instruction(node->on_use, AZ_OP_MUS, 14) &&
-            !script_contains_instruction(node->on_use, AZ_OP_SND, 5)) {
-          ROOM_ERROR("Upgrade #%d (%s) doesn't play mus14 or snd5",
-                     (int)upgrade, az_upgrade_name(upgrade));
-        }
-        // Check for duplicate upgrades.
-        for (int other_room_index = room_index + 1;
-             other_room_index < planet->num_rooms; ++other_room_index) {
-          const az_room_t *other_room = &planet->rooms[other_room_index];
-          if (room_contains_upgrade(other_room, upgrade)) {
-            ROOM_ERROR("Upgrade #%d (%s) also appears in room %d",
-                       (int)upgrade, az_upgrade_name(upgrade),
-                       other_room_index);
-          }
-        }
-      }
+    if (!exists) {
+      add_error(&audit->general_errors, "Missing upgrade #%d (%s)", i,
+                az_upgrade_name(upgrade));
     }
   }
-  // Check that all upgrades exist.
-  for (int i = 0; i < AZ_ARRAY_SIZE(upgrade_exists); ++i) {
-    if (!upgrade_exists[i]) {
-      GENERAL_ERROR("Missing upgrade #%d (%s)", i,
-                    az_upgrade_name((az_upgrade_t)i));
+}
+
+#undef ROOM_ERROR
+
+/*===========================================================================*/
+
+void az_init_audit(az_audit_t *audit) {
+  AZ_ZERO_OBJECT(audit);
+}
+
+typedef struct {
+  az_audit_t *audit;
+  const az_room_key_t *keys;
+  const az_room_t *rooms;
+} az_audit_job_t;
+
+static void audit_room_at_index(void *data, int index) {
+  const az_audit_job_t *job = data;
+  const az_room_key_t key = job->keys[index];
+  assert(key >= 0 && key < job->audit->num_rooms);
+  audit_room(&job->rooms[index], key, &job->audit->rooms[key]);
+}
+
+void az_update_audit(az_audit_t *audit, const az_script_t *planet_on_start,
+                     int num_rooms, int num_changed,
+                     const az_room_key_t *keys, const az_room_t *rooms) {
+  assert(num_rooms >= 0);
+  assert(num_changed >= 0);
+  // Resize the cache to fit the planet.
+  for (int i = num_rooms; i < audit->num_rooms; ++i) {
+    destroy_log(&audit->rooms[i].local_errors);
+    destroy_log(&audit->rooms[i].cross_errors);
+  }
+  if (num_rooms != audit->num_rooms) {
+    // AZ_ALLOC zeroes the memory, so any new rooms start out with empty logs.
+    az_audit_room_t *new_rooms = AZ_ALLOC(num_rooms, az_audit_room_t);
+    const int num_kept = az_imin(num_rooms, audit->num_rooms);
+    if (num_kept > 0) {
+      memcpy(new_rooms, audit->rooms, num_kept * sizeof(az_audit_room_t));
     }
+    az_free(audit->rooms);
+    audit->rooms = new_rooms;
+    audit->num_rooms = num_rooms;
+  }
+  // Check each changed room by itself, in parallel.  Each room's result is
+  // only written by the worker auditing that room.
+  const az_audit_job_t job = {.audit = audit, .keys = keys, .rooms = rooms};
+  az_parallel_for(num_changed, audit_room_at_index, (void *)&job);
+  // Recheck everything else.
+  clear_log(&audit->general_errors);
+  audit_script(&audit->general_errors, planet_on_start);
+  audit_cross_room(audit);
+  audit->num_errors = audit->general_errors.num_errors;
+  for (int i = 0; i < num_rooms; ++i) {
+    audit->num_errors += audit->rooms[i].local_errors.num_errors +
+      audit->rooms[i].cross_errors.num_errors;
+  }
+}
+
+void az_print_audit(const az_audit_t *audit) {
+  print_log(&audit->general_errors, -1);
+  for (int i = 0; i < audit->num_rooms; ++i) {
+    print_log(&audit->rooms[i].local_errors, i);
+    print_log(&audit->rooms[i].cross_errors, i);
+  }
+}
+
+void az_destroy_audit(az_audit_t *audit) {
+  for (int i = 0; i < audit->num_rooms; ++i) {
+    destroy_log(&audit->rooms[i].local_errors);
+    destroy_log(&audit->rooms[i].cross_errors);
   }
-  return ok;
+  az_free(audit->rooms);
+  destroy_log(&audit->general_errors);
+  AZ_ZERO_OBJECT(audit);
 }
 
 /*===========================================================================*/
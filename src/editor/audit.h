@@ -22,13 +22,63 @@
 #define EDITOR_AUDIT_H_
 
 #include <stdbool.h>
+#include <stddef.h> // for size_t
 
 #include "azimuth/state/planet.h"
+#include "azimuth/state/room.h"
+#include "azimuth/state/script.h"
+#include "azimuth/state/upgrade.h"
 
 /*===========================================================================*/
 
-// Returns true if there are no problems.
-bool az_audit_scenario(const az_planet_t *planet);
+// A list of problems found by the audit, one per line.
+typedef struct {
+  int num_errors;
+  size_t length, capacity;
+  char *text; // NUL-terminated (or NULL, if capacity is zero)
+} az_audit_log_t;
+
+typedef struct {
+  bool audited; // false if this room hasn't been audited yet
+  // Problems found by checking this room by itself:
+  az_audit_log_t local_errors;
+  // What the cross-room checks need to know about this room:
+  az_zone_key_t zone_key;
+  bool sets_music;
+  int num_exits;
+  az_room_key_t exits[AZ_MAX_NUM_DOORS]; // non-forcefield doors only
+  az_upgrades_t upgrades;
+  // Problems found by comparing this room with others:
+  az_audit_log_t cross_errors;
+} az_audit_room_t;
+
+// Cached audit results for a whole planet.  Re-auditing a few changed rooms
+// only reruns the per-room checks for those rooms; the cross-room checks
+// (door pairing, zone music, and upgrade uniqueness) then run on the cached
+// summaries of every room, which is cheap.
+typedef struct {
+  int num_rooms;
+  az_audit_room_t *rooms;
+  az_audit_log_t general_errors;
+  int num_errors; // total across all logs
+} az_audit_t;
+
+/*===========================================================================*/
+
+void az_init_audit(az_audit_t *audit);
+
+// Rerun the per-room checks for the given rooms (spreading them across worker
+// threads), where rooms[i] is the room with key keys[i], then rerun the
+// cross-room checks.  The planet has num_rooms rooms in total; the audit must
+// already have results for each room that isn't among those given.
+void az_update_audit(az_audit_t *audit, const az_script_t *planet_on_start,
+                     int num_rooms, int num_changed,
+                     const az_room_key_t *keys, const az_room_t *rooms);
+
+// Print all the problems found to the console.
+void az_print_audit(const az_audit_t *audit);
+
+void az_destroy_audit(az_audit_t *audit);
 
 /*===========================================================================*/
 
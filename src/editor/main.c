@@ -38,20 +38,23 @@
 #include "azimuth/view/wall.h" // for az_init_wall_drawing
 #include "editor/list.h"
 #include "editor/state.h"
+#include "editor/undo.h"
 #include "editor/view.h"
 
 /*===========================================================================*/
 
+// The maximum number of bytes of memory to use for undo history.
+#define UNDO_BUDGET (4 * 1024 * 1024)
+
 static az_editor_state_t state;
+static az_undo_history_t history;
 
 static az_editor_room_t *get_current_room(void) {
   return AZ_LIST_GET(state.planet.rooms, state.current_room);
 }
 
 static void set_room_unsaved(az_editor_room_t *room) {
-  room->unsaved = true;
-  state.unsaved = true;
-  az_relabel_editor_room(room);
+  az_set_editor_room_unsaved(&state, room);
 }
 
 static void deselect_all_rooms(void) {
@@ -101,6 +104,7 @@ static void add_new_room(void) {
     .theta_span = theta_span
   };
   state.current_room = room_key;
+  az_set_editor_planet_unsaved(&state);
   set_room_unsaved(room);
 }
 
@@ -168,9 +172,16 @@ static void select_all(az_editor_room_t *room, bool selected) {
 static void do_select(int x, int y, bool multi) {
   az_editor_room_t *room = get_current_room();
   const az_vector_t pt = az_pixel_to_position(&state, x, y);
+  const az_editor_object_t *found;
+  const int num_found = az_find_editor_objects(room, pt, pt, &found);
+  // Consider the nearby objects one kind at a time; the order matters, since
+  // each kind must be strictly closer than the previous kinds to win.
   double best_dist = INFINITY;
   az_editor_gravfield_t *best_gravfield = NULL;
-  AZ_LIST_LOOP(gravfield, room->gravfields) {
+  for (int i = 0; i < num_found; ++i) {
+    if (found[i].type != AZ_EOBJ_GRAVFIELD) continue;
+    az_editor_gravfield_t *gravfield =
+      AZ_LIST_GET(room->gravfields, found[i].index);
     double dist = az_vdist(pt, gravfield->spec.position);
     if (dist >= best_dist) continue;
     const az_gravfield_t real_gravfield = {
@@ -186,7 +197,9 @@ static void do_select(int x, int y, bool multi) {
     }
   }
   az_editor_wall_t *best_wall = NULL;
-  AZ_LIST_LOOP(wall, room->walls) {
+  for (int i = 0; i < num_found; ++i) {
+    if (found[i].type != AZ_EOBJ_WALL) continue;
+    az_editor_wall_t *wall = AZ_LIST_GET(room->walls, found[i].index);
     double dist = az_vdist(pt, wall->spec.position);
     if (dist <= wall->spec.data->bounding_radius && dist < best_dist) {
       best_dist = dist;
@@ -194,7 +207,9 @@ static void do_select(int x, int y, bool multi) {
     }
   }
   az_editor_node_t *best_node = NULL;
-  AZ_LIST_LOOP(node, room->nodes) {
+  for (int i = 0; i < num_found; ++i) {
+    if (found[i].type != AZ_EOBJ_NODE) continue;
+    az_editor_node_t *node = AZ_LIST_GET(room->nodes, found[i].index);
     double dist = az_vdist(pt, node->spec.position);
     if (dist <= AZ_NODE_BOUNDING_RADIUS && dist < best_dist) {
       best_dist = dist;
@@ -202,7 +217,9 @@ static void do_select(int x, int y, bool multi) {
     }
   }
   az_editor_baddie_t *best_baddie = NULL;
-  AZ_LIST_LOOP(baddie, room->baddies) {
+  for (int i = 0; i < num_found; ++i) {
+    if (found[i].type != AZ_EOBJ_BADDIE) continue;
+    az_editor_baddie_t *baddie = AZ_LIST_GET(room->baddies, found[i].index);
     double dist = az_vdist(pt, baddie->spec.position);
     if (dist <= az_get_baddie_data(baddie->spec.kind)->
                 overall_bounding_radius &&
@@ -212,7 +229,9 @@ static void do_select(int x, int y, bool multi) {
     }
   }
   az_editor_door_t *best_door = NULL;
-  AZ_LIST_LOOP(door, room->doors) {
+  for (int i = 0; i < num_found; ++i) {
+    if (found[i].type != AZ_EOBJ_DOOR) continue;
+    az_editor_door_t *door = AZ_LIST_GET(room->doors, found[i].index);
     double dist = az_vdist(pt, door->spec.position);
     if (dist <= AZ_DOOR_BOUNDING_RADIUS && dist < best_dist) {
       best_dist = dist;
@@ -289,15 +308,39 @@ static void do_select_from_sector(int x, int y, bool multi) {
     theta0 += sweep;
     sweep = fabs(sweep);
   }
+  // Find the bounding box of the sector (its corners, plus wherever it
+  // crosses an axis at its outer edge), and only examine objects near that:
+  const double theta1 = theta0 + sweep;
+  az_vector_t extremes[8] = {
+    az_vpolar(min_r, theta0), az_vpolar(min_r, theta1),
+    az_vpolar(max_r, theta0), az_vpolar(max_r, theta1)
+  };
+  int num_extremes = 4;
+  for (int quadrant = 0; quadrant < 4; ++quadrant) {
+    const double theta = quadrant * AZ_HALF_PI;
+    if (az_mod2pi_nonneg(theta - theta0) <= sweep) {
+      extremes[num_extremes++] = az_vpolar(max_r, theta);
+    }
+  }
+  az_vector_t min_corner = extremes[0], max_corner = extremes[0];
+  for (int i = 1; i < num_extremes; ++i) {
+    min_corner.x = fmin(min_corner.x, extremes[i].x);
+    min_corner.y = fmin(min_corner.y, extremes[i].y);
+    max_corner.x = fmax(max_corner.x, extremes[i].x);
+    max_corner.y = fmax(max_corner.y, extremes[i].y);
+  }
   az_editor_room_t *room = get_current_room();
-  AZ_EDITOR_OBJECT_LOOP(object, room) {
-    const double obj_r = az_vnorm(*object.position);
-    const double obj_theta = az_vtheta(*object.position);
+  if (!multi) select_all(room, false);
+  const az_editor_object_t *found;
+  const int num_found =
+    az_find_editor_objects(room, min_corner, max_corner, &found);
+  for (int i = 0; i < num_found; ++i) {
+    const az_editor_object_t *object = &found[i];
+    const double obj_r = az_vnorm(*object->position);
+    const double obj_theta = az_vtheta(*object->position);
     if (obj_r >= min_r && obj_r <= max_r &&
         az_mod2pi_nonneg(obj_theta - theta0) <= sweep) {
-      *object.selected = (multi ? !*object.selected : true);
-    } else if (!multi) {
-      *object.selected = false;
+      *object->selected = (multi ? !*object->selected : true);
     }
   }
   state.selection_sector.active = false;
@@ -366,6 +409,7 @@ static void do_move(int x, int y, int dx, int dy, bool constrained,
   az_editor_room_t *room = get_current_room();
   AZ_EDITOR_OBJECT_LOOP(object, room) {
     if (!*object.selected) continue;
+    az_note_undo_transform(&history, &object);
     if (rotate_with_gravity) {
       *object.position =
         az_vadd(new_position,
@@ -399,9 +443,11 @@ static void do_mass_move(int x, int y, int dx, int dy) {
     // Move objects in the room:
     const az_vector_t delta = az_vmul(normal, dr);
     AZ_EDITOR_OBJECT_LOOP(object, room) {
+      az_note_undo_transform(&history, &object);
       *object.position = az_vadd(*object.position, delta);
     }
     // Change camera bounds:
+    az_note_undo_room(&history, room);
     const double r1 = camera_bounds->min_r + 0.5 * camera_bounds->r_span;
     assert(r1 >= 0.0);
     camera_bounds->min_r = fmax(0.0, camera_bounds->min_r + dr);
@@ -444,6 +490,7 @@ static void do_rotate(int x, int y, int dx, int dy) {
     az_vtheta(az_vsub(pt1, center)) - az_vtheta(az_vsub(pt0, center));
   AZ_EDITOR_OBJECT_LOOP(object, room) {
     if (!*object.selected) continue;
+    az_note_undo_transform(&history, &object);
     rotate_around(object.position, center, dtheta);
     *object.angle = state.brush.angle = az_mod2pi(*object.angle + dtheta);
   }
@@ -456,9 +503,11 @@ static void do_mass_rotate(int x, int y, int dx, int dy) {
               az_vtheta(az_pixel_to_position(&state, x - dx, y - dy)));
   AZ_LIST_LOOP(room, state.planet.rooms) {
     if (!room->selected) continue;
+    az_note_undo_room(&history, room);
     room->camera_bounds.min_theta =
       az_mod2pi(room->camera_bounds.min_theta + dtheta);
     AZ_EDITOR_OBJECT_LOOP(object, room) {
+      az_note_undo_transform(&history, &object);
       *object.position = az_vrotate(*object.position, dtheta);
       *object.angle = az_mod2pi(*object.angle + dtheta);
     }
@@ -482,6 +531,7 @@ static void do_rotate_align(bool to_camera) {
   AZ_EDITOR_OBJECT_LOOP(object, room) {
     if (!*object.selected) continue;
     const double up = (to_camera ? cam_up : az_vtheta(*object.position));
+    az_note_undo_transform(&history, &object);
     *object.angle = state.brush.angle = az_mod2pi(up + step *
         ceil(az_mod2pi_nonneg(*object.angle - up + 0.001) / step));
     set_room_unsaved(room);
@@ -508,6 +558,7 @@ static void do_set_camera_bounds(int x, int y) {
   const double new_r = az_vnorm(pt);
   const double new_theta = az_vtheta(pt);
   const double threshold = 20.0 * state.zoom_level;
+  az_note_undo_room(&history, room);
   // Update r-bounds:
   if (new_r < bounds->min_r + 0.5 * bounds->r_span) {
     bounds->r_span += bounds->min_r - new_r;
@@ -582,6 +633,8 @@ static void do_add_baddie(int x, int y, bool constrained,
   position_new_object(x, y, constrained, rotate_with_gravity,
                       &baddie->spec.position, &baddie->spec.angle);
   baddie->selected = true;
+  az_note_undo_insert(&history, room, AZ_EOBJ_BADDIE,
+                      AZ_LIST_SIZE(room->baddies) - 1);
 }
 
 static void do_add_door(int x, int y, bool constrained,
@@ -594,6 +647,8 @@ static void do_add_door(int x, int y, bool constrained,
   position_new_object(x, y, constrained, rotate_with_gravity,
                       &door->spec.position, &door->spec.angle);
   door->selected = true;
+  az_note_undo_insert(&history, room, AZ_EOBJ_DOOR,
+                      AZ_LIST_SIZE(room->doors) - 1);
 }
 
 static void do_add_gravfield(int x, int y, bool constrained,
@@ -607,6 +662,8 @@ static void do_add_gravfield(int x, int y, bool constrained,
   position_new_object(x, y, constrained, rotate_with_gravity,
                       &gravfield->spec.position, &gravfield->spec.angle);
   gravfield->selected = true;
+  az_note_undo_insert(&history, room, AZ_EOBJ_GRAVFIELD,
+                      AZ_LIST_SIZE(room->gravfields) - 1);
 }
 
 static void do_add_node(int x, int y, bool constrained,
@@ -619,6 +676,8 @@ static void do_add_node(int x, int y, bool constrained,
   position_new_object(x, y, constrained, rotate_with_gravity,
                       &node->spec.position, &node->spec.angle);
   node->selected = true;
+  az_note_undo_insert(&history, room, AZ_EOBJ_NODE,
+                      AZ_LIST_SIZE(room->nodes) - 1);
 }
 
 static void do_add_wall(int x, int y, bool constrained,
@@ -631,23 +690,26 @@ static void do_add_wall(int x, int y, bool constrained,
   position_new_object(x, y, constrained, rotate_with_gravity,
                       &wall->spec.position, &wall->spec.angle);
   wall->selected = true;
+  az_note_undo_insert(&history, room, AZ_EOBJ_WALL,
+                      AZ_LIST_SIZE(room->walls) - 1);
 }
 
 static void do_remove(void) {
   az_editor_room_t *room = get_current_room();
   bool any = false;
-#define NUKE_SCRIPTS(obj, script) do { \
-    AZ_LIST_LOOP(obj, room->obj##s) { \
-      if (!obj->selected) continue; \
-      az_free_script(obj->spec.script); \
-      obj->spec.script = NULL; \
+  // The undo history takes ownership of the removed objects' scripts.
+#define NOTE_REMOVALS(obj, type) do { \
+    for (int i = AZ_LIST_SIZE(room->obj##s) - 1; i >= 0; --i) { \
+      if (!AZ_LIST_GET(room->obj##s, i)->selected) continue; \
+      az_note_undo_remove(&history, room, type, i); \
     } \
   } while (0)
-  NUKE_SCRIPTS(baddie, on_kill);
-  NUKE_SCRIPTS(door, on_open);
-  NUKE_SCRIPTS(gravfield, on_enter);
-  NUKE_SCRIPTS(node, on_use);
-#undef NUKE_SCRIPTS
+  NOTE_REMOVALS(baddie, AZ_EOBJ_BADDIE);
+  NOTE_REMOVALS(door, AZ_EOBJ_DOOR);
+  NOTE_REMOVALS(gravfield, AZ_EOBJ_GRAVFIELD);
+  NOTE_REMOVALS(node, AZ_EOBJ_NODE);
+  NOTE_REMOVALS(wall, AZ_EOBJ_WALL);
+#undef NOTE_REMOVALS
 
 #define REMOVE(obj) do { \
     AZ_LIST_DECLARE(az_editor_##obj##_t, temp_##obj##s); \
@@ -747,6 +809,8 @@ static void do_paste(void) {
           baddie->spec = object->spec.baddie;
           az_vpluseq(&baddie->spec.position, state.camera);
           baddie->spec.on_kill = az_clone_script(object->spec.baddie.on_kill);
+          az_note_undo_insert(&history, room, AZ_EOBJ_BADDIE,
+                              AZ_LIST_SIZE(room->baddies) - 1);
         }
         break;
       case AZ_EOBJ_DOOR:
@@ -757,6 +821,8 @@ static void do_paste(void) {
           az_vpluseq(&door->spec.position, state.camera);
           door->spec.destination = state.current_room;
           door->spec.on_open = az_clone_script(object->spec.door.on_open);
+          az_note_undo_insert(&history, room, AZ_EOBJ_DOOR,
+                              AZ_LIST_SIZE(room->doors) - 1);
         }
         break;
       case AZ_EOBJ_GRAVFIELD:
@@ -767,6 +833,8 @@ static void do_paste(void) {
           az_vpluseq(&gravfield->spec.position, state.camera);
           gravfield->spec.on_enter =
             az_clone_script(object->spec.gravfield.on_enter);
+          az_note_undo_insert(&history, room, AZ_EOBJ_GRAVFIELD,
+                              AZ_LIST_SIZE(room->gravfields) - 1);
         }
         break;
       case AZ_EOBJ_NODE:
@@ -776,6 +844,8 @@ static void do_paste(void) {
           node->spec = object->spec.node;
           az_vpluseq(&node->spec.position, state.camera);
           node->spec.on_use = az_clone_script(object->spec.node.on_use);
+          az_note_undo_insert(&history, room, AZ_EOBJ_NODE,
+                              AZ_LIST_SIZE(room->nodes) - 1);
         }
         break;
       case AZ_EOBJ_WALL:
@@ -784,6 +854,8 @@ static void do_paste(void) {
           wall->selected = true;
           wall->spec = object->spec.wall;
           az_vpluseq(&wall->spec.position, state.camera);
+          az_note_undo_insert(&history, room, AZ_EOBJ_WALL,
+                              AZ_LIST_SIZE(room->walls) - 1);
         }
         break;
     }
@@ -792,26 +864,29 @@ static void do_paste(void) {
 
 static void do_partition(bool front) {
   az_editor_room_t *room = get_current_room();
-#define PARTITION(obj) do { \
-    AZ_LIST_DECLARE(az_editor_##obj##_t, back_##obj##s); \
-    AZ_LIST_INIT(back_##obj##s, 2); \
-    AZ_LIST_DECLARE(az_editor_##obj##_t, front_##obj##s); \
-    AZ_LIST_INIT(front_##obj##s, 2); \
-    AZ_LIST_LOOP(obj, room->obj##s) { \
-      if (obj->selected == front) *AZ_LIST_ADD(front_##obj##s) = *obj; \
-      else *AZ_LIST_ADD(back_##obj##s) = *obj; \
+  // Move each object whose selection state matches front to the end of its
+  // list, one at a time (preserving relative order), so that the undo history
+  // only needs to record the individual moves.
+#define PARTITION(obj, type) do { \
+    const int num = AZ_LIST_SIZE(room->obj##s); \
+    for (int i = 0, seen = 0; seen < num; ++seen) { \
+      az_editor_##obj##_t *obj = AZ_LIST_GET(room->obj##s, i); \
+      if (obj->selected != front) { \
+        ++i; \
+        continue; \
+      } \
+      const az_editor_##obj##_t temp = *obj; \
+      memmove(obj, obj + 1, (num - 1 - i) * sizeof(temp)); \
+      *AZ_LIST_GET(room->obj##s, num - 1) = temp; \
+      az_note_undo_move(&history, room, type, i, num - 1); \
     } \
-    AZ_LIST_SWAP(back_##obj##s, room->obj##s); \
-    AZ_LIST_CONCAT(room->obj##s, front_##obj##s); \
-    AZ_LIST_DESTROY(back_##obj##s); \
-    AZ_LIST_DESTROY(front_##obj##s); \
   } while (0)
 
-  PARTITION(baddie);
-  PARTITION(door);
-  PARTITION(gravfield);
-  PARTITION(node);
-  PARTITION(wall);
+  PARTITION(baddie, AZ_EOBJ_BADDIE);
+  PARTITION(door, AZ_EOBJ_DOOR);
+  PARTITION(gravfield, AZ_EOBJ_GRAVFIELD);
+  PARTITION(node, AZ_EOBJ_NODE);
+  PARTITION(wall, AZ_EOBJ_WALL);
 #undef PARTITION
   set_room_unsaved(room);
 }
@@ -822,6 +897,8 @@ static void do_change_data(int delta, bool secondary) {
   az_editor_room_t *room = get_current_room();
   AZ_LIST_LOOP(baddie, room->baddies) {
     if (!baddie->selected) continue;
+    az_note_undo_modify(&history, room, AZ_EOBJ_BADDIE,
+                        baddie - room->baddies.items);
     const az_baddie_kind_t new_kind =
       az_advance_baddie_kind(baddie->spec.kind, delta);
     baddie->spec.kind = new_kind;
@@ -830,6 +907,8 @@ static void do_change_data(int delta, bool secondary) {
   }
   AZ_LIST_LOOP(door, room->doors) {
     if (!door->selected) continue;
+    az_note_undo_modify(&history, room, AZ_EOBJ_DOOR,
+                        door - room->doors.items);
     const az_door_kind_t new_kind =
       az_modulo((int)door->spec.kind - 1 + delta, AZ_NUM_DOOR_KINDS) + 1;
     door->spec.kind = new_kind;
@@ -838,6 +917,8 @@ static void do_change_data(int delta, bool secondary) {
   }
   AZ_LIST_LOOP(gravfield, room->gravfields) {
     if (!gravfield->selected) continue;
+    az_note_undo_modify(&history, room, AZ_EOBJ_GRAVFIELD,
+                        gravfield - room->gravfields.items);
     const az_gravfield_kind_t new_kind =
       az_modulo((int)gravfield->spec.kind - 1 + delta,
                 AZ_NUM_GRAVFIELD_KINDS) + 1;
@@ -847,6 +928,8 @@ static void do_change_data(int delta, bool secondary) {
   }
   AZ_LIST_LOOP(node, room->nodes) {
     if (!node->selected) continue;
+    az_note_undo_modify(&history, room, AZ_EOBJ_NODE,
+                        node - room->nodes.items);
     if (secondary) {
       switch (node->spec.kind) {
         case AZ_NODE_NOTHING: AZ_ASSERT_UNREACHABLE();
@@ -892,6 +975,8 @@ static void do_change_data(int delta, bool secondary) {
   }
   AZ_LIST_LOOP(wall, room->walls) {
     if (!wall->selected) continue;
+    az_note_undo_modify(&history, room, AZ_EOBJ_WALL,
+                        wall - room->walls.items);
     if (secondary) {
       const az_wall_kind_t new_kind =
         az_modulo((int)wall->spec.kind - 1 + delta, AZ_NUM_WALL_KINDS) + 1;
@@ -910,6 +995,7 @@ static void do_change_data(int delta, bool secondary) {
 static void do_nodify_walls(void) {
   az_editor_room_t *room = get_current_room();
   bool any = false;
+  bool converted[AZ_MAX_NUM_WALLS] = {false};
   AZ_LIST_DECLARE(az_editor_wall_t, temp_walls);
   AZ_LIST_INIT(temp_walls, 2);
   AZ_LIST_LOOP(wall, room->walls) {
@@ -918,6 +1004,7 @@ static void do_nodify_walls(void) {
       continue;
     }
     any = true;
+    converted[wall - room->walls.items] = true;
     az_editor_node_t *node = AZ_LIST_ADD(room->nodes);
     node->selected = true;
     node->spec.kind = AZ_NODE_FAKE_WALL_FG;
@@ -925,6 +1012,11 @@ static void do_nodify_walls(void) {
     node->spec.position = wall->spec.position;
     node->spec.angle = wall->spec.angle;
     node->spec.uuid_slot = wall->spec.uuid_slot;
+    az_note_undo_insert(&history, room, AZ_EOBJ_NODE,
+                        AZ_LIST_SIZE(room->nodes) - 1);
+  }
+  for (int i = AZ_LIST_SIZE(room->walls) - 1; i >= 0; --i) {
+    if (converted[i]) az_note_undo_remove(&history, room, AZ_EOBJ_WALL, i);
   }
   AZ_LIST_SWAP(temp_walls, room->walls);
   AZ_LIST_DESTROY(temp_walls);
@@ -934,6 +1026,7 @@ static void do_nodify_walls(void) {
 static void do_wallify_nodes(void) {
   az_editor_room_t *room = get_current_room();
   bool any = false;
+  bool converted[AZ_MAX_NUM_NODES] = {false};
   AZ_LIST_DECLARE(az_editor_node_t, temp_nodes);
   AZ_LIST_INIT(temp_nodes, 2);
   AZ_LIST_LOOP(node, room->nodes) {
@@ -944,6 +1037,7 @@ static void do_wallify_nodes(void) {
       continue;
     }
     any = true;
+    converted[node - room->nodes.items] = true;
     az_editor_wall_t *wall = AZ_LIST_ADD(room->walls);
     wall->selected = true;
     wall->spec.kind = AZ_WALL_INDESTRUCTIBLE;
@@ -951,8 +1045,12 @@ static void do_wallify_nodes(void) {
     wall->spec.position = node->spec.position;
     wall->spec.angle = node->spec.angle;
     wall->spec.uuid_slot = node->spec.uuid_slot;
-    az_free_script(node->spec.on_use);
-    node->spec.on_use = NULL;
+    az_note_undo_insert(&history, room, AZ_EOBJ_WALL,
+                        AZ_LIST_SIZE(room->walls) - 1);
+  }
+  // The undo history takes ownership of the removed nodes' scripts.
+  for (int i = AZ_LIST_SIZE(room->nodes) - 1; i >= 0; --i) {
+    if (converted[i]) az_note_undo_remove(&history, room, AZ_EOBJ_NODE, i);
   }
   AZ_LIST_SWAP(temp_nodes, room->nodes);
   AZ_LIST_DESTROY(temp_nodes);
@@ -1001,6 +1099,7 @@ static void do_flip_room_horz(void) {
   const double mid_theta = bounds->min_theta + 0.5 * bounds->theta_span;
   const az_vector_t axis = az_vpolar(1, mid_theta);
   AZ_EDITOR_OBJECT_LOOP(object, room) {
+    az_note_undo_modify(&history, room, object.type, object.index);
     az_vpluseq(object.position,
                az_vmul(az_vflatten(*object.position, axis), -2));
     *object.angle = az_mod2pi(mid_theta -
@@ -1040,6 +1139,7 @@ static void do_flip_room_horz(void) {
 
 static void do_change_background_pattern(int delta) {
   az_editor_room_t *room = get_current_room();
+  az_note_undo_room(&history, room);
   room->background_pattern =
     az_modulo(room->background_pattern + delta, AZ_NUM_BG_PATTERNS);
   set_room_unsaved(room);
@@ -1047,6 +1147,7 @@ static void do_change_background_pattern(int delta) {
 
 static void do_change_zone(int delta) {
   az_editor_room_t *room = get_current_room();
+  az_note_undo_room(&history, room);
   room->zone_key = az_modulo(room->zone_key + delta,
                              AZ_LIST_SIZE(state.planet.zones));
   state.brush.zone_key = room->zone_key;
@@ -1064,6 +1165,7 @@ static void do_toggle_property(az_room_flags_t flag) {
   }
   AZ_LIST_LOOP(room, state.planet.rooms) {
     if (!room->selected) continue;
+    az_note_undo_room(&history, room);
     if (currently_set) room->properties &= ~flag;
     else room->properties |= flag;
     set_room_unsaved(room);
@@ -1091,10 +1193,16 @@ static void auto_set_door_dest(void) {
       }
     }
     if (closest_door != NULL) {
+      az_editor_room_t *target_room =
+        AZ_LIST_GET(state.planet.rooms, target);
+      az_note_undo_modify(&history, room, AZ_EOBJ_DOOR,
+                          door - room->doors.items);
+      az_note_undo_modify(&history, target_room, AZ_EOBJ_DOOR,
+                          closest_door - target_room->doors.items);
       door->spec.destination = target;
       closest_door->spec.destination = state.current_room;
       set_room_unsaved(room);
-      set_room_unsaved(AZ_LIST_GET(state.planet.rooms, target));
+      set_room_unsaved(target_room);
     }
   }
   AZ_LIST_LOOP(node, room->nodes) {
@@ -1108,6 +1216,8 @@ static void auto_set_door_dest(void) {
         best_dist = dist;
       }
     }
+    az_note_undo_modify(&history, room, AZ_EOBJ_NODE,
+                        node - room->nodes.items);
     node->spec.subkind.secret = target;
     set_room_unsaved(room);
   }
@@ -1186,6 +1296,8 @@ static void try_edit_gravfield(void) {
     if (!gravfield->selected) continue;
     if (az_is_liquid(gravfield->spec.kind) != liquid) continue;
     if (az_is_trapezoidal(gravfield->spec.kind) != trapezoidal) continue;
+    az_note_undo_modify(&history, room, AZ_EOBJ_GRAVFIELD,
+                        gravfield - room->gravfields.items);
     gravfield->spec.strength = strength;
     gravfield->spec.size = size;
     set_room_unsaved(room);
@@ -1232,20 +1344,35 @@ static void try_edit_script(void) {
     if (script == NULL) return;
   }
   az_script_t **dest = &room->on_start;
+  az_editor_object_type_t dest_type = AZ_EOBJ_NOTHING;
+  int dest_index = 0;
   AZ_LIST_LOOP(baddie, room->baddies) {
-    if (baddie->selected) dest = &baddie->spec.on_kill;
+    if (!baddie->selected) continue;
+    dest = &baddie->spec.on_kill;
+    dest_type = AZ_EOBJ_BADDIE;
+    dest_index = baddie - room->baddies.items;
   }
   AZ_LIST_LOOP(door, room->doors) {
-    if (door->selected) dest = &door->spec.on_open;
+    if (!door->selected) continue;
+    dest = &door->spec.on_open;
+    dest_type = AZ_EOBJ_DOOR;
+    dest_index = door - room->doors.items;
   }
   AZ_LIST_LOOP(gravfield, room->gravfields) {
-    if (gravfield->selected) dest = &gravfield->spec.on_enter;
+    if (!gravfield->selected) continue;
+    dest = &gravfield->spec.on_enter;
+    dest_type = AZ_EOBJ_GRAVFIELD;
+    dest_index = gravfield - room->gravfields.items;
   }
   AZ_LIST_LOOP(node, room->nodes) {
-    if (node->selected) dest = &node->spec.on_use;
+    if (!node->selected) continue;
+    dest = &node->spec.on_use;
+    dest_type = AZ_EOBJ_NODE;
+    dest_index = node - room->nodes.items;
   }
   state.text.action = AZ_ETA_NOTHING;
-  az_free_script(*dest);
+  // The undo history takes ownership of the old script.
+  az_note_undo_script(&history, room, dest_type, dest_index);
   *dest = script;
   set_room_unsaved(room);
 }
@@ -1282,6 +1409,8 @@ static void try_set_cargo_slots(void) {
     if (baddie->selected) {
       AZ_STATIC_ASSERT(AZ_ARRAY_SIZE(baddie->spec.cargo_slots) ==
                        AZ_ARRAY_SIZE(slots));
+      az_note_undo_modify(&history, room, AZ_EOBJ_BADDIE,
+                          baddie - room->baddies.items);
       for (int i = 0; i < AZ_ARRAY_SIZE(baddie->spec.cargo_slots); ++i) {
         baddie->spec.cargo_slots[i] = slots[i];
       }
@@ -1349,11 +1478,15 @@ static void try_set_door_dest(void) {
   az_editor_room_t *room = get_current_room();
   AZ_LIST_LOOP(door, room->doors) {
     if (!door->selected) continue;
+    az_note_undo_modify(&history, room, AZ_EOBJ_DOOR,
+                        door - room->doors.items);
     door->spec.destination = key;
     set_room_unsaved(room);
   }
   AZ_LIST_LOOP(node, room->nodes) {
     if (!node->selected || node->spec.kind != AZ_NODE_SECRET) continue;
+    az_note_undo_modify(&history, room, AZ_EOBJ_NODE,
+                        node - room->nodes.items);
     node->spec.subkind.secret = key;
     set_room_unsaved(room);
   }
@@ -1376,6 +1509,7 @@ static void try_set_marker_flag(void) {
   assert(state.text.buffer[state.text.length] == '\0');
   az_editor_room_t *room = get_current_room();
   if (state.text.length == 0) {
+    az_note_undo_room(&history, room);
     room->properties &= ~(AZ_ROOMF_MARK_IF_CLR | AZ_ROOMF_MARK_IF_SET);
     room->marker_flag = 0;
   } else {
@@ -1384,13 +1518,15 @@ static void try_set_marker_flag(void) {
     if (sscanf(state.text.buffer, "%c%d%n", &kind, &flag, &count) < 2) return;
     if (count != state.text.length) return;
     if (flag < 0 || flag >= AZ_MAX_NUM_FLAGS) return;
+    if (kind != 'c' && kind != 's') return;
+    az_note_undo_room(&history, room);
     if (kind == 'c') {
       room->properties &= ~AZ_ROOMF_MARK_IF_SET;
       room->properties |= AZ_ROOMF_MARK_IF_CLR;
     } else if (kind == 's') {
       room->properties &= ~AZ_ROOMF_MARK_IF_CLR;
       room->properties |= AZ_ROOMF_MARK_IF_SET;
-    } else return;
+    }
     room->marker_flag = (az_flag_t)flag;
   }
   set_room_unsaved(room);
@@ -1454,30 +1590,40 @@ static void try_set_uuid_slot(void) {
   // Set the UUID slot for a single object.
   AZ_LIST_LOOP(baddie, room->baddies) {
     if (baddie->selected) {
+      az_note_undo_modify(&history, room, AZ_EOBJ_BADDIE,
+                          baddie - room->baddies.items);
       baddie->spec.uuid_slot = uuid_slot;
       return;
     }
   }
   AZ_LIST_LOOP(door, room->doors) {
     if (door->selected) {
+      az_note_undo_modify(&history, room, AZ_EOBJ_DOOR,
+                          door - room->doors.items);
       door->spec.uuid_slot = uuid_slot;
       return;
     }
   }
   AZ_LIST_LOOP(gravfield, room->gravfields) {
     if (gravfield->selected) {
+      az_note_undo_modify(&history, room, AZ_EOBJ_GRAVFIELD,
+                          gravfield - room->gravfields.items);
       gravfield->spec.uuid_slot = uuid_slot;
       return;
     }
   }
   AZ_LIST_LOOP(node, room->nodes) {
     if (node->selected) {
+      az_note_undo_modify(&history, room, AZ_EOBJ_NODE,
+                          node - room->nodes.items);
       node->spec.uuid_slot = uuid_slot;
       return;
     }
   }
   AZ_LIST_LOOP(wall, room->walls) {
     if (wall->selected) {
+      az_note_undo_modify(&history, room, AZ_EOBJ_WALL,
+                          wall - room->walls.items);
       wall->spec.uuid_slot = uuid_slot;
       return;
     }
@@ -1491,6 +1637,7 @@ static void do_save(bool summarize) {
 }
 
 static void event_loop(void) {
+  int drag_count = 0;
   while (true) {
     if (state.text.action == AZ_ETA_NOTHING) {
       state.controls.up = az_is_key_held(AZ_KEY_UP_ARROW);
@@ -1509,6 +1656,13 @@ static void event_loop(void) {
 
     az_event_t event;
     while (az_poll_event(&event)) {
+      // Changes made while handling a single event form one undoable step,
+      // except that all changes made during one mouse drag (from mouse-down
+      // until mouse-up) are merged into a single step.
+      if (event.kind == AZ_EVENT_MOUSE_DOWN) ++drag_count;
+      az_begin_undo_step(&history, (event.kind == AZ_EVENT_MOUSE_DOWN ||
+                                    event.kind == AZ_EVENT_MOUSE_MOVE ?
+                                    drag_count : 0));
       switch (event.kind) {
         case AZ_EVENT_KEY_DOWN:
           // If we're editing text, handle key events specially.
@@ -1685,7 +1839,10 @@ static void event_loop(void) {
               if (event.key.command && !event.key.shift) do_copy(true);
               break;
             case AZ_KEY_Z:
-              if (!event.key.command) do_change_zone(event.key.shift ? -1 : 1);
+              if (event.key.command) {
+                if (event.key.shift) az_redo(&history);
+                else az_undo(&history);
+              } else do_change_zone(event.key.shift ? -1 : 1);
               break;
             case AZ_KEY_BACKSPACE: do_remove(); break;
             default: break;
@@ -1775,6 +1932,7 @@ static void event_loop(void) {
           break;
         default: break;
       }
+      az_end_undo_step(&history);
     }
   }
 }
@@ -1783,13 +1941,16 @@ int main(int argc, char **argv) {
   az_init_baddie_datas();
   az_init_wall_datas();
   az_register_gl_init_func(az_init_wall_drawing);
+  az_register_gl_init_func(az_init_editor_room_outlines);
   if (!az_load_editor_state(&state)) {
     printf("Failed to load scenario.\n");
     return EXIT_FAILURE;
   }
   az_init_gui(false, false);
+  az_init_undo_history(&history, &state, UNDO_BUDGET);
 
   event_loop();
+  az_destroy_undo_history(&history);
   az_destroy_editor_state(&state);
 
   return EXIT_SUCCESS;
@@ -38,6 +38,17 @@
 
 #define SAVE_ALL_ROOMS false
 
+// The smallest cell size to use for rooms' spatial indices.  This is about the
+// size of a typical small object, so that each cell holds only a few of them.
+#define MIN_INDEX_CELL_SIZE 64.0
+
+// How often (in ticks) to re-audit rooms that have changed since their last
+// audit:
+#define AUDIT_PERIOD_TICKS 15
+
+// Storage for the results of az_find_editor_objects.
+static AZ_LIST_DECLARE(az_editor_object_t, found_objects);
+
 static const int wall_data_indices[] = {
   // Colony walls:
   0, 2, 1, 21,
@@ -338,8 +349,24 @@ void az_relabel_editor_room(az_editor_room_t *room) {
   }
 }
 
+void az_set_editor_room_unsaved(az_editor_state_t *state,
+                                az_editor_room_t *room) {
+  room->unsaved = true;
+  ++room->revision;
+  room->index_valid = false;
+  state->unsaved = true;
+  az_relabel_editor_room(room);
+}
+
+void az_set_editor_planet_unsaved(az_editor_state_t *state) {
+  state->planet_unsaved = true;
+  ++state->planet_revision;
+  state->unsaved = true;
+}
+
 bool az_load_editor_state(az_editor_state_t *state) {
   init_reverse_indices();
+  az_init_audit(&state->audit);
   state->spin_camera = true;
   state->zoom_level = 128.0;
   state->brush.baddie_kind = AZ_BAD_MARKER;
@@ -358,7 +385,7 @@ bool az_load_editor_state(az_editor_state_t *state) {
   AZ_LIST_INIT(state->clipboard, 0);
 
   az_planet_t planet;
-  if (!az_load_planet("data", &planet)) return false;
+  if (!az_load_planet_text("data", &planet)) return false;
 
   state->current_room = state->planet.start_room = planet.start_room;
   state->planet.on_start = az_clone_script(planet.on_start);
@@ -432,9 +459,11 @@ bool az_load_editor_state(az_editor_state_t *state) {
   return true;
 }
 
-static void summarize_scenario(const az_planet_t *planet) {
+static void summarize_scenario(const az_audit_t *audit,
+                               const az_planet_t *planet) {
   printf("\n");
-  if (!az_audit_scenario(planet)) {
+  if (audit->num_errors > 0) {
+    az_print_audit(audit);
     printf("\n");
   }
   // Print number of rooms in each zone (both total rooms in that zone, and
@@ -480,20 +509,65 @@ static void summarize_scenario(const az_planet_t *planet) {
          (int)(100.0 * (double)total_pop_rooms / (double)planet->num_rooms));
 }
 
-bool az_save_editor_state(az_editor_state_t *state, bool summarize) {
-  assert(state != NULL);
-  // Count unsaved rooms:
-  int num_rooms_to_save = 0;
-  AZ_LIST_LOOP(room, state->planet.rooms) {
-    if (SAVE_ALL_ROOMS || room->unsaved) ++num_rooms_to_save;
+// Convert an editor room into a planet room, which must later be destroyed
+// with az_destroy_room.
+static void convert_room(const az_editor_room_t *eroom, az_room_t *room) {
+  room->zone_key = eroom->zone_key;
+  room->properties = eroom->properties &
+    (AZ_ROOMF_HEATED | AZ_ROOMF_MARK_IF_CLR | AZ_ROOMF_MARK_IF_SET |
+     AZ_ROOMF_UNMAPPED);
+  room->marker_flag = eroom->marker_flag;
+  room->camera_bounds = eroom->camera_bounds;
+  room->on_start = az_clone_script(eroom->on_start);
+  room->background_pattern = eroom->background_pattern;
+  // Convert baddies:
+  room->num_baddies = AZ_LIST_SIZE(eroom->baddies);
+  room->baddies = AZ_ALLOC(room->num_baddies, az_baddie_spec_t);
+  for (int i = 0; i < room->num_baddies; ++i) {
+    room->baddies[i] = AZ_LIST_GET(eroom->baddies, i)->spec;
+    room->baddies[i].on_kill = az_clone_script(room->baddies[i].on_kill);
+  }
+  // Convert doors:
+  room->num_doors = AZ_LIST_SIZE(eroom->doors);
+  room->doors = AZ_ALLOC(room->num_doors, az_door_spec_t);
+  for (int i = 0; i < room->num_doors; ++i) {
+    room->doors[i] = AZ_LIST_GET(eroom->doors, i)->spec;
+    room->doors[i].on_open = az_clone_script(room->doors[i].on_open);
+  }
+  // Convert gravfields:
+  room->num_gravfields = AZ_LIST_SIZE(eroom->gravfields);
+  room->gravfields = AZ_ALLOC(room->num_gravfields, az_gravfield_spec_t);
+  for (int i = 0; i < room->num_gravfields; ++i) {
+    room->gravfields[i] = AZ_LIST_GET(eroom->gravfields, i)->spec;
+    room->gravfields[i].on_enter =
+      az_clone_script(room->gravfields[i].on_enter);
+  }
+  // Convert nodes:
+  room->num_nodes = AZ_LIST_SIZE(eroom->nodes);
+  room->nodes = AZ_ALLOC(room->num_nodes, az_node_spec_t);
+  for (int i = 0; i < room->num_nodes; ++i) {
+    room->nodes[i] = AZ_LIST_GET(eroom->nodes, i)->spec;
+    room->nodes[i].on_use = az_clone_script(room->nodes[i].on_use);
+  }
+  // Convert walls:
+  room->num_walls = AZ_LIST_SIZE(eroom->walls);
+  room->walls = AZ_ALLOC(room->num_walls, az_wall_spec_t);
+  for (int i = 0; i < room->num_walls; ++i) {
+    room->walls[i] = AZ_LIST_GET(eroom->walls, i)->spec;
   }
-  // Convert planet:
+}
+
+// Convert the whole editor planet into a planet, which must later be
+// destroyed with az_destroy_planet.  Only needed to audit the scenario; saving
+// just converts whatever has changed.
+static void convert_planet(const az_editor_state_t *state,
+                           az_planet_t *planet) {
   const int num_hints = AZ_LIST_SIZE(state->planet.hints);
   const int num_paragraphs = AZ_LIST_SIZE(state->planet.paragraphs);
   const int num_zones = AZ_LIST_SIZE(state->planet.zones);
   const int num_rooms = AZ_LIST_SIZE(state->planet.rooms);
   assert(num_rooms >= 0);
-  az_planet_t planet = {
+  *planet = (az_planet_t){
     .start_room = state->planet.start_room,
     .on_start = az_clone_script(state->planet.on_start),
     .num_hints = num_hints,
@@ -507,93 +581,106 @@ bool az_save_editor_state(az_editor_state_t *state, bool summarize) {
   };
   // Convert hints:
   for (int i = 0; i < num_hints; ++i) {
-    planet.hints[i] = *AZ_LIST_GET(state->planet.hints, i);
+    planet->hints[i] = *AZ_LIST_GET(state->planet.hints, i);
   }
   // Convert paragraphs:
   for (int i = 0; i < num_paragraphs; ++i) {
-    planet.paragraphs[i] =
+    planet->paragraphs[i] =
       az_strdup(*AZ_LIST_GET(state->planet.paragraphs, i));
   }
   // Convert zones:
   for (int i = 0; i < num_zones; ++i) {
-    az_clone_zone(AZ_LIST_GET(state->planet.zones, i), &planet.zones[i]);
+    az_clone_zone(AZ_LIST_GET(state->planet.zones, i), &planet->zones[i]);
   }
   // Convert rooms:
-  az_room_key_t *rooms_to_save = AZ_ALLOC(num_rooms_to_save, az_room_key_t);
-  int num_rooms_to_save_so_far = 0;
+  for (az_room_key_t key = 0; key < num_rooms; ++key) {
+    convert_room(AZ_LIST_GET(state->planet.rooms, key), &planet->rooms[key]);
+  }
+}
+
+// Rerun the audit for any rooms that have changed since they were last
+// audited.
+static void update_audit(az_editor_state_t *state) {
+  const int num_rooms = AZ_LIST_SIZE(state->planet.rooms);
+  int num_changed = 0;
+  AZ_LIST_LOOP(eroom, state->planet.rooms) {
+    if (eroom - state->planet.rooms.items >= state->audit.num_rooms ||
+        eroom->audited_revision != eroom->revision) ++num_changed;
+  }
+  // Even if no rooms changed, the planet-level checks (and the cross-room
+  // checks, which depend on the number of rooms) may need rerunning.
+  if (num_changed == 0 &&
+      state->audited_planet_revision == state->planet_revision) return;
+  state->audited_planet_revision = state->planet_revision;
+  az_room_key_t *keys = AZ_ALLOC(num_changed, az_room_key_t);
+  az_room_t *rooms = AZ_ALLOC(num_changed, az_room_t);
+  int index = 0;
   for (az_room_key_t key = 0; key < num_rooms; ++key) {
     az_editor_room_t *eroom = AZ_LIST_GET(state->planet.rooms, key);
-    if (SAVE_ALL_ROOMS || eroom->unsaved) {
-      assert(num_rooms_to_save_so_far < num_rooms_to_save);
-      rooms_to_save[num_rooms_to_save_so_far] = key;
-      ++num_rooms_to_save_so_far;
-    }
-    az_room_t *room = &planet.rooms[key];
-    room->zone_key = eroom->zone_key;
-    room->properties = eroom->properties &
-      (AZ_ROOMF_HEATED | AZ_ROOMF_MARK_IF_CLR | AZ_ROOMF_MARK_IF_SET |
-       AZ_ROOMF_UNMAPPED);
-    room->marker_flag = eroom->marker_flag;
-    room->camera_bounds = eroom->camera_bounds;
-    room->on_start = az_clone_script(eroom->on_start);
-    room->background_pattern = eroom->background_pattern;
-    // Convert baddies:
-    room->num_baddies = AZ_LIST_SIZE(eroom->baddies);
-    room->baddies = AZ_ALLOC(room->num_baddies, az_baddie_spec_t);
-    for (int i = 0; i < room->num_baddies; ++i) {
-      room->baddies[i] = AZ_LIST_GET(eroom->baddies, i)->spec;
-      room->baddies[i].on_kill = az_clone_script(room->baddies[i].on_kill);
-    }
-    // Convert doors:
-    room->num_doors = AZ_LIST_SIZE(eroom->doors);
-    room->doors = AZ_ALLOC(room->num_doors, az_door_spec_t);
-    for (int i = 0; i < room->num_doors; ++i) {
-      room->doors[i] = AZ_LIST_GET(eroom->doors, i)->spec;
-      room->doors[i].on_open = az_clone_script(room->doors[i].on_open);
-    }
-    // Convert gravfields:
-    room->num_gravfields = AZ_LIST_SIZE(eroom->gravfields);
-    room->gravfields = AZ_ALLOC(room->num_gravfields, az_gravfield_spec_t);
-    for (int i = 0; i < room->num_gravfields; ++i) {
-      room->gravfields[i] = AZ_LIST_GET(eroom->gravfields, i)->spec;
-      room->gravfields[i].on_enter =
-        az_clone_script(room->gravfields[i].on_enter);
-    }
-    // Convert nodes:
-    room->num_nodes = AZ_LIST_SIZE(eroom->nodes);
-    room->nodes = AZ_ALLOC(room->num_nodes, az_node_spec_t);
-    for (int i = 0; i < room->num_nodes; ++i) {
-      room->nodes[i] = AZ_LIST_GET(eroom->nodes, i)->spec;
-      room->nodes[i].on_use = az_clone_script(room->nodes[i].on_use);
-    }
-    // Convert walls:
-    room->num_walls = AZ_LIST_SIZE(eroom->walls);
-    room->walls = AZ_ALLOC(room->num_walls, az_wall_spec_t);
-    for (int i = 0; i < room->num_walls; ++i) {
-      room->walls[i] = AZ_LIST_GET(eroom->walls, i)->spec;
-    }
+    if (key < state->audit.num_rooms &&
+        eroom->audited_revision == eroom->revision) continue;
+    keys[index] = key;
+    convert_room(eroom, &rooms[index]);
+    eroom->audited_revision = eroom->revision;
+    ++index;
   }
-  assert(num_rooms_to_save_so_far == num_rooms_to_save);
+  assert(index == num_changed);
+  az_update_audit(&state->audit, state->planet.on_start, num_rooms,
+                  num_changed, keys, rooms);
+  for (int i = 0; i < num_changed; ++i) az_destroy_room(&rooms[i]);
+  az_free(rooms);
+  az_free(keys);
+}
+
+bool az_save_editor_state(az_editor_state_t *state, bool summarize) {
+  assert(state != NULL);
   // Summarize:
-  if (summarize) summarize_scenario(&planet);
-  // Write to disk:
-  const bool success =
-    az_save_planet(&planet, "data", rooms_to_save, num_rooms_to_save);
-  // Clean up:
-  free(rooms_to_save);
-  az_destroy_planet(&planet);
-  if (success) {
-    state->unsaved = false;
-    AZ_LIST_LOOP(room, state->planet.rooms) room->unsaved = false;
+  if (summarize) {
+    az_planet_t planet;
+    convert_planet(state, &planet);
+    update_audit(state);
+    summarize_scenario(&state->audit, &planet);
+    az_destroy_planet(&planet);
+  }
+  // Write each unsaved room to disk, one at a time, so that we never need to
+  // convert more than one room at once:
+  const int num_rooms = AZ_LIST_SIZE(state->planet.rooms);
+  for (az_room_key_t key = 0; key < num_rooms; ++key) {
+    az_editor_room_t *eroom = AZ_LIST_GET(state->planet.rooms, key);
+    if (!(SAVE_ALL_ROOMS || eroom->unsaved)) continue;
+    az_room_t room = {0};
+    convert_room(eroom, &room);
+    const bool success = az_save_planet_room(&room, "data", key);
+    az_destroy_room(&room);
+    if (!success) return false;
+    eroom->unsaved = false;
+  }
+  // Write the planet-level data, if it changed.  The planet.txt file doesn't
+  // include any rooms, so the planet we write it from can just borrow the
+  // editor's own arrays rather than copying them.
+  if (SAVE_ALL_ROOMS || state->planet_unsaved) {
+    const az_planet_t planet = {
+      .start_room = state->planet.start_room,
+      .on_start = state->planet.on_start,
+      .num_hints = AZ_LIST_SIZE(state->planet.hints),
+      .hints = state->planet.hints.items,
+      .num_paragraphs = AZ_LIST_SIZE(state->planet.paragraphs),
+      .paragraphs = state->planet.paragraphs.items,
+      .num_zones = AZ_LIST_SIZE(state->planet.zones),
+      .zones = state->planet.zones.items,
+      .num_rooms = num_rooms
+    };
+    if (!az_save_planet_header(&planet, "data")) return false;
+    state->planet_unsaved = false;
   }
-  return success;
+  state->unsaved = false;
+  return true;
 }
 
-/*===========================================================================*/
-
 void az_tick_editor_state(az_editor_state_t *state, double time) {
   ++state->clock;
   state->total_time += time;
+  if (state->clock % AUDIT_PERIOD_TICKS == 0) update_audit(state);
   const double scroll_speed = 300.0 * state->zoom_level * time;
   const double spin_radius = 80.0 * state->zoom_level;
 
@@ -697,8 +784,13 @@ void az_destroy_editor_state(az_editor_state_t *state) {
     AZ_LIST_LOOP(node, room->nodes) az_free_script(node->spec.on_use);
     AZ_LIST_DESTROY(room->nodes);
     AZ_LIST_DESTROY(room->walls);
+    az_destroy_circle_grid(&room->index);
+    az_free(room->index_walls);
+    az_destroy_circle_grid(&room->wall_index);
   }
   AZ_LIST_DESTROY(state->planet.rooms);
+  AZ_LIST_DESTROY(found_objects);
+  az_destroy_audit(&state->audit);
 }
 
 /*===========================================================================*/
@@ -728,32 +820,6 @@ int az_advance_wall_data_index(int wall_data_index, int delta) {
 
 /*===========================================================================*/
 
-bool az_circle_hits_editor_walls(
-    const az_editor_state_t *state, double circle_radius, az_vector_t start,
-    az_vector_t delta, az_vector_t *pos_out, az_vector_t *normal_out) {
-  az_editor_room_t *room =
-    AZ_LIST_GET(state->planet.rooms, state->current_room);
-  bool hit_anything = false;
-  AZ_LIST_LOOP(editor_wall, room->walls) {
-    const az_wall_t real_wall = {
-      .kind = editor_wall->spec.kind,
-      .data = editor_wall->spec.data,
-      .position = editor_wall->spec.position,
-      .angle = editor_wall->spec.angle
-    };
-    az_vector_t pos;
-    if (az_circle_hits_wall(&real_wall, circle_radius, start, delta,
-                            &pos, normal_out)) {
-      if (pos_out != NULL) *pos_out = pos;
-      delta = az_vsub(pos, start);
-      hit_anything = true;
-    }
-  }
-  return hit_anything;
-}
-
-/*===========================================================================*/
-
 bool az_editor_object_next(az_editor_object_t *object) {
   az_editor_room_t *room = object->room;
   ++object->index;
@@ -820,4 +886,129 @@ bool az_editor_object_next(az_editor_object_t *object) {
   AZ_ASSERT_UNREACHABLE();
 }
 
+static double editor_object_bounding_radius(const az_editor_object_t *object) {
+  az_editor_room_t *room = object->room;
+  switch (object->type) {
+    case AZ_EOBJ_NOTHING: AZ_ASSERT_UNREACHABLE();
+    case AZ_EOBJ_BADDIE:
+      return az_get_baddie_data(AZ_LIST_GET(room->baddies, object->index)->
+                                spec.kind)->overall_bounding_radius;
+    case AZ_EOBJ_DOOR:
+      return AZ_DOOR_BOUNDING_RADIUS;
+    case AZ_EOBJ_GRAVFIELD: {
+      const az_gravfield_spec_t *spec =
+        &AZ_LIST_GET(room->gravfields, object->index)->spec;
+      const az_gravfield_t gravfield = {
+        .kind = spec->kind, .position = spec->position, .angle = spec->angle,
+        .strength = spec->strength, .size = spec->size
+      };
+      return az_gravfield_bounding_radius(&gravfield);
+    }
+    case AZ_EOBJ_NODE:
+      return AZ_NODE_BOUNDING_RADIUS;
+    case AZ_EOBJ_WALL:
+      return AZ_LIST_GET(room->walls, object->index)->spec.data->
+        bounding_radius;
+  }
+  AZ_ASSERT_UNREACHABLE();
+}
+
+static int count_editor_objects(const az_editor_room_t *room) {
+  return AZ_LIST_SIZE(room->baddies) + AZ_LIST_SIZE(room->doors) +
+    AZ_LIST_SIZE(room->gravfields) + AZ_LIST_SIZE(room->nodes) +
+    AZ_LIST_SIZE(room->walls);
+}
+
+static void rebuild_room_index(az_editor_room_t *room) {
+  const int num_objects = count_editor_objects(room);
+  az_grid_circle_t *circles = AZ_ALLOC(num_objects, az_grid_circle_t);
+  int num_circles = 0;
+  AZ_EDITOR_OBJECT_LOOP(object, room) {
+    circles[num_circles].center = *object.position;
+    circles[num_circles].radius = editor_object_bounding_radius(&object);
+    ++num_circles;
+  }
+  assert(num_circles == num_objects);
+  az_build_circle_grid(&room->index, num_circles, circles,
+                       MIN_INDEX_CELL_SIZE);
+  // The walls come last in AZ_EDITOR_OBJECT_LOOP order, so their circles are
+  // already at the end of the array:
+  const int num_walls = AZ_LIST_SIZE(room->walls);
+  az_free(room->index_walls);
+  room->index_walls = AZ_ALLOC(num_walls, az_wall_t);
+  for (int i = 0; i < num_walls; ++i) {
+    const az_editor_wall_t *editor_wall = AZ_LIST_GET(room->walls, i);
+    room->index_walls[i] = (az_wall_t){
+      .kind = editor_wall->spec.kind,
+      .data = editor_wall->spec.data,
+      .position = editor_wall->spec.position,
+      .angle = editor_wall->spec.angle
+    };
+  }
+  az_build_circle_grid(&room->wall_index, num_walls,
+                       circles + (num_objects - num_walls),
+                       MIN_INDEX_CELL_SIZE);
+  az_free(circles);
+  room->index_valid = true;
+}
+
+static void ensure_room_index(az_editor_room_t *room) {
+  // Adding or removing objects without invalidating the index would leave it
+  // pointing at the wrong objects, so double-check the count too.
+  if (!room->index_valid ||
+      room->index.num_circles != count_editor_objects(room)) {
+    rebuild_room_index(room);
+  }
+}
+
+// Get the object at the given position in AZ_EDITOR_OBJECT_LOOP order.
+static az_editor_object_t get_editor_object(az_editor_room_t *room,
+                                            int position) {
+  const struct { az_editor_object_type_t type; int count; } runs[] = {
+    {AZ_EOBJ_BADDIE, AZ_LIST_SIZE(room->baddies)},
+    {AZ_EOBJ_DOOR, AZ_LIST_SIZE(room->doors)},
+    {AZ_EOBJ_GRAVFIELD, AZ_LIST_SIZE(room->gravfields)},
+    {AZ_EOBJ_NODE, AZ_LIST_SIZE(room->nodes)},
+    {AZ_EOBJ_WALL, AZ_LIST_SIZE(room->walls)}
+  };
+  AZ_ARRAY_LOOP(run, runs) {
+    if (position < run->count) {
+      az_editor_object_t object = {
+        .room = room, .type = run->type, .index = position - 1
+      };
+      if (!az_editor_object_next(&object)) AZ_ASSERT_UNREACHABLE();
+      return object;
+    }
+    position -= run->count;
+  }
+  AZ_ASSERT_UNREACHABLE();
+}
+
+int az_find_editor_objects(az_editor_room_t *room, az_vector_t min_corner,
+                           az_vector_t max_corner,
+                           const az_editor_object_t **objects_out) {
+  ensure_room_index(room);
+  const int *positions;
+  const int num_found =
+    az_query_circle_grid(&room->index, min_corner, max_corner, &positions);
+  AZ_LIST_DESTROY(found_objects);
+  AZ_LIST_INIT(found_objects, num_found);
+  for (int i = 0; i < num_found; ++i) {
+    *AZ_LIST_ADD(found_objects) = get_editor_object(room, positions[i]);
+  }
+  *objects_out = found_objects.items;
+  return num_found;
+}
+
+bool az_circle_hits_editor_walls(
+    const az_editor_state_t *state, double circle_radius, az_vector_t start,
+    az_vector_t delta, az_vector_t *pos_out, az_vector_t *normal_out) {
+  az_editor_room_t *room =
+    AZ_LIST_GET(state->planet.rooms, state->current_room);
+  ensure_room_index(room);
+  return az_circle_hits_walls(room->index_walls, AZ_LIST_SIZE(room->walls),
+                              &room->wall_index, circle_radius, start, delta,
+                              pos_out, normal_out);
+}
+
 /*===========================================================================*/
@@ -28,7 +28,9 @@
 #include "azimuth/state/upgrade.h"
 #include "azimuth/state/wall.h"
 #include "azimuth/util/clock.h"
+#include "azimuth/util/grid.h"
 #include "azimuth/util/vector.h"
+#include "editor/audit.h"
 #include "editor/list.h"
 
 /*===========================================================================*/
@@ -114,6 +116,8 @@ typedef struct {
 typedef struct {
   bool selected;
   bool unsaved; // true if this room currently has unsaved changes
+  int revision; // incremented whenever the room changes, to expire caches
+  int audited_revision; // the revision that the audit results are for
   az_editor_room_label_t label;
   az_zone_key_t zone_key;
   az_room_flags_t properties;
@@ -126,12 +130,24 @@ typedef struct {
   AZ_LIST_DECLARE(az_editor_gravfield_t, gravfields);
   AZ_LIST_DECLARE(az_editor_node_t, nodes);
   AZ_LIST_DECLARE(az_editor_wall_t, walls);
+  // Spatial index of the objects' bounding circles, used for picking, and of
+  // just the walls (converted to az_wall_t), used for collision checks.  These
+  // are rebuilt on demand whenever index_valid is false, so clear that after
+  // adding, removing, moving, or resizing any objects.
+  bool index_valid;
+  az_circle_grid_t index;
+  az_wall_t *index_walls;
+  az_circle_grid_t wall_index;
 } az_editor_room_t;
 
 typedef struct {
   az_clock_t clock;
   double total_time;
   bool unsaved; // true if _anything_ currently has unsaved changes
+  // True if the planet-level data (anything other than the contents of the
+  // rooms, including the number of rooms) has unsaved changes:
+  bool planet_unsaved;
+  int planet_revision; // incremented whenever the planet-level data changes
   bool spin_camera;
   az_vector_t camera;
   double zoom_level;
@@ -176,6 +192,10 @@ typedef struct {
     AZ_LIST_DECLARE(az_zone_t, zones);
     AZ_LIST_DECLARE(az_editor_room_t, rooms);
   } planet;
+  // Audit results for the planet, kept up to date (for any rooms that change)
+  // as the planet is edited:
+  az_audit_t audit;
+  int audited_planet_revision; // the planet revision the audit results are for
 } az_editor_state_t;
 
 /*===========================================================================*/
@@ -183,15 +203,26 @@ typedef struct {
 // Load and initialize the editor state from disk.  Return false on failure.
 bool az_load_editor_state(az_editor_state_t *state);
 
-// Save the editor state to disk.  Return false on failure, otherwise set
-// state->unsaved to false and return true.  If summarize is true, also print
-// some summary info about the scenario to the console.
+// Save the editor state to disk, writing only the rooms that have unsaved
+// changes (and the planet-level data, only if that has changed).  Return false
+// on failure, otherwise set state->unsaved to false and return true.  If
+// summarize is true, also print some summary info about the scenario to the
+// console.
 bool az_save_editor_state(az_editor_state_t *state, bool summarize);
 
 void az_tick_editor_state(az_editor_state_t *state, double time);
 
 void az_relabel_editor_room(az_editor_room_t *room);
 
+// Record that the room has been changed: mark it (and the state) as unsaved,
+// expire its cached data, and relabel it.
+void az_set_editor_room_unsaved(az_editor_state_t *state,
+                                az_editor_room_t *room);
+
+// Record that the planet-level data has been changed: mark it (and the state)
+// as unsaved, and expire the audit results that depend on it.
+void az_set_editor_planet_unsaved(az_editor_state_t *state);
+
 void az_clear_clipboard(az_editor_state_t *state);
 
 void az_init_editor_text(
@@ -212,6 +243,9 @@ int az_advance_wall_data_index(int wall_data_index, int delta);
 
 /*===========================================================================*/
 
+// Like az_circle_hits_walls, for the walls in the current room.  (This may
+// rebuild the current room's cached spatial index, but doesn't otherwise
+// change the state.)
 bool az_circle_hits_editor_walls(
     const az_editor_state_t *state, double circle_radius, az_vector_t start,
     az_vector_t delta, az_vector_t *point_out, az_vector_t *normal_out);
@@ -233,6 +267,15 @@ typedef struct {
 
 bool az_editor_object_next(az_editor_object_t *object);
 
+// Find the objects in the room whose bounding circles might overlap the given
+// box (rebuilding the room's spatial index first if necessary), in the same
+// order that AZ_EDITOR_OBJECT_LOOP would visit them.  Returns the number of
+// objects found, and sets *objects_out to point to them; that array remains
+// valid until the next call.
+int az_find_editor_objects(az_editor_room_t *room, az_vector_t min_corner,
+                           az_vector_t max_corner,
+                           const az_editor_object_t **objects_out);
+
 /*===========================================================================*/
 
 #endif // EDITOR_STATE_H_
@@ -0,0 +1,786 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#include "editor/undo.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "azimuth/constants.h"
+#include "azimuth/state/room.h"
+#include "azimuth/state/script.h"
+#include "azimuth/util/misc.h"
+#include "azimuth/util/vector.h"
+#include "editor/list.h"
+#include "editor/state.h"
+
+/*===========================================================================*/
+
+typedef enum {
+  // Payload is the object's old position and angle.
+  AZ_UNDO_TRANSFORM,
+  // Payload is the object's old spec (ignoring its script).
+  AZ_UNDO_MODIFY,
+  // Payload is the old script (which the record owns).
+  AZ_UNDO_SCRIPT,
+  // Payload is the room's old attributes.
+  AZ_UNDO_ROOM,
+  // Payload is the object's spec while it's not in the room (which is while
+  // the step is undone for inserts, or while it is done for removes).
+  AZ_UNDO_INSERT,
+  AZ_UNDO_REMOVE,
+  // No payload; the object moved from index to other_index.
+  AZ_UNDO_MOVE
+} az_undo_record_kind_t;
+
+// Each record is stored packed in the history's bytes as this header,
+// followed immediately by its payload (if any).
+typedef struct {
+  unsigned char kind; // an az_undo_record_kind_t
+  unsigned char type; // an az_editor_object_type_t
+  unsigned short room_key;
+  unsigned short index;
+  unsigned short other_index;
+} az_undo_record_t;
+
+AZ_STATIC_ASSERT(AZ_MAX_NUM_ROOMS <= 0xffff);
+AZ_STATIC_ASSERT(AZ_MAX_NUM_WALLS <= 0xffff);
+
+typedef struct {
+  az_vector_t position;
+  double angle;
+} az_undo_pose_t;
+
+typedef struct {
+  az_zone_key_t zone_key;
+  az_room_flags_t properties;
+  az_flag_t marker_flag;
+  az_background_pattern_t background_pattern;
+  az_camera_bounds_t camera_bounds;
+} az_undo_room_attrs_t;
+
+typedef union {
+  az_baddie_spec_t baddie;
+  az_door_spec_t door;
+  az_gravfield_spec_t gravfield;
+  az_node_spec_t node;
+  az_wall_spec_t wall;
+} az_undo_spec_t;
+
+/*===========================================================================*/
+
+static size_t spec_size(az_editor_object_type_t type) {
+  switch (type) {
+    case AZ_EOBJ_NOTHING: break;
+    case AZ_EOBJ_BADDIE: return sizeof(az_baddie_spec_t);
+    case AZ_EOBJ_DOOR: return sizeof(az_door_spec_t);
+    case AZ_EOBJ_GRAVFIELD: return sizeof(az_gravfield_spec_t);
+    case AZ_EOBJ_NODE: return sizeof(az_node_spec_t);
+    case AZ_EOBJ_WALL: return sizeof(az_wall_spec_t);
+  }
+  AZ_ASSERT_UNREACHABLE();
+}
+
+static void *get_spec(az_editor_room_t *room, az_editor_object_type_t type,
+                      int index) {
+  switch (type) {
+    case AZ_EOBJ_NOTHING: break;
+    case AZ_EOBJ_BADDIE: return &AZ_LIST_GET(room->baddies, index)->spec;
+    case AZ_EOBJ_DOOR: return &AZ_LIST_GET(room->doors, index)->spec;
+    case AZ_EOBJ_GRAVFIELD:
+      return &AZ_LIST_GET(room->gravfields, index)->spec;
+    case AZ_EOBJ_NODE: return &AZ_LIST_GET(room->nodes, index)->spec;
+    case AZ_EOBJ_WALL: return &AZ_LIST_GET(room->walls, index)->spec;
+  }
+  AZ_ASSERT_UNREACHABLE();
+}
+
+// Return a pointer to the spec's script field, or NULL if this type of object
+// has no script.
+static az_script_t **get_spec_script(void *spec,
+                                     az_editor_object_type_t type) {
+  switch (type) {
+    case AZ_EOBJ_NOTHING: break;
+    case AZ_EOBJ_BADDIE: return &((az_baddie_spec_t *)spec)->on_kill;
+    case AZ_EOBJ_DOOR: return &((az_door_spec_t *)spec)->on_open;
+    case AZ_EOBJ_GRAVFIELD:
+      return &((az_gravfield_spec_t *)spec)->on_enter;
+    case AZ_EOBJ_NODE: return &((az_node_spec_t *)spec)->on_use;
+    case AZ_EOBJ_WALL: return NULL;
+  }
+  AZ_ASSERT_UNREACHABLE();
+}
+
+static void get_spec_pose(void *spec, az_editor_object_type_t type,
+                          az_vector_t **position_out, double **angle_out) {
+  switch (type) {
+    case AZ_EOBJ_NOTHING: AZ_ASSERT_UNREACHABLE();
+#define GET_POSE(spec_type) do { \
+      spec_type *typed_spec = spec; \
+      *position_out = &typed_spec->position; \
+      *angle_out = &typed_spec->angle; \
+    } while (0)
+    case AZ_EOBJ_BADDIE: GET_POSE(az_baddie_spec_t); break;
+    case AZ_EOBJ_DOOR: GET_POSE(az_door_spec_t); break;
+    case AZ_EOBJ_GRAVFIELD: GET_POSE(az_gravfield_spec_t); break;
+    case AZ_EOBJ_NODE: GET_POSE(az_node_spec_t); break;
+    case AZ_EOBJ_WALL: GET_POSE(az_wall_spec_t); break;
+#undef GET_POSE
+  }
+}
+
+static void set_selected(az_editor_room_t *room, az_editor_object_type_t type,
+                         int index) {
+  switch (type) {
+    case AZ_EOBJ_NOTHING: break;
+    case AZ_EOBJ_BADDIE:
+      AZ_LIST_GET(room->baddies, index)->selected = true; break;
+    case AZ_EOBJ_DOOR:
+      AZ_LIST_GET(room->doors, index)->selected = true; break;
+    case AZ_EOBJ_GRAVFIELD:
+      AZ_LIST_GET(room->gravfields, index)->selected = true; break;
+    case AZ_EOBJ_NODE:
+      AZ_LIST_GET(room->nodes, index)->selected = true; break;
+    case AZ_EOBJ_WALL:
+      AZ_LIST_GET(room->walls, index)->selected = true; break;
+  }
+}
+
+static void deselect_room(az_editor_room_t *room) {
+  AZ_EDITOR_OBJECT_LOOP(object, room) *object.selected = false;
+}
+
+// Insert a new (selected) object with the given spec into its list.
+static void insert_object(az_editor_room_t *room,
+                          az_editor_object_type_t type, int index,
+                          const void *spec) {
+#define INSERT(obj) do { \
+    AZ_LIST_ADD(room->obj##s); \
+    az_editor_##obj##_t *item = AZ_LIST_GET(room->obj##s, index); \
+    memmove(item + 1, item, \
+            (AZ_LIST_SIZE(room->obj##s) - 1 - index) * sizeof(*item)); \
+    item->selected = true; \
+    memcpy(&item->spec, spec, sizeof(item->spec)); \
+  } while (0)
+  switch (type) {
+    case AZ_EOBJ_NOTHING: AZ_ASSERT_UNREACHABLE();
+    case AZ_EOBJ_BADDIE: INSERT(baddie); break;
+    case AZ_EOBJ_DOOR: INSERT(door); break;
+    case AZ_EOBJ_GRAVFIELD: INSERT(gravfield); break;
+    case AZ_EOBJ_NODE: INSERT(node); break;
+    case AZ_EOBJ_WALL: INSERT(wall); break;
+  }
+#undef INSERT
+}
+
+// Remove an object from its list, copying its spec into spec_out.
+static void remove_object(az_editor_room_t *room,
+                          az_editor_object_type_t type, int index,
+                          void *spec_out) {
+#define REMOVE(obj) do { \
+    az_editor_##obj##_t *item = AZ_LIST_GET(room->obj##s, index); \
+    memcpy(spec_out, &item->spec, sizeof(item->spec)); \
+    AZ_LIST_REMOVE(room->obj##s, item); \
+  } while (0)
+  switch (type) {
+    case AZ_EOBJ_NOTHING: AZ_ASSERT_UNREACHABLE();
+    case AZ_EOBJ_BADDIE: REMOVE(baddie); break;
+    case AZ_EOBJ_DOOR: REMOVE(door); break;
+    case AZ_EOBJ_GRAVFIELD: REMOVE(gravfield); break;
+    case AZ_EOBJ_NODE: REMOVE(node); break;
+    case AZ_EOBJ_WALL: REMOVE(wall); break;
+  }
+#undef REMOVE
+}
+
+// Move an object within its list (keeping its selection state), shifting the
+// objects in between over by one.
+static void move_object(az_editor_room_t *room, az_editor_object_type_t type,
+                        int from, int to) {
+#define MOVE(obj) do { \
+    az_editor_##obj##_t *src = AZ_LIST_GET(room->obj##s, from); \
+    az_editor_##obj##_t *dest = AZ_LIST_GET(room->obj##s, to); \
+    const az_editor_##obj##_t temp = *src; \
+    if (from < to) memmove(src, src + 1, (to - from) * sizeof(temp)); \
+    else memmove(dest + 1, dest, (from - to) * sizeof(temp)); \
+    *dest = temp; \
+  } while (0)
+  switch (type) {
+    case AZ_EOBJ_NOTHING: AZ_ASSERT_UNREACHABLE();
+    case AZ_EOBJ_BADDIE: MOVE(baddie); break;
+    case AZ_EOBJ_DOOR: MOVE(door); break;
+    case AZ_EOBJ_GRAVFIELD: MOVE(gravfield); break;
+    case AZ_EOBJ_NODE: MOVE(node); break;
+    case AZ_EOBJ_WALL: MOVE(wall); break;
+  }
+#undef MOVE
+}
+
+static az_undo_room_attrs_t get_room_attrs(const az_editor_room_t *room) {
+  return (az_undo_room_attrs_t){
+    .zone_key = room->zone_key, .properties = room->properties,
+    .marker_flag = room->marker_flag,
+    .background_pattern = room->background_pattern,
+    .camera_bounds = room->camera_bounds
+  };
+}
+
+static void set_room_attrs(az_editor_room_t *room,
+                           const az_undo_room_attrs_t *attrs) {
+  room->zone_key = attrs->zone_key;
+  room->properties = attrs->properties;
+  room->marker_flag = attrs->marker_flag;
+  room->background_pattern = attrs->background_pattern;
+  room->camera_bounds = attrs->camera_bounds;
+}
+
+static size_t script_size(const az_script_t *script) {
+  if (script == NULL) return 0;
+  return sizeof(az_script_t) +
+    script->num_instructions * sizeof(az_instruction_t);
+}
+
+/*===========================================================================*/
+
+static size_t payload_size(const az_undo_record_t *record) {
+  switch ((az_undo_record_kind_t)record->kind) {
+    case AZ_UNDO_TRANSFORM: return sizeof(az_undo_pose_t);
+    case AZ_UNDO_MODIFY:
+    case AZ_UNDO_INSERT:
+    case AZ_UNDO_REMOVE:
+      return spec_size(record->type);
+    case AZ_UNDO_SCRIPT: return sizeof(az_script_t *);
+    case AZ_UNDO_ROOM: return sizeof(az_undo_room_attrs_t);
+    case AZ_UNDO_MOVE: return 0;
+  }
+  AZ_ASSERT_UNREACHABLE();
+}
+
+// Read the record header at the given offset, and return the offset of the
+// next record.
+static size_t read_record(const az_undo_history_t *history, size_t offset,
+                          az_undo_record_t *record_out) {
+  assert(offset + sizeof(*record_out) <= history->num_bytes);
+  memcpy(record_out, history->bytes + offset, sizeof(*record_out));
+  return offset + sizeof(*record_out) + payload_size(record_out);
+}
+
+static size_t step_end(const az_undo_history_t *history, int step_index) {
+  return (step_index + 1 < AZ_LIST_SIZE(history->steps) ?
+          AZ_LIST_GET(history->steps, step_index + 1)->begin :
+          history->num_bytes);
+}
+
+// Approximately how much memory the history is using.
+static size_t total_size(az_undo_history_t *history) {
+  size_t total = history->num_bytes +
+    AZ_LIST_SIZE(history->steps) * sizeof(az_undo_step_t);
+  AZ_LIST_LOOP(step, history->steps) total += step->script_bytes;
+  return total;
+}
+
+// Free the scripts that the step's records currently own, given whether the
+// step is currently done (as opposed to undone).
+static void free_step_scripts(az_undo_history_t *history, int step_index,
+                              bool done) {
+  const size_t end = step_end(history, step_index);
+  size_t offset = AZ_LIST_GET(history->steps, step_index)->begin;
+  while (offset < end) {
+    az_undo_record_t record;
+    const size_t next = read_record(history, offset, &record);
+    unsigned char *payload = history->bytes + offset + sizeof(record);
+    az_script_t *script = NULL;
+    if (record.kind == AZ_UNDO_SCRIPT) {
+      memcpy(&script, payload, sizeof(script));
+    } else if ((record.kind == AZ_UNDO_INSERT && !done) ||
+               (record.kind == AZ_UNDO_REMOVE && done)) {
+      az_undo_spec_t spec;
+      memcpy(&spec, payload, spec_size(record.type));
+      az_script_t **script_ptr = get_spec_script(&spec, record.type);
+      if (script_ptr != NULL) script = *script_ptr;
+    }
+    az_free_script(script);
+    offset = next;
+  }
+}
+
+static void discard_redo_steps(az_undo_history_t *history) {
+  while (AZ_LIST_SIZE(history->steps) > history->num_done) {
+    const int step_index = AZ_LIST_SIZE(history->steps) - 1;
+    az_undo_step_t *step = AZ_LIST_GET(history->steps, step_index);
+    free_step_scripts(history, step_index, false);
+    history->num_bytes = step->begin;
+    AZ_LIST_REMOVE(history->steps, step);
+  }
+}
+
+static void discard_oldest_step(az_undo_history_t *history) {
+  assert(history->num_done > 0);
+  free_step_scripts(history, 0, true);
+  const size_t shift = step_end(history, 0);
+  memmove(history->bytes, history->bytes + shift,
+          history->num_bytes - shift);
+  history->num_bytes -= shift;
+  AZ_LIST_REMOVE(history->steps, AZ_LIST_GET(history->steps, 0));
+  AZ_LIST_LOOP(step, history->steps) {
+    step->begin -= shift;
+    step->merge_begin -= shift;
+  }
+  --history->num_done;
+}
+
+static void resize_bytes(az_undo_history_t *history, size_t new_max) {
+  assert(new_max >= history->num_bytes);
+  if (new_max == 0) {
+    free(history->bytes);
+    history->bytes = NULL;
+  } else {
+    unsigned char *new_bytes = realloc(history->bytes, new_max);
+    if (new_bytes == NULL) AZ_FATAL("Out of memory.\n");
+    history->bytes = new_bytes;
+  }
+  history->max_bytes = new_max;
+}
+
+/*===========================================================================*/
+// Noted records:
+
+static uint64_t noted_key(az_undo_record_kind_t kind, int room_key,
+                          az_editor_object_type_t type, int index) {
+  return (uint64_t)kind | ((uint64_t)type << 4) | ((uint64_t)room_key << 8) |
+    ((uint64_t)index << 24);
+}
+
+static size_t hash_noted_key(uint64_t key) {
+  return (size_t)((key * UINT64_C(0x9e3779b97f4a7c15)) >> 32);
+}
+
+// Empty the set of noted records (this must be done whenever the current
+// step's merge_begin changes).
+static void forget_noted_records(az_undo_history_t *history) {
+  history->num_noted = 0;
+  ++history->noted_generation;
+  // If the generation wraps around, old entries could look current again.
+  if (history->noted_generation == 0) {
+    if (history->noted != NULL) {
+      memset(history->noted, 0, history->max_noted * sizeof(az_undo_noted_t));
+    }
+    history->noted_generation = 1;
+  }
+}
+
+// Return the set's slot for the key, which is either the slot holding the key
+// or the empty slot where it would go.  The set must not be full.
+static az_undo_noted_t *find_noted_slot(const az_undo_history_t *history,
+                                        uint64_t key) {
+  assert(history->num_noted < history->max_noted);
+  const size_t mask = history->max_noted - 1;
+  for (size_t i = hash_noted_key(key) & mask; true; i = (i + 1) & mask) {
+    az_undo_noted_t *slot = &history->noted[i];
+    if (slot->generation != history->noted_generation ||
+        slot->key == key) return slot;
+  }
+}
+
+static bool is_noted(const az_undo_history_t *history, uint64_t key) {
+  if (history->num_noted == 0) return false;
+  const az_undo_noted_t *slot = find_noted_slot(history, key);
+  return (slot->generation == history->noted_generation);
+}
+
+static void note_record(az_undo_history_t *history, uint64_t key) {
+  if (2 * (history->num_noted + 1) > history->max_noted) {
+    az_undo_noted_t *old_noted = history->noted;
+    const size_t old_max = history->max_noted;
+    history->max_noted = (old_max == 0 ? 64 : 2 * old_max);
+    history->noted = AZ_ALLOC(history->max_noted, az_undo_noted_t);
+    history->num_noted = 0;
+    for (size_t i = 0; i < old_max; ++i) {
+      if (old_noted[i].generation != history->noted_generation) continue;
+      *find_noted_slot(history, old_noted[i].key) = old_noted[i];
+      ++history->num_noted;
+    }
+    az_free(old_noted);
+  }
+  az_undo_noted_t *slot = find_noted_slot(history, key);
+  if (slot->generation == history->noted_generation) return;
+  slot->key = key;
+  slot->generation = history->noted_generation;
+  ++history->num_noted;
+}
+
+/*===========================================================================*/
+
+void az_init_undo_history(az_undo_history_t *history,
+                          az_editor_state_t *state, size_t budget) {
+  AZ_ZERO_OBJECT(history);
+  history->state = state;
+  history->budget = budget;
+  history->noted_generation = 1;
+  AZ_LIST_INIT(history->steps, 0);
+}
+
+void az_clear_undo_history(az_undo_history_t *history) {
+  assert(!history->step_open);
+  discard_redo_steps(history);
+  while (history->num_done > 0) discard_oldest_step(history);
+  assert(history->num_bytes == 0);
+  resize_bytes(history, 0);
+  history->can_merge = false;
+  forget_noted_records(history);
+}
+
+void az_destroy_undo_history(az_undo_history_t *history) {
+  az_clear_undo_history(history);
+  AZ_LIST_DESTROY(history->steps);
+  az_free(history->noted);
+}
+
+void az_begin_undo_step(az_undo_history_t *history, int merge_key) {
+  assert(!history->recording);
+  history->recording = true;
+  history->step_open = false;
+  history->merge_key = merge_key;
+}
+
+void az_end_undo_step(az_undo_history_t *history) {
+  assert(history->recording);
+  history->recording = false;
+  if (!history->step_open) return;
+  history->step_open = false;
+  history->can_merge = true;
+  // Drop the oldest steps until we're within budget.  If the newest step is
+  // too big all by itself, then we can't keep any steps at all.
+  while (total_size(history) > history->budget && history->num_done > 1) {
+    discard_oldest_step(history);
+  }
+  if (total_size(history) > history->budget) {
+    az_clear_undo_history(history);
+  } else if (history->max_bytes > history->budget &&
+             history->num_bytes <= history->max_bytes / 4) {
+    resize_bytes(history, history->max_bytes / 2);
+  }
+}
+
+/*===========================================================================*/
+
+// Swap the record's payload with the live state (undoing or redoing the
+// record), and select whatever object it changed.
+static void apply_record(az_undo_history_t *history, size_t offset,
+                         bool undo) {
+  az_undo_record_t record;
+  read_record(history, offset, &record);
+  unsigned char *payload = history->bytes + offset + sizeof(record);
+  const az_editor_object_type_t type = record.type;
+  const int index = record.index;
+  az_editor_room_t *room =
+    AZ_LIST_GET(history->state->planet.rooms, record.room_key);
+  switch ((az_undo_record_kind_t)record.kind) {
+    case AZ_UNDO_TRANSFORM: {
+      az_vector_t *position = NULL;
+      double *angle = NULL;
+      get_spec_pose(get_spec(room, type, index), type, &position, &angle);
+      az_undo_pose_t pose;
+      memcpy(&pose, payload, sizeof(pose));
+      const az_undo_pose_t live = {.position = *position, .angle = *angle};
+      memcpy(payload, &live, sizeof(live));
+      *position = pose.position;
+      *angle = pose.angle;
+      set_selected(room, type, index);
+    } break;
+    case AZ_UNDO_MODIFY: {
+      void *spec = get_spec(room, type, index);
+      const size_t size = spec_size(type);
+      az_undo_spec_t live;
+      memcpy(&live, spec, size);
+      memcpy(spec, payload, size);
+      memcpy(payload, &live, size);
+      // The script stays put; only AZ_UNDO_SCRIPT records change that.
+      az_script_t **script_ptr = get_spec_script(spec, type);
+      if (script_ptr != NULL) *script_ptr = *get_spec_script(&live, type);
+      set_selected(room, type, index);
+    } break;
+    case AZ_UNDO_SCRIPT: {
+      az_script_t **script_ptr = &room->on_start;
+      if (type != AZ_EOBJ_NOTHING) {
+        script_ptr = get_spec_script(get_spec(room, type, index), type);
+        set_selected(room, type, index);
+      }
+      az_script_t *script;
+      memcpy(&script, payload, sizeof(script));
+      memcpy(payload, script_ptr, sizeof(*script_ptr));
+      *script_ptr = script;
+    } break;
+    case AZ_UNDO_ROOM: {
+      az_undo_room_attrs_t attrs;
+      memcpy(&attrs, payload, sizeof(attrs));
+      const az_undo_room_attrs_t live = get_room_attrs(room);
+      memcpy(payload, &live, sizeof(live));
+      set_room_attrs(room, &attrs);
+    } break;
+    case AZ_UNDO_INSERT:
+      if (undo) remove_object(room, type, index, payload);
+      else insert_object(room, type, index, payload);
+      break;
+    case AZ_UNDO_REMOVE:
+      if (undo) insert_object(room, type, index, payload);
+      else remove_object(room, type, index, payload);
+      break;
+    case AZ_UNDO_MOVE:
+      if (undo) move_object(room, type, record.other_index, index);
+      else move_object(room, type, index, record.other_index);
+      break;
+  }
+  az_set_editor_room_unsaved(history->state, room);
+}
+
+static void apply_step(az_undo_history_t *history, int step_index,
+                       bool undo) {
+  az_editor_state_t *state = history->state;
+  // Find the records, clear the selection in the affected rooms, and check
+  // whether the step touches the current room.
+  AZ_LIST_DECLARE(size_t, offsets);
+  AZ_LIST_INIT(offsets, 16);
+  bool touches_current_room = false;
+  int first_room_key = -1, last_room_key = -1;
+  const size_t end = step_end(history, step_index);
+  size_t offset = AZ_LIST_GET(history->steps, step_index)->begin;
+  while (offset < end) {
+    *AZ_LIST_ADD(offsets) = offset;
+    az_undo_record_t record;
+    offset = read_record(history, offset, &record);
+    if (record.room_key != last_room_key) {
+      last_room_key = record.room_key;
+      if (first_room_key < 0) first_room_key = record.room_key;
+      if (record.room_key == state->current_room) {
+        touches_current_room = true;
+      }
+      deselect_room(AZ_LIST_GET(state->planet.rooms, record.room_key));
+    }
+  }
+  assert(offset == end);
+  // Undo the records in reverse order, or redo them in forward order.
+  const int num_records = AZ_LIST_SIZE(offsets);
+  for (int i = 0; i < num_records; ++i) {
+    const int record_index = (undo ? num_records - 1 - i : i);
+    apply_record(history, *AZ_LIST_GET(offsets, record_index), undo);
+  }
+  AZ_LIST_DESTROY(offsets);
+  // Make sure the change is visible.
+  if (!touches_current_room && first_room_key >= 0) {
+    state->current_room = first_room_key;
+    AZ_LIST_LOOP(room, state->planet.rooms) room->selected = false;
+    az_editor_room_t *room = AZ_LIST_GET(state->planet.rooms, first_room_key);
+    room->selected = true;
+    state->brush.zone_key = room->zone_key;
+    az_center_editor_camera_on_current_room(state);
+  }
+}
+
+bool az_undo(az_undo_history_t *history) {
+  assert(!history->step_open);
+  if (history->num_done <= 0) return false;
+  --history->num_done;
+  apply_step(history, history->num_done, true);
+  history->can_merge = false;
+  return true;
+}
+
+bool az_redo(az_undo_history_t *history) {
+  assert(!history->step_open);
+  if (history->num_done >= AZ_LIST_SIZE(history->steps)) return false;
+  apply_step(history, history->num_done, false);
+  ++history->num_done;
+  history->can_merge = false;
+  return true;
+}
+
+/*===========================================================================*/
+
+static az_undo_step_t *open_step(az_undo_history_t *history) {
+  assert(history->recording);
+  if (!history->step_open) {
+    history->step_open = true;
+    discard_redo_steps(history);
+    const int num_steps = AZ_LIST_SIZE(history->steps);
+    if (history->merge_key == 0 || !history->can_merge || num_steps == 0 ||
+        AZ_LIST_GET(history->steps, num_steps - 1)->merge_key !=
+        history->merge_key) {
+      az_undo_step_t *step = AZ_LIST_ADD(history->steps);
+      step->merge_key = history->merge_key;
+      step->begin = step->merge_begin = history->num_bytes;
+      history->num_done = AZ_LIST_SIZE(history->steps);
+      forget_noted_records(history);
+    }
+  }
+  assert(history->num_done == AZ_LIST_SIZE(history->steps));
+  return AZ_LIST_GET(history->steps, history->num_done - 1);
+}
+
+static int get_room_key(const az_undo_history_t *history,
+                        const az_editor_room_t *room) {
+  const int room_key = room - history->state->planet.rooms.items;
+  assert(room_key >= 0);
+  assert(room_key < AZ_LIST_SIZE(history->state->planet.rooms));
+  return room_key;
+}
+
+#ifndef NDEBUG
+// Like has_record, but the slow way, for checking the noted-record set.
+static bool scan_for_record(const az_undo_history_t *history,
+                            const az_undo_step_t *step, int room_key,
+                            az_undo_record_kind_t kind,
+                            az_editor_object_type_t type, int index) {
+  size_t offset = step->merge_begin;
+  while (offset < history->num_bytes) {
+    az_undo_record_t record;
+    offset = read_record(history, offset, &record);
+    if (record.kind == kind && record.room_key == room_key &&
+        record.type == type && record.index == index) return true;
+  }
+  return false;
+}
+#endif
+
+// Return true if the current step already has a record of the given kind for
+// the given object, after which no objects were inserted/removed/moved (so
+// that the object's index still means the same thing).
+static bool has_record(az_undo_history_t *history, az_editor_room_t *room,
+                       az_undo_record_kind_t kind,
+                       az_editor_object_type_t type, int index) {
+  const az_undo_step_t *step = open_step(history);
+  const int room_key = get_room_key(history, room);
+  const bool noted =
+    is_noted(history, noted_key(kind, room_key, type, index));
+  assert(noted == scan_for_record(history, step, room_key, kind, type,
+                                  index));
+  (void)step;
+  return noted;
+}
+
+static void add_record(az_undo_history_t *history, az_editor_room_t *room,
+                       az_undo_record_kind_t kind,
+                       az_editor_object_type_t type, int index,
+                       int other_index, const void *payload, size_t size,
+                       size_t script_bytes) {
+  az_undo_step_t *step = open_step(history);
+  assert(index >= 0 && index <= 0xffff);
+  assert(other_index >= 0 && other_index <= 0xffff);
+  const az_undo_record_t record = {
+    .kind = kind, .type = type, .room_key = get_room_key(history, room),
+    .index = index, .other_index = other_index
+  };
+  assert(payload_size(&record) == size);
+  const size_t record_size = sizeof(record) + size;
+  if (history->num_bytes + record_size > history->max_bytes) {
+    size_t new_max = 2 * history->max_bytes + 1024;
+    if (new_max < history->num_bytes + record_size) {
+      new_max = history->num_bytes + record_size;
+    }
+    resize_bytes(history, new_max);
+  }
+  memcpy(history->bytes + history->num_bytes, &record, sizeof(record));
+  if (size > 0) {
+    memcpy(history->bytes + history->num_bytes + sizeof(record),
+           payload, size);
+  }
+  history->num_bytes += record_size;
+  step->script_bytes += script_bytes;
+  if (kind == AZ_UNDO_INSERT || kind == AZ_UNDO_REMOVE ||
+      kind == AZ_UNDO_MOVE) {
+    step->structural = true;
+    step->merge_begin = history->num_bytes;
+    forget_noted_records(history);
+  } else note_record(history, noted_key(kind, record.room_key, type, index));
+}
+
+void az_note_undo_transform(az_undo_history_t *history,
+                            const az_editor_object_t *object) {
+  // A transform or modify record for this object already covers this.
+  if (has_record(history, object->room, AZ_UNDO_TRANSFORM, object->type,
+                 object->index) ||
+      has_record(history, object->room, AZ_UNDO_MODIFY, object->type,
+                 object->index)) return;
+  const az_undo_pose_t pose = {
+    .position = *object->position, .angle = *object->angle
+  };
+  add_record(history, object->room, AZ_UNDO_TRANSFORM, object->type,
+             object->index, 0, &pose, sizeof(pose), 0);
+}
+
+void az_note_undo_modify(az_undo_history_t *history, az_editor_room_t *room,
+                         az_editor_object_type_t type, int index) {
+  if (has_record(history, room, AZ_UNDO_MODIFY, type, index)) return;
+  add_record(history, room, AZ_UNDO_MODIFY, type, index, 0,
+             get_spec(room, type, index), spec_size(type), 0);
+}
+
+void az_note_undo_script(az_undo_history_t *history, az_editor_room_t *room,
+                         az_editor_object_type_t type, int index) {
+  az_script_t **script_ptr = (type == AZ_EOBJ_NOTHING ? &room->on_start :
+      get_spec_script(get_spec(room, type, index), type));
+  assert(script_ptr != NULL);
+  // If we already saved an older script for this object, then the current
+  // one is just an intermediate version, and no longer needed.
+  if (has_record(history, room, AZ_UNDO_SCRIPT, type, index)) {
+    az_free_script(*script_ptr);
+    *script_ptr = NULL;
+    return;
+  }
+  add_record(history, room, AZ_UNDO_SCRIPT, type, index, 0, script_ptr,
+             sizeof(*script_ptr), script_size(*script_ptr));
+}
+
+void az_note_undo_room(az_undo_history_t *history, az_editor_room_t *room) {
+  if (has_record(history, room, AZ_UNDO_ROOM, AZ_EOBJ_NOTHING, 0)) return;
+  const az_undo_room_attrs_t attrs = get_room_attrs(room);
+  add_record(history, room, AZ_UNDO_ROOM, AZ_EOBJ_NOTHING, 0, 0,
+             &attrs, sizeof(attrs), 0);
+}
+
+static size_t spec_script_size(void *spec, az_editor_object_type_t type) {
+  az_script_t **script_ptr = get_spec_script(spec, type);
+  return (script_ptr == NULL ? 0 : script_size(*script_ptr));
+}
+
+void az_note_undo_remove(az_undo_history_t *history, az_editor_room_t *room,
+                         az_editor_object_type_t type, int index) {
+  void *spec = get_spec(room, type, index);
+  add_record(history, room, AZ_UNDO_REMOVE, type, index, 0, spec,
+             spec_size(type), spec_script_size(spec, type));
+}
+
+void az_note_undo_insert(az_undo_history_t *history, az_editor_room_t *room,
+                         az_editor_object_type_t type, int index) {
+  // The payload doesn't matter until the step is undone, at which point the
+  // removed object will be stored there.
+  void *spec = get_spec(room, type, index);
+  add_record(history, room, AZ_UNDO_INSERT, type, index, 0, spec,
+             spec_size(type), spec_script_size(spec, type));
+}
+
+void az_note_undo_move(az_undo_history_t *history, az_editor_room_t *room,
+                       az_editor_object_type_t type, int from, int to) {
+  if (from == to) return;
+  add_record(history, room, AZ_UNDO_MOVE, type, from, to, NULL, 0, 0);
+}
+
+/*===========================================================================*/
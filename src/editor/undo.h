@@ -0,0 +1,142 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#pragma once
+#ifndef EDITOR_UNDO_H_
+#define EDITOR_UNDO_H_
+
+#include <stdbool.h>
+#include <stddef.h> // for size_t
+#include <stdint.h>
+
+#include "editor/list.h"
+#include "editor/state.h"
+
+/*===========================================================================*/
+
+// The undo history records, for each undoable step, only the deltas that the
+// step made to individual objects (or room attributes), rather than copies of
+// whole rooms.  Each delta record stores the "other" version of whatever it
+// changed, so undoing or redoing a step just swaps that with the live version.
+
+typedef struct {
+  int merge_key;
+  bool structural; // true if the step inserts, removes, or reorders objects
+  size_t begin; // offset of the step's first record in the history's bytes
+  size_t merge_begin; // records before this offset can't be merged with
+  size_t script_bytes; // approximate size of scripts held by the records
+} az_undo_step_t;
+
+// An entry in the history's hash set of noted records (see below).  Entries
+// from older generations count as empty slots.
+typedef struct {
+  uint64_t key;
+  unsigned int generation;
+} az_undo_noted_t;
+
+typedef struct {
+  az_editor_state_t *state;
+  size_t budget; // the maximum number of bytes to use for the history
+  // Packed delta records for all steps, in order:
+  size_t num_bytes, max_bytes;
+  unsigned char *bytes;
+  // Steps before num_done can be undone; steps after can be redone:
+  AZ_LIST_DECLARE(az_undo_step_t, steps);
+  int num_done;
+  // The merge key for the step currently being recorded (if recording is
+  // true), and whether any changes have been noted for that step yet:
+  bool recording, step_open;
+  int merge_key;
+  bool can_merge; // false if the last step must not be merged into
+  // A hash set (with linear probing) of the records in the current step
+  // since its merge_begin, so that checking whether an object's change has
+  // already been noted doesn't require scanning the whole step.  Bumping the
+  // generation empties the set.
+  size_t num_noted, max_noted;
+  az_undo_noted_t *noted;
+  unsigned int noted_generation;
+} az_undo_history_t;
+
+/*===========================================================================*/
+
+void az_init_undo_history(az_undo_history_t *history,
+                          az_editor_state_t *state, size_t budget);
+
+// Delete all steps, freeing any scripts held by the history.
+void az_clear_undo_history(az_undo_history_t *history);
+
+void az_destroy_undo_history(az_undo_history_t *history);
+
+// Start/finish recording a step.  Changes noted in between become a single
+// undoable step (if nothing is noted, no step is added).  If merge_key is
+// nonzero and equal to that of the previous step (and nothing has been undone
+// since), the changes are merged into that step instead, so that e.g. a whole
+// mouse drag can be undone at once.  Finishing a step discards old steps as
+// necessary to keep the history within its budget.
+void az_begin_undo_step(az_undo_history_t *history, int merge_key);
+void az_end_undo_step(az_undo_history_t *history);
+
+// Undo the most recent step, or redo the most recently undone step.  Either
+// must be called while no changes have been noted for the current step.
+// Return false if there was nothing to undo/redo.
+bool az_undo(az_undo_history_t *history);
+bool az_redo(az_undo_history_t *history);
+
+/*===========================================================================*/
+
+// The below functions record changes for the current step.  The "before"
+// functions must be called just before making the change, and the "after"
+// functions just after.
+
+// Before changing the object's position and/or angle (and nothing else).
+void az_note_undo_transform(az_undo_history_t *history,
+                            const az_editor_object_t *object);
+
+// Before changing any fields of the object's spec other than its script.
+void az_note_undo_modify(az_undo_history_t *history, az_editor_room_t *room,
+                         az_editor_object_type_t type, int index);
+
+// Before replacing the object's script (or the room's on_start script, if type
+// is AZ_EOBJ_NOTHING).  The history takes ownership of the old script, so the
+// caller must not free it.
+void az_note_undo_script(az_undo_history_t *history, az_editor_room_t *room,
+                         az_editor_object_type_t type, int index);
+
+// Before changing the room's zone, properties, marker flag, camera bounds,
+// and/or background pattern.
+void az_note_undo_room(az_undo_history_t *history, az_editor_room_t *room);
+
+// Before removing the object from its list.  The history takes ownership of
+// the object's script, so the caller must not free it.  When removing several
+// objects of one type, call this in order of decreasing index.
+void az_note_undo_remove(az_undo_history_t *history, az_editor_room_t *room,
+                         az_editor_object_type_t type, int index);
+
+// After inserting the object into its list at the given index.
+void az_note_undo_insert(az_undo_history_t *history, az_editor_room_t *room,
+                         az_editor_object_type_t type, int index);
+
+// After moving the object at index from to index to (shifting the objects in
+// between over by one).
+void az_note_undo_move(az_undo_history_t *history, az_editor_room_t *room,
+                       az_editor_object_type_t type, int from, int to);
+
+/*===========================================================================*/
+
+#endif // EDITOR_UNDO_H_
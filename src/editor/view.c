@@ -21,6 +21,7 @@
 
 #include <assert.h>
 #include <math.h>
+#include <string.h> // for strcspn
 
 #include <GL/gl.h>
 
@@ -38,6 +39,7 @@
 #include "azimuth/view/string.h"
 #include "azimuth/view/util.h"
 #include "azimuth/view/wall.h"
+#include "editor/audit.h"
 #include "editor/list.h"
 #include "editor/state.h"
 
@@ -547,6 +549,113 @@ static void draw_room_minimap(az_editor_state_t *state,
   }
 }
 
+// When zoomed out at least this far (but not so far as minimap mode), rooms
+// other than the current one are drawn as simplified outlines, which are much
+// cheaper to draw than the full rooms, with all their animations and labels.
+#define OUTLINE_ZOOM_LEVEL 2.5
+
+// Cached display lists of the room outlines, indexed by room key.
+static struct {
+  bool compiled;
+  int revision; // the room revision that the display list was compiled from
+  GLuint display_list;
+} room_outlines[AZ_MAX_NUM_ROOMS];
+
+void az_init_editor_room_outlines(void) {
+  // Any display lists we had belonged to the old GL context, so just forget
+  // them; they'll be recompiled as needed.
+  AZ_ARRAY_LOOP(outline, room_outlines) {
+    outline->compiled = false;
+    outline->display_list = 0u;
+  }
+}
+
+static void outline_circle(az_vector_t center, double radius) {
+  glBegin(GL_LINE_LOOP); {
+    for (int i = 0; i < 360; i += 30) {
+      az_gl_vertex(az_vadd(center, az_vpolar(radius, AZ_DEG2RAD(i))));
+    }
+  } glEnd();
+}
+
+static void outline_polygon(az_polygon_t polygon, az_color_t color,
+                            az_vector_t position, double angle) {
+  glColor3ub(color.r, color.g, color.b);
+  glPushMatrix(); {
+    az_gl_translated(position);
+    az_gl_rotated(angle);
+    glBegin(GL_LINE_LOOP); {
+      for (int i = 0; i < polygon.num_vertices; ++i) {
+        az_gl_vertex(polygon.vertices[i]);
+      }
+    } glEnd();
+  } glPopMatrix();
+}
+
+static void compile_room_outline(az_editor_room_t *room, GLuint list) {
+  glNewList(list, GL_COMPILE); {
+    AZ_LIST_LOOP(gravfield, room->gravfields) {
+      glColor3f(0.5, 0, 1); // purple
+      draw_gravfield_border(&gravfield->spec);
+    }
+    AZ_LIST_LOOP(wall, room->walls) {
+      outline_polygon(wall->spec.data->polygon, wall->spec.data->color1,
+                      wall->spec.position, wall->spec.angle);
+    }
+    AZ_LIST_LOOP(node, room->nodes) {
+      switch (node->spec.kind) {
+        case AZ_NODE_NOTHING: AZ_ASSERT_UNREACHABLE();
+        case AZ_NODE_DOODAD_FG:
+        case AZ_NODE_DOODAD_BG:
+          break;
+        case AZ_NODE_FAKE_WALL_FG:
+        case AZ_NODE_FAKE_WALL_BG: {
+          const az_wall_data_t *data = node->spec.subkind.fake_wall;
+          outline_polygon(data->polygon, data->color1, node->spec.position,
+                          node->spec.angle);
+        } break;
+        case AZ_NODE_CONSOLE:
+        case AZ_NODE_TRACTOR:
+        case AZ_NODE_UPGRADE:
+        case AZ_NODE_MARKER:
+        case AZ_NODE_SECRET:
+          glColor3f(0, 1, 1); // cyan
+          outline_circle(node->spec.position, 0.5 * AZ_NODE_BOUNDING_RADIUS);
+          break;
+      }
+    }
+    AZ_LIST_LOOP(baddie, room->baddies) {
+      glColor3f(1, 0, 0); // red
+      outline_circle(baddie->spec.position, az_get_baddie_data(
+          baddie->spec.kind)->overall_bounding_radius);
+    }
+    AZ_LIST_LOOP(door, room->doors) {
+      glColor3f(1, 1, 1); // white
+      outline_circle(door->spec.position, AZ_DOOR_BOUNDING_RADIUS);
+    }
+  } glEndList();
+}
+
+// Draw a simplified outline of the room's contents, recompiling its cached
+// display list first if the room has changed since it was last compiled.
+static void draw_room_outline(az_editor_room_t *room, az_room_key_t key) {
+  assert(key >= 0 && key < AZ_MAX_NUM_ROOMS);
+  if (!room_outlines[key].compiled ||
+      room_outlines[key].revision != room->revision) {
+    if (room_outlines[key].display_list == 0u) {
+      room_outlines[key].display_list = glGenLists(1);
+      if (room_outlines[key].display_list == 0u) {
+        AZ_FATAL("glGenLists failed.\n");
+      }
+    }
+    compile_room_outline(room, room_outlines[key].display_list);
+    room_outlines[key].compiled = true;
+    room_outlines[key].revision = room->revision;
+  }
+  glCallList(room_outlines[key].display_list);
+  draw_camera_edge_bounds(room);
+}
+
 static void draw_selection_circle(az_vector_t position, double angle,
                                   double radius) {
   glPushMatrix(); {
@@ -593,10 +702,13 @@ static void draw_camera_view(az_editor_state_t *state) {
     if (az_mod2pi_nonneg(camera_theta -
                          (bounds->min_theta - 0.5 * extra_theta_span)) >
         bounds->theta_span + extra_theta_span) continue;
-    // Draw the room.
+    // Draw the room, in less detail if we're zoomed out.
     if (!az_editor_is_in_minimap_mode(state)) {
-      draw_room(state, room);
-      if (room->selected) draw_camera_edge_bounds(room);
+      if (state->zoom_level >= OUTLINE_ZOOM_LEVEL) draw_room_outline(room, i);
+      else {
+        draw_room(state, room);
+        if (room->selected) draw_camera_edge_bounds(room);
+      }
     } else draw_room_minimap(state, room, i);
   }
 
@@ -726,6 +838,24 @@ static void draw_hud(az_editor_state_t *state) {
     az_draw_string(8, AZ_ALIGN_LEFT, 620, 5, "U");
   }
 
+  // Draw the number of audit problems, and the first problem in this room:
+  if (state->audit.num_errors > 0) {
+    glColor3f(1, 0, 0); // red
+    az_draw_printf(8, AZ_ALIGN_LEFT, 450, 5, "AUDIT:%d",
+                   state->audit.num_errors);
+    if (state->current_room < state->audit.num_rooms) {
+      const az_audit_room_t *audit_room =
+        &state->audit.rooms[state->current_room];
+      const az_audit_log_t *log = (audit_room->local_errors.num_errors > 0 ?
+                                   &audit_room->local_errors :
+                                   &audit_room->cross_errors);
+      if (log->num_errors > 0) {
+        az_draw_chars(8, AZ_ALIGN_LEFT, 20, 20, log->text,
+                      strcspn(log->text, "\n"));
+      }
+    }
+  }
+
   // Draw the tool name:
   const char *tool_name = "???";
   switch (state->tool) {
@@ -29,6 +29,10 @@
 
 void az_editor_draw_screen(az_editor_state_t *state);
 
+// Register this with az_register_gl_init_func, so that the cached room
+// outlines are recompiled whenever the GL context is recreated.
+void az_init_editor_room_outlines(void);
+
 az_vector_t az_pixel_to_position(const az_editor_state_t *state, int x, int y);
 
 int az_pixel_to_text_box_index(int x, int y);
@@ -18,16 +18,27 @@
 =============================================================================*/
 
 #include <assert.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <SDL/SDL.h>
 
 #include "azimuth/state/music.h"
+#include "azimuth/util/misc.h"
 #include "azimuth/util/music.h"
 #include "azimuth/util/sound.h"
 
 /*===========================================================================*/
 
+// When rendering offline, stop after this much music even if it hasn't
+// stopped on its own (most tracks loop forever):
+#define MAX_RENDER_SECONDS 180
+
 static az_music_t music;
 static az_music_synth_t synth;
 
@@ -42,31 +53,163 @@ static void destroy_music(void) {
   az_destroy_music(&music);
 }
 
-int main(int argc, char **argv) {
-  if (argc < 2 || argc > 3) {
-    fprintf(stderr, "Usage: %s filename [flag]\n", argv[0]);
-    return EXIT_FAILURE;
+static bool load_music(const char *filepath) {
+  int num_drums = 0;
+  const az_sound_data_t *drums = NULL;
+  az_get_drum_kit(&num_drums, &drums);
+  if (!az_parse_music_from_path(filepath, num_drums, drums, &music)) {
+    fprintf(stderr, "ERROR: failed to parse music from %s.\n", filepath);
+    return false;
   }
+  return true;
+}
 
-  int music_flag = 0;
-  if (argc >= 3) {
-    if (sscanf(argv[2], "%d", &music_flag) < 1) {
-      fprintf(stderr, "Invalid flag value: %s\n", argv[2]);
-      return EXIT_FAILURE;
-    }
+static bool parse_flag(const char *string, int *flag_out) {
+  if (sscanf(string, "%d", flag_out) < 1) {
+    fprintf(stderr, "Invalid flag value: %s\n", string);
+    return false;
   }
+  return true;
+}
 
-  // Initialize drum kit:
-  int num_drums = 0;
-  const az_sound_data_t *drums = NULL;
-  az_get_drum_kit(&num_drums, &drums);
+/*===========================================================================*/
+// Offline rendering:
 
-  // Load music:
-  if (!az_parse_music_from_path(argv[1], num_drums, drums, &music)) {
-    fprintf(stderr, "ERROR: failed to parse music.\n");
+// Synthesize the music (which must already be loaded) as fast as we can,
+// until it stops or until MAX_RENDER_SECONDS have been rendered.  The caller
+// must az_free() the returned samples.
+static int16_t *render_music(int flag, size_t *num_samples_out) {
+  const size_t max_samples = (size_t)MAX_RENDER_SECONDS * AZ_AUDIO_RATE;
+  int16_t *samples = AZ_ALLOC(max_samples, int16_t);
+  az_reset_music_synth(&synth, &music, flag);
+  size_t num_samples = 0;
+  while (num_samples < max_samples && !synth.stopped) {
+    const size_t remaining = max_samples - num_samples;
+    num_samples += az_synthesize_music_part(
+        &synth, samples + num_samples,
+        (remaining < AZ_AUDIO_RATE ? (int)remaining : AZ_AUDIO_RATE));
+  }
+  *num_samples_out = num_samples;
+  return samples;
+}
+
+// 64-bit FNV-1a hash of the samples (as little-endian bytes), so that
+// synthesizer changes can be checked for bit-exactness.
+static uint64_t hash_samples(const int16_t *samples, size_t num_samples) {
+  uint64_t hash = UINT64_C(14695981039346656037);
+  for (size_t i = 0; i < num_samples; ++i) {
+    const uint16_t sample = (uint16_t)samples[i];
+    hash = (hash ^ (sample & 0xff)) * UINT64_C(1099511628211);
+    hash = (hash ^ (sample >> 8)) * UINT64_C(1099511628211);
+  }
+  return hash;
+}
+
+static int render_to_wav(const char *wav_path, const char *music_path,
+                         int flag) {
+  if (!load_music(music_path)) return EXIT_FAILURE;
+  atexit(destroy_music);
+  size_t num_samples = 0;
+  int16_t *samples = render_music(flag, &num_samples);
+  FILE *file = fopen(wav_path, "wb");
+  bool success = (file != NULL);
+  if (success) {
+    success = az_write_wav_file(file, samples, num_samples);
+    success = (fclose(file) == 0) && success;
+  }
+  az_free(samples);
+  if (!success) {
+    fprintf(stderr, "ERROR: failed to write %s.\n", wav_path);
+    return EXIT_FAILURE;
+  }
+  fprintf(stderr, "Wrote %.2f seconds of music to %s.\n",
+          (double)num_samples / AZ_AUDIO_RATE, wav_path);
+  return EXIT_SUCCESS;
+}
+
+static int run_benchmark(int num_paths, char **music_paths) {
+  if (SDL_Init(SDL_INIT_TIMER) != 0) {
+    fprintf(stderr, "ERROR: SDL_Init failed.\n");
+    return EXIT_FAILURE;
+  }
+  atexit(SDL_Quit);
+  double total_music_seconds = 0.0, total_wall_seconds = 0.0;
+  for (int i = 0; i < num_paths; ++i) {
+    if (!load_music(music_paths[i])) return EXIT_FAILURE;
+    const Uint32 start_ticks = SDL_GetTicks();
+    size_t num_samples = 0;
+    int16_t *samples = render_music(0, &num_samples);
+    const Uint32 end_ticks = SDL_GetTicks();
+    const double music_seconds = (double)num_samples / AZ_AUDIO_RATE;
+    const double wall_seconds = 0.001 * (end_ticks - start_ticks);
+    printf("%s: %7.2fs of music in %6.3fs (%6.1fx), hash %016" PRIx64 "\n",
+           music_paths[i], music_seconds, wall_seconds,
+           music_seconds / (wall_seconds > 0.0 ? wall_seconds : 0.001),
+           hash_samples(samples, num_samples));
+    az_free(samples);
+    az_destroy_music(&music);
+    total_music_seconds += music_seconds;
+    total_wall_seconds += wall_seconds;
+  }
+  printf("Total: %.2fs of music in %.3fs (%.1fx)\n", total_music_seconds,
+         total_wall_seconds, total_music_seconds /
+         (total_wall_seconds > 0.0 ? total_wall_seconds : 0.001));
+  return EXIT_SUCCESS;
+}
+
+// Renders the music and compares it against a reference render (e.g. a WAV
+// written by --render before changing the synthesizer), reporting the RMS and
+// peak difference as fractions of full scale.  The shorter of the two is
+// padded with silence.
+static int compare_to_wav(const char *wav_path, const char *music_path,
+                          int flag) {
+  FILE *file = fopen(wav_path, "rb");
+  int16_t *ref_samples = NULL;
+  size_t num_ref_samples = 0;
+  bool success = (file != NULL);
+  if (success) {
+    success = az_read_wav_file(file, &ref_samples, &num_ref_samples);
+    fclose(file);
+  }
+  if (!success) {
+    fprintf(stderr, "ERROR: failed to read %s.\n", wav_path);
+    return EXIT_FAILURE;
+  }
+  if (!load_music(music_path)) {
+    az_free(ref_samples);
     return EXIT_FAILURE;
   }
   atexit(destroy_music);
+  size_t num_samples = 0;
+  int16_t *samples = render_music(flag, &num_samples);
+  const size_t num_compared =
+    (num_samples > num_ref_samples ? num_samples : num_ref_samples);
+  double sum_squares = 0.0;
+  int peak = 0;
+  for (size_t i = 0; i < num_compared; ++i) {
+    const int sample = (i < num_samples ? samples[i] : 0);
+    const int ref_sample = (i < num_ref_samples ? ref_samples[i] : 0);
+    const int diff = abs(sample - ref_sample);
+    sum_squares += (double)diff * diff;
+    if (diff > peak) peak = diff;
+  }
+  az_free(samples);
+  az_free(ref_samples);
+  const double rms =
+    (num_compared == 0 ? 0.0 : sqrt(sum_squares / num_compared));
+  printf("%s: %zu -> %zu samples, RMS error %.3f%%, peak error %.3f%%\n",
+         music_path, num_ref_samples, num_samples, 100.0 * rms / INT16_MAX,
+         100.0 * peak / INT16_MAX);
+  return EXIT_SUCCESS;
+}
+
+/*===========================================================================*/
+// Live playback:
+
+static int play_live(const char *music_path, int music_flag) {
+  // Load music:
+  if (!load_music(music_path)) return EXIT_FAILURE;
+  atexit(destroy_music);
   az_reset_music_synth(&synth, &music, music_flag);
 
   // Initialize SDL audio:
@@ -111,3 +254,44 @@ int main(int argc, char **argv) {
 }
 
 /*===========================================================================*/
+
+static int usage(const char *program_name) {
+  fprintf(stderr, "Usage: %s [-s] filename [flag]\n"
+          "       %s [-s] --render out.wav filename [flag]\n"
+          "       %s [-s] --compare ref.wav filename [flag]\n"
+          "       %s [-s] --bench filename...\n",
+          program_name, program_name, program_name, program_name);
+  return EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+  // By default, use the same oscillators as the game does; pass -s to use
+  // the old supersampling oscillators instead, for comparison.
+  const char *program_name = argv[0];
+  synth.oscillator = AZ_MUSIC_OSC_BANDLIMITED;
+  if (argc >= 2 && strcmp(argv[1], "-s") == 0) {
+    synth.oscillator = AZ_MUSIC_OSC_SUPERSAMPLE;
+    --argc;
+    ++argv;
+  }
+
+  int music_flag = 0;
+  if (argc >= 2 && strcmp(argv[1], "--render") == 0) {
+    if (argc < 4 || argc > 5) return usage(program_name);
+    if (argc >= 5 && !parse_flag(argv[4], &music_flag)) return EXIT_FAILURE;
+    return render_to_wav(argv[2], argv[3], music_flag);
+  } else if (argc >= 2 && strcmp(argv[1], "--compare") == 0) {
+    if (argc < 4 || argc > 5) return usage(program_name);
+    if (argc >= 5 && !parse_flag(argv[4], &music_flag)) return EXIT_FAILURE;
+    return compare_to_wav(argv[2], argv[3], music_flag);
+  } else if (argc >= 2 && strcmp(argv[1], "--bench") == 0) {
+    if (argc < 3) return usage(program_name);
+    return run_benchmark(argc - 2, argv + 2);
+  }
+
+  if (argc < 2 || argc > 3) return usage(program_name);
+  if (argc >= 3 && !parse_flag(argv[2], &music_flag)) return EXIT_FAILURE;
+  return play_live(argv[1], music_flag);
+}
+
+/*===========================================================================*/
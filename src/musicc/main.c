@@ -0,0 +1,70 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "azimuth/state/music.h"
+#include "azimuth/util/misc.h"
+#include "azimuth/util/music.h"
+#include "azimuth/util/sound.h"
+#include "azimuth/util/string.h"
+
+/*===========================================================================*/
+
+// Compiles a music text file into the binary format that the game will load
+// in preference to the text file (see az_write_compiled_music).  The output
+// file is written in full under a temporary name and then renamed, so that a
+// partially-written file is never mistaken for an up-to-date one.
+static int compile_music(const char *input_path, const char *output_path) {
+  int num_drums = 0;
+  const az_sound_data_t *drums = NULL;
+  az_get_drum_kit(&num_drums, &drums);
+  az_music_t music;
+  if (!az_parse_music_from_path(input_path, num_drums, drums, &music)) {
+    fprintf(stderr, "ERROR: failed to parse music from %s.\n", input_path);
+    return EXIT_FAILURE;
+  }
+  char *temp_path = az_strprintf("%s.tmp", output_path);
+  FILE *file = fopen(temp_path, "wb");
+  bool success = false;
+  if (file != NULL) {
+    success = az_write_compiled_music(&music, num_drums, drums, file);
+    success = (fclose(file) == 0) && success;
+    success = success && rename(temp_path, output_path) == 0;
+    if (!success) remove(temp_path);
+  }
+  if (!success) {
+    fprintf(stderr, "ERROR: failed to write %s.\n", output_path);
+  }
+  az_free(temp_path);
+  az_destroy_music(&music);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s input.txt output.bin\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  return compile_music(argv[1], argv[2]);
+}
+
+/*===========================================================================*/
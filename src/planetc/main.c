@@ -0,0 +1,224 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "azimuth/state/planet.h"
+#include "azimuth/state/room.h"
+#include "azimuth/state/script.h"
+#include "azimuth/state/wall.h" // for az_init_wall_datas
+#include "azimuth/util/file.h"
+#include "azimuth/util/misc.h"
+#include "azimuth/util/string.h"
+
+/*===========================================================================*/
+
+// Compiles the planet.txt and roomNNN.txt files in the given resource
+// directory into a single planet bundle (see az_write_planet_bundle), which
+// az_load_planet will use in preference to the text files as long as it is
+// newer than all of them.  The bundle is written in full under a temporary
+// name and then renamed, so that a partially-written bundle is never mistaken
+// for an up-to-date one.
+static int compile_planet(const char *resource_dir, const char *output_path) {
+  az_planet_t planet;
+  if (!az_load_planet_text(resource_dir, &planet)) {
+    fprintf(stderr, "ERROR: failed to load planet from %s.\n", resource_dir);
+    return EXIT_FAILURE;
+  }
+  char *temp_path = az_strprintf("%s.tmp", output_path);
+  FILE *file = fopen(temp_path, "wb");
+  bool success = false;
+  if (file != NULL) {
+    success = az_write_planet_bundle(&planet, file);
+    success = (fclose(file) == 0) && success;
+    success = success && rename(temp_path, output_path) == 0;
+    if (!success) remove(temp_path);
+  }
+  if (!success) {
+    fprintf(stderr, "ERROR: failed to write %s.\n", output_path);
+  }
+  az_free(temp_path);
+  az_destroy_planet(&planet);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Returns the total size in bytes of the planet.txt and roomNNN.txt files in
+// the given resource directory.
+static size_t total_text_size(const char *resource_dir, int num_rooms) {
+  size_t total = 0;
+  for (int i = -1; i < num_rooms; ++i) {
+    char *text_path = (i < 0 ?
+                       az_strprintf("%s/rooms/planet.txt", resource_dir) :
+                       az_strprintf("%s/rooms/room%03d.txt", resource_dir, i));
+    size_t size = 0;
+    char *data = az_read_file(text_path, &size);
+    if (data != NULL) total += size;
+    az_free(data);
+    az_free(text_path);
+  }
+  return total;
+}
+
+static double wall_seconds(void) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (double)now.tv_sec + 1e-6 * (double)now.tv_usec;
+}
+
+// Parses the text files in the given resource directory repeatedly, and
+// reports how long it takes.  This measures wall-clock time rather than CPU
+// time, since the room files are parsed on several threads at once.
+static int run_benchmark(const char *resource_dir, int num_iterations) {
+  size_t num_bytes = 0;
+  const double start = wall_seconds();
+  for (int i = 0; i < num_iterations; ++i) {
+    az_planet_t planet;
+    if (!az_load_planet_text(resource_dir, &planet)) {
+      fprintf(stderr, "ERROR: failed to load planet from %s.\n",
+              resource_dir);
+      return EXIT_FAILURE;
+    }
+    if (num_bytes == 0) {
+      num_bytes = total_text_size(resource_dir, planet.num_rooms);
+    }
+    az_destroy_planet(&planet);
+  }
+  const double seconds = wall_seconds() - start;
+  const double megabytes = (double)num_bytes * num_iterations / 1e6;
+  printf("Parsed %.2f MB of text in %.3fs (%.2f ms/load, %.1f MB/s)\n",
+         megabytes, seconds, 1000.0 * seconds / num_iterations,
+         megabytes / (seconds > 0.0 ? seconds : 0.001));
+  return EXIT_SUCCESS;
+}
+
+// Collects the text of every script in the planet (as the editor would show it
+// in a script text box) into a newly-allocated array of strings.
+static int collect_script_texts(const az_planet_t *planet, char ***texts_out) {
+  int num_scripts = 0, capacity = 64;
+  char **texts = AZ_ALLOC(capacity, char*);
+  for (int i = -1; i < planet->num_rooms; ++i) {
+    const az_room_t *room = (i < 0 ? NULL : &planet->rooms[i]);
+    const az_script_t *scripts[1 + AZ_MAX_NUM_BADDIES + AZ_MAX_NUM_DOORS +
+                               AZ_MAX_NUM_GRAVFIELDS + AZ_MAX_NUM_NODES];
+    int num_room_scripts = 0;
+    if (room == NULL) scripts[num_room_scripts++] = planet->on_start;
+    else {
+      for (int owner = 0; owner < AZ_NUM_SCRIPT_OWNERS; ++owner) {
+        const int num_owners = az_num_room_script_owners(room, owner);
+        for (int j = 0; j < num_owners; ++j) {
+          scripts[num_room_scripts++] = az_room_script_at(room, owner, j);
+        }
+      }
+    }
+    for (int j = 0; j < num_room_scripts; ++j) {
+      if (scripts[j] == NULL) continue;
+      char buffer[8192];
+      if (!az_sprint_script(scripts[j], buffer, sizeof(buffer))) continue;
+      if (num_scripts == capacity) {
+        capacity *= 2;
+        char **new_texts = AZ_ALLOC(capacity, char*);
+        memcpy(new_texts, texts, num_scripts * sizeof(char*));
+        az_free(texts);
+        texts = new_texts;
+      }
+      texts[num_scripts++] = az_strdup(buffer);
+    }
+  }
+  *texts_out = texts;
+  return num_scripts;
+}
+
+// Parses the text of every script in the planet repeatedly with
+// az_sscan_script (as the editor does whenever a script text box is
+// committed), and reports how long it takes.
+static int run_script_benchmark(const char *resource_dir,
+                                int num_iterations) {
+  az_planet_t planet;
+  if (!az_load_planet_text(resource_dir, &planet)) {
+    fprintf(stderr, "ERROR: failed to load planet from %s.\n",
+            resource_dir);
+    return EXIT_FAILURE;
+  }
+  char **texts = NULL;
+  const int num_scripts = collect_script_texts(&planet, &texts);
+  az_destroy_planet(&planet);
+  size_t num_bytes = 0;
+  for (int i = 0; i < num_scripts; ++i) num_bytes += strlen(texts[i]);
+  int result = EXIT_SUCCESS;
+  const double start = wall_seconds();
+  for (int i = 0; i < num_iterations && result == EXIT_SUCCESS; ++i) {
+    for (int j = 0; j < num_scripts; ++j) {
+      az_script_t *script = az_sscan_script(texts[j], strlen(texts[j]));
+      if (script == NULL) {
+        fprintf(stderr, "ERROR: failed to parse script: %s\n", texts[j]);
+        result = EXIT_FAILURE;
+        break;
+      }
+      az_free_script(script);
+    }
+  }
+  const double seconds = wall_seconds() - start;
+  if (result == EXIT_SUCCESS) {
+    const double num_parses = (double)num_scripts * num_iterations;
+    printf("Parsed %d scripts (%.1f KB) %d times in %.3fs "
+           "(%.2f us/script)\n", num_scripts, (double)num_bytes / 1e3,
+           num_iterations, seconds, 1e6 * seconds / num_parses);
+  }
+  for (int i = 0; i < num_scripts; ++i) az_free(texts[i]);
+  az_free(texts);
+  return result;
+}
+
+static int usage(const char *program_name) {
+  fprintf(stderr, "Usage: %s resource_dir [output.bin]\n"
+          "       %s --bench resource_dir [iterations]\n"
+          "       %s --bench-scripts resource_dir [iterations]\n"
+          "  (default output is resource_dir/rooms/planet.bin)\n",
+          program_name, program_name, program_name);
+  return EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+  az_init_wall_datas();
+  if (argc >= 2 && strcmp(argv[1], "--bench") == 0) {
+    if (argc != 3 && argc != 4) return usage(argv[0]);
+    const int num_iterations = (argc == 4 ? atoi(argv[3]) : 20);
+    if (num_iterations <= 0) return usage(argv[0]);
+    return run_benchmark(argv[2], num_iterations);
+  }
+  if (argc >= 2 && strcmp(argv[1], "--bench-scripts") == 0) {
+    if (argc != 3 && argc != 4) return usage(argv[0]);
+    const int num_iterations = (argc == 4 ? atoi(argv[3]) : 100);
+    if (num_iterations <= 0) return usage(argv[0]);
+    return run_script_benchmark(argv[2], num_iterations);
+  }
+  if (argc != 2 && argc != 3) return usage(argv[0]);
+  const char *resource_dir = argv[1];
+  if (argc == 3) return compile_planet(resource_dir, argv[2]);
+  char *output_path = az_strprintf("%s/rooms/planet.bin", resource_dir);
+  const int result = compile_planet(resource_dir, output_path);
+  az_free(output_path);
+  return result;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,76 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "azimuth/util/arena.h"
+#include "test/test.h"
+
+/*===========================================================================*/
+
+void test_arena_alloc(void) {
+  az_arena_t arena = {0};
+  EXPECT_TRUE(AZ_ARENA_ALLOC(&arena, 0, double) == NULL);
+  EXPECT_INT_EQ(0, arena.num_blocks);
+
+  // Allocations are zeroed, aligned, and don't overlap.
+  char *chars = AZ_ARENA_ALLOC(&arena, 3, char);
+  double *doubles = AZ_ARENA_ALLOC(&arena, 5, double);
+  ASSERT_TRUE(chars != NULL && doubles != NULL);
+  EXPECT_INT_EQ(0, (uintptr_t)doubles % sizeof(double));
+  EXPECT_TRUE((char *)doubles >= chars + 3);
+  for (int i = 0; i < 5; ++i) EXPECT_TRUE(doubles[i] == 0.0);
+  memset(chars, 'x', 3);
+  EXPECT_INT_EQ(1, arena.num_blocks);
+
+  // Big allocations get their own block, without disturbing the current one.
+  char *big = AZ_ARENA_ALLOC(&arena, 1000000, char);
+  EXPECT_INT_EQ(2, arena.num_blocks);
+  EXPECT_INT_EQ(0, big[999999]);
+  char *after = AZ_ARENA_ALLOC(&arena, 1, char);
+  EXPECT_TRUE(after > (char *)doubles && after < chars + 1000);
+
+  // Many small allocations eventually fill up the block.
+  for (int i = 0; i < 10000; ++i) AZ_ARENA_ALLOC(&arena, 16, char);
+  EXPECT_TRUE(arena.num_blocks > 2);
+
+  // Clearing keeps one block, and memory comes back zeroed.
+  az_clear_arena(&arena);
+  EXPECT_INT_EQ(1, arena.num_blocks);
+  int *ints = AZ_ARENA_ALLOC(&arena, 1000, int);
+  for (int i = 0; i < 1000; ++i) EXPECT_INT_EQ(0, ints[i]);
+
+  az_destroy_arena(&arena);
+  EXPECT_INT_EQ(0, arena.num_blocks);
+  EXPECT_TRUE(arena.block == NULL);
+}
+
+void test_arena_strings(void) {
+  az_arena_t arena = {0};
+  EXPECT_TRUE(az_arena_strdup(&arena, NULL) == NULL);
+  char *copy = az_arena_strdup(&arena, "Hello");
+  EXPECT_STRING_EQ("Hello", copy);
+  char *printed = az_arena_strprintf(&arena, "%s, %d!", "World", 42);
+  EXPECT_STRING_EQ("World, 42!", printed);
+  EXPECT_STRING_EQ("Hello", copy);
+  az_destroy_arena(&arena);
+}
+
+/*===========================================================================*/
@@ -17,9 +17,15 @@
 | with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
 =============================================================================*/
 
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "azimuth/util/audio.h"
+#include "azimuth/util/misc.h"
+#include "azimuth/util/music.h"
 #include "azimuth/util/sound.h"
 #include "test/test.h"
 
@@ -40,14 +46,66 @@ void test_create_sound_data(void) {
   EXPECT_TRUE(data.samples == NULL);
 }
 
+void test_synthesize_sound(void) {
+  const az_sound_spec_t spec = {
+    .wave_kind = AZ_NOISE_WAVE, .env_sustain = 0.25, .env_decay = 0.25,
+    .start_freq = 0.5, .freq_slide = -0.25, .repeat_speed = 0.5
+  };
+  az_sound_data_t data = { .num_samples = 0 };
+  az_create_sound_data(&spec, &data);
+  ASSERT_TRUE(data.num_samples > 1000);
+  // Synthesizing the same sound a piece at a time should produce exactly the
+  // same samples (even for noise).
+  int16_t *samples = AZ_ALLOC(AZ_MAX_SOUND_SAMPLES, int16_t);
+  az_sound_synth_t synth;
+  az_reset_sound_synth(&synth, &spec);
+  int num_samples = 0;
+  for (int chunk_size = 1; !synth.finished; ++chunk_size) {
+    num_samples += az_synthesize_sound(
+        &synth, samples + num_samples,
+        az_imin(chunk_size, AZ_MAX_SOUND_SAMPLES - num_samples));
+  }
+  EXPECT_INT_EQ(data.num_samples, num_samples);
+  EXPECT_INT_EQ(0, memcmp(samples, data.samples,
+                          data.num_samples * sizeof(int16_t)));
+  // Once finished, the synth produces no more samples.
+  EXPECT_INT_EQ(0, az_synthesize_sound(&synth, samples, 10));
+  az_free(samples);
+  az_destroy_sound_data(&data);
+}
+
+void test_wav_file_round_trip(void) {
+  const int16_t samples[] = {0, 1, -1, 12345, -32768, 32767};
+  FILE *file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  EXPECT_TRUE(az_write_wav_file(file, samples, AZ_ARRAY_SIZE(samples)));
+  rewind(file);
+  int16_t *loaded = NULL;
+  size_t num_loaded = 0;
+  EXPECT_TRUE(az_read_wav_file(file, &loaded, &num_loaded));
+  EXPECT_INT_EQ(AZ_ARRAY_SIZE(samples), num_loaded);
+  if (num_loaded == AZ_ARRAY_SIZE(samples)) {
+    EXPECT_INT_EQ(0, memcmp(samples, loaded, sizeof(samples)));
+  }
+  az_free(loaded);
+  fclose(file);
+  // A truncated file should fail to load.
+  file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  EXPECT_TRUE(fputs("RIFF", file) != EOF);
+  rewind(file);
+  EXPECT_FALSE(az_read_wav_file(file, &loaded, &num_loaded));
+  fclose(file);
+}
+
 void test_persist_sound(void) {
   az_soundboard_t soundboard = { .num_persists = 0 };
   const az_sound_data_t sound1, sound2, sound3, sound4;
-  az_persist_sound_data(&soundboard, &sound1, 1);
+  az_persist_sound_data(&soundboard, &sound1, 1, AZ_SNDPRI_NORMAL);
   az_reset_sound_data(&soundboard, &sound2);
   az_hold_sound_data(&soundboard, &sound3);
-  az_persist_sound_data(&soundboard, &sound2, 1);
-  az_loop_sound_data(&soundboard, &sound4, 1);
+  az_persist_sound_data(&soundboard, &sound2, 1, AZ_SNDPRI_NORMAL);
+  az_loop_sound_data(&soundboard, &sound4, 1, AZ_SNDPRI_NORMAL);
   EXPECT_INT_EQ(4, soundboard.num_persists);
 
   EXPECT_TRUE(soundboard.persists[0].sound_data == &sound1);
@@ -77,22 +135,22 @@ void test_sound_volume(void) {
 
   // Perform a sequence of operations with persisted sounds, and make sure the
   // volumes come out right.
-  az_loop_sound_data(&soundboard, &sound1, 0.5);
+  az_loop_sound_data(&soundboard, &sound1, 0.5, AZ_SNDPRI_NORMAL);
   EXPECT_INT_EQ(1, soundboard.num_persists);
   EXPECT_TRUE(soundboard.persists[0].sound_data == &sound1);
   EXPECT_APPROX(0.5, soundboard.persists[0].volume);
 
-  az_loop_sound_data(&soundboard, &sound1, 0.25);
+  az_loop_sound_data(&soundboard, &sound1, 0.25, AZ_SNDPRI_NORMAL);
   EXPECT_INT_EQ(1, soundboard.num_persists);
   EXPECT_TRUE(soundboard.persists[0].sound_data == &sound1);
   EXPECT_APPROX(0.5, soundboard.persists[0].volume);
 
-  az_loop_sound_data(&soundboard, &sound1, 0.75);
+  az_loop_sound_data(&soundboard, &sound1, 0.75, AZ_SNDPRI_NORMAL);
   EXPECT_INT_EQ(1, soundboard.num_persists);
   EXPECT_TRUE(soundboard.persists[0].sound_data == &sound1);
   EXPECT_APPROX(0.75, soundboard.persists[0].volume);
 
-  az_loop_sound_data(&soundboard, &sound2, 1.0);
+  az_loop_sound_data(&soundboard, &sound2, 1.0, AZ_SNDPRI_NORMAL);
   EXPECT_INT_EQ(2, soundboard.num_persists);
   EXPECT_TRUE(soundboard.persists[0].sound_data == &sound1);
   EXPECT_APPROX(0.75, soundboard.persists[0].volume);
@@ -100,24 +158,28 @@ void test_sound_volume(void) {
   EXPECT_APPROX(1.0, soundboard.persists[1].volume);
 
   // Now test out oneshot sounds as well.
-  az_play_sound_data(&soundboard, &sound3, 0.625);
+  az_play_sound_data(&soundboard, &sound3, 0.625, AZ_SNDPRI_NORMAL);
   EXPECT_INT_EQ(1, soundboard.num_oneshots);
   EXPECT_TRUE(soundboard.oneshots[0].sound_data == &sound3);
   EXPECT_APPROX(0.625, soundboard.oneshots[0].volume);
 
-  az_play_sound_data(&soundboard, &sound3, 0.5);
+  // Playing the same sound again in the same frame should merge the two into
+  // a single louder sound (adding power, not amplitude).
+  az_play_sound_data(&soundboard, &sound3, 0.5, AZ_SNDPRI_NORMAL);
   EXPECT_INT_EQ(1, soundboard.num_oneshots);
   EXPECT_TRUE(soundboard.oneshots[0].sound_data == &sound3);
-  EXPECT_APPROX(0.625, soundboard.oneshots[0].volume);
+  EXPECT_APPROX(sqrtf(0.625f * 0.625f + 0.5f * 0.5f),
+                soundboard.oneshots[0].volume);
 
-  az_play_sound_data(&soundboard, &sound4, 0.5);
+  az_play_sound_data(&soundboard, &sound4, 0.5, AZ_SNDPRI_NORMAL);
   EXPECT_INT_EQ(2, soundboard.num_oneshots);
   EXPECT_TRUE(soundboard.oneshots[0].sound_data == &sound3);
-  EXPECT_APPROX(0.625, soundboard.oneshots[0].volume);
+  EXPECT_APPROX(sqrtf(0.625f * 0.625f + 0.5f * 0.5f),
+                soundboard.oneshots[0].volume);
   EXPECT_TRUE(soundboard.oneshots[1].sound_data == &sound4);
   EXPECT_APPROX(0.5, soundboard.oneshots[1].volume);
 
-  az_play_sound_data(&soundboard, &sound3, 1);
+  az_play_sound_data(&soundboard, &sound3, 1, AZ_SNDPRI_NORMAL);
   EXPECT_INT_EQ(2, soundboard.num_oneshots);
   EXPECT_TRUE(soundboard.oneshots[0].sound_data == &sound3);
   EXPECT_APPROX(1, soundboard.oneshots[0].volume);
@@ -125,6 +187,44 @@ void test_sound_volume(void) {
   EXPECT_APPROX(0.5, soundboard.oneshots[1].volume);
 }
 
+void test_sound_priority(void) {
+  az_soundboard_t soundboard = { .num_oneshots = 0 };
+  az_sound_data_t sounds[AZ_ARRAY_SIZE(soundboard.oneshots) + 2];
+  const int capacity = AZ_ARRAY_SIZE(soundboard.oneshots);
+  for (int i = 0; i < capacity; ++i) {
+    az_play_sound_data(&soundboard, &sounds[i], 0.5, AZ_SNDPRI_NORMAL);
+  }
+  EXPECT_INT_EQ(capacity, soundboard.num_oneshots);
+  EXPECT_INT_EQ(0, soundboard.num_dropped);
+  // Once the soundboard is full, a less important sound gets dropped...
+  az_play_sound_data(&soundboard, &sounds[capacity], 1, AZ_SNDPRI_LOW);
+  EXPECT_INT_EQ(capacity, soundboard.num_oneshots);
+  EXPECT_INT_EQ(1, soundboard.num_dropped);
+  for (int i = 0; i < capacity; ++i) {
+    EXPECT_TRUE(soundboard.oneshots[i].sound_data != &sounds[capacity]);
+  }
+  // ...but a more important sound displaces one of the others.
+  az_play_sound_data(&soundboard, &sounds[capacity + 1], 0.25,
+                     AZ_SNDPRI_CRITICAL);
+  EXPECT_INT_EQ(capacity, soundboard.num_oneshots);
+  EXPECT_INT_EQ(2, soundboard.num_dropped);
+  int num_found = 0;
+  for (int i = 0; i < capacity; ++i) {
+    if (soundboard.oneshots[i].sound_data != &sounds[capacity + 1]) continue;
+    ++num_found;
+    EXPECT_INT_EQ(AZ_SNDPRI_CRITICAL, soundboard.oneshots[i].priority);
+  }
+  EXPECT_INT_EQ(1, num_found);
+  // Merging with an existing sound doesn't need a new slot, and keeps the
+  // higher of the two priorities.
+  az_play_sound_data(&soundboard, &sounds[capacity + 1], 0.25, AZ_SNDPRI_LOW);
+  EXPECT_INT_EQ(2, soundboard.num_dropped);
+  for (int i = 0; i < capacity; ++i) {
+    if (soundboard.oneshots[i].sound_data != &sounds[capacity + 1]) continue;
+    EXPECT_INT_EQ(AZ_SNDPRI_CRITICAL, soundboard.oneshots[i].priority);
+  }
+}
+
 #define PARSE_MUSIC_FROM_STRING(music_string, music) do { \
     FILE *file = tmpfile(); \
     ASSERT_TRUE(file != NULL); \
@@ -179,4 +279,93 @@ void test_parse_music_instructions(void) {
   EXPECT_INT_EQ(2, music.instructions[3].index);
 }
 
+void test_compiled_music(void) {
+  const char *music_string =
+    "@M \"$1 A|B\"\n"
+    "=title \"Round Trip\"\n"
+    "!Part A\n"
+    "1 Ws c4q d e f\n"
+    "2 rh g3h\n"
+    "!Part B\n"
+    "3 Wt50 c5w\n";
+  az_music_t parsed;
+  PARSE_MUSIC_FROM_STRING(music_string, &parsed);
+  FILE *file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  EXPECT_TRUE(az_write_compiled_music(&parsed, 0, NULL, file));
+  rewind(file);
+  az_music_t loaded;
+  const bool success = az_load_compiled_music_from_file(file, 0, NULL, &loaded);
+  fclose(file);
+  ASSERT_TRUE(success);
+  EXPECT_TRUE(loaded.block != NULL);
+  ASSERT_TRUE(loaded.title != NULL);
+  EXPECT_STRING_EQ("Round Trip", loaded.title);
+  ASSERT_INT_EQ(parsed.num_instructions, loaded.num_instructions);
+  for (int i = 0; i < parsed.num_instructions; ++i) {
+    EXPECT_INT_EQ(parsed.instructions[i].opcode,
+                  loaded.instructions[i].opcode);
+    EXPECT_INT_EQ(parsed.instructions[i].value, loaded.instructions[i].value);
+    EXPECT_INT_EQ(parsed.instructions[i].index, loaded.instructions[i].index);
+  }
+  ASSERT_INT_EQ(parsed.num_parts, loaded.num_parts);
+  for (int p = 0; p < parsed.num_parts; ++p) {
+    for (int t = 0; t < AZ_MUSIC_NUM_TRACKS; ++t) {
+      const az_music_track_t *expected = &parsed.parts[p].tracks[t];
+      const az_music_track_t *actual = &loaded.parts[p].tracks[t];
+      ASSERT_INT_EQ(expected->num_notes, actual->num_notes);
+      for (int n = 0; n < expected->num_notes; ++n) {
+        const az_music_note_t *expected_note = &expected->notes[n];
+        const az_music_note_t *actual_note = &actual->notes[n];
+        EXPECT_INT_EQ(expected_note->type, actual_note->type);
+        if (expected_note->type == AZ_NOTE_TONE) {
+          EXPECT_APPROX(expected_note->attributes.tone.frequency,
+                        actual_note->attributes.tone.frequency);
+        }
+      }
+    }
+  }
+  az_destroy_music(&loaded);
+  az_destroy_music(&parsed);
+  // Files from an incompatible build (here, simulated by a bad magic number)
+  // should be rejected rather than misread:
+  file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  EXPECT_TRUE(0 <= fputs("AZMX and then some more garbage bytes", file));
+  rewind(file);
+  EXPECT_FALSE(az_load_compiled_music_from_file(file, 0, NULL, &loaded));
+  fclose(file);
+}
+
+static double music_rms(const az_music_t *music,
+                        az_music_oscillator_t oscillator) {
+  az_music_synth_t synth = { .oscillator = oscillator };
+  az_reset_music_synth(&synth, music, 0);
+  EXPECT_INT_EQ(oscillator, synth.oscillator);
+  int16_t samples[AZ_AUDIO_RATE / 2];
+  az_synthesize_music(&synth, samples, AZ_ARRAY_SIZE(samples));
+  double sum = 0.0;
+  AZ_ARRAY_LOOP(sample, samples) sum += (double)*sample * (double)*sample;
+  return sqrt(sum / AZ_ARRAY_SIZE(samples));
+}
+
+void test_synthesize_music_oscillators(void) {
+  const char *music_string =
+    "@M \"|A\"\n"
+    "!Part A\n"
+    "1 Wp25 V5,30 c4q d5 e6 f7\n"
+    "2 Wt30 D20,10 c3h g4h\n"
+    "3 Ws e5w\n"
+    "4 Wn L20 c6w\n";
+  az_music_t music;
+  PARSE_MUSIC_FROM_STRING(music_string, &music);
+  // The band-limited oscillators should produce about as much energy as the
+  // supersampling ones; they only differ in how much aliasing they let in.
+  const double supersample_rms = music_rms(&music, AZ_MUSIC_OSC_SUPERSAMPLE);
+  const double bandlimited_rms = music_rms(&music, AZ_MUSIC_OSC_BANDLIMITED);
+  EXPECT_TRUE(supersample_rms > 1000.0);
+  EXPECT_WITHIN(supersample_rms, bandlimited_rms, 0.1 * supersample_rms);
+  az_destroy_music(&music);
+}
+
 /*===========================================================================*/
@@ -0,0 +1,142 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "azimuth/util/grid.h"
+#include "azimuth/util/random.h"
+#include "azimuth/util/vector.h"
+#include "test/test.h"
+
+/*===========================================================================*/
+
+#define NUM_CIRCLES 300
+
+static bool box_overlaps_circle(az_vector_t min_corner, az_vector_t max_corner,
+                                const az_grid_circle_t *circle) {
+  return (circle->center.x + circle->radius >= min_corner.x &&
+          circle->center.x - circle->radius <= max_corner.x &&
+          circle->center.y + circle->radius >= min_corner.y &&
+          circle->center.y - circle->radius <= max_corner.y);
+}
+
+void test_circle_grid_empty(void) {
+  az_circle_grid_t grid = {0};
+  const int *indices = NULL;
+  EXPECT_INT_EQ(0, az_query_circle_grid(&grid, AZ_VZERO, AZ_VZERO, &indices));
+  az_build_circle_grid(&grid, 0, NULL, 50.0);
+  EXPECT_INT_EQ(0, az_query_circle_grid(&grid, (az_vector_t){-1e9, -1e9},
+                                        (az_vector_t){1e9, 1e9}, &indices));
+  az_destroy_circle_grid(&grid);
+}
+
+// Check grid queries against simply testing every circle.
+void test_circle_grid_matches_brute_force(void) {
+  az_random_seed_t seed = {1, 1};
+  az_grid_circle_t circles[NUM_CIRCLES];
+  for (int i = 0; i < NUM_CIRCLES; ++i) {
+    circles[i].center = (az_vector_t){2000.0 * az_rand_sdouble(&seed),
+                                      500.0 * az_rand_sdouble(&seed)};
+    circles[i].radius = (i % 10 == 0 ? 400.0 : 40.0) *
+      az_rand_udouble(&seed);
+  }
+  // One far-flung circle mustn't blow up the size of the grid.
+  circles[7].center = (az_vector_t){1e7, -1e7};
+
+  az_circle_grid_t grid = {0};
+  az_build_circle_grid(&grid, NUM_CIRCLES, circles, 50.0);
+  EXPECT_TRUE(grid.num_cols * grid.num_rows <= 4 * NUM_CIRCLES);
+  for (int trial = 0; trial < 200; ++trial) {
+    const az_vector_t corner = {2500.0 * az_rand_sdouble(&seed),
+                                800.0 * az_rand_sdouble(&seed)};
+    // Alternate between point queries and box queries of various sizes.
+    const az_vector_t size = (trial % 2 == 0 ? AZ_VZERO :
+        (az_vector_t){600.0 * az_rand_udouble(&seed),
+                      600.0 * az_rand_udouble(&seed)});
+    const az_vector_t far_corner = az_vadd(corner, size);
+    const int *indices = NULL;
+    const int num_found =
+      az_query_circle_grid(&grid, corner, far_corner, &indices);
+    int next = 0;
+    for (int i = 0; i < NUM_CIRCLES; ++i) {
+      if (!box_overlaps_circle(corner, far_corner, &circles[i])) continue;
+      ASSERT_TRUE(next < num_found);
+      EXPECT_INT_EQ(i, indices[next]);
+      ++next;
+    }
+    EXPECT_INT_EQ(next, num_found);
+  }
+  const int *indices = NULL;
+  ASSERT_INT_EQ(1, az_query_circle_grid(&grid, circles[7].center,
+                                        circles[7].center, &indices));
+  EXPECT_INT_EQ(7, indices[0]);
+
+  // Rebuilding replaces the old contents.
+  az_build_circle_grid(&grid, 1, circles, 50.0);
+  EXPECT_INT_EQ(0, az_query_circle_grid(&grid, circles[7].center,
+                                        circles[7].center, &indices));
+  az_destroy_circle_grid(&grid);
+  EXPECT_INT_EQ(0, grid.num_circles);
+}
+
+void test_circle_grid_sweep(void) {
+  az_random_seed_t seed = {2, 3};
+  az_grid_circle_t circles[NUM_CIRCLES];
+  for (int i = 0; i < NUM_CIRCLES; ++i) {
+    circles[i].center = (az_vector_t){1000.0 * az_rand_sdouble(&seed),
+                                      1000.0 * az_rand_sdouble(&seed)};
+    circles[i].radius = 60.0 * az_rand_udouble(&seed);
+  }
+  az_circle_grid_t grid = {0};
+  az_build_circle_grid(&grid, NUM_CIRCLES, circles, 50.0);
+  for (int trial = 0; trial < 200; ++trial) {
+    const double radius = (trial % 4 == 0 ? 0.0 :
+                           40.0 * az_rand_udouble(&seed));
+    const az_vector_t start = {1500.0 * az_rand_sdouble(&seed),
+                               1500.0 * az_rand_sdouble(&seed)};
+    // Include zero-length, axis-aligned, and very long sweeps.
+    az_vector_t delta = az_vpolar(3000.0 * az_rand_udouble(&seed),
+                                  AZ_PI * az_rand_sdouble(&seed));
+    if (trial % 5 == 0) delta = AZ_VZERO;
+    else if (trial % 5 == 1) delta.y = 0.0;
+    else if (trial % 5 == 2) delta.x = 0.0;
+    const int *indices = NULL;
+    const int num_found =
+      az_sweep_circle_grid(&grid, radius, start, delta, &indices);
+    const double delta_sq = az_vdot(delta, delta);
+    int next = 0;
+    for (int i = 0; i < NUM_CIRCLES; ++i) {
+      const az_vector_t rel = az_vsub(circles[i].center, start);
+      const double t = (delta_sq == 0.0 ? 0.0 :
+                        fmax(0.0, fmin(1.0, az_vdot(rel, delta) /
+                                       delta_sq)));
+      if (!az_vwithin(rel, az_vmul(delta, t),
+                      circles[i].radius + radius)) continue;
+      ASSERT_TRUE(next < num_found);
+      EXPECT_INT_EQ(i, indices[next]);
+      ++next;
+    }
+    EXPECT_INT_EQ(next, num_found);
+  }
+  az_destroy_circle_grid(&grid);
+}
+
+/*===========================================================================*/
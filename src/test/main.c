@@ -17,12 +17,17 @@
 | with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
 =============================================================================*/
 
+#include "azimuth/state/baddie.h"
+#include "azimuth/state/wall.h"
 #include "test/test.h"
 
 /*===========================================================================*/
 
 int main(int argc, char **argv) {
+  az_init_wall_datas(); // some tests load the game's room files
+  az_init_baddie_datas(); // some tests add baddies to a space state
   RUN_TEST(test_alloc);
+  RUN_TEST(test_alloc_tracking);
   RUN_TEST(test_arc_circle_hits_circle);
   RUN_TEST(test_arc_circle_hits_line);
   RUN_TEST(test_arc_circle_hits_line_segment);
@@ -34,7 +39,12 @@ int main(int argc, char **argv) {
   RUN_TEST(test_arc_ray_hits_line_segment);
   RUN_TEST(test_arc_ray_hits_polygon);
   RUN_TEST(test_arc_ray_hits_polygon_trans);
+  RUN_TEST(test_arena_alloc);
+  RUN_TEST(test_arena_strings);
   RUN_TEST(test_array_size);
+  RUN_TEST(test_circle_grid_empty);
+  RUN_TEST(test_circle_grid_matches_brute_force);
+  RUN_TEST(test_circle_grid_sweep);
   RUN_TEST(test_circle_hits_arc);
   RUN_TEST(test_circle_hits_circle);
   RUN_TEST(test_circle_hits_line);
@@ -42,6 +52,7 @@ int main(int argc, char **argv) {
   RUN_TEST(test_circle_hits_point);
   RUN_TEST(test_circle_hits_polygon);
   RUN_TEST(test_circle_hits_polygon_trans);
+  RUN_TEST(test_circle_hits_walls_indexed);
   RUN_TEST(test_circle_touches_line);
   RUN_TEST(test_circle_touches_line_segment);
   RUN_TEST(test_circle_touches_polygon);
@@ -49,12 +60,14 @@ int main(int argc, char **argv) {
   RUN_TEST(test_clock_mod);
   RUN_TEST(test_clock_zigzag);
   RUN_TEST(test_color3f);
+  RUN_TEST(test_compiled_music);
   RUN_TEST(test_create_sound_data);
   RUN_TEST(test_cubic_bezier_angle);
   RUN_TEST(test_cubic_bezier_arc_length);
   RUN_TEST(test_cubic_bezier_arc_param);
   RUN_TEST(test_cubic_bezier_point);
   RUN_TEST(test_find_knee);
+  RUN_TEST(test_global_random_seed);
   RUN_TEST(test_hint_matches);
   RUN_TEST(test_hsva_color);
   RUN_TEST(test_is_number_key);
@@ -63,9 +76,13 @@ int main(int argc, char **argv) {
   RUN_TEST(test_mod2pi);
   RUN_TEST(test_paragraph_length);
   RUN_TEST(test_paragraph_scan);
+  RUN_TEST(test_parallel_for);
   RUN_TEST(test_parse_music);
   RUN_TEST(test_parse_music_instructions);
   RUN_TEST(test_persist_sound);
+  RUN_TEST(test_planet_bundle);
+  RUN_TEST(test_planet_lazy_rooms);
+  RUN_TEST(test_planet_save_room);
   RUN_TEST(test_player_flags);
   RUN_TEST(test_player_give_upgrade);
   RUN_TEST(test_player_set_room_visited);
@@ -84,14 +101,27 @@ int main(int argc, char **argv) {
   RUN_TEST(test_ray_hits_line_segment);
   RUN_TEST(test_ray_hits_polygon);
   RUN_TEST(test_ray_hits_polygon_trans);
+  RUN_TEST(test_replay_round_trip);
+  RUN_TEST(test_room_script_at);
+  RUN_TEST(test_save_games_atomic);
+  RUN_TEST(test_save_games_background);
+  RUN_TEST(test_scan_format);
+  RUN_TEST(test_scan_numbers);
   RUN_TEST(test_script_clone);
   RUN_TEST(test_script_print);
   RUN_TEST(test_script_scan);
+  RUN_TEST(test_script_scan_fuzz);
+  RUN_TEST(test_script_verify);
   RUN_TEST(test_select_gun);
   RUN_TEST(test_signmod);
+  RUN_TEST(test_sound_priority);
   RUN_TEST(test_sound_volume);
+  RUN_TEST(test_space_snapshot);
+  RUN_TEST(test_space_state_checksum);
   RUN_TEST(test_strdup);
   RUN_TEST(test_strprintf);
+  RUN_TEST(test_synthesize_music_oscillators);
+  RUN_TEST(test_synthesize_sound);
   RUN_TEST(test_transition_color);
   RUN_TEST(test_uids);
   RUN_TEST(test_vaddlen);
@@ -102,6 +132,7 @@ int main(int argc, char **argv) {
   RUN_TEST(test_vrotate);
   RUN_TEST(test_vunit);
   RUN_TEST(test_vwithlen);
+  RUN_TEST(test_wav_file_round_trip);
   RUN_TEST(test_zero_array);
   RUN_TEST(test_zero_object);
 
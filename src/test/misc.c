@@ -91,6 +91,38 @@ void test_alloc(void) {
   free(array2);
 }
 
+void test_alloc_tracking(void) {
+  az_enable_alloc_tracking();
+  EXPECT_TRUE(az_is_tracking_allocs());
+  const size_t initial_bytes = az_tracked_live_bytes();
+  // Make lots of allocations of different sizes, then free every third one,
+  // then the rest, checking that the live byte count keeps up.
+  char *blocks[3000];
+  size_t expected_bytes = initial_bytes;
+  for (int i = 0; i < AZ_ARRAY_SIZE(blocks); ++i) {
+    blocks[i] = AZ_ALLOC(1 + i % 37, char);
+    expected_bytes += 1 + i % 37;
+  }
+  EXPECT_INT_EQ(expected_bytes, az_tracked_live_bytes());
+  for (int i = 0; i < AZ_ARRAY_SIZE(blocks); i += 3) {
+    az_free(blocks[i]);
+    expected_bytes -= 1 + i % 37;
+  }
+  EXPECT_INT_EQ(expected_bytes, az_tracked_live_bytes());
+  for (int i = 0; i < AZ_ARRAY_SIZE(blocks); ++i) {
+    if (i % 3 != 0) az_free(blocks[i]);
+  }
+  EXPECT_INT_EQ(initial_bytes, az_tracked_live_bytes());
+  // Freeing memory that was never tracked is harmless.
+  az_free(malloc(10));
+  az_free(NULL);
+  EXPECT_INT_EQ(initial_bytes, az_tracked_live_bytes());
+  // Turn tracking back off, so that it doesn't affect the other tests.
+  az_disable_alloc_tracking();
+  EXPECT_FALSE(az_is_tracking_allocs());
+  EXPECT_INT_EQ(0, az_tracked_live_bytes());
+}
+
 // Test out some static assertions:
 AZ_STATIC_ASSERT(1 + 2 == 3);
 AZ_STATIC_ASSERT(sizeof(char) == 1);
@@ -0,0 +1,41 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#include "azimuth/util/misc.h"
+#include "azimuth/util/parallel.h"
+#include "test/test.h"
+
+/*===========================================================================*/
+
+static void count_call(void *data, int index) {
+  int *counts = data;
+  counts[index] += index + 1;
+}
+
+void test_parallel_for(void) {
+  int counts[1000] = {0};
+  az_parallel_for(AZ_ARRAY_SIZE(counts), count_call, counts);
+  for (int i = 0; i < AZ_ARRAY_SIZE(counts); ++i) {
+    EXPECT_INT_EQ(i + 1, counts[i]);
+  }
+  // A zero count shouldn't call the function at all.
+  az_parallel_for(0, count_call, NULL);
+}
+
+/*===========================================================================*/
@@ -17,8 +17,13 @@
 | with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
 =============================================================================*/
 
+#include <stdio.h>
+#include <string.h>
+
 #include "azimuth/state/planet.h"
 #include "azimuth/state/player.h"
+#include "azimuth/state/room.h"
+#include "azimuth/state/script.h"
 #include "test/test.h"
 
 /*===========================================================================*/
@@ -100,4 +105,212 @@ void test_hint_matches(void) {
   EXPECT_TRUE(az_hint_matches(&hint, &player));
 }
 
+void test_planet_bundle(void) {
+  az_instruction_t instructions[] = {
+    { .opcode = AZ_OP_PUSH, .immediate = 3 }, { .opcode = AZ_OP_HALT }
+  };
+  az_script_t script = { .num_instructions = 2, .instructions = instructions };
+  az_zone_t zones[] = {
+    { .name = "Zone A", .entering_message = "Entering: A" },
+    { .name = "Zone B", .entering_message = "Entering: B" }
+  };
+  az_hint_t hints[] = {{ .result = AZ_UPG_GUN_CHARGE, .target_room = 1 }};
+  char *paragraphs[] = { "Hello", "World" };
+  az_door_spec_t doors[] = {
+    { .kind = AZ_DOOR_NORMAL, .on_open = &script, .destination = 0,
+      .position = {10, 20} }
+  };
+  az_room_t rooms[] = {
+    { .zone_key = 1, .on_start = &script },
+    { .zone_key = 0, .num_doors = 1, .doors = doors }
+  };
+  const az_planet_t original = {
+    .start_room = 1, .on_start = &script,
+    .num_paragraphs = 2, .paragraphs = paragraphs,
+    .num_zones = 2, .zones = zones, .num_hints = 1, .hints = hints,
+    .num_rooms = 2, .rooms = rooms
+  };
+  FILE *file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  EXPECT_TRUE(az_write_planet_bundle(&original, file));
+  rewind(file);
+  az_planet_t planet;
+  const bool success = az_load_planet_bundle_from_file(file, &planet);
+  fclose(file);
+  ASSERT_TRUE(success);
+  EXPECT_TRUE(planet.bundle != NULL);
+  EXPECT_INT_EQ(1, planet.start_room);
+  ASSERT_TRUE(planet.on_start != NULL);
+  EXPECT_INT_EQ(2, planet.on_start->num_instructions);
+  EXPECT_INT_EQ(AZ_OP_PUSH, planet.on_start->instructions[0].opcode);
+  EXPECT_APPROX(3, planet.on_start->instructions[0].immediate);
+  ASSERT_INT_EQ(2, planet.num_zones);
+  EXPECT_STRING_EQ("Zone B", planet.zones[1].name);
+  EXPECT_STRING_EQ("Entering: A", planet.zones[0].entering_message);
+  ASSERT_INT_EQ(1, planet.num_hints);
+  EXPECT_INT_EQ(1, planet.hints[0].target_room);
+  ASSERT_INT_EQ(2, planet.num_paragraphs);
+  EXPECT_STRING_EQ("World", planet.paragraphs[1]);
+  ASSERT_INT_EQ(2, planet.num_rooms);
+  EXPECT_INT_EQ(1, planet.rooms[0].zone_key);
+  EXPECT_TRUE(planet.rooms[0].on_start != NULL);
+  EXPECT_TRUE(planet.rooms[0].doors == NULL);
+  ASSERT_INT_EQ(1, planet.rooms[1].num_doors);
+  EXPECT_INT_EQ(AZ_DOOR_NORMAL, planet.rooms[1].doors[0].kind);
+  EXPECT_APPROX(20, planet.rooms[1].doors[0].position.y);
+  ASSERT_TRUE(planet.rooms[1].doors[0].on_open != NULL);
+  EXPECT_INT_EQ(AZ_OP_HALT,
+                planet.rooms[1].doors[0].on_open->instructions[1].opcode);
+  az_destroy_planet(&planet);
+  EXPECT_TRUE(planet.bundle == NULL);
+
+  // A truncated bundle should be rejected.
+  file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  EXPECT_TRUE(az_write_planet_bundle(&original, file));
+  const long size = ftell(file);
+  rewind(file);
+  char buffer[size];
+  EXPECT_TRUE(fread(buffer, size, 1, file) == 1);
+  fclose(file);
+  file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  EXPECT_TRUE(fwrite(buffer, size - 8, 1, file) == 1);
+  rewind(file);
+  EXPECT_FALSE(az_load_planet_bundle_from_file(file, &planet));
+  fclose(file);
+}
+
+// This test uses the game's real room files, so it must be run from the top of
+// the source tree (as "make test" does).
+void test_planet_lazy_rooms(void) {
+  az_planet_t full, lazy;
+  ASSERT_TRUE(az_load_planet_text("data", &full));
+  ASSERT_TRUE(az_load_planet_lazily("data", &lazy));
+  EXPECT_TRUE(full.room_cache == NULL);
+  ASSERT_TRUE(lazy.room_cache != NULL);
+  ASSERT_INT_EQ(full.num_rooms, lazy.num_rooms);
+
+  // The metadata should all be loaded up front, and nothing else.
+  for (int i = 0; i < full.num_rooms; ++i) {
+    const az_room_t *expected = &full.rooms[i];
+    const az_room_t *actual = &lazy.rooms[i];
+    EXPECT_INT_EQ(expected->zone_key, actual->zone_key);
+    EXPECT_INT_EQ(expected->properties, actual->properties);
+    EXPECT_INT_EQ(expected->marker_flag, actual->marker_flag);
+    EXPECT_INT_EQ(expected->background_pattern, actual->background_pattern);
+    EXPECT_APPROX(expected->camera_bounds.min_r, actual->camera_bounds.min_r);
+    EXPECT_APPROX(expected->camera_bounds.theta_span,
+                  actual->camera_bounds.theta_span);
+    EXPECT_TRUE(actual->on_start == NULL);
+    EXPECT_INT_EQ(0, actual->num_walls);
+  }
+  EXPECT_INT_EQ(0, lazy.room_cache->num_loads);
+
+  // Fetching each room's contents should load it, and the previous room
+  // should stay valid while the next one is loaded.
+  const az_room_t *previous = NULL;
+  for (int i = 0; i < full.num_rooms; ++i) {
+    const az_room_t *expected = &full.rooms[i];
+    const az_room_t *actual = az_get_room_contents(&lazy, i);
+    EXPECT_INT_EQ(expected->num_baddies, actual->num_baddies);
+    EXPECT_INT_EQ(expected->num_gravfields, actual->num_gravfields);
+    EXPECT_INT_EQ(expected->num_nodes, actual->num_nodes);
+    EXPECT_TRUE((expected->on_start == NULL) == (actual->on_start == NULL));
+    ASSERT_INT_EQ(expected->num_doors, actual->num_doors);
+    for (int j = 0; j < actual->num_doors; ++j) {
+      EXPECT_INT_EQ(expected->doors[j].destination,
+                    actual->doors[j].destination);
+    }
+    ASSERT_INT_EQ(expected->num_walls, actual->num_walls);
+    for (int j = 0; j < actual->num_walls; ++j) {
+      EXPECT_TRUE(expected->walls[j].data == actual->walls[j].data);
+      EXPECT_VAPPROX(expected->walls[j].position, actual->walls[j].position);
+    }
+    if (previous != NULL) {
+      EXPECT_INT_EQ(full.rooms[i - 1].num_walls, previous->num_walls);
+    }
+    previous = actual;
+  }
+  EXPECT_INT_EQ(full.num_rooms, lazy.room_cache->num_loads);
+
+  // After prefetching a room's neighbors, moving into them shouldn't need any
+  // more loading.
+  const az_room_key_t start = full.start_room;
+  az_get_room_contents(&lazy, start);
+  az_prefetch_room_neighbors(&lazy, start);
+  const int num_loads = lazy.room_cache->num_loads;
+  for (int i = 0; i < full.rooms[start].num_doors; ++i) {
+    az_get_room_contents(&lazy, full.rooms[start].doors[i].destination);
+    az_get_room_contents(&lazy, start);
+  }
+  EXPECT_INT_EQ(num_loads, lazy.room_cache->num_loads);
+
+  az_destroy_planet(&lazy);
+  EXPECT_TRUE(lazy.room_cache == NULL);
+  az_destroy_planet(&full);
+}
+
+// Saving a room (as the editor does for each edited room) should write a file
+// that loads back the same, without leaving a temporary file behind.  Like
+// test_planet_lazy_rooms, this must be run from the top of the source tree.
+void test_planet_save_room(void) {
+  az_planet_t planet;
+  ASSERT_TRUE(az_load_planet_text("data", &planet));
+  const az_room_t *original = &planet.rooms[planet.start_room];
+  ASSERT_TRUE(az_save_room_to_path(original, "out/test_room.txt"));
+  FILE *temp_file = fopen("out/test_room.txt.tmp", "r");
+  EXPECT_TRUE(temp_file == NULL);
+  if (temp_file != NULL) fclose(temp_file);
+  az_room_t room;
+  ASSERT_TRUE(az_load_room_from_path("out/test_room.txt", &room));
+  EXPECT_INT_EQ(original->zone_key, room.zone_key);
+  EXPECT_INT_EQ(original->num_baddies, room.num_baddies);
+  EXPECT_INT_EQ(original->num_nodes, room.num_nodes);
+  ASSERT_INT_EQ(original->num_doors, room.num_doors);
+  for (int i = 0; i < room.num_doors; ++i) {
+    EXPECT_INT_EQ(original->doors[i].destination, room.doors[i].destination);
+  }
+  ASSERT_INT_EQ(original->num_walls, room.num_walls);
+  for (int i = 0; i < room.num_walls; ++i) {
+    EXPECT_TRUE(original->walls[i].data == room.walls[i].data);
+    EXPECT_VAPPROX(original->walls[i].position, room.walls[i].position);
+  }
+  az_destroy_room(&room);
+  az_destroy_planet(&planet);
+  remove("out/test_room.txt");
+}
+
+// Check that az_room_script_at visits each script in a room exactly once,
+// along with the object that owns it.
+void test_room_script_at(void) {
+  az_script_t scripts[5];
+  az_baddie_spec_t baddies[2] = {{.on_kill = &scripts[0]}, {.on_kill = NULL}};
+  az_door_spec_t doors[1] = {{.on_open = &scripts[1]}};
+  az_node_spec_t nodes[2] = {{.on_use = NULL}, {.on_use = &scripts[2]}};
+  const az_room_t room = {
+    .on_start = &scripts[3], .num_baddies = 2, .baddies = baddies,
+    .num_doors = 1, .doors = doors, .num_nodes = 2, .nodes = nodes
+  };
+  EXPECT_INT_EQ(1, az_num_room_script_owners(&room, AZ_SCRIPT_OWNER_ROOM));
+  EXPECT_INT_EQ(2, az_num_room_script_owners(&room, AZ_SCRIPT_OWNER_BADDIE));
+  EXPECT_INT_EQ(0, az_num_room_script_owners(&room,
+                                             AZ_SCRIPT_OWNER_GRAVFIELD));
+  EXPECT_TRUE(az_room_script_at(&room, AZ_SCRIPT_OWNER_ROOM, 0) ==
+              &scripts[3]);
+  EXPECT_TRUE(az_room_script_at(&room, AZ_SCRIPT_OWNER_BADDIE, 1) == NULL);
+  EXPECT_TRUE(az_room_script_at(&room, AZ_SCRIPT_OWNER_DOOR, 0) ==
+              &scripts[1]);
+  EXPECT_TRUE(az_room_script_at(&room, AZ_SCRIPT_OWNER_NODE, 1) ==
+              &scripts[2]);
+  int num_found = 0;
+  for (int owner = 0; owner < AZ_NUM_SCRIPT_OWNERS; ++owner) {
+    const int num_owners = az_num_room_script_owners(&room, owner);
+    for (int i = 0; i < num_owners; ++i) {
+      if (az_room_script_at(&room, owner, i) != NULL) ++num_found;
+    }
+  }
+  EXPECT_INT_EQ(4, num_found);
+}
+
 /*===========================================================================*/
@@ -23,6 +23,15 @@
 
 /*===========================================================================*/
 
+void test_global_random_seed(void) {
+  const az_random_seed_t seed = az_get_global_random_seed();
+  const int first = az_randint(0, 1000000);
+  const double second = az_random(0.0, 1.0);
+  az_set_global_random_seed(seed);
+  EXPECT_INT_EQ(first, az_randint(0, 1000000));
+  EXPECT_TRUE(second == az_random(0.0, 1.0));
+}
+
 void test_random(void) {
   EXPECT_TRUE(az_random(3.5, 3.5) == 3.5);
   EXPECT_TRUE(az_random(-1.25, -1.25) == -1.25);
@@ -0,0 +1,133 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "azimuth/state/baddie.h"
+#include "azimuth/state/player.h"
+#include "azimuth/state/projectile.h"
+#include "azimuth/state/replay.h"
+#include "azimuth/state/space.h"
+#include "azimuth/util/key.h"
+#include "azimuth/util/misc.h"
+#include "azimuth/util/prefs.h"
+#include "test/test.h"
+
+/*===========================================================================*/
+
+void test_replay_round_trip(void) {
+  az_replay_start_t start;
+  AZ_ZERO_OBJECT(&start);
+  start.saved_game_index = 2;
+  start.saved_game.present = true;
+  az_init_player(&start.saved_game.player);
+  start.saved_game.player.current_room = 17;
+  az_reset_prefs_to_defaults(&start.prefs);
+  start.seed = (az_random_seed_t){12345, 67890};
+
+  az_replay_record_t tick = { .kind = AZ_RPR_TICK };
+  tick.data.tick.controls.fire_held = true;
+  tick.data.tick.checksum = UINT64_C(0x0123456789abcdef);
+  az_replay_record_t pause = { .kind = AZ_RPR_PAUSE };
+  az_init_player(&pause.data.pause.player);
+  pause.data.pause.player.rockets = 5;
+  pause.data.pause.prefs = start.prefs;
+  pause.data.pause.prefs.keys[AZ_PREFS_FIRE_KEY_INDEX] = AZ_KEY_F;
+  az_replay_record_t key = { .kind = AZ_RPR_KEY, .data.key = AZ_KEY_3 };
+
+  FILE *file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  EXPECT_TRUE(az_write_replay_start(&start, file));
+  EXPECT_TRUE(az_write_replay_record(&tick, file));
+  EXPECT_TRUE(az_write_replay_record(&pause, file));
+  EXPECT_TRUE(az_write_replay_record(&key, file));
+  // Leave a truncated record at the end, as from a crash mid-write.
+  fputc(AZ_RPR_TICK, file);
+  rewind(file);
+
+  az_replay_start_t start2;
+  EXPECT_TRUE(az_read_replay_start(file, &start2));
+  EXPECT_INT_EQ(2, start2.saved_game_index);
+  EXPECT_TRUE(start2.saved_game.present);
+  EXPECT_INT_EQ(17, start2.saved_game.player.current_room);
+  EXPECT_TRUE(start2.seed.z == 12345 && start2.seed.w == 67890);
+  EXPECT_INT_EQ(start.prefs.keys[AZ_PREFS_UP_KEY_INDEX],
+                start2.prefs.keys[AZ_PREFS_UP_KEY_INDEX]);
+  az_replay_record_t record;
+  EXPECT_TRUE(az_read_replay_record(file, &record));
+  EXPECT_INT_EQ(AZ_RPR_TICK, record.kind);
+  EXPECT_TRUE(record.data.tick.controls.fire_held);
+  EXPECT_FALSE(record.data.tick.controls.up_held);
+  EXPECT_TRUE(record.data.tick.checksum == UINT64_C(0x0123456789abcdef));
+  EXPECT_TRUE(az_read_replay_record(file, &record));
+  EXPECT_INT_EQ(AZ_RPR_PAUSE, record.kind);
+  EXPECT_INT_EQ(5, record.data.pause.player.rockets);
+  EXPECT_INT_EQ(AZ_KEY_F,
+                record.data.pause.prefs.keys[AZ_PREFS_FIRE_KEY_INDEX]);
+  EXPECT_TRUE(az_read_replay_record(file, &record));
+  EXPECT_INT_EQ(AZ_RPR_KEY, record.kind);
+  EXPECT_INT_EQ(AZ_KEY_3, record.data.key);
+  EXPECT_FALSE(az_read_replay_record(file, &record));
+  fclose(file);
+
+  // A replay from some other kind of file must be rejected.
+  file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  fputs("This is not a replay file; it's just some text.", file);
+  rewind(file);
+  EXPECT_FALSE(az_read_replay_start(file, &start2));
+  fclose(file);
+}
+
+static az_space_state_t state;
+
+void test_space_state_checksum(void) {
+  AZ_ZERO_OBJECT(&state);
+  az_init_player(&state.ship.player);
+  state.baddies[3].kind = AZ_BAD_BOX;
+  state.baddies[3].position = (az_vector_t){100, 200};
+  state.projectiles[7].kind = AZ_PROJ_GUN_NORMAL;
+  const uint64_t checksum = az_space_state_checksum(&state);
+  EXPECT_TRUE(checksum == az_space_state_checksum(&state));
+
+  // Cosmetic state shouldn't affect the checksum...
+  state.camera.center.x += 50.0;
+  state.darkness = 0.5;
+  EXPECT_TRUE(checksum == az_space_state_checksum(&state));
+
+  // ...but even the tiniest change to the ship, a baddie, or a projectile
+  // should.
+  state.ship.velocity.y = 1e-300;
+  EXPECT_FALSE(checksum == az_space_state_checksum(&state));
+  state.ship.velocity.y = 0.0;
+  EXPECT_TRUE(checksum == az_space_state_checksum(&state));
+  state.baddies[3].health += 0.5;
+  EXPECT_FALSE(checksum == az_space_state_checksum(&state));
+  state.baddies[3].health -= 0.5;
+  state.projectiles[7].age = 0.25;
+  EXPECT_FALSE(checksum == az_space_state_checksum(&state));
+  state.projectiles[7].age = 0.0;
+  // Objects that aren't present don't count.
+  state.baddies[4].position.x = 3.0;
+  EXPECT_TRUE(checksum == az_space_state_checksum(&state));
+}
+
+/*===========================================================================*/
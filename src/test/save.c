@@ -0,0 +1,105 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/select.h>
+
+#include "azimuth/state/planet.h"
+#include "azimuth/state/player.h"
+#include "azimuth/state/save.h"
+#include "azimuth/util/file.h"
+#include "test/test.h"
+
+/*===========================================================================*/
+
+static const char test_save_path[] = "out/test_save.txt";
+
+static bool write_garbage_then_fail(void *data, FILE *file) {
+  fputs("garbage", file);
+  return false;
+}
+
+static void make_test_games(az_saved_games_t *games) {
+  az_reset_saved_games(games);
+  games->highest_percentage = 42;
+  games->games[1].present = true;
+  az_init_player(&games->games[1].player);
+  games->games[1].player.current_room = 3;
+}
+
+void test_save_games_atomic(void) {
+  const az_planet_t planet = { .num_rooms = 5 };
+  az_saved_games_t games;
+  make_test_games(&games);
+  ASSERT_TRUE(az_save_games_to_path(&games, test_save_path));
+
+  // A failed write must leave the existing file (and nothing else) behind.
+  EXPECT_FALSE(az_write_file_atomically(test_save_path,
+                                        write_garbage_then_fail, NULL));
+  FILE *temp_file = fopen("out/test_save.txt.tmp", "r");
+  EXPECT_TRUE(temp_file == NULL);
+  if (temp_file != NULL) fclose(temp_file);
+
+  az_saved_games_t loaded;
+  EXPECT_TRUE(az_load_games_from_path(&planet, test_save_path, &loaded));
+  EXPECT_INT_EQ(42, loaded.highest_percentage);
+  EXPECT_FALSE(loaded.games[0].present);
+  EXPECT_TRUE(loaded.games[1].present);
+  EXPECT_INT_EQ(3, loaded.games[1].player.current_room);
+  remove(test_save_path);
+}
+
+// Wait for the background save to finish, and return true, or return false if
+// it takes more than a few seconds.
+static bool wait_for_saving_games(bool *success_out) {
+  for (int i = 0; i < 5000; ++i) {
+    if (az_poll_saving_games(success_out)) return true;
+    // C99 has no nanosleep, so sleep for a millisecond with select instead.
+    struct timeval delay = {.tv_sec = 0, .tv_usec = 1000};
+    select(0, NULL, NULL, NULL, &delay);
+  }
+  return false;
+}
+
+void test_save_games_background(void) {
+  const az_planet_t planet = { .num_rooms = 5 };
+  az_saved_games_t games;
+  make_test_games(&games);
+  bool success = false;
+  EXPECT_FALSE(az_poll_saving_games(&success));
+  az_begin_saving_games_to_path(&games, test_save_path);
+  // The save works from a snapshot, so changing the games now mustn't matter.
+  games.games[1].player.current_room = 4;
+  ASSERT_TRUE(wait_for_saving_games(&success));
+  EXPECT_TRUE(success);
+  EXPECT_FALSE(az_poll_saving_games(&success));
+
+  az_saved_games_t loaded;
+  EXPECT_TRUE(az_load_games_from_path(&planet, test_save_path, &loaded));
+  EXPECT_INT_EQ(3, loaded.games[1].player.current_room);
+  remove(test_save_path);
+
+  // Saving to a directory that doesn't exist should report failure.
+  az_begin_saving_games_to_path(&games, "out/no/such/dir/save.txt");
+  ASSERT_TRUE(wait_for_saving_games(&success));
+  EXPECT_FALSE(success);
+}
+
+/*===========================================================================*/
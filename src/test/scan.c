@@ -0,0 +1,107 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "azimuth/util/misc.h"
+#include "azimuth/util/scan.h"
+#include "test/test.h"
+
+/*===========================================================================*/
+
+// Scan a double from the string with both az_scan and sscanf, and check that
+// they agree exactly (including how much input they consume).
+static void check_double(const char *string) {
+  double expected = 0.0, actual = 0.0;
+  int expected_length = -1, actual_length = -1;
+  const int expected_result =
+    sscanf(string, "%lf%n", &expected, &expected_length);
+  az_scanner_t scanner;
+  az_init_scanner(&scanner, string, strlen(string));
+  const int actual_result = az_scan(&scanner, "%lf%n", &actual,
+                                    &actual_length);
+  EXPECT_INT_EQ(expected_result, actual_result);
+  EXPECT_INT_EQ(expected_length, actual_length);
+  EXPECT_TRUE(memcmp(&expected, &actual, sizeof(double)) == 0);
+}
+
+void test_scan_numbers(void) {
+  const char *doubles[] = {
+    "0", "-0.00", "1659.04", "-3.009731", "0.533747", ".5", "5.", "+7.25",
+    "-1251.09x", "9007199254740993", "0.1234567890123456789", "1e3",
+    "2.5E-3,", "123456789.123456789", "0.30000000000000004", "x", "-",
+    "  42"
+  };
+  for (int i = 0; i < AZ_ARRAY_SIZE(doubles); ++i) {
+    check_double(doubles[i]);
+  }
+
+  az_scanner_t scanner;
+  const char *ints = "-17 +3 2147483647 12x";
+  az_init_scanner(&scanner, ints, strlen(ints));
+  int a = 0, b = 0, c = 0, d = 0;
+  EXPECT_INT_EQ(4, az_scan(&scanner, "%d%d%d%d", &a, &b, &c, &d));
+  EXPECT_INT_EQ(-17, a);
+  EXPECT_INT_EQ(3, b);
+  EXPECT_INT_EQ(2147483647, c);
+  EXPECT_INT_EQ(12, d);
+  EXPECT_INT_EQ('x', az_scan_getc(&scanner));
+  EXPECT_INT_EQ(EOF, az_scan_getc(&scanner));
+}
+
+void test_scan_format(void) {
+  // The scanner shouldn't need its input to be NUL-terminated, so only give
+  // it part of this string.
+  const char *input = "@R z7 p12/3\n  c(1.5,-2)!W1 d23 u0;@@@";
+  az_scanner_t scanner;
+  az_init_scanner(&scanner, input, strlen(input) - 3);
+  int zone = 0, marker = 0, count = 0;
+  unsigned int properties = 0;
+  double x = 0.0, y = 0.0;
+  EXPECT_INT_EQ(2, az_scan(&scanner, "@R z%d p%u", &zone, &properties));
+  EXPECT_INT_EQ(7, zone);
+  EXPECT_INT_EQ(12, properties);
+  EXPECT_INT_EQ(1, az_scan(&scanner, "/%d", &marker));
+  EXPECT_INT_EQ(3, marker);
+  EXPECT_INT_EQ(2, az_scan(&scanner, " c(%lf,%lf)%n", &x, &y, &count));
+  EXPECT_APPROX(1.5, x);
+  EXPECT_APPROX(-2.0, y);
+  EXPECT_INT_EQ(12, count);
+  EXPECT_TRUE(az_scan_try_char(&scanner, '!'));
+  EXPECT_FALSE(az_scan_try_char(&scanner, '!'));
+  char name[3];
+  EXPECT_INT_EQ(1, az_scan(&scanner, "%2[A-Z]", name));
+  EXPECT_STRING_EQ("W", name);
+  // A mismatched literal stops the scan without consuming that character.
+  EXPECT_INT_EQ(1, az_scan(&scanner, "%d x%d", &zone, &marker));
+  EXPECT_INT_EQ(1, zone);
+  EXPECT_INT_EQ('d', az_scan_peek(&scanner));
+  char ch = '\0';
+  EXPECT_INT_EQ(1, az_scan(&scanner, " %c", &ch));
+  EXPECT_INT_EQ('d', ch);
+  EXPECT_INT_EQ(2, az_scan(&scanner, "%d u%d;", &zone, &marker));
+  EXPECT_INT_EQ(23, zone);
+  EXPECT_INT_EQ(0, marker);
+  // Running out of input before any conversion is an input failure.
+  EXPECT_INT_EQ(EOF, az_scan(&scanner, " %c", &ch));
+  EXPECT_INT_EQ(EOF, az_scan_peek(&scanner));
+}
+
+/*===========================================================================*/
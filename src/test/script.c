@@ -17,8 +17,12 @@
 | with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
 =============================================================================*/
 
+#include <math.h>
+#include <stdio.h>
 #include <string.h>
 
+#include "azimuth/state/planet.h"
+#include "azimuth/state/room.h"
 #include "azimuth/state/script.h"
 #include "azimuth/util/misc.h"
 #include "test/test.h"
@@ -93,4 +97,173 @@ void test_script_clone(void) {
   az_free_script(script2);
 }
 
+// This is how az_sscan_script used to work (by round-tripping the string
+// through a temporary file), for comparison with the in-memory version.
+static az_script_t *sscan_script_via_file(const char *string) {
+  FILE *file = tmpfile();
+  if (file == NULL) return NULL;
+  az_script_t *script = NULL;
+  if (fputs(string, file) >= 0) {
+    rewind(file);
+    script = az_fscan_script(file);
+  }
+  fclose(file);
+  return script;
+}
+
+static bool scripts_equal(const az_script_t *script1,
+                          const az_script_t *script2) {
+  if (script1 == NULL || script2 == NULL) return script1 == script2;
+  if (script1->num_instructions != script2->num_instructions) return false;
+  for (int i = 0; i < script1->num_instructions; ++i) {
+    const az_instruction_t ins1 = script1->instructions[i];
+    const az_instruction_t ins2 = script2->instructions[i];
+    if (ins1.opcode != ins2.opcode) return false;
+    if (ins1.immediate != ins2.immediate &&
+        !(isnan(ins1.immediate) && isnan(ins2.immediate))) return false;
+  }
+  return script1->verified == script2->verified &&
+    script1->max_stack_depth == script2->max_stack_depth;
+}
+
+static void expect_same_as_file_scan(const char *string) {
+  az_script_t *expected = sscan_script_via_file(string);
+  az_script_t *actual = az_sscan_script(string, strlen(string));
+  EXPECT_TRUE(scripts_equal(expected, actual));
+  az_free_script(expected);
+  az_free_script(actual);
+}
+
+static void add_room_script_texts(const az_script_t *script, int *num_texts,
+                                  char texts[][1000]) {
+  if (script == NULL) return;
+  ASSERT_TRUE(az_sprint_script(script, texts[*num_texts], 1000));
+  ++*num_texts;
+}
+
+// This test uses the game's real room files, so it must be run from the top of
+// the source tree (as "make test" does).
+void test_script_scan_fuzz(void) {
+  az_planet_t planet;
+  ASSERT_TRUE(az_load_planet_text("data", &planet));
+  static char texts[2000][1000];
+  int num_texts = 0;
+  add_room_script_texts(planet.on_start, &num_texts, texts);
+  for (int i = 0; i < planet.num_rooms; ++i) {
+    const az_room_t *room = &planet.rooms[i];
+    ASSERT_TRUE(num_texts + 1 + room->num_baddies + room->num_doors +
+                room->num_gravfields + room->num_nodes <=
+                AZ_ARRAY_SIZE(texts));
+    for (int owner = 0; owner < AZ_NUM_SCRIPT_OWNERS; ++owner) {
+      const int num_owners = az_num_room_script_owners(room, owner);
+      for (int j = 0; j < num_owners; ++j) {
+        add_room_script_texts(az_room_script_at(room, owner, j), &num_texts,
+                              texts);
+      }
+    }
+  }
+  az_destroy_planet(&planet);
+  EXPECT_TRUE(num_texts > 100);
+
+  // Every real script should parse the same way as before, and then so should
+  // randomly-mangled versions of them (most of which won't parse at all).  To
+  // keep the parser from complaining too much on stderr, leave the opcode
+  // names alone, and mangle only the punctuation, labels, and numbers.
+  static const char alphabet[] = "AZ@#/,;.-+019 ";
+  unsigned int seed = 12345;
+  for (int i = 0; i < num_texts; ++i) {
+    expect_same_as_file_scan(texts[i]);
+    for (int j = 0; j < 10; ++j) {
+      char mangled[1001];
+      strcpy(mangled, texts[i]);
+      const int length = strlen(mangled);
+      seed = seed * 1103515245u + 12345u;
+      int position = (seed >> 8) % (length + 1);
+      while ('a' <= mangled[position] && mangled[position] <= 'z') {
+        ++position;
+      }
+      const char ch = alphabet[(seed >> 20) % (sizeof(alphabet) - 1)];
+      switch (j % 4) {
+        case 0: mangled[position] = '\0'; break; // truncate
+        case 1: if (position < length) mangled[position] = ch; break;
+        case 2: // delete a character
+          memmove(mangled + position, mangled + position + 1,
+                  length - position);
+          break;
+        case 3: // insert a character
+          memmove(mangled + position + 1, mangled + position,
+                  length - position + 1);
+          mangled[position] = ch;
+          break;
+      }
+      expect_same_as_file_scan(mangled);
+    }
+  }
+}
+
+void test_script_verify(void) {
+  // The test script from above underflows the stack in its BNEZ.
+  az_script_t *script = az_sscan_script(script_string, strlen(script_string));
+  ASSERT_TRUE(script != NULL);
+  EXPECT_FALSE(script->verified);
+  az_free_script(script);
+
+  // Scripts that can't misuse the stack should be verified, with their
+  // maximum depth taken over all paths through the script.
+  const char *good_strings[] = {
+    "gpos1,push1,push2,vadd,spos1;",
+    "test5,beqz/A,push1,push2,A#nop;",
+    "push3,A#subi1,dup,bnez/A,pop;"
+  };
+  const int good_depths[] = {4, 2, 2};
+  for (int i = 0; i < AZ_ARRAY_SIZE(good_strings); ++i) {
+    script = az_sscan_script(good_strings[i], strlen(good_strings[i]));
+    ASSERT_TRUE(script != NULL);
+    EXPECT_TRUE(script->verified);
+    EXPECT_INT_EQ(good_depths[i], script->max_stack_depth);
+    // Clones should be verified too.
+    az_script_t *clone = az_clone_script(script);
+    EXPECT_TRUE(clone->verified);
+    EXPECT_INT_EQ(good_depths[i], clone->max_stack_depth);
+    az_free_script(clone);
+    az_free_script(script);
+  }
+
+  // Scripts that can underflow or overflow (even if they wouldn't in
+  // practice) should fail verification.
+  const char *bad_strings[] = {
+    "pop;", "push1,vadd;", "test5,bnez/A,push1,A#pop;",
+    "A#push1,jump/A;", "push1,swap3;"
+  };
+  for (int i = 0; i < AZ_ARRAY_SIZE(bad_strings); ++i) {
+    script = az_sscan_script(bad_strings[i], strlen(bad_strings[i]));
+    ASSERT_TRUE(script != NULL);
+    EXPECT_FALSE(script->verified);
+    az_free_script(script);
+  }
+
+  // So should jumps out of range, invalid opcodes, and non-finite pushes.
+  az_instruction_t instructions[] = {
+    { .opcode = AZ_OP_PUSH, .immediate = 1 },
+    { .opcode = AZ_OP_BEQZ, .immediate = 2 },
+    { .opcode = AZ_OP_HALT }
+  };
+  az_script_t manual = { .num_instructions = AZ_ARRAY_SIZE(instructions),
+                         .instructions = instructions };
+  EXPECT_FALSE(manual.verified);
+  EXPECT_TRUE(az_verify_script(&manual));
+  EXPECT_INT_EQ(1, manual.max_stack_depth);
+  instructions[1].immediate = 3;
+  EXPECT_FALSE(az_verify_script(&manual));
+  EXPECT_FALSE(manual.verified);
+  instructions[1].immediate = -2;
+  EXPECT_FALSE(az_verify_script(&manual));
+  instructions[1].immediate = 2;
+  instructions[0].immediate = INFINITY;
+  EXPECT_FALSE(az_verify_script(&manual));
+  instructions[0].immediate = 1;
+  instructions[2].opcode = (az_opcode_t)(AZ_OP_ERROR + 1);
+  EXPECT_FALSE(az_verify_script(&manual));
+}
+
 /*===========================================================================*/
@@ -0,0 +1,155 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "azimuth/state/baddie.h"
+#include "azimuth/state/planet.h"
+#include "azimuth/state/player.h"
+#include "azimuth/state/projectile.h"
+#include "azimuth/state/room.h"
+#include "azimuth/state/snapshot.h"
+#include "azimuth/state/space.h"
+#include "azimuth/util/misc.h"
+#include "azimuth/util/prefs.h"
+#include "azimuth/util/random.h"
+#include "test/test.h"
+
+/*===========================================================================*/
+
+static az_space_state_t state, restored;
+static az_space_snapshot_t snapshot, loaded;
+
+// Find a room with a door that has an on_open script.
+static az_room_key_t find_room_with_door_script(const az_planet_t *planet) {
+  for (int key = 0; key < planet->num_rooms; ++key) {
+    const az_room_t *room = az_get_room_contents(planet, key);
+    for (int i = 0; i < room->num_doors; ++i) {
+      if (room->doors[i].on_open != NULL) return key;
+    }
+  }
+  return -1;
+}
+
+static void set_up_state(const az_planet_t *planet,
+                         const az_preferences_t *prefs, az_room_key_t key) {
+  AZ_ZERO_OBJECT(&state);
+  state.planet = planet;
+  state.prefs = prefs;
+  az_init_player(&state.ship.player);
+  state.ship.player.current_room = key;
+  az_enter_room(&state, key);
+  state.ship.position = (az_vector_t){123.5, -45.25};
+  state.clock = 9876;
+  state.sync_vm.script = planet->on_start;
+  state.sync_vm.pc = 3;
+  state.monologue.paragraph = planet->paragraphs[planet->num_paragraphs - 1];
+  az_set_message(&state, "Not one of the planet's paragraphs.");
+  az_init_projectile(&state.projectiles[5], AZ_PROJ_GUN_NORMAL,
+                     (az_vector_t){10, 20}, 1.0, 1.0, AZ_SHIP_UID);
+  az_particle_t *particle;
+  if (az_insert_particle(&state, &particle)) {
+    particle->kind = AZ_PAR_SPARK;
+    particle->age = 0.5;
+  }
+}
+
+static void check_restored(const az_planet_t *planet) {
+  EXPECT_TRUE(restored.planet == planet);
+  EXPECT_TRUE(restored.prefs == state.prefs);
+  EXPECT_TRUE(restored.ship.position.x == 123.5);
+  EXPECT_TRUE(restored.ship.position.y == -45.25);
+  EXPECT_TRUE(restored.clock == 9876);
+  EXPECT_TRUE(restored.sync_vm.script == planet->on_start);
+  EXPECT_INT_EQ(3, restored.sync_vm.pc);
+  EXPECT_TRUE(restored.monologue.paragraph == state.monologue.paragraph);
+  // Messages that don't come from the planet aren't captured.
+  EXPECT_TRUE(restored.message.paragraph == NULL);
+  EXPECT_TRUE(restored.message.time_remaining == 0.0);
+  EXPECT_TRUE(restored.projectiles[5].data == state.projectiles[5].data);
+  EXPECT_TRUE(restored.projectiles[5].position.y == 20.0);
+  EXPECT_TRUE(restored.particles[0].age == state.particles[0].age);
+  for (int i = 0; i < AZ_ARRAY_SIZE(state.baddies); ++i) {
+    EXPECT_INT_EQ(state.baddies[i].kind, restored.baddies[i].kind);
+    if (state.baddies[i].kind == AZ_BAD_NOTHING) continue;
+    EXPECT_TRUE(restored.baddies[i].data == state.baddies[i].data);
+    EXPECT_TRUE(restored.baddies[i].on_kill == state.baddies[i].on_kill);
+  }
+  for (int i = 0; i < AZ_ARRAY_SIZE(state.doors); ++i) {
+    EXPECT_TRUE(restored.doors[i].on_open == state.doors[i].on_open);
+  }
+  for (int i = 0; i < AZ_ARRAY_SIZE(state.nodes); ++i) {
+    EXPECT_TRUE(restored.nodes[i].on_use == state.nodes[i].on_use);
+  }
+  for (int i = 0; i < AZ_ARRAY_SIZE(state.walls); ++i) {
+    EXPECT_INT_EQ(state.walls[i].kind, restored.walls[i].kind);
+    EXPECT_TRUE(restored.walls[i].data == state.walls[i].data);
+  }
+}
+
+void test_space_snapshot(void) {
+  az_planet_t planet;
+  ASSERT_TRUE(az_load_planet_text("data", &planet));
+  az_preferences_t prefs;
+  az_reset_prefs_to_defaults(&prefs);
+  const az_room_key_t key = find_room_with_door_script(&planet);
+  ASSERT_TRUE(key >= 0);
+  set_up_state(&planet, &prefs, key);
+
+  const az_random_seed_t seed = az_get_global_random_seed();
+  ASSERT_TRUE(az_take_space_snapshot(&state, &snapshot));
+  az_random(0, 1);
+
+  // Round-trip the snapshot through a file, then restore it.
+  FILE *file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  EXPECT_TRUE(az_write_space_snapshot(&snapshot, file));
+  rewind(file);
+  EXPECT_TRUE(az_read_space_snapshot(file, &loaded));
+  fclose(file);
+  ASSERT_TRUE(az_restore_space_snapshot(&loaded, &planet, &prefs,
+                                        &restored));
+  check_restored(&planet);
+  const az_random_seed_t restored_seed = az_get_global_random_seed();
+  EXPECT_TRUE(restored_seed.z == seed.z && restored_seed.w == seed.w);
+
+  // The same snapshot can be restored into a lazily-loaded copy of the
+  // planet, too.
+  az_planet_t lazy;
+  ASSERT_TRUE(az_load_planet_lazily("data", &lazy));
+  set_up_state(&lazy, &prefs, key);
+  ASSERT_TRUE(az_take_space_snapshot(&state, &snapshot));
+  ASSERT_TRUE(az_restore_space_snapshot(&snapshot, &lazy, &prefs,
+                                        &restored));
+  check_restored(&lazy);
+
+  // A snapshot can't be restored with a different planet, nor can one that
+  // refers to a script that the planet doesn't own be taken.
+  EXPECT_FALSE(az_restore_space_snapshot(
+      &snapshot, &(az_planet_t){ .num_rooms = 1 }, &prefs, &restored));
+  const az_script_t foreign_script = { .num_instructions = 0 };
+  state.timers[0].vm.script = &foreign_script;
+  EXPECT_FALSE(az_take_space_snapshot(&state, &snapshot));
+
+  az_destroy_planet(&lazy);
+  az_destroy_planet(&planet);
+}
+
+/*===========================================================================*/
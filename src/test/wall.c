@@ -0,0 +1,82 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#include <stdbool.h>
+
+#include "azimuth/state/wall.h"
+#include "azimuth/util/grid.h"
+#include "azimuth/util/random.h"
+#include "azimuth/util/vector.h"
+#include "test/test.h"
+
+/*===========================================================================*/
+
+#define NUM_ROOMS 20
+#define MAX_WALLS 200
+
+// Check that sweeping a circle through the walls of random rooms gives
+// exactly the same results with a grid as by testing every wall.
+void test_circle_hits_walls_indexed(void) {
+  az_random_seed_t seed = {7, 11};
+  for (int room = 0; room < NUM_ROOMS; ++room) {
+    const int num_walls = (room == 0 ? 0 :
+        1 + (int)(az_rand_udouble(&seed) * (MAX_WALLS - 1)));
+    az_wall_t walls[MAX_WALLS];
+    az_grid_circle_t circles[MAX_WALLS];
+    for (int i = 0; i < num_walls; ++i) {
+      const int data_index =
+        (int)(az_rand_udouble(&seed) * AZ_NUM_WALL_DATAS) %
+        AZ_NUM_WALL_DATAS;
+      walls[i] = (az_wall_t){
+        .kind = AZ_WALL_INDESTRUCTIBLE,
+        .data = az_get_wall_data(data_index),
+        .position = {1500.0 * az_rand_sdouble(&seed),
+                     1500.0 * az_rand_sdouble(&seed)},
+        .angle = AZ_PI * az_rand_sdouble(&seed)
+      };
+      circles[i].center = walls[i].position;
+      circles[i].radius = walls[i].data->bounding_radius;
+    }
+    az_circle_grid_t grid = {0};
+    az_build_circle_grid(&grid, num_walls, circles, 64.0);
+    for (int trial = 0; trial < 50; ++trial) {
+      const double radius = (trial % 3 == 0 ? 0.0 :
+                             30.0 * az_rand_udouble(&seed));
+      const az_vector_t start = {2000.0 * az_rand_sdouble(&seed),
+                                 2000.0 * az_rand_sdouble(&seed)};
+      const az_vector_t delta =
+        az_vpolar((trial % 2 == 0 ? 10000.0 : 300.0) *
+                  az_rand_udouble(&seed), AZ_PI * az_rand_sdouble(&seed));
+      az_vector_t expected_pos = AZ_VZERO, expected_normal = AZ_VZERO;
+      const bool expected_hit = az_circle_hits_walls(
+          walls, num_walls, NULL, radius, start, delta,
+          &expected_pos, &expected_normal);
+      az_vector_t actual_pos = AZ_VZERO, actual_normal = AZ_VZERO;
+      const bool actual_hit = az_circle_hits_walls(
+          walls, num_walls, &grid, radius, start, delta,
+          &actual_pos, &actual_normal);
+      EXPECT_TRUE(expected_hit == actual_hit);
+      EXPECT_VAPPROX(expected_pos, actual_pos);
+      EXPECT_VAPPROX(expected_normal, actual_normal);
+    }
+    az_destroy_circle_grid(&grid);
+  }
+}
+
+/*===========================================================================*/
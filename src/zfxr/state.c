@@ -19,7 +19,11 @@
 
 #include "zfxr/state.h"
 
+#include <assert.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 #include "azimuth/util/audio.h"
 #include "azimuth/util/misc.h"
@@ -28,31 +32,112 @@
 
 /*===========================================================================*/
 
+// How many samples the synthesis thread generates between checks for a newer
+// request:
+#define SYNTH_CHUNK_SAMPLES 1024
+// How far the synthesis thread must get into a new sound before we start
+// playing it, so that playback won't overtake synthesis:
+#define PLAYBACK_LEAD_SAMPLES 4096
+
+static void *run_synth_thread(void *arg) {
+  az_zfxr_state_t *state = arg;
+  az_sound_synth_t synth;
+  int generation = 0;
+  int16_t *samples = NULL;
+  int num_samples = 0;
+  pthread_mutex_lock(&state->synth.mutex);
+  while (true) {
+    while (state->synth.generation == generation &&
+           (samples == NULL || synth.finished)) {
+      pthread_cond_wait(&state->synth.cond, &state->synth.mutex);
+    }
+    // If there's a newer request, drop whatever we were working on, and start
+    // on the new sound in a buffer that the audio system isn't using.
+    if (state->synth.generation != generation) {
+      generation = state->synth.generation;
+      az_reset_sound_synth(&synth, &state->synth.spec);
+      int buffer = 0;
+      while (buffer == state->synth.playing ||
+             buffer == state->synth.retired) ++buffer;
+      assert(buffer < AZ_ZFXR_NUM_BUFFERS);
+      state->synth.buffer = buffer;
+      state->synth.buffer_generation = generation;
+      state->synth.num_synthesized = 0;
+      state->synth.finished = false;
+      samples = state->buffers[buffer].samples;
+      num_samples = 0;
+    }
+    pthread_mutex_unlock(&state->synth.mutex);
+    num_samples += az_synthesize_sound(&synth, samples + num_samples,
+                                       SYNTH_CHUNK_SAMPLES);
+    pthread_mutex_lock(&state->synth.mutex);
+    if (state->synth.generation == generation) {
+      state->synth.num_synthesized = num_samples;
+      state->synth.finished = synth.finished;
+    }
+  }
+  return NULL;
+}
+
 void az_init_zfxr_state(az_zfxr_state_t *state) {
   AZ_ZERO_OBJECT(state);
   state->sound_spec.wave_kind = AZ_TRIANGLE_WAVE;
   state->sound_spec.env_decay = 0.375;
   state->sound_spec.start_freq = 0.25;
   state->sound_spec.freq_slide = 0.25;
-  az_create_sound_data(&state->sound_spec, &state->sound_data);
   state->request_play = true;
+  AZ_ARRAY_LOOP(buffer, state->buffers) {
+    buffer->samples = AZ_ALLOC(AZ_MAX_SOUND_SAMPLES, int16_t);
+  }
+  state->synth.playing = state->synth.retired = -1;
+  if (pthread_mutex_init(&state->synth.mutex, NULL) != 0 ||
+      pthread_cond_init(&state->synth.cond, NULL) != 0 ||
+      pthread_create(&state->synth_thread, NULL, run_synth_thread,
+                     state) != 0) {
+    AZ_FATAL("Couldn't start the synthesis thread.\n");
+  }
 }
 
 void az_tick_zfxr_state(az_zfxr_state_t *state, double time) {
-  if (state->request_play) {
-    if (state->ready_to_play) {
-      az_destroy_sound_data(&state->sound_data);
-      az_create_sound_data(&state->sound_spec, &state->sound_data);
-      az_persist_sound_data(&state->soundboard, &state->sound_data, 1);
+  bool restart = false;
+  int playing, num_samples = 0;
+  pthread_mutex_lock(&state->synth.mutex); {
+    // The audio system has been ticked since the last frame, so it no longer
+    // refers to the sound that we stopped playing then.
+    state->synth.retired = -1;
+    if (state->request_play) {
+      state->synth.spec = state->sound_spec;
+      ++state->synth.generation;
+      pthread_cond_signal(&state->synth.cond);
       state->request_play = false;
-      state->ready_to_play = false;
-    } else {
-      az_reset_sound_data(&state->soundboard, &state->sound_data);
-      state->ready_to_play = true;
     }
-  } else {
-    az_persist_sound_data(&state->soundboard, &state->sound_data, 1);
+    // Switch to the newest sound once enough of it is ready.  Until then, let
+    // the previous sound keep playing.
+    if (state->synth.buffer_generation == state->synth.generation &&
+        state->synth.buffer != state->synth.playing &&
+        (state->synth.finished ||
+         state->synth.num_synthesized >= PLAYBACK_LEAD_SAMPLES)) {
+      state->synth.retired = state->synth.playing;
+      state->synth.playing = (state->synth.num_synthesized > 0 ?
+                              state->synth.buffer : -1);
+      restart = true;
+    }
+    playing = state->synth.playing;
+    if (playing >= 0 && playing == state->synth.buffer) {
+      num_samples = state->synth.num_synthesized;
+    }
+  } pthread_mutex_unlock(&state->synth.mutex);
+
+  if (playing < 0) return;
+  az_sound_data_t *sound_data = &state->buffers[playing];
+  // If the synthesis thread has moved on to a newer request, this sound won't
+  // get any longer, so just leave its length as is.
+  if (num_samples > 0) {
+    __atomic_store_n(&sound_data->num_samples, (size_t)num_samples,
+                     __ATOMIC_RELEASE);
   }
+  if (restart) az_reset_sound_data(&state->soundboard, sound_data);
+  az_persist_sound_data(&state->soundboard, sound_data, 1, AZ_SNDPRI_NORMAL);
 }
 
 /*===========================================================================*/
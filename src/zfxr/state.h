@@ -21,6 +21,7 @@
 #ifndef ZFXR_STATE_H_
 #define ZFXR_STATE_H_
 
+#include <pthread.h>
 #include <stdbool.h>
 
 #include "azimuth/util/audio.h"
@@ -28,11 +29,38 @@
 
 /*===========================================================================*/
 
+// How many sound buffers the synthesis thread rotates through; we need one
+// for the sound being played, one for the sound that just stopped playing (in
+// case the audio system hasn't let go of it yet), and one to synthesize into.
+#define AZ_ZFXR_NUM_BUFFERS 3
+
 typedef struct {
   az_sound_spec_t sound_spec;
-  az_sound_data_t sound_data;
   az_soundboard_t soundboard;
-  bool request_play, ready_to_play;
+  bool request_play;
+  // Each buffer holds up to AZ_MAX_SOUND_SAMPLES samples.  The num_samples
+  // field of each one is only written by az_tick_zfxr_state, and never goes
+  // past what the synthesis thread has published.
+  az_sound_data_t buffers[AZ_ZFXR_NUM_BUFFERS];
+  pthread_t synth_thread;
+  // Shared with the synthesis thread; all fields are protected by the mutex.
+  struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    // The spec most recently requested, and a counter that is incremented
+    // with each request.  The synthesis thread abandons any older request as
+    // soon as a newer one comes in.
+    az_sound_spec_t spec;
+    int generation;
+    // Which buffers are being played, and stopped being played this frame
+    // (or -1 for none); the synthesis thread won't write into either.
+    int playing, retired;
+    // The buffer the synthesis thread is writing into, the generation it is
+    // synthesizing, and its progress so far.
+    int buffer, buffer_generation;
+    int num_synthesized;
+    bool finished;
+  } synth;
 } az_zfxr_state_t;
 
 void az_init_zfxr_state(az_zfxr_state_t *state);
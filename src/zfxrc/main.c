@@ -0,0 +1,199 @@
+/*=============================================================================
+| Copyright 2012 Matthew D. Steele <mdsteele@alum.mit.edu>                    |
+|                                                                             |
+| This file is part of Azimuth.                                               |
+|                                                                             |
+| Azimuth is free software: you can redistribute it and/or modify it under    |
+| the terms of the GNU General Public License as published by the Free        |
+| Software Foundation, either version 3 of the License, or (at your option)   |
+| any later version.                                                          |
+|                                                                             |
+| Azimuth is distributed in the hope that it will be useful, but WITHOUT      |
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       |
+| FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   |
+| more details.                                                               |
+|                                                                             |
+| You should have received a copy of the GNU General Public License along     |
+| with Azimuth.  If not, see <http://www.gnu.org/licenses/>.                  |
+=============================================================================*/
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "azimuth/state/sound.h"
+#include "azimuth/util/misc.h"
+#include "azimuth/util/sound.h"
+#include "azimuth/util/string.h"
+#include "azimuth/util/vector.h"
+
+/*===========================================================================*/
+
+// The sound synthesizer never outputs samples beyond this magnitude; any
+// samples that reach it were clipped.
+#define MAX_SAMPLE_MAGNITUDE 32000
+
+static double wall_seconds(void) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (double)now.tv_sec + 1e-6 * (double)now.tv_usec;
+}
+
+// Sounds are identified by number, as in scripts.
+static char *wav_path_for_key(const char *dir, int sound_index) {
+  return az_strprintf("%s/sound%03d.wav", dir, sound_index);
+}
+
+static bool write_wav(const char *path, const az_sound_data_t *data) {
+  FILE *file = fopen(path, "wb");
+  bool success = (file != NULL);
+  if (success) {
+    success = az_write_wav_file(file, data->samples, data->num_samples);
+    success = (fclose(file) == 0) && success;
+  }
+  if (!success) fprintf(stderr, "ERROR: failed to write %s.\n", path);
+  return success;
+}
+
+// Synthesizes every sound in the game (writing each one to a WAV file in
+// output_dir, if that isn't NULL), and reports how long each one takes to
+// synthesize, how long it is, and how loud it gets.
+static int export_sounds(const char *output_dir) {
+  int num_clipped_sounds = 0;
+  size_t total_samples = 0;
+  double total_seconds = 0.0;
+  for (int i = 1; i <= AZ_NUM_SOUND_KEYS; ++i) {
+    const az_sound_spec_t *spec = az_get_sound_spec((az_sound_key_t)i);
+    az_sound_data_t data;
+    const double start = wall_seconds();
+    az_create_sound_data(spec, &data);
+    const double seconds = wall_seconds() - start;
+    int peak = 0, num_clipped = 0;
+    for (size_t j = 0; j < data.num_samples; ++j) {
+      const int magnitude = abs(data.samples[j]);
+      peak = az_imax(peak, magnitude);
+      if (magnitude >= MAX_SAMPLE_MAGNITUDE) ++num_clipped;
+    }
+    printf("sound%03d: %6zu samples (%.3fs), synth %7.3f ms, peak %5.1f%%",
+           i, data.num_samples, (double)data.num_samples / AZ_AUDIO_RATE,
+           1000.0 * seconds, 100.0 * peak / MAX_SAMPLE_MAGNITUDE);
+    if (num_clipped > 0) {
+      printf(", %d samples clipped", num_clipped);
+      ++num_clipped_sounds;
+    }
+    printf("\n");
+    total_samples += data.num_samples;
+    total_seconds += seconds;
+    bool success = true;
+    if (output_dir != NULL) {
+      char *path = wav_path_for_key(output_dir, i);
+      success = write_wav(path, &data);
+      az_free(path);
+    }
+    az_destroy_sound_data(&data);
+    if (!success) return EXIT_FAILURE;
+  }
+  printf("Synthesized %d sounds (%.2fs of audio) in %.3fs; %d clipped\n",
+         AZ_NUM_SOUND_KEYS, (double)total_samples / AZ_AUDIO_RATE,
+         total_seconds, num_clipped_sounds);
+  return EXIT_SUCCESS;
+}
+
+/*===========================================================================*/
+
+// Sets *exists_out to false (and returns true) if the file doesn't exist.
+// Returns false if the file exists but can't be read.
+static bool read_wav(const char *path, bool *exists_out, int16_t **samples_out,
+                     size_t *num_samples_out) {
+  *exists_out = false;
+  *samples_out = NULL;
+  *num_samples_out = 0;
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) return true;
+  *exists_out = true;
+  const bool success = az_read_wav_file(file, samples_out, num_samples_out);
+  fclose(file);
+  if (!success) fprintf(stderr, "ERROR: failed to read %s.\n", path);
+  return success;
+}
+
+// Returns the RMS difference between the two sounds (padding the shorter one
+// with silence), as a fraction of full scale.
+static double rms_error(const int16_t *samples1, size_t num_samples1,
+                        const int16_t *samples2, size_t num_samples2) {
+  const size_t num_samples =
+    (num_samples1 > num_samples2 ? num_samples1 : num_samples2);
+  if (num_samples == 0) return 0.0;
+  double sum = 0.0;
+  for (size_t i = 0; i < num_samples; ++i) {
+    const double sample1 = (i < num_samples1 ? samples1[i] : 0);
+    const double sample2 = (i < num_samples2 ? samples2[i] : 0);
+    sum += (sample1 - sample2) * (sample1 - sample2);
+  }
+  return sqrt(sum / num_samples) / MAX_SAMPLE_MAGNITUDE;
+}
+
+// Compares the sounds exported (by export_sounds) to two directories, e.g.
+// before and after changing the sound specs or the synthesizer, and reports
+// each sound that differs.
+static int diff_sounds(const char *old_dir, const char *new_dir) {
+  int num_differ = 0;
+  bool success = true;
+  for (int i = 1; i <= AZ_NUM_SOUND_KEYS && success; ++i) {
+    char *old_path = wav_path_for_key(old_dir, i);
+    char *new_path = wav_path_for_key(new_dir, i);
+    bool has_old = false, has_new = false;
+    int16_t *old_samples = NULL, *new_samples = NULL;
+    size_t num_old_samples = 0, num_new_samples = 0;
+    success = (read_wav(old_path, &has_old, &old_samples,
+                        &num_old_samples) &&
+               read_wav(new_path, &has_new, &new_samples, &num_new_samples));
+    // If neither file exists (or both are empty), the sample arrays are NULL
+    // and there's nothing to compare.
+    if (success && has_old != has_new) {
+      printf("sound%03d: only in %s\n", i, has_old ? old_dir : new_dir);
+      ++num_differ;
+    } else if (success &&
+               (num_old_samples != num_new_samples ||
+                (num_old_samples > 0 &&
+                 memcmp(old_samples, new_samples,
+                        num_old_samples * sizeof(int16_t)) != 0))) {
+      printf("sound%03d: %zu -> %zu samples, RMS error %.3f%%\n", i,
+             num_old_samples, num_new_samples,
+             100.0 * rms_error(old_samples, num_old_samples,
+                               new_samples, num_new_samples));
+      ++num_differ;
+    }
+    az_free(old_samples);
+    az_free(new_samples);
+    az_free(old_path);
+    az_free(new_path);
+  }
+  if (!success) return EXIT_FAILURE;
+  printf("%d of %d sounds differ\n", num_differ, AZ_NUM_SOUND_KEYS);
+  return EXIT_SUCCESS;
+}
+
+/*===========================================================================*/
+
+static int usage(const char *program_name) {
+  fprintf(stderr, "Usage: %s [output_dir]\n"
+          "       %s --diff old_dir new_dir\n",
+          program_name, program_name);
+  return EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+  if (argc >= 2 && strcmp(argv[1], "--diff") == 0) {
+    if (argc != 4) return usage(argv[0]);
+    return diff_sounds(argv[2], argv[3]);
+  }
+  if (argc > 2 || (argc == 2 && argv[1][0] == '-')) return usage(argv[0]);
+  return export_sounds(argc == 2 ? argv[1] : NULL);
+}
+
+/*===========================================================================*/